@@ -0,0 +1,92 @@
+#include "access_control.h"
+#include <string.h>
+
+#define USER_TYPE_ADMIN 1
+
+AccessResult AccessControl::scan(AccessDecision &decision)
+{
+    memset(&decision, 0, sizeof(decision));
+    TraceLap lap(trace, clock);
+
+    // Empty polls are not traced, they would drown the real scans
+    uint8_t p = sensor.getImage();
+    if (p == FINGERPRINT_NOFINGER)
+    {
+        return decision.result = ACCESS_NO_FINGER;
+    }
+    lap.mark(TRACE_GET_IMAGE);
+    if (p != FINGERPRINT_OK)
+    {
+        return decision.result = ACCESS_SENSOR_ERROR;
+    }
+
+    p = sensor.image2Tz();
+    lap.mark(TRACE_IMAGE2TZ);
+    if (p != FINGERPRINT_OK)
+    {
+        return decision.result = ACCESS_BAD_IMAGE;
+    }
+
+    p = sensor.fingerSearch();
+    lap.mark(TRACE_SEARCH);
+    if (p == FINGERPRINT_NOTFOUND)
+    {
+        return decision.result = ACCESS_NO_MATCH;
+    }
+    if (p != FINGERPRINT_OK)
+    {
+        return decision.result = ACCESS_SENSOR_ERROR;
+    }
+
+    decision.punchingId = sensor.fingerID();
+    decision.timestamp = clock.unixTime();
+
+    bool found = lookup(decision.punchingId, decision.member, lookupCtx);
+    lap.mark(TRACE_LOOKUP);
+    if (!found)
+    {
+        return decision.result = ACCESS_UNKNOWN_MEMBER;
+    }
+
+    decision.result = authorize(decision.member, decision.timestamp) ? ACCESS_GRANTED : ACCESS_DENIED;
+    lap.mark(TRACE_AUTHORIZE);
+
+    // Open the door first, logging and publishing come after
+    if (decision.result == ACCESS_GRANTED && lock != nullptr)
+    {
+        lock->unlock();
+    }
+    lap.total(TRACE_DECISION);
+    return decision.result;
+}
+
+bool AccessControl::authorize(const MemberEntry &member, uint32_t now)
+{
+    if (member.userType == USER_TYPE_ADMIN)
+    {
+        return true;
+    }
+    return member.subsEndInSec >= now;
+}
+
+const char *AccessControl::resultName(AccessResult result)
+{
+    switch (result)
+    {
+    case ACCESS_NO_FINGER:
+        return "noFinger";
+    case ACCESS_SENSOR_ERROR:
+        return "sensorError";
+    case ACCESS_BAD_IMAGE:
+        return "badImage";
+    case ACCESS_NO_MATCH:
+        return "noMatch";
+    case ACCESS_UNKNOWN_MEMBER:
+        return "unknownMember";
+    case ACCESS_GRANTED:
+        return "granted";
+    case ACCESS_DENIED:
+        return "denied";
+    }
+    return "unknown";
+}
@@ -0,0 +1,63 @@
+#ifndef ACCESS_CONTROL_H
+#define ACCESS_CONTROL_H
+
+#include <stdint.h>
+#include "hal_fingerprint.h"
+#include "hal_clock.h"
+#include "member_index.h"
+#include "latency_trace.h"
+#include "lock_actuator.h"
+
+enum AccessResult
+{
+    ACCESS_NO_FINGER = 0,
+    ACCESS_SENSOR_ERROR,
+    ACCESS_BAD_IMAGE,      // image2Tz failed, finger should be placed again
+    ACCESS_NO_MATCH,       // No template on the sensor matches
+    ACCESS_UNKNOWN_MEMBER, // Template matched a slot without a member
+    ACCESS_GRANTED,
+    ACCESS_DENIED,         // Subscription expired
+};
+
+struct AccessDecision
+{
+    AccessResult result;
+    uint16_t punchingId;
+    uint32_t timestamp;
+    MemberEntry member; // Valid for ACCESS_GRANTED and ACCESS_DENIED
+};
+
+// Copy the member for a punching ID, false when there is none. Lets the
+// firmware take its own lock around the index.
+typedef bool (*MemberLookup)(uint16_t punchingId, MemberEntry &entry, void *ctx);
+
+// One scan of the fingerprint sensor up to the access decision. Does no
+// storage or network I/O, so it can run on the sensor task or on a host.
+// With a lock set, a grant unlocks the door before scan() returns.
+class AccessControl
+{
+public:
+    AccessControl(hal::FingerprintSensor &sensor, hal::Clock &clock, MemberLookup lookup, void *lookupCtx)
+        : sensor(sensor), clock(clock), lookup(lookup), lookupCtx(lookupCtx) {}
+
+    AccessResult scan(AccessDecision &decision);
+
+    // Time each step of scan() into `trace`
+    void setTrace(LatencyTrace *trace) { this->trace = trace; }
+    void setLock(LockActuator *lock) { this->lock = lock; }
+
+    // Admins always get in, members until the end of their subscription
+    static bool authorize(const MemberEntry &member, uint32_t now);
+
+    static const char *resultName(AccessResult result);
+
+private:
+    hal::FingerprintSensor &sensor;
+    hal::Clock &clock;
+    MemberLookup lookup;
+    void *lookupCtx;
+    LatencyTrace *trace = nullptr;
+    LockActuator *lock = nullptr;
+};
+
+#endif
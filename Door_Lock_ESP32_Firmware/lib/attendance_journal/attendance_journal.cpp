@@ -0,0 +1,125 @@
+#include "attendance_journal.h"
+#include "crc16.h"
+#include "civil_time.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// Records read per flash access while replaying a day
+#define ATTENDANCE_BATCH 16
+
+static uint16_t recordCrc(const AttendanceRecord &record)
+{
+    return crc16Ccitt(&record, offsetof(AttendanceRecord, crc));
+}
+
+void AttendanceJournal::dayPath(uint32_t timestamp, char *path, size_t size) const
+{
+    CivilDate date = civilFromDays(timestamp / 86400);
+    snprintf(path, size, "%s/%04d%02u%02u.bin", dir, (int)date.year, (unsigned)date.month, (unsigned)date.day);
+}
+
+bool AttendanceJournal::append(uint16_t punchingId, uint32_t timestamp, uint8_t direction)
+{
+    char path[ATTENDANCE_PATH_LEN];
+    dayPath(timestamp, path, sizeof(path));
+
+    // A power cut during the previous append leaves a partial record.
+    // Pad it to a full (invalid) record so later ones stay aligned.
+    uint8_t data[2 * sizeof(AttendanceRecord)];
+    size_t partial = fileSystem.size(path) % sizeof(AttendanceRecord);
+    size_t pad = partial != 0 ? sizeof(AttendanceRecord) - partial : 0;
+    memset(data, 0xFF, pad);
+
+    AttendanceRecord record;
+    record.timestamp = timestamp;
+    record.punchingId = punchingId;
+    record.direction = direction;
+    record.reserved = 0;
+    record.crc = recordCrc(record);
+
+    memcpy(&data[pad], &record, sizeof(record));
+    size_t length = pad + sizeof(record);
+    if (fileSystem.append(path, data, length) != length)
+    {
+        return false;
+    }
+
+    if (timestamp / 86400 == insideDay)
+    {
+        if (direction == ATTENDANCE_IN)
+        {
+            inside.set(punchingId);
+        }
+        else
+        {
+            inside.reset(punchingId);
+        }
+    }
+    return true;
+}
+
+static bool replayDirection(const AttendanceRecord &record, void *ctx)
+{
+    SlotBitmap &inside = *static_cast<SlotBitmap *>(ctx);
+    if (record.direction == ATTENDANCE_IN)
+    {
+        inside.set(record.punchingId);
+    }
+    else
+    {
+        inside.reset(record.punchingId);
+    }
+    return true;
+}
+
+void AttendanceJournal::loadDay(uint32_t timestamp)
+{
+    inside.clear();
+    forEachOfDay(timestamp, replayDirection, &inside);
+    insideDay = timestamp / 86400;
+}
+
+uint8_t AttendanceJournal::nextDirection(uint16_t punchingId, uint32_t timestamp)
+{
+    if (timestamp / 86400 != insideDay)
+    {
+        loadDay(timestamp);
+    }
+    return inside.test(punchingId) ? ATTENDANCE_OUT : ATTENDANCE_IN;
+}
+
+bool AttendanceJournal::forEachOfDay(uint32_t timestamp, AttendanceVisitor visitor, void *ctx)
+{
+    char path[ATTENDANCE_PATH_LEN];
+    dayPath(timestamp, path, sizeof(path));
+
+    if (!fileSystem.exists(path))
+    {
+        return true;
+    }
+
+    AttendanceRecord batch[ATTENDANCE_BATCH];
+    size_t offset = 0;
+    size_t got;
+
+    while ((got = fileSystem.readAt(path, offset, batch, sizeof(batch))) >= sizeof(AttendanceRecord))
+    {
+        offset += got;
+        size_t count = got / sizeof(AttendanceRecord);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (batch[i].crc != recordCrc(batch[i]))
+            {
+                corrupt++;
+                continue;
+            }
+            if (!visitor(batch[i], ctx))
+            {
+                return true;
+            }
+        }
+    }
+
+    return true;
+}
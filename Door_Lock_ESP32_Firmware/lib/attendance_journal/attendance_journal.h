@@ -0,0 +1,59 @@
+#ifndef ATTENDANCE_JOURNAL_H
+#define ATTENDANCE_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal_fs.h"
+#include "slot_bitmap.h"
+
+#define ATTENDANCE_IN  0
+#define ATTENDANCE_OUT 1
+
+#define ATTENDANCE_PATH_LEN 40
+
+// One punch as stored on flash. Files are /attendance/YYYYMMDD.bin and are
+// only ever appended to, so a punch costs one small write.
+struct __attribute__((packed)) AttendanceRecord
+{
+    uint32_t timestamp;
+    uint16_t punchingId;
+    uint8_t direction;
+    uint8_t reserved;
+    uint16_t crc; // CRC-16 of the preceding bytes
+};
+
+static_assert(sizeof(AttendanceRecord) == 10, "AttendanceRecord layout changed");
+
+// Return false from the visitor to stop iterating
+typedef bool (*AttendanceVisitor)(const AttendanceRecord &record, void *ctx);
+
+class AttendanceJournal
+{
+public:
+    AttendanceJournal(hal::FileSystem &fileSystem, const char *dir) : fileSystem(fileSystem), dir(dir) {}
+
+    bool append(uint16_t punchingId, uint32_t timestamp, uint8_t direction);
+
+    // IN for a member's first punch of the day, then alternating. The day
+    // file is replayed once, later punches are answered from RAM.
+    uint8_t nextDirection(uint16_t punchingId, uint32_t timestamp);
+
+    // Visit every intact record of the day containing `timestamp`
+    bool forEachOfDay(uint32_t timestamp, AttendanceVisitor visitor, void *ctx);
+
+    void dayPath(uint32_t timestamp, char *path, size_t size) const;
+
+    uint32_t corruptRecords() const { return corrupt; }
+
+private:
+    void loadDay(uint32_t timestamp);
+
+    hal::FileSystem &fileSystem;
+    const char *dir;
+    uint32_t corrupt = 0;
+
+    SlotBitmap inside;               // Members whose last punch of insideDay was IN
+    uint32_t insideDay = UINT32_MAX; // Unix day `inside` was loaded for
+};
+
+#endif
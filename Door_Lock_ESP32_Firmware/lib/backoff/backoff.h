@@ -0,0 +1,44 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+// Exponential backoff with "equal jitter": each delay is half the current
+// window plus a random part of the other half, so a fleet that lost the
+// same broker does not reconnect in lockstep.
+class Backoff
+{
+public:
+    Backoff(uint32_t baseMs, uint32_t maxMs) : baseMs(baseMs), maxMs(maxMs) {}
+
+    // Delay before the next attempt; `random` is any 32-bit random value
+    uint32_t next(uint32_t random)
+    {
+        uint32_t window = baseMs;
+        for (uint8_t i = 0; i < failures && window < maxMs; i++)
+        {
+            window *= 2;
+        }
+        if (window > maxMs)
+        {
+            window = maxMs;
+        }
+        if (failures < 255)
+        {
+            failures++;
+        }
+
+        uint32_t half = window / 2;
+        return half + (half > 0 ? random % (half + 1) : 0);
+    }
+
+    void reset() { failures = 0; }
+    uint8_t attempts() const { return failures; }
+
+private:
+    uint32_t baseMs;
+    uint32_t maxMs;
+    uint8_t failures = 0;
+};
+
+#endif
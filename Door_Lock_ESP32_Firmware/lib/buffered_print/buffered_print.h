@@ -0,0 +1,53 @@
+#ifndef BUFFERED_PRINT_H
+#define BUFFERED_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal_mqtt.h"
+
+#define BUFFERED_PRINT_SIZE 128
+
+// Collects small writes (ArduinoJson emits one token at a time) into
+// fixed chunks before passing them to the transport's streamed publish.
+// ArduinoJson takes it as a custom writer, so it needs no Print base.
+class BufferedPrint
+{
+public:
+    explicit BufferedPrint(hal::MqttTransport &target) : target(target) {}
+    ~BufferedPrint() { flush(); }
+
+    size_t write(uint8_t c)
+    {
+        if (used == sizeof(buffer))
+        {
+            flush();
+        }
+        buffer[used++] = c;
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            write(data[i]);
+        }
+        return size;
+    }
+
+    void flush()
+    {
+        if (used > 0)
+        {
+            target.write(buffer, used);
+            used = 0;
+        }
+    }
+
+private:
+    hal::MqttTransport &target;
+    uint8_t buffer[BUFFERED_PRINT_SIZE];
+    size_t used = 0;
+};
+
+#endif
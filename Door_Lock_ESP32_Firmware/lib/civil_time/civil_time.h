@@ -0,0 +1,272 @@
+#ifndef CIVIL_TIME_H
+#define CIVIL_TIME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Calendar arithmetic and ISO-8601 parsing on plain character spans.
+// Nothing here allocates and everything is constexpr, so dates known at
+// compile time cost nothing at run time.
+
+struct CivilDate
+{
+    int32_t year;
+    uint8_t month; // 1-12
+    uint8_t day;   // 1-31
+};
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's algorithm)
+constexpr int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day)
+{
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yoe = (uint32_t)(year - era * 400);
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+constexpr CivilDate civilFromDays(int32_t days)
+{
+    days += 719468;
+    int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t doe = (uint32_t)(days - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+    return {(int32_t)yoe + era * 400 + (month <= 2), (uint8_t)month, (uint8_t)(doy - (153 * mp + 2) / 5 + 1)};
+}
+
+constexpr bool isLeapYear(int32_t year)
+{
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+constexpr uint8_t daysInMonth(int32_t year, uint32_t month)
+{
+    return month == 2 ? (isLeapYear(year) ? 29 : 28) : (month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31;
+}
+
+enum IsoParseStatus
+{
+    ISO_OK = 0,
+    ISO_BAD_FORMAT,   // Not an ISO-8601 date or date-time
+    ISO_OUT_OF_RANGE, // Well formed, but no such date or time
+};
+
+struct IsoDateTime
+{
+    CivilDate date;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint16_t millisecond;
+    int32_t offsetSeconds; // East of UTC, when hasOffset
+    bool hasTime;
+    bool hasOffset;
+};
+
+namespace civil_detail
+{
+
+// Reads exactly `count` digits at `pos`
+constexpr bool digits(const char *text, size_t length, size_t &pos, size_t count, uint32_t &value)
+{
+    if (pos + count > length)
+    {
+        return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        char c = text[pos + i];
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (uint32_t)(c - '0');
+    }
+    pos += count;
+    return true;
+}
+
+constexpr bool at(const char *text, size_t length, size_t pos, char c)
+{
+    return pos < length && text[pos] == c;
+}
+
+} // namespace civil_detail
+
+// Accepts YYYY-MM-DD or YYYYMMDD, optionally followed by 'T' or ' ' and
+// hh:mm[:ss[.fff]] (or hhmm[ss]), then 'Z' or +hh[:mm] / -hh[:mm].
+// The whole span must be consumed; a trailing NUL ends it early.
+constexpr IsoParseStatus isoParse(const char *text, size_t length, IsoDateTime &out)
+{
+    using civil_detail::at;
+    using civil_detail::digits;
+
+    out = {};
+    for (size_t i = 0; i < length; i++)
+    {
+        if (text[i] == '\0')
+        {
+            length = i;
+        }
+    }
+
+    size_t pos = 0;
+    uint32_t year = 0, month = 0, day = 0;
+    if (!digits(text, length, pos, 4, year))
+    {
+        return ISO_BAD_FORMAT;
+    }
+    bool extended = at(text, length, pos, '-');
+    pos += extended;
+    if (!digits(text, length, pos, 2, month) || (extended && !at(text, length, pos++, '-')) ||
+        !digits(text, length, pos, 2, day))
+    {
+        return ISO_BAD_FORMAT;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth((int32_t)year, month))
+    {
+        return ISO_OUT_OF_RANGE;
+    }
+    out.date = {(int32_t)year, (uint8_t)month, (uint8_t)day};
+
+    if (pos == length)
+    {
+        return ISO_OK;
+    }
+    if (!at(text, length, pos, 'T') && !at(text, length, pos, ' '))
+    {
+        return ISO_BAD_FORMAT;
+    }
+    pos++;
+
+    uint32_t hour = 0, minute = 0, second = 0, fraction = 0;
+    if (!digits(text, length, pos, 2, hour) || (extended && !at(text, length, pos++, ':')) ||
+        !digits(text, length, pos, 2, minute))
+    {
+        return ISO_BAD_FORMAT;
+    }
+    bool hasSeconds = extended ? at(text, length, pos, ':') : pos < length && text[pos] >= '0' && text[pos] <= '9';
+    if (hasSeconds)
+    {
+        pos += extended;
+        if (!digits(text, length, pos, 2, second))
+        {
+            return ISO_BAD_FORMAT;
+        }
+        if (at(text, length, pos, '.') || at(text, length, pos, ','))
+        {
+            pos++;
+            size_t first = pos;
+            uint32_t scale = 100;
+            while (pos < length && text[pos] >= '0' && text[pos] <= '9')
+            {
+                fraction += (uint32_t)(text[pos] - '0') * scale; // Digits past milliseconds are dropped
+                scale /= 10;
+                pos++;
+            }
+            if (pos == first)
+            {
+                return ISO_BAD_FORMAT;
+            }
+        }
+    }
+    // 24:00:00 is not accepted, leap seconds are
+    if (hour > 23 || minute > 59 || second > 60)
+    {
+        return ISO_OUT_OF_RANGE;
+    }
+    out.hour = (uint8_t)hour;
+    out.minute = (uint8_t)minute;
+    out.second = (uint8_t)second;
+    out.millisecond = (uint16_t)fraction;
+    out.hasTime = true;
+
+    if (pos == length)
+    {
+        return ISO_OK;
+    }
+    if (at(text, length, pos, 'Z'))
+    {
+        out.hasOffset = true;
+        return pos + 1 == length ? ISO_OK : ISO_BAD_FORMAT;
+    }
+    if (!at(text, length, pos, '+') && !at(text, length, pos, '-'))
+    {
+        return ISO_BAD_FORMAT;
+    }
+    bool west = text[pos++] == '-';
+    uint32_t offsetHour = 0, offsetMinute = 0;
+    if (!digits(text, length, pos, 2, offsetHour))
+    {
+        return ISO_BAD_FORMAT;
+    }
+    if (pos < length)
+    {
+        pos += at(text, length, pos, ':');
+        if (!digits(text, length, pos, 2, offsetMinute) || pos != length)
+        {
+            return ISO_BAD_FORMAT;
+        }
+    }
+    if (offsetHour > 14 || offsetMinute > 59)
+    {
+        return ISO_OUT_OF_RANGE;
+    }
+    int32_t offset = (int32_t)(offsetHour * 3600 + offsetMinute * 60);
+    out.offsetSeconds = west ? -offset : offset;
+    out.hasOffset = true;
+    return ISO_OK;
+}
+
+constexpr size_t isoLength(const char *text)
+{
+    size_t length = 0;
+    while (text[length] != '\0')
+    {
+        length++;
+    }
+    return length;
+}
+
+// Seconds since 1970 on the clock of `localOffsetSeconds`. A value with its
+// own offset is converted to it; one without is taken as already local.
+constexpr int64_t isoLocalSeconds(const IsoDateTime &value, int32_t localOffsetSeconds)
+{
+    int64_t seconds = (int64_t)daysFromCivil(value.date.year, value.date.month, value.date.day) * 86400 +
+                      value.hour * 3600 + value.minute * 60 + value.second;
+    return value.hasOffset ? seconds - value.offsetSeconds + localOffsetSeconds : seconds;
+}
+
+// Local midnight of the day the date-time falls on, 0 for a parse error
+constexpr uint32_t isoDayStart(const char *text, size_t length, int32_t localOffsetSeconds)
+{
+    IsoDateTime value = {};
+    if (text == nullptr || isoParse(text, length, value) != ISO_OK || value.date.year < 1970 || value.date.year > 2105)
+    {
+        return 0;
+    }
+    int64_t seconds = isoLocalSeconds(value, localOffsetSeconds);
+    if (seconds < 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(seconds - seconds % 86400);
+}
+
+constexpr uint32_t isoDayStart(const char *text, int32_t localOffsetSeconds)
+{
+    return text == nullptr ? 0 : isoDayStart(text, isoLength(text), localOffsetSeconds);
+}
+
+static_assert(daysFromCivil(1970, 1, 1) == 0, "civil epoch");
+static_assert(daysFromCivil(2000, 3, 1) == 11017, "civil leap century");
+static_assert(civilFromDays(11016).day == 29, "civil 2000-02-29");
+static_assert(isoDayStart("2025-06-08", 0) == 1749340800, "ISO date");
+static_assert(isoDayStart("2025-06-07T20:00:00Z", 19800) == 1749340800, "ISO offset");
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// FIFO of preallocated command buffers between mqttCallback() and the
+// dispatcher in loop(). Payloads are copied once into a free slot and
+// handed out in arrival order; nothing is allocated after boot.
+template <size_t SLOTS, size_t SLOT_SIZE>
+class CommandQueue
+{
+public:
+    // Copies the payload, false when every slot is taken or it does not fit
+    bool push(const uint8_t *payload, size_t length)
+    {
+        if (length > SLOT_SIZE)
+        {
+            oversizedCount++;
+            return false;
+        }
+        if (count == SLOTS)
+        {
+            droppedCount++;
+            return false;
+        }
+
+        size_t slot = (head + count) % SLOTS;
+        memcpy(buffers[slot], payload, length);
+        buffers[slot][length] = '\0';
+        lengths[slot] = length;
+        count++;
+
+        if (count > peakCount)
+        {
+            peakCount = count;
+        }
+        return true;
+    }
+
+    // Oldest command, null terminated; valid until pop()
+    const char *front(size_t &length) const
+    {
+        if (count == 0)
+        {
+            return nullptr;
+        }
+        length = lengths[head];
+        return buffers[head];
+    }
+
+    void pop()
+    {
+        if (count > 0)
+        {
+            head = (head + 1) % SLOTS;
+            count--;
+        }
+    }
+
+    size_t depth() const { return count; }
+    size_t capacity() const { return SLOTS; }
+    size_t peak() const { return peakCount; }
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t oversized() const { return oversizedCount; }
+
+private:
+    char buffers[SLOTS][SLOT_SIZE + 1];
+    size_t lengths[SLOTS] = {};
+    size_t head = 0;
+    size_t count = 0;
+    size_t peakCount = 0;
+    uint32_t droppedCount = 0;
+    uint32_t oversizedCount = 0;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "command_router.h"
+#include <string.h>
+#include "wire_format.h"
+
+CommandStatus CommandRouter::dispatch(const uint8_t *payload, size_t length)
+{
+    if (length == 0)
+    {
+        return COMMAND_EMPTY;
+    }
+
+    JsonDocument doc(allocator);
+    error = wireDeserialize(doc, payload, length);
+    if (error)
+    {
+        return error == DeserializationError::NoMemory ? COMMAND_ERR_MEMORY : COMMAND_ERR_PARSE;
+    }
+
+    const char *type = doc["type"] | "";
+    for (size_t i = 0; i < routeCount; i++)
+    {
+        if (strcmp(type, routes[i].type) == 0)
+        {
+            routes[i].handler(doc, ctx);
+            return COMMAND_OK;
+        }
+    }
+    if (fallback != nullptr)
+    {
+        fallback(doc, ctx);
+    }
+    return COMMAND_UNKNOWN;
+}
+
+const char *CommandRouter::statusName(CommandStatus status)
+{
+    switch (status)
+    {
+    case COMMAND_OK:
+        return "ok";
+    case COMMAND_EMPTY:
+        return "empty";
+    case COMMAND_ERR_PARSE:
+        return "parse";
+    case COMMAND_ERR_MEMORY:
+        return "memory";
+    case COMMAND_UNKNOWN:
+        return "unknown command";
+    case COMMAND_STATUS_COUNT:
+        break;
+    }
+    return "unknown";
+}
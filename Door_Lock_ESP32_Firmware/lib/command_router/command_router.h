@@ -0,0 +1,58 @@
+#ifndef COMMAND_ROUTER_H
+#define COMMAND_ROUTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+
+enum CommandStatus
+{
+    COMMAND_OK = 0,
+    COMMAND_EMPTY,
+    COMMAND_ERR_PARSE,
+    COMMAND_ERR_MEMORY, // Document did not fit the allocator
+    COMMAND_UNKNOWN,    // No route for the type, the fallback was called
+    COMMAND_STATUS_COUNT
+};
+
+// `ctx` is the one given to the router, so handlers need not reach for globals
+typedef void (*CommandHandler)(JsonDocument &doc, void *ctx);
+
+struct CommandRoute
+{
+    const char *type;
+    CommandHandler handler;
+};
+
+// Parses a command in either wire encoding and calls the handler for its
+// "type". The document lives in `allocator` and is gone once dispatch()
+// returns, so a handler that replies must do it before returning.
+class CommandRouter
+{
+public:
+    CommandRouter(const CommandRoute *routes, size_t routeCount, CommandHandler fallback,
+                  ArduinoJson::Allocator *allocator, void *ctx)
+        : routes(routes), routeCount(routeCount), fallback(fallback), allocator(allocator), ctx(ctx) {}
+
+    template <size_t N>
+    CommandRouter(const CommandRoute (&routes)[N], CommandHandler fallback, ArduinoJson::Allocator *allocator,
+                  void *ctx)
+        : CommandRouter(routes, N, fallback, allocator, ctx) {}
+
+    CommandStatus dispatch(const uint8_t *payload, size_t length);
+
+    // Parser error of the last COMMAND_ERR_PARSE
+    const char *parseError() const { return error.c_str(); }
+
+    static const char *statusName(CommandStatus status);
+
+private:
+    const CommandRoute *routes;
+    size_t routeCount;
+    CommandHandler fallback;
+    ArduinoJson::Allocator *allocator;
+    void *ctx;
+    DeserializationError error;
+};
+
+#endif
@@ -1,7 +1,11 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <stdint.h> // Native tests use the same values
+#endif
 
 #define MQTT_MAX_BUFFER_SIZE 1024
 uint16_t MAX_CAPACITY  = 1000;
@@ -17,9 +21,100 @@ uint16_t MAX_CAPACITY  = 1000;
 #define TIME_SYNC_DELAY 86400000
 #define TIME_OFFSET     19800   //Time offset for India
 
+// Software clock, see lib/system_time
+#define SYSTIME_SLEW_MAX_PPM       500     //Rate offsets are worked off at (1 s takes ~33 min)
+#define SYSTIME_STEP_THRESHOLD_MS  2000    //Behind by more is stepped, ahead by more is slewed faster
+#define SYSTIME_AHEAD_SLEW_PPM     100000  //Rate a lead beyond the threshold is worked off at (1 min takes 10 min)
+#define SYSTIME_STEP_BACK_MS       3600000 //Ahead by more is stepped back and reported
+#define SYSTIME_DRIFT_MAX_PPM      200
+#define SYSTIME_DRIFT_BASELINE_S   600     //Shortest span between RTC edges used for drift
+#define SYSTIME_RTC_SAMPLE_MS      600000  //Search for an RTC second edge every 10 minutes
+#define SYSTIME_EDGE_POLL_MS       5       //RTC reads while searching for the edge
+#define SYSTIME_EDGE_TOLERANCE_US  20000   //Edge must be pinned down this closely
+#define SYSTIME_EDGE_SEARCH_MS     3000    //Give up on a search after this
+#define SYSTIME_NTP_TOLERANCE_US   600000  //NTPClient only has whole seconds
+
+// Fingerprint enrollment
+#define ENROLL_CAPTURE_TIMEOUT_MS 30000 //Max wait for a finger on the sensor
+#define ENROLL_LIFT_TIMEOUT_MS    15000 //Max wait for the finger to be lifted
+#define ENROLL_POLL_INTERVAL_MS   50    //Gap between sensor polls while enrolling
+
+// Fingerprint task
+#define FP_TASK_CORE        0    //Loop runs on core 1, keep the sensor off it
+#define FP_TASK_PRIORITY    10   //Above loop(), below the WiFi/lwIP tasks
+#define FP_TASK_STACK       6144
+#define FP_SCAN_INTERVAL_MS 20   //Gap between getImage polls
+#define FP_EVENT_QUEUE_LEN  16   //Access events waiting for loop(), power of two
+#define FP_TOUCH_PIN         -1    //Sensor touch/wakeup output (e.g. 4), -1 when not wired
+#define FP_TOUCH_ACTIVE_HIGH true  //Level of the touch output while a finger is on it
+#define FP_TOUCH_BURST_MS    1500  //Fast polling after a touch or a detected finger
+#define FP_IDLE_POLL_MS      150   //Polling period when there is no touch line
+#define FP_IDLE_WAKE_MS      100   //Task wake-up while waiting for a touch (door contact)
+#define FP_TOUCH_FALLBACK_MS 1000  //Poll anyway this long after the last scan if no touch edge came
+
+// Wi-Fi station connect
+#define WIFI_CONNECT_TIMEOUT_MS      10000 //Full connect: scan, then join
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000  //Join the cached BSSID/channel before falling back to a scan
+#define WIFI_CACHE_IP                false //Also reuse the last DHCP lease (only with reserved leases)
+#define WIFI_BACKOFF_BASE_MS         2000  //First retry window after a failed attempt
+#define WIFI_BACKOFF_MAX_MS          60000
+#define WIFI_AP_FALLBACK_FAILURES    3     //Failed attempts in a row before the setup AP comes up
+#define WIFI_AP_LINGER_MS            30000 //Setup AP kept after joining, so the page can show success
+#define WIFI_SCAN_MAX                20    //Networks kept for the setup page
+
+// Inbound commands buffered between mqttCallback() and the dispatcher.
+// PubSubClient::loop() hands over at most one packet per call and loop()
+// dispatches the queue before calling it again, so one slot is all it
+// fills. A command that finds it full is refused with a busy reply and
+// counted (test_command_queue).
+#define CMD_QUEUE_SLOTS 1 //Each slot holds MQTT_MAX_BUFFER_SIZE bytes
+
+// Bulk member import (importMembers command)
+#define MEMBER_IMPORT_TIMEOUT_MS 60000 //An open import is dropped after this long without a chunk
+#define MEMBER_LOG_SLOTS         256   //Member changes kept for syncMembers, 36 bytes each
+
+// Memory
+#define JSON_ARENA_SIZE          8192    //JsonDocuments of one request, kept out of the heap
+#define HEAP_CHECK_INTERVAL_MS   30000
+#define HEAP_HISTORY_SLOTS       24      //Samples kept for the "heap" command
+#define HEAP_HISTORY_INTERVAL_MS 3600000 //One sample per hour
+#define HEAP_LOW_WARN_BYTES      10000
+#define METRICS_PUBLISH_INTERVAL_MS 60000 //Compact metrics message on the telemetry topic
+#define HEAP_FRAGMENTATION_WARN  75      //% of free heap outside the largest block (the ESP32 heap is split in regions, ~40% is normal)
+
+// MQTT reconnect
+#define MQTT_CONNECT_TIMEOUT_S  3       //Max time one connect attempt may take
+#define MQTT_BACKOFF_BASE_MS    1000    //First retry window
+#define MQTT_BACKOFF_MAX_MS     60000   //Retry window cap
+#define MQTT_TASK_STACK         4096
+
+// Store-and-forward outbox for attendance and command results
+#define OUTBOX_SLOTS              128   //Messages kept on flash (256 bytes each)
+#define OUTBOX_DROP_OLDEST        true  //When full: overwrite oldest (true) or reject newest (false)
+#define OUTBOX_DRAIN_BATCH        5     //Messages published per drain
+#define OUTBOX_DRAIN_INTERVAL_MS  200   //Gap between drains
+
+// Door lock relay and door contact
+#define LOCK_RELAY_PIN         25
+#define LOCK_RELAY_ACTIVE_HIGH true
+#define DOOR_SENSOR_PIN        LOCK_NO_PIN //Reed contact to GND (e.g. 27), LOCK_NO_PIN if not fitted
+#define DOOR_OPEN_HIGH         true  //Pull-up reads HIGH once the magnet moves away
+#define LOCK_PULSE_MS          3000  //Unlock time when nobody opens the door
+#define LOCK_RELOCK_DELAY_MS   500   //Relock this long after the door closes
+#define LOCK_MAX_OPEN_MS       30000 //Relock and raise an alarm if the door is still open after this
+
+// Access path latency histograms (built with -D LATENCY_TRACE=1)
+#define LATENCY_REPORT_INTERVAL_MS 300000 //Telemetry publish period
+
 //Error code
-#define F_SEN_COMMU -1   //Error: Cannot communicate with sensor
-#define F_SEN_FULL  -2   //Error: Fingerprint sensor storage is full
+#define F_OK            0  //Enrollment started or finished
+#define F_SEN_COMMU     -1 //Error: Cannot communicate with sensor
+#define F_SEN_FULL      -2 //Error: Fingerprint sensor storage is full
+#define F_ENROLL_BUSY   -3 //Error: Another enrollment is in progress
+#define F_NO_USER_ID    -4 //Error: Request has no userId
+#define F_ENROLL_FAILED -5 //Error: Sensor did not take the finger
+#define F_STORE_FAILED  -6 //Error: Member could not be saved
+#define F_USER_ID_LONG  -7 //Error: userId longer than MEMBER_USER_ID_LEN - 1 characters
 #define SPIFFS_READ -2;  //Unable to read file from SPIFFS
 
 #if (DEBUG == true)
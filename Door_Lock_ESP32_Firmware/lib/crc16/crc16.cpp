@@ -0,0 +1,16 @@
+#include "crc16.h"
+
+uint16_t crc16Ccitt(const void *data, size_t length, uint16_t crc)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    while (length--)
+    {
+        crc ^= (uint16_t)(*bytes++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,10 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-16/CCITT-FALSE, used to detect torn record writes on flash
+uint16_t crc16Ccitt(const void *data, size_t length, uint16_t crc = 0xFFFF);
+
+#endif
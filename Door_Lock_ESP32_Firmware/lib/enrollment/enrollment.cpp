@@ -0,0 +1,163 @@
+#include "enrollment.h"
+
+bool Enrollment::start(uint16_t id, uint32_t nowMs)
+{
+    if (active())
+    {
+        return false;
+    }
+
+    slot = id;
+    error = FINGERPRINT_OK;
+    cancelRequested = false;
+    enter(ENROLL_CAPTURE_1, nowMs);
+    return true;
+}
+
+void Enrollment::reset()
+{
+    current = ENROLL_IDLE;
+    slot = 0;
+    cancelRequested = false;
+}
+
+void Enrollment::enter(EnrollStage next, uint32_t nowMs)
+{
+    current = next;
+    stageStartMs = nowMs;
+    lastPollMs = nowMs - pollIntervalMs;
+}
+
+// Take one image into char buffer 1 or 2. Bad images are retried until
+// the stage times out; communication errors end the enrollment.
+bool Enrollment::capture(uint8_t buffer, EnrollStage next, uint32_t nowMs)
+{
+    uint8_t p = sensor.getImage();
+    if (p == FINGERPRINT_NOFINGER || p == FINGERPRINT_IMAGEFAIL)
+    {
+        return false;
+    }
+    if (p != FINGERPRINT_OK)
+    {
+        error = p;
+        enter(ENROLL_FAILED, nowMs);
+        return true;
+    }
+
+    p = sensor.image2Tz(buffer);
+    switch (p)
+    {
+    case FINGERPRINT_OK:
+        enter(next, nowMs);
+        return true;
+    case FINGERPRINT_IMAGEMESS:
+    case FINGERPRINT_FEATUREFAIL:
+    case FINGERPRINT_INVALIDIMAGE:
+        error = p;
+        return false;
+    default:
+        error = p;
+        enter(ENROLL_FAILED, nowMs);
+        return true;
+    }
+}
+
+bool Enrollment::update(uint32_t nowMs)
+{
+    if (!active())
+    {
+        return false;
+    }
+
+    if (cancelRequested)
+    {
+        enter(ENROLL_CANCELLED, nowMs);
+        return true;
+    }
+
+    uint32_t timeout = current == ENROLL_LIFT_FINGER ? liftTimeoutMs : captureTimeoutMs;
+    if (nowMs - stageStartMs > timeout)
+    {
+        error = FINGERPRINT_TIMEOUT;
+        enter(ENROLL_TIMEOUT, nowMs);
+        return true;
+    }
+
+    if (nowMs - lastPollMs < pollIntervalMs)
+    {
+        return false;
+    }
+    lastPollMs = nowMs;
+
+    uint8_t p;
+    switch (current)
+    {
+    case ENROLL_CAPTURE_1:
+        return capture(1, ENROLL_LIFT_FINGER, nowMs);
+
+    case ENROLL_LIFT_FINGER:
+        if (sensor.getImage() != FINGERPRINT_NOFINGER)
+        {
+            return false;
+        }
+        enter(ENROLL_CAPTURE_2, nowMs);
+        return true;
+
+    case ENROLL_CAPTURE_2:
+        return capture(2, ENROLL_CREATE_MODEL, nowMs);
+
+    case ENROLL_CREATE_MODEL:
+        p = sensor.createModel();
+        if (p != FINGERPRINT_OK)
+        {
+            error = p;
+            enter(ENROLL_FAILED, nowMs);
+            return true;
+        }
+        enter(ENROLL_STORE, nowMs);
+        return true;
+
+    case ENROLL_STORE:
+        p = sensor.storeModel(slot);
+        if (p != FINGERPRINT_OK)
+        {
+            error = p;
+            enter(ENROLL_FAILED, nowMs);
+            return true;
+        }
+        error = FINGERPRINT_OK;
+        enter(ENROLL_DONE, nowMs);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+const char *Enrollment::stageName(EnrollStage stage)
+{
+    switch (stage)
+    {
+    case ENROLL_IDLE:
+        return "idle";
+    case ENROLL_CAPTURE_1:
+        return "placeFinger";
+    case ENROLL_LIFT_FINGER:
+        return "removeFinger";
+    case ENROLL_CAPTURE_2:
+        return "placeFingerAgain";
+    case ENROLL_CREATE_MODEL:
+        return "creatingModel";
+    case ENROLL_STORE:
+        return "storing";
+    case ENROLL_DONE:
+        return "done";
+    case ENROLL_FAILED:
+        return "failed";
+    case ENROLL_CANCELLED:
+        return "cancelled";
+    case ENROLL_TIMEOUT:
+        return "timeout";
+    }
+    return "unknown";
+}
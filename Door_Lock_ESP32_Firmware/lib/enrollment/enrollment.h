@@ -0,0 +1,62 @@
+#ifndef ENROLLMENT_H
+#define ENROLLMENT_H
+
+#include <stdint.h>
+#include "hal_fingerprint.h"
+
+enum EnrollStage
+{
+    ENROLL_IDLE = 0,
+    ENROLL_CAPTURE_1,
+    ENROLL_LIFT_FINGER,
+    ENROLL_CAPTURE_2,
+    ENROLL_CREATE_MODEL,
+    ENROLL_STORE,
+    ENROLL_DONE,
+    ENROLL_FAILED,
+    ENROLL_CANCELLED,
+    ENROLL_TIMEOUT,
+};
+
+// Fingerprint enrollment as a state machine. update() is called from
+// loop() and issues at most one capture (getImage + image2Tz) per call,
+// so the rest of the firmware keeps running while someone enrolls.
+class Enrollment
+{
+public:
+    Enrollment(hal::FingerprintSensor &sensor, uint32_t captureTimeoutMs, uint32_t liftTimeoutMs, uint32_t pollIntervalMs)
+        : sensor(sensor), captureTimeoutMs(captureTimeoutMs), liftTimeoutMs(liftTimeoutMs), pollIntervalMs(pollIntervalMs) {}
+
+    bool start(uint16_t id, uint32_t nowMs);
+    void cancel() { cancelRequested = true; }
+    void reset();
+
+    // Returns true when the stage changed
+    bool update(uint32_t nowMs);
+
+    bool active() const { return current > ENROLL_IDLE && current < ENROLL_DONE; }
+    bool finished() const { return current >= ENROLL_DONE; }
+    EnrollStage stage() const { return current; }
+    uint16_t id() const { return slot; }
+    uint8_t lastError() const { return error; }
+
+    static const char *stageName(EnrollStage stage);
+
+private:
+    void enter(EnrollStage next, uint32_t nowMs);
+    bool capture(uint8_t buffer, EnrollStage next, uint32_t nowMs);
+
+    hal::FingerprintSensor &sensor;
+    uint32_t captureTimeoutMs;
+    uint32_t liftTimeoutMs;
+    uint32_t pollIntervalMs;
+
+    EnrollStage current = ENROLL_IDLE;
+    uint16_t slot = 0;
+    uint8_t error = FINGERPRINT_OK;
+    bool cancelRequested = false;
+    uint32_t stageStartMs = 0;
+    uint32_t lastPollMs = 0;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef HAL_CLOCK_H
+#define HAL_CLOCK_H
+
+#include <stdint.h>
+
+namespace hal
+{
+
+class Clock
+{
+public:
+    virtual ~Clock() {}
+
+    // Monotonic, wrap like Arduino millis()/micros()
+    virtual uint32_t millis() = 0;
+    virtual uint32_t micros() = 0;
+    // Monotonic microseconds since boot, does not wrap
+    virtual uint64_t micros64() = 0;
+    // Wall clock in seconds since 1970, 0 when unknown
+    virtual uint32_t unixTime() = 0;
+};
+
+} // namespace hal
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef HAL_FINGERPRINT_H
+#define HAL_FINGERPRINT_H
+
+#include <stdint.h>
+
+// Confirmation codes of the R30x/AS608 protocol, same values and names as
+// Adafruit_Fingerprint.h so both headers can be included together
+#ifndef FINGERPRINT_OK
+#define FINGERPRINT_OK 0x00
+#define FINGERPRINT_PACKETRECIEVEERR 0x01
+#define FINGERPRINT_NOFINGER 0x02
+#define FINGERPRINT_IMAGEFAIL 0x03
+#define FINGERPRINT_IMAGEMESS 0x06
+#define FINGERPRINT_FEATUREFAIL 0x07
+#define FINGERPRINT_NOMATCH 0x08
+#define FINGERPRINT_NOTFOUND 0x09
+#define FINGERPRINT_ENROLLMISMATCH 0x0A
+#define FINGERPRINT_BADLOCATION 0x0B
+#define FINGERPRINT_DELETEFAIL 0x10
+#define FINGERPRINT_DBCLEARFAIL 0x11
+#define FINGERPRINT_INVALIDIMAGE 0x15
+#define FINGERPRINT_FLASHERR 0x18
+#define FINGERPRINT_TIMEOUT 0xFF
+#endif
+
+// Bytes of one page of the sensor's template index table (256 slots)
+#define FP_INDEX_PAGE_BYTES 32
+
+namespace hal
+{
+
+// Fingerprint sensor commands used by enrollment and scanning.
+// Methods return the sensor's confirmation code.
+class FingerprintSensor
+{
+public:
+    virtual ~FingerprintSensor() {}
+
+    virtual uint8_t getImage() = 0;
+    virtual uint8_t image2Tz(uint8_t buffer = 1) = 0;
+    virtual uint8_t fingerSearch(uint8_t buffer = 1) = 0;
+    virtual uint8_t createModel() = 0;
+    virtual uint8_t storeModel(uint16_t id, uint8_t buffer = 1) = 0;
+    virtual uint8_t deleteModel(uint16_t id) = 0;
+    virtual uint8_t emptyDatabase() = 0;
+    // One page of the index table, bit j of byte i is slot page * 256 + i * 8 + j
+    virtual uint8_t readIndexPage(uint8_t page, uint8_t *bits) = 0;
+
+    // Result of the last successful fingerSearch()
+    virtual uint16_t fingerID() const = 0;
+    virtual uint16_t confidence() const = 0;
+};
+
+} // namespace hal
+
+#endif
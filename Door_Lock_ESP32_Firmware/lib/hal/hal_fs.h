@@ -0,0 +1,34 @@
+#ifndef HAL_FS_H
+#define HAL_FS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace hal
+{
+
+// Path based file access, the subset the storage modules need. Every call
+// opens and closes the file, which is what they did with fs::FS anyway.
+class FileSystem
+{
+public:
+    virtual ~FileSystem() {}
+
+    virtual bool exists(const char *path) = 0;
+    // Create an empty file, truncating an existing one
+    virtual bool create(const char *path) = 0;
+    // Size in bytes, 0 when the file does not exist
+    virtual size_t size(const char *path) = 0;
+
+    // Return the number of bytes transferred
+    virtual size_t readAt(const char *path, size_t offset, void *data, size_t length) = 0;
+    virtual size_t writeAt(const char *path, size_t offset, const void *data, size_t length) = 0;
+    virtual size_t append(const char *path, const void *data, size_t length) = 0;
+
+    virtual bool remove(const char *path) = 0;
+    virtual bool rename(const char *from, const char *to) = 0;
+};
+
+} // namespace hal
+
+#endif
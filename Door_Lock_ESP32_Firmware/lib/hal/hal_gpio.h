@@ -0,0 +1,28 @@
+#ifndef HAL_GPIO_H
+#define HAL_GPIO_H
+
+#include <stdint.h>
+
+namespace hal
+{
+
+enum GpioMode
+{
+    GPIO_MODE_INPUT = 0,
+    GPIO_MODE_INPUT_PULLUP,
+    GPIO_MODE_OUTPUT,
+};
+
+class Gpio
+{
+public:
+    virtual ~Gpio() {}
+
+    virtual void mode(uint8_t pin, GpioMode mode) = 0;
+    virtual void write(uint8_t pin, bool high) = 0;
+    virtual bool read(uint8_t pin) = 0;
+};
+
+} // namespace hal
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef HAL_KV_H
+#define HAL_KV_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace hal
+{
+
+// Persistent settings (NVS on the device)
+class KeyValueStore
+{
+public:
+    virtual ~KeyValueStore() {}
+
+    // Copies at most size - 1 characters, returns false when the key is missing
+    virtual bool getString(const char *key, char *value, size_t size) = 0;
+    virtual bool putString(const char *key, const char *value) = 0;
+
+    virtual bool getBytes(const char *key, void *value, size_t length) = 0;
+    virtual bool putBytes(const char *key, const void *value, size_t length) = 0;
+
+    virtual bool getBool(const char *key, bool defaultValue) = 0;
+    virtual bool putBool(const char *key, bool value) = 0;
+
+    virtual bool remove(const char *key) = 0;
+};
+
+} // namespace hal
+
+#endif
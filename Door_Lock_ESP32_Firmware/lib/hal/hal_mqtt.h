@@ -0,0 +1,28 @@
+#ifndef HAL_MQTT_H
+#define HAL_MQTT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace hal
+{
+
+// Outbound side of the broker connection
+class MqttTransport
+{
+public:
+    virtual ~MqttTransport() {}
+
+    virtual bool connected() = 0;
+    virtual bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained = false) = 0;
+    virtual bool subscribe(const char *topic) = 0;
+
+    // Streamed publish of a payload whose length is known up front
+    virtual bool beginPublish(const char *topic, size_t length, bool retained = false) = 0;
+    virtual size_t write(const uint8_t *data, size_t length) = 0;
+    virtual bool endPublish() = 0;
+};
+
+} // namespace hal
+
+#endif
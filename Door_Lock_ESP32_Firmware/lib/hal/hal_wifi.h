@@ -0,0 +1,54 @@
+#ifndef HAL_WIFI_H
+#define HAL_WIFI_H
+
+#include <stdint.h>
+
+namespace hal
+{
+
+// Addresses as IPAddress converts them to uint32_t
+struct WiFiStationInfo
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+struct WiFiNetwork
+{
+    char ssid[33];
+    int8_t rssi;
+    bool open;
+};
+
+// Station and soft access point of the radio. Every call returns at once;
+// connection progress and scan results are polled.
+class WiFiRadio
+{
+public:
+    virtual ~WiFiRadio() {}
+
+    // channel 0 and bssid null let the radio scan for the network.
+    // staticIp null means DHCP.
+    virtual void beginStation(const char *ssid, const char *password, uint8_t channel, const uint8_t *bssid,
+                              const WiFiStationInfo *staticIp) = 0;
+    virtual void disconnectStation() = 0;
+    virtual bool stationConnected() = 0;
+    virtual bool stationInfo(WiFiStationInfo &info) = 0;
+
+    virtual void startAccessPoint(const char *ssid, const char *password) = 0;
+    virtual void stopAccessPoint() = 0;
+
+    virtual bool startScan() = 0;
+    // Networks found, -1 while the scan runs, -2 when it failed
+    virtual int scanComplete() = 0;
+    virtual bool scanEntry(uint8_t index, WiFiNetwork &network) = 0;
+    virtual void scanDelete() = 0;
+};
+
+} // namespace hal
+
+#endif
@@ -0,0 +1,209 @@
+#include "hal_arduino.h"
+#include <string.h>
+
+#define FP_READ_INDEX_TABLE 0x1F // Not wrapped by Adafruit_Fingerprint
+
+bool ArduinoFileSystem::exists(const char *path)
+{
+    return fileSystem.exists(path);
+}
+
+bool ArduinoFileSystem::create(const char *path)
+{
+    File file = fileSystem.open(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+size_t ArduinoFileSystem::size(const char *path)
+{
+    if (!fileSystem.exists(path))
+    {
+        return 0;
+    }
+
+    File file = fileSystem.open(path, "r");
+    if (!file)
+    {
+        return 0;
+    }
+    size_t bytes = file.size();
+    file.close();
+    return bytes;
+}
+
+size_t ArduinoFileSystem::readAt(const char *path, size_t offset, void *data, size_t length)
+{
+    File file = fileSystem.open(path, "r");
+    if (!file)
+    {
+        return 0;
+    }
+
+    size_t got = 0;
+    if (file.seek(offset, SeekSet))
+    {
+        got = file.read((uint8_t *)data, length);
+    }
+    file.close();
+    return got;
+}
+
+size_t ArduinoFileSystem::writeAt(const char *path, size_t offset, const void *data, size_t length)
+{
+    File file = fileSystem.open(path, "r+");
+    if (!file)
+    {
+        return 0;
+    }
+
+    size_t written = 0;
+    if (file.seek(offset, SeekSet))
+    {
+        written = file.write((const uint8_t *)data, length);
+    }
+    file.close();
+    return written;
+}
+
+size_t ArduinoFileSystem::append(const char *path, const void *data, size_t length)
+{
+    File file = fileSystem.open(path, "a");
+    if (!file)
+    {
+        return 0;
+    }
+
+    size_t written = file.write((const uint8_t *)data, length);
+    file.close();
+    return written;
+}
+
+bool ArduinoFileSystem::remove(const char *path)
+{
+    return fileSystem.remove(path);
+}
+
+bool ArduinoFileSystem::rename(const char *from, const char *to)
+{
+    return fileSystem.rename(from, to);
+}
+
+uint8_t ArduinoFingerprintSensor::readIndexPage(uint8_t page, uint8_t *bits)
+{
+    uint8_t data[] = {FP_READ_INDEX_TABLE, page};
+    Adafruit_Fingerprint_Packet packet(FINGERPRINT_COMMANDPACKET, sizeof(data), data);
+    finger.writeStructuredPacket(packet);
+
+    uint8_t p = finger.getStructuredPacket(&packet);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (packet.type != FINGERPRINT_ACKPACKET)
+    {
+        return FINGERPRINT_PACKETRECIEVEERR;
+    }
+    if (packet.data[0] != FINGERPRINT_OK)
+    {
+        return packet.data[0];
+    }
+
+    memcpy(bits, &packet.data[1], FP_INDEX_PAGE_BYTES);
+    return FINGERPRINT_OK;
+}
+
+bool PreferencesStore::getString(const char *key, char *value, size_t size)
+{
+    if (!prefs.isKey(key))
+    {
+        return false;
+    }
+    return prefs.getString(key, value, size) > 0;
+}
+
+bool PreferencesStore::putString(const char *key, const char *value)
+{
+    return prefs.putString(key, value) == strlen(value);
+}
+
+bool PreferencesStore::getBytes(const char *key, void *value, size_t length)
+{
+    return prefs.getBytesLength(key) == length && prefs.getBytes(key, value, length) == length;
+}
+
+bool PreferencesStore::putBytes(const char *key, const void *value, size_t length)
+{
+    return prefs.putBytes(key, value, length) == length;
+}
+
+void ArduinoWiFiRadio::beginStation(const char *ssid, const char *password, uint8_t channel, const uint8_t *bssid,
+                                    const hal::WiFiStationInfo *staticIp)
+{
+    applyMode();
+    // Retries are paced by the caller
+    WiFi.setAutoReconnect(false);
+    if (staticIp != nullptr)
+    {
+        WiFi.config(IPAddress(staticIp->ip), IPAddress(staticIp->gateway), IPAddress(staticIp->subnet),
+                    IPAddress(staticIp->dns));
+    }
+    else
+    {
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    }
+    WiFi.begin(ssid, password, channel, bssid);
+}
+
+bool ArduinoWiFiRadio::stationInfo(hal::WiFiStationInfo &info)
+{
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        return false;
+    }
+
+    const uint8_t *bssid = WiFi.BSSID();
+    if (bssid == nullptr)
+    {
+        return false;
+    }
+    memcpy(info.bssid, bssid, sizeof(info.bssid));
+    info.channel = WiFi.channel();
+    info.ip = WiFi.localIP();
+    info.gateway = WiFi.gatewayIP();
+    info.subnet = WiFi.subnetMask();
+    info.dns = WiFi.dnsIP();
+    return true;
+}
+
+void ArduinoWiFiRadio::startAccessPoint(const char *ssid, const char *password)
+{
+    apOn = true;
+    applyMode();
+    WiFi.softAP(ssid, password);
+}
+
+void ArduinoWiFiRadio::stopAccessPoint()
+{
+    WiFi.softAPdisconnect(false);
+    apOn = false;
+    applyMode();
+}
+
+bool ArduinoWiFiRadio::scanEntry(uint8_t index, hal::WiFiNetwork &network)
+{
+    if (index >= WiFi.scanComplete())
+    {
+        return false;
+    }
+
+    strncpy(network.ssid, WiFi.SSID(index).c_str(), sizeof(network.ssid) - 1);
+    network.ssid[sizeof(network.ssid) - 1] = '\0';
+    network.rssi = WiFi.RSSI(index);
+    network.open = WiFi.encryptionType(index) == WIFI_AUTH_OPEN;
+    return true;
+}
@@ -0,0 +1,149 @@
+#ifndef HAL_ARDUINO_H
+#define HAL_ARDUINO_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <Preferences.h>
+#include <PubSubClient.h>
+#include <Adafruit_Fingerprint.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+#include "hal_fs.h"
+#include "hal_fingerprint.h"
+#include "hal_clock.h"
+#include "hal_kv.h"
+#include "hal_mqtt.h"
+#include "hal_gpio.h"
+#include "hal_wifi.h"
+
+// HAL implementations on top of the Arduino-ESP32 libraries
+
+class ArduinoFileSystem : public hal::FileSystem
+{
+public:
+    explicit ArduinoFileSystem(fs::FS &fileSystem) : fileSystem(fileSystem) {}
+
+    bool exists(const char *path) override;
+    bool create(const char *path) override;
+    size_t size(const char *path) override;
+    size_t readAt(const char *path, size_t offset, void *data, size_t length) override;
+    size_t writeAt(const char *path, size_t offset, const void *data, size_t length) override;
+    size_t append(const char *path, const void *data, size_t length) override;
+    bool remove(const char *path) override;
+    bool rename(const char *from, const char *to) override;
+
+private:
+    fs::FS &fileSystem;
+};
+
+class ArduinoFingerprintSensor : public hal::FingerprintSensor
+{
+public:
+    explicit ArduinoFingerprintSensor(Adafruit_Fingerprint &finger) : finger(finger) {}
+
+    uint8_t getImage() override { return finger.getImage(); }
+    uint8_t image2Tz(uint8_t buffer = 1) override { return finger.image2Tz(buffer); }
+    uint8_t fingerSearch(uint8_t buffer = 1) override { return finger.fingerSearch(buffer); }
+    uint8_t createModel() override { return finger.createModel(); }
+    uint8_t storeModel(uint16_t id, uint8_t buffer = 1) override { return finger.storeModel(id, buffer); }
+    uint8_t deleteModel(uint16_t id) override { return finger.deleteModel(id); }
+    uint8_t emptyDatabase() override { return finger.emptyDatabase(); }
+    uint8_t readIndexPage(uint8_t page, uint8_t *bits) override;
+
+    uint16_t fingerID() const override { return finger.fingerID; }
+    uint16_t confidence() const override { return finger.confidence; }
+
+private:
+    Adafruit_Fingerprint &finger;
+};
+
+// millis()/micros() plus a wall clock supplied by the firmware (RTC)
+class ArduinoClock : public hal::Clock
+{
+public:
+    explicit ArduinoClock(uint32_t (*wallClock)()) : wallClock(wallClock) {}
+
+    uint32_t millis() override { return ::millis(); }
+    uint32_t micros() override { return ::micros(); }
+    uint64_t micros64() override { return (uint64_t)esp_timer_get_time(); }
+    uint32_t unixTime() override { return wallClock(); }
+
+private:
+    uint32_t (*wallClock)();
+};
+
+class ArduinoGpio : public hal::Gpio
+{
+public:
+    void mode(uint8_t pin, hal::GpioMode mode) override
+    {
+        pinMode(pin, mode == hal::GPIO_MODE_OUTPUT ? OUTPUT : mode == hal::GPIO_MODE_INPUT_PULLUP ? INPUT_PULLUP : INPUT);
+    }
+    void write(uint8_t pin, bool high) override { digitalWrite(pin, high ? HIGH : LOW); }
+    bool read(uint8_t pin) override { return digitalRead(pin) == HIGH; }
+};
+
+class ArduinoWiFiRadio : public hal::WiFiRadio
+{
+public:
+    void beginStation(const char *ssid, const char *password, uint8_t channel, const uint8_t *bssid,
+                      const hal::WiFiStationInfo *staticIp) override;
+    void disconnectStation() override { WiFi.disconnect(false); }
+    bool stationConnected() override { return WiFi.status() == WL_CONNECTED; }
+    bool stationInfo(hal::WiFiStationInfo &info) override;
+
+    void startAccessPoint(const char *ssid, const char *password) override;
+    void stopAccessPoint() override;
+
+    bool startScan() override { return WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING; }
+    int scanComplete() override { return WiFi.scanComplete(); }
+    bool scanEntry(uint8_t index, hal::WiFiNetwork &network) override;
+    void scanDelete() override { WiFi.scanDelete(); }
+
+private:
+    void applyMode() { WiFi.mode(apOn ? WIFI_AP_STA : WIFI_STA); }
+
+    bool apOn = false;
+};
+
+class PreferencesStore : public hal::KeyValueStore
+{
+public:
+    explicit PreferencesStore(Preferences &prefs) : prefs(prefs) {}
+
+    bool getString(const char *key, char *value, size_t size) override;
+    bool putString(const char *key, const char *value) override;
+    bool getBytes(const char *key, void *value, size_t length) override;
+    bool putBytes(const char *key, const void *value, size_t length) override;
+    bool getBool(const char *key, bool defaultValue) override { return prefs.getBool(key, defaultValue); }
+    bool putBool(const char *key, bool value) override { return prefs.putBool(key, value) > 0; }
+    bool remove(const char *key) override { return prefs.remove(key); }
+
+private:
+    Preferences &prefs;
+};
+
+class PubSubTransport : public hal::MqttTransport
+{
+public:
+    explicit PubSubTransport(PubSubClient &client) : client(client) {}
+
+    bool connected() override { return client.connected(); }
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained = false) override
+    {
+        return client.publish(topic, payload, length, retained);
+    }
+    bool subscribe(const char *topic) override { return client.subscribe(topic); }
+
+    bool beginPublish(const char *topic, size_t length, bool retained = false) override
+    {
+        return client.beginPublish(topic, length, retained);
+    }
+    size_t write(const uint8_t *data, size_t length) override { return client.write(data, length); }
+    bool endPublish() override { return client.endPublish() > 0; }
+
+private:
+    PubSubClient &client;
+};
+
+#endif
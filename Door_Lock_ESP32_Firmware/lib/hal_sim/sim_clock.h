@@ -0,0 +1,30 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+#include "hal_clock.h"
+
+// Virtual time for host builds. Nothing advances it except advance*(),
+// which the simulated devices call to charge their latency.
+class SimClock : public hal::Clock
+{
+public:
+    explicit SimClock(uint32_t unixStart = 1735689600) : unixBase(unixStart) {} // 2025-01-01
+
+    uint32_t millis() override { return (uint32_t)(nowUs / 1000); }
+    uint32_t micros() override { return (uint32_t)nowUs; }
+    uint64_t micros64() override { return nowUs; }
+    uint32_t unixTime() override { return unixBase == 0 ? 0 : unixBase + (uint32_t)(nowUs / 1000000); }
+
+    void advanceUs(uint64_t us) { nowUs += us; }
+    void advanceMs(uint32_t ms) { nowUs += (uint64_t)ms * 1000; }
+    void setUnixTime(uint32_t unixTime) { unixBase = unixTime - (uint32_t)(nowUs / 1000000); }
+
+    uint64_t elapsedUs() const { return nowUs; }
+
+private:
+    uint64_t nowUs = 0;
+    uint32_t unixBase;
+};
+
+#endif
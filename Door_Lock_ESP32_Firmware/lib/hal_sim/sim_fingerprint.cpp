@@ -0,0 +1,191 @@
+#include "sim_fingerprint.h"
+#include <string.h>
+
+// Header, address, PID, length and checksum around every packet payload
+#define SIM_FP_FRAME_BYTES 11
+
+SimFingerprintSensor::SimFingerprintSensor(SimClock &clock, uint16_t capacity, const SimFingerprintTiming &timing)
+    : clock(clock), timing(timing), templates(capacity, NO_FINGER)
+{
+}
+
+void SimFingerprintSensor::touch(uint32_t finger, uint32_t holdMs, uint32_t delayMs)
+{
+    Touch next;
+    next.startUs = clock.elapsedUs() + (uint64_t)delayMs * 1000;
+    next.endUs = next.startUs + (uint64_t)holdMs * 1000;
+    next.finger = finger;
+    touches.push_back(next);
+}
+
+void SimFingerprintSensor::setTemplate(uint16_t id, uint32_t finger)
+{
+    if (id < templates.size())
+    {
+        templates[id] = finger;
+    }
+}
+
+// Charge one command/ack exchange. Returns an injected failure, if any.
+uint8_t SimFingerprintSensor::command(size_t sendBytes, size_t replyBytes, uint32_t workUs)
+{
+    commandCount++;
+    uint64_t uartUs = (uint64_t)(SIM_FP_FRAME_BYTES * 2 + sendBytes + replyBytes) * 10 * 1000000 / timing.baud;
+    clock.advanceUs(uartUs + workUs);
+
+    if (injected.empty())
+    {
+        return FINGERPRINT_OK;
+    }
+    uint8_t code = injected.front();
+    injected.pop_front();
+    return code;
+}
+
+uint32_t SimFingerprintSensor::fingerOnGlass()
+{
+    uint64_t now = clock.elapsedUs();
+    while (!touches.empty() && touches.front().endUs <= now)
+    {
+        touches.pop_front();
+    }
+    if (!touches.empty() && touches.front().startUs <= now)
+    {
+        return touches.front().finger;
+    }
+    return NO_FINGER;
+}
+
+uint8_t SimFingerprintSensor::getImage()
+{
+    // The image is taken at the start of the command
+    uint32_t finger = fingerOnGlass();
+    uint8_t p = command(1, 1, finger != NO_FINGER ? timing.getImageUs : timing.noFingerUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (finger == NO_FINGER)
+    {
+        return FINGERPRINT_NOFINGER;
+    }
+    image = finger;
+    return FINGERPRINT_OK;
+}
+
+uint8_t SimFingerprintSensor::image2Tz(uint8_t buffer)
+{
+    uint8_t p = command(2, 1, timing.image2TzUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (buffer < 1 || buffer > 2 || image == NO_FINGER)
+    {
+        return FINGERPRINT_INVALIDIMAGE;
+    }
+    charBuffer[buffer - 1] = image;
+    return FINGERPRINT_OK;
+}
+
+uint8_t SimFingerprintSensor::fingerSearch(uint8_t buffer)
+{
+    uint8_t p = command(6, 5, timing.searchUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (buffer < 1 || buffer > 2 || charBuffer[buffer - 1] == NO_FINGER)
+    {
+        return FINGERPRINT_NOTFOUND;
+    }
+
+    for (size_t id = 0; id < templates.size(); id++)
+    {
+        if (templates[id] == charBuffer[buffer - 1])
+        {
+            foundId = id;
+            foundConfidence = 150;
+            return FINGERPRINT_OK;
+        }
+    }
+    return FINGERPRINT_NOTFOUND;
+}
+
+uint8_t SimFingerprintSensor::createModel()
+{
+    uint8_t p = command(1, 1, timing.createModelUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (charBuffer[0] == NO_FINGER || charBuffer[0] != charBuffer[1])
+    {
+        return FINGERPRINT_ENROLLMISMATCH;
+    }
+    return FINGERPRINT_OK;
+}
+
+uint8_t SimFingerprintSensor::storeModel(uint16_t id, uint8_t buffer)
+{
+    uint8_t p = command(4, 1, timing.storeModelUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (id >= templates.size() || buffer < 1 || buffer > 2)
+    {
+        return FINGERPRINT_BADLOCATION;
+    }
+    templates[id] = charBuffer[buffer - 1];
+    return FINGERPRINT_OK;
+}
+
+uint8_t SimFingerprintSensor::deleteModel(uint16_t id)
+{
+    uint8_t p = command(5, 1, timing.deleteModelUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    if (id >= templates.size())
+    {
+        return FINGERPRINT_DELETEFAIL;
+    }
+    templates[id] = NO_FINGER;
+    return FINGERPRINT_OK;
+}
+
+uint8_t SimFingerprintSensor::emptyDatabase()
+{
+    uint8_t p = command(1, 1, timing.emptyDatabaseUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+    for (size_t id = 0; id < templates.size(); id++)
+    {
+        templates[id] = NO_FINGER;
+    }
+    return FINGERPRINT_OK;
+}
+
+uint8_t SimFingerprintSensor::readIndexPage(uint8_t page, uint8_t *bits)
+{
+    uint8_t p = command(2, 1 + FP_INDEX_PAGE_BYTES, timing.indexPageUs);
+    if (p != FINGERPRINT_OK)
+    {
+        return p;
+    }
+
+    memset(bits, 0, FP_INDEX_PAGE_BYTES);
+    for (size_t i = 0; i < FP_INDEX_PAGE_BYTES * 8; i++)
+    {
+        size_t id = (size_t)page * FP_INDEX_PAGE_BYTES * 8 + i;
+        if (id < templates.size() && templates[id] != NO_FINGER)
+        {
+            bits[i / 8] |= 1 << (i % 8);
+        }
+    }
+    return FINGERPRINT_OK;
+}
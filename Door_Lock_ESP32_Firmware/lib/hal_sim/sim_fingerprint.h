@@ -0,0 +1,83 @@
+#ifndef SIM_FINGERPRINT_H
+#define SIM_FINGERPRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include "hal_fingerprint.h"
+#include "sim_clock.h"
+
+// Time one command keeps the sensor busy, on top of the UART transfer.
+// Defaults follow the R307/AS608 datasheets at 57600 baud.
+struct SimFingerprintTiming
+{
+    uint32_t baud = 57600;
+    uint32_t getImageUs = 120000; // Finger on the glass
+    uint32_t noFingerUs = 20000;
+    uint32_t image2TzUs = 70000;
+    uint32_t searchUs = 60000;    // Fast search over 1000 templates
+    uint32_t createModelUs = 40000;
+    uint32_t storeModelUs = 30000;
+    uint32_t deleteModelUs = 20000;
+    uint32_t emptyDatabaseUs = 200000;
+    uint32_t indexPageUs = 5000;
+};
+
+// Scripted fingerprint sensor. Fingers are identified by an arbitrary
+// number: touch() puts one on the glass for a while, storeModel() ties the
+// finger in a char buffer to a slot, and fingerSearch() finds it again.
+// Every command advances the clock by its UART and processing time.
+class SimFingerprintSensor : public hal::FingerprintSensor
+{
+public:
+    SimFingerprintSensor(SimClock &clock, uint16_t capacity, const SimFingerprintTiming &timing = SimFingerprintTiming());
+
+    // Put `finger` on the sensor `delayMs` from now for `holdMs`
+    void touch(uint32_t finger, uint32_t holdMs, uint32_t delayMs = 0);
+    // Make the next command fail with `code` (e.g. FINGERPRINT_PACKETRECIEVEERR)
+    void failNext(uint8_t code) { injected.push_back(code); }
+    // Preload a template, as if enrolled earlier
+    void setTemplate(uint16_t id, uint32_t finger);
+
+    uint8_t getImage() override;
+    uint8_t image2Tz(uint8_t buffer = 1) override;
+    uint8_t fingerSearch(uint8_t buffer = 1) override;
+    uint8_t createModel() override;
+    uint8_t storeModel(uint16_t id, uint8_t buffer = 1) override;
+    uint8_t deleteModel(uint16_t id) override;
+    uint8_t emptyDatabase() override;
+    uint8_t readIndexPage(uint8_t page, uint8_t *bits) override;
+
+    uint16_t fingerID() const override { return foundId; }
+    uint16_t confidence() const override { return foundConfidence; }
+
+    uint32_t commands() const { return commandCount; }
+
+private:
+    struct Touch
+    {
+        uint64_t startUs;
+        uint64_t endUs;
+        uint32_t finger;
+    };
+
+    static constexpr uint32_t NO_FINGER = 0;
+
+    uint8_t command(size_t sendBytes, size_t replyBytes, uint32_t workUs);
+    uint32_t fingerOnGlass();
+
+    SimClock &clock;
+    SimFingerprintTiming timing;
+    std::deque<Touch> touches;
+    std::deque<uint8_t> injected;
+    std::vector<uint32_t> templates; // Finger stored in each slot, 0 when empty
+
+    uint32_t image = NO_FINGER;
+    uint32_t charBuffer[2] = {NO_FINGER, NO_FINGER};
+    uint16_t foundId = 0;
+    uint16_t foundConfidence = 0;
+    uint32_t commandCount = 0;
+};
+
+#endif
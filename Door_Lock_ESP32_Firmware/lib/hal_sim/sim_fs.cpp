@@ -0,0 +1,110 @@
+#include "sim_fs.h"
+#include <string.h>
+
+void RamFileSystem::charge(size_t bytes, uint32_t byteNs)
+{
+    ops++;
+    if (clock != nullptr)
+    {
+        clock->advanceUs(timing.openUs + (uint64_t)bytes * byteNs / 1000);
+    }
+}
+
+bool RamFileSystem::exists(const char *path)
+{
+    charge(0, 0);
+    return files.count(path) > 0;
+}
+
+bool RamFileSystem::create(const char *path)
+{
+    charge(0, 0);
+    files[path].clear();
+    return true;
+}
+
+size_t RamFileSystem::size(const char *path)
+{
+    charge(0, 0);
+    auto it = files.find(path);
+    return it != files.end() ? it->second.size() : 0;
+}
+
+size_t RamFileSystem::readAt(const char *path, size_t offset, void *data, size_t length)
+{
+    auto it = files.find(path);
+    if (it == files.end() || offset > it->second.size())
+    {
+        charge(0, 0);
+        return 0;
+    }
+
+    size_t got = it->second.size() - offset;
+    if (got > length)
+    {
+        got = length;
+    }
+    memcpy(data, it->second.data() + offset, got);
+    charge(got, timing.readByteNs);
+    return got;
+}
+
+size_t RamFileSystem::writeAt(const char *path, size_t offset, const void *data, size_t length)
+{
+    auto it = files.find(path);
+    if (it == files.end() || offset > it->second.size())
+    {
+        charge(0, 0);
+        return 0;
+    }
+
+    std::vector<uint8_t> &file = it->second;
+    if (file.size() < offset + length)
+    {
+        file.resize(offset + length);
+    }
+    memcpy(file.data() + offset, data, length);
+    written += length;
+    charge(length, timing.writeByteNs);
+    return length;
+}
+
+size_t RamFileSystem::append(const char *path, const void *data, size_t length)
+{
+    std::vector<uint8_t> &file = files[path];
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    file.insert(file.end(), bytes, bytes + length);
+    written += length;
+    charge(length, timing.writeByteNs);
+    return length;
+}
+
+bool RamFileSystem::remove(const char *path)
+{
+    charge(0, 0);
+    return files.erase(path) > 0;
+}
+
+bool RamFileSystem::rename(const char *from, const char *to)
+{
+    charge(0, 0);
+    auto it = files.find(from);
+    if (it == files.end())
+    {
+        return false;
+    }
+    files[to] = std::move(it->second);
+    files.erase(from);
+    return true;
+}
+
+bool RamFileSystem::truncate(const char *path, size_t length)
+{
+    auto it = files.find(path);
+    if (it == files.end() || length > it->second.size())
+    {
+        return false;
+    }
+    it->second.resize(length);
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "hal_fs.h"
+#include "sim_clock.h"
+
+// Flash costs charged to the clock, roughly SPIFFS on a 4 MB ESP32 part
+struct SimFileTiming
+{
+    uint32_t openUs = 1500;
+    uint32_t readByteNs = 250;
+    uint32_t writeByteNs = 2000;
+};
+
+// RAM backed file system. Counts every operation so a harness can check
+// which code paths touched storage.
+class RamFileSystem : public hal::FileSystem
+{
+public:
+    RamFileSystem() {}
+    RamFileSystem(SimClock &clock, const SimFileTiming &timing = SimFileTiming()) : clock(&clock), timing(timing) {}
+
+    bool exists(const char *path) override;
+    bool create(const char *path) override;
+    size_t size(const char *path) override;
+    size_t readAt(const char *path, size_t offset, void *data, size_t length) override;
+    size_t writeAt(const char *path, size_t offset, const void *data, size_t length) override;
+    size_t append(const char *path, const void *data, size_t length) override;
+    bool remove(const char *path) override;
+    bool rename(const char *from, const char *to) override;
+
+    // Cut a file short, as a power loss in the middle of a write would
+    bool truncate(const char *path, size_t length);
+
+    uint32_t operations() const { return ops; }
+    uint64_t bytesWritten() const { return written; }
+    size_t fileCount() const { return files.size(); }
+
+private:
+    void charge(size_t bytes, uint32_t byteNs);
+
+    SimClock *clock = nullptr;
+    SimFileTiming timing;
+    std::map<std::string, std::vector<uint8_t>> files;
+    uint32_t ops = 0;
+    uint64_t written = 0;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SIM_GPIO_H
+#define SIM_GPIO_H
+
+#include <stdint.h>
+#include <vector>
+#include "hal_gpio.h"
+#include "sim_clock.h"
+
+// Pin levels in RAM. Output changes are logged with the virtual time so a
+// harness can order them against other simulated I/O.
+class SimGpio : public hal::Gpio
+{
+public:
+    static const uint8_t PINS = 40;
+
+    struct Edge
+    {
+        uint8_t pin;
+        bool high;
+        uint64_t atUs;
+    };
+
+    explicit SimGpio(SimClock &clock) : clock(clock) {}
+
+    void mode(uint8_t pin, hal::GpioMode mode) override
+    {
+        if (pin < PINS && mode == hal::GPIO_MODE_INPUT_PULLUP)
+        {
+            levels[pin] = true;
+        }
+    }
+
+    void write(uint8_t pin, bool high) override
+    {
+        if (pin < PINS && levels[pin] != high)
+        {
+            levels[pin] = high;
+            edges.push_back({pin, high, clock.elapsedUs()});
+        }
+    }
+
+    bool read(uint8_t pin) override { return pin < PINS && levels[pin]; }
+
+    // Drive an input from outside, e.g. the door contact
+    void setInput(uint8_t pin, bool high)
+    {
+        if (pin < PINS)
+        {
+            levels[pin] = high;
+        }
+    }
+
+    std::vector<Edge> edges;
+
+private:
+    SimClock &clock;
+    bool levels[PINS] = {};
+};
+
+#endif
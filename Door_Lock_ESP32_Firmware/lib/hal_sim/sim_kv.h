@@ -0,0 +1,70 @@
+#ifndef SIM_KV_H
+#define SIM_KV_H
+
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "hal_kv.h"
+
+// In-memory stand-in for NVS
+class SimKeyValueStore : public hal::KeyValueStore
+{
+public:
+    bool getString(const char *key, char *value, size_t size) override
+    {
+        auto it = values.find(key);
+        if (it == values.end() || size == 0)
+        {
+            return false;
+        }
+        size_t length = it->second.size() < size - 1 ? it->second.size() : size - 1;
+        memcpy(value, it->second.data(), length);
+        value[length] = '\0';
+        return true;
+    }
+
+    bool putString(const char *key, const char *value) override
+    {
+        values[key].assign(value, value + strlen(value));
+        return true;
+    }
+
+    bool getBytes(const char *key, void *value, size_t length) override
+    {
+        auto it = values.find(key);
+        if (it == values.end() || it->second.size() != length)
+        {
+            return false;
+        }
+        memcpy(value, it->second.data(), length);
+        return true;
+    }
+
+    bool putBytes(const char *key, const void *value, size_t length) override
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(value);
+        values[key].assign(bytes, bytes + length);
+        return true;
+    }
+
+    bool getBool(const char *key, bool defaultValue) override
+    {
+        auto it = values.find(key);
+        return it != values.end() && it->second.size() == 1 ? it->second[0] != 0 : defaultValue;
+    }
+
+    bool putBool(const char *key, bool value) override
+    {
+        values[key].assign(1, value ? 1 : 0);
+        return true;
+    }
+
+    bool remove(const char *key) override { return values.erase(key) > 0; }
+
+private:
+    std::map<std::string, std::vector<uint8_t>> values;
+};
+
+#endif
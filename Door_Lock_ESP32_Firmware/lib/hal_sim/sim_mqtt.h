@@ -0,0 +1,76 @@
+#ifndef SIM_MQTT_H
+#define SIM_MQTT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "hal_mqtt.h"
+
+// Records what the firmware publishes instead of sending it
+class SimMqttTransport : public hal::MqttTransport
+{
+public:
+    struct Message
+    {
+        std::string topic;
+        std::string payload;
+        bool retained;
+    };
+
+    bool connected() override { return online; }
+
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained = false) override
+    {
+        if (!online)
+        {
+            return false;
+        }
+        messages.push_back({topic, std::string((const char *)payload, length), retained});
+        return true;
+    }
+
+    bool subscribe(const char *topic) override
+    {
+        subscriptions.push_back(topic);
+        return online;
+    }
+
+    bool beginPublish(const char *topic, size_t length, bool retained = false) override
+    {
+        if (!online)
+        {
+            return false;
+        }
+        streaming = {topic, std::string(), retained};
+        streamLength = length;
+        return true;
+    }
+
+    size_t write(const uint8_t *data, size_t length) override
+    {
+        streaming.payload.append((const char *)data, length);
+        return length;
+    }
+
+    // Fails when the written length differs from the announced one
+    bool endPublish() override
+    {
+        bool ok = streaming.payload.size() == streamLength;
+        if (ok)
+        {
+            messages.push_back(streaming);
+        }
+        streaming = Message();
+        return ok;
+    }
+
+    bool online = true;
+    std::vector<Message> messages;
+    std::vector<std::string> subscriptions;
+
+private:
+    Message streaming;
+    size_t streamLength = 0;
+};
+
+#endif
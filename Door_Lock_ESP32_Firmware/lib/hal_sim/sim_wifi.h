@@ -0,0 +1,133 @@
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "hal_wifi.h"
+#include "sim_clock.h"
+
+// One access point and a radio that joins it after a set delay. A harness
+// flaps the link with setAvailable() and advances the SimClock between
+// update() calls; calls count how often the firmware touched the radio.
+class SimWiFiRadio : public hal::WiFiRadio
+{
+public:
+    explicit SimWiFiRadio(SimClock &clock) : clock(clock)
+    {
+        const uint8_t defaultBssid[6] = {0x24, 0x0a, 0xc4, 0x12, 0x34, 0x56};
+        memcpy(bssid, defaultBssid, sizeof(bssid));
+    }
+
+    void beginStation(const char *ssid, const char *password, uint8_t channel, const uint8_t *bssidHint,
+                      const hal::WiFiStationInfo *staticIp) override
+    {
+        begins++;
+        joining = true;
+        joined = false;
+        // A stale BSSID or channel hint never joins
+        hintMatches = (channel == 0 || channel == this->channel) &&
+                      (bssidHint == nullptr || memcmp(bssidHint, bssid, sizeof(bssid)) == 0);
+        credentialsMatch = apSsid == ssid && apPassword == password;
+        joinAt = clock.millis() + (channel != 0 ? fastJoinMs : scanJoinMs);
+        usedStaticIp = staticIp != nullptr;
+    }
+
+    void disconnectStation() override
+    {
+        joining = false;
+        joined = false;
+    }
+
+    bool stationConnected() override
+    {
+        if (!available)
+        {
+            joined = false;
+        }
+        else if (joining && hintMatches && credentialsMatch && (int32_t)(clock.millis() - joinAt) >= 0)
+        {
+            joining = false;
+            joined = true;
+        }
+        return joined;
+    }
+
+    bool stationInfo(hal::WiFiStationInfo &info) override
+    {
+        if (!joined)
+        {
+            return false;
+        }
+        memcpy(info.bssid, bssid, sizeof(bssid));
+        info.channel = channel;
+        info.ip = 0x6401A8C0; // 192.168.1.100
+        info.gateway = 0x0101A8C0;
+        info.subnet = 0x00FFFFFF;
+        info.dns = 0x0101A8C0;
+        return true;
+    }
+
+    void startAccessPoint(const char *ssid, const char *password) override { apUp = true; }
+    void stopAccessPoint() override { apUp = false; }
+
+    bool startScan() override
+    {
+        scans++;
+        scanDoneAt = clock.millis() + scanMs;
+        scanRunning = true;
+        return true;
+    }
+
+    int scanComplete() override
+    {
+        if (!scanRunning)
+        {
+            return -2;
+        }
+        return (int32_t)(clock.millis() - scanDoneAt) >= 0 ? (int)networks.size() : -1;
+    }
+
+    bool scanEntry(uint8_t index, hal::WiFiNetwork &network) override
+    {
+        if (index >= networks.size())
+        {
+            return false;
+        }
+        network = networks[index];
+        return true;
+    }
+
+    void scanDelete() override { scanRunning = false; }
+
+    // Drops an established link and blocks joins until it comes back
+    void setAvailable(bool up) { available = up; }
+
+    std::string apSsid = "office";
+    std::string apPassword = "secret";
+    uint8_t channel = 6;
+    uint8_t bssid[6];
+    uint32_t fastJoinMs = 300;
+    uint32_t scanJoinMs = 2500;
+    uint32_t scanMs = 2000;
+    std::vector<hal::WiFiNetwork> networks;
+
+    bool apUp = false;
+    bool usedStaticIp = false;
+    uint32_t begins = 0;
+    uint32_t scans = 0;
+
+private:
+    SimClock &clock;
+    bool available = true;
+    bool joining = false;
+    bool joined = false;
+    bool hintMatches = false;
+    bool credentialsMatch = false;
+    uint32_t joinAt = 0;
+    bool scanRunning = false;
+    uint32_t scanDoneAt = 0;
+};
+
+#endif
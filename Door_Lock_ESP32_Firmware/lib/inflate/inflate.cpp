@@ -0,0 +1,452 @@
+#include "inflate.h"
+#include <string.h>
+
+// Follows the structure of zlib's puff.c: canonical Huffman codes decoded
+// bit by bit from per-length counts. Slower than table lookups but small,
+// which suits the few KB decoded per import chunk.
+
+#define INFLATE_MAX_BITS  15
+#define INFLATE_MAX_LCODE 286
+#define INFLATE_MAX_DCODE 30
+#define INFLATE_FIX_LCODE 288
+
+struct InflateState
+{
+    const uint8_t *in;
+    size_t inLength;
+    size_t inPos;
+    uint32_t bitBuffer;
+    uint8_t bitCount;
+
+    uint8_t *out;
+    size_t outSize;
+    size_t outPos;
+};
+
+struct Huffman
+{
+    uint16_t counts[INFLATE_MAX_BITS + 1];
+    uint16_t *symbols;
+};
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                        2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                      193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Reads `count` bits, LSB first; false when the input runs out
+static bool readBits(InflateState &s, uint8_t count, uint32_t &value)
+{
+    while (s.bitCount < count)
+    {
+        if (s.inPos == s.inLength)
+        {
+            return false;
+        }
+        s.bitBuffer |= (uint32_t)s.in[s.inPos++] << s.bitCount;
+        s.bitCount += 8;
+    }
+    value = s.bitBuffer & ((1UL << count) - 1);
+    s.bitBuffer >>= count;
+    s.bitCount -= count;
+    return true;
+}
+
+// Canonical code from code lengths; false when the lengths over-subscribe
+static bool buildHuffman(Huffman &h, const uint8_t *lengths, uint16_t count)
+{
+    memset(h.counts, 0, sizeof(h.counts));
+    for (uint16_t symbol = 0; symbol < count; symbol++)
+    {
+        h.counts[lengths[symbol]]++;
+    }
+
+    int32_t left = 1;
+    for (uint8_t length = 1; length <= INFLATE_MAX_BITS; length++)
+    {
+        left = (left << 1) - h.counts[length];
+        if (left < 0)
+        {
+            return false;
+        }
+    }
+
+    uint16_t offsets[INFLATE_MAX_BITS + 1];
+    offsets[1] = 0;
+    for (uint8_t length = 1; length < INFLATE_MAX_BITS; length++)
+    {
+        offsets[length + 1] = offsets[length] + h.counts[length];
+    }
+    for (uint16_t symbol = 0; symbol < count; symbol++)
+    {
+        if (lengths[symbol] != 0)
+        {
+            h.symbols[offsets[lengths[symbol]]++] = symbol;
+        }
+    }
+    return true;
+}
+
+// Next symbol, -1 for a truncated input, -2 for a code that is not in the table
+static int32_t decodeSymbol(InflateState &s, const Huffman &h)
+{
+    int32_t code = 0, first = 0, index = 0;
+    for (uint8_t length = 1; length <= INFLATE_MAX_BITS; length++)
+    {
+        uint32_t bit;
+        if (!readBits(s, 1, bit))
+        {
+            return -1;
+        }
+        code |= bit;
+        int32_t count = h.counts[length];
+        if (code - count < first)
+        {
+            return h.symbols[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+static InflateStatus symbolError(int32_t symbol)
+{
+    return symbol == -1 ? INFLATE_ERR_TRUNCATED : INFLATE_ERR_FORMAT;
+}
+
+static InflateStatus inflateCodes(InflateState &s, const Huffman &lengthCode, const Huffman &distCode)
+{
+    for (;;)
+    {
+        int32_t symbol = decodeSymbol(s, lengthCode);
+        if (symbol < 0)
+        {
+            return symbolError(symbol);
+        }
+
+        if (symbol < 256)
+        {
+            if (s.outPos == s.outSize)
+            {
+                return INFLATE_ERR_FULL;
+            }
+            s.out[s.outPos++] = (uint8_t)symbol;
+            continue;
+        }
+        if (symbol == 256)
+        {
+            return INFLATE_OK;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29)
+        {
+            return INFLATE_ERR_FORMAT;
+        }
+        uint32_t extra;
+        if (!readBits(s, lengthExtra[symbol], extra))
+        {
+            return INFLATE_ERR_TRUNCATED;
+        }
+        size_t length = lengthBase[symbol] + extra;
+
+        symbol = decodeSymbol(s, distCode);
+        if (symbol < 0)
+        {
+            return symbolError(symbol);
+        }
+        if (symbol >= 30)
+        {
+            return INFLATE_ERR_FORMAT;
+        }
+        if (!readBits(s, distExtra[symbol], extra))
+        {
+            return INFLATE_ERR_TRUNCATED;
+        }
+        size_t distance = distBase[symbol] + extra;
+
+        if (distance > s.outPos)
+        {
+            return INFLATE_ERR_FORMAT; // Reaches before the start of this piece
+        }
+        if (length > s.outSize - s.outPos)
+        {
+            return INFLATE_ERR_FULL;
+        }
+        // Byte by byte, the copy may overlap itself
+        for (; length > 0; length--, s.outPos++)
+        {
+            s.out[s.outPos] = s.out[s.outPos - distance];
+        }
+    }
+}
+
+static InflateStatus inflateStored(InflateState &s)
+{
+    // Stored blocks start on a byte boundary
+    s.bitBuffer = 0;
+    s.bitCount = 0;
+
+    if (s.inLength - s.inPos < 4)
+    {
+        return INFLATE_ERR_TRUNCATED;
+    }
+    uint16_t length = s.in[s.inPos] | (s.in[s.inPos + 1] << 8);
+    uint16_t check = s.in[s.inPos + 2] | (s.in[s.inPos + 3] << 8);
+    s.inPos += 4;
+    if ((uint16_t)~check != length)
+    {
+        return INFLATE_ERR_FORMAT;
+    }
+    if (s.inLength - s.inPos < length)
+    {
+        return INFLATE_ERR_TRUNCATED;
+    }
+    if (s.outSize - s.outPos < length)
+    {
+        return INFLATE_ERR_FULL;
+    }
+
+    memcpy(&s.out[s.outPos], &s.in[s.inPos], length);
+    s.inPos += length;
+    s.outPos += length;
+    return INFLATE_OK;
+}
+
+static InflateStatus inflateFixed(InflateState &s)
+{
+    uint16_t lengthSymbols[INFLATE_FIX_LCODE], distSymbols[INFLATE_MAX_DCODE];
+    Huffman lengthCode = {{}, lengthSymbols};
+    Huffman distCode = {{}, distSymbols};
+    uint8_t lengths[INFLATE_FIX_LCODE];
+
+    uint16_t symbol = 0;
+    for (; symbol < 144; symbol++)
+        lengths[symbol] = 8;
+    for (; symbol < 256; symbol++)
+        lengths[symbol] = 9;
+    for (; symbol < 280; symbol++)
+        lengths[symbol] = 7;
+    for (; symbol < INFLATE_FIX_LCODE; symbol++)
+        lengths[symbol] = 8;
+    buildHuffman(lengthCode, lengths, INFLATE_FIX_LCODE);
+
+    memset(lengths, 5, INFLATE_MAX_DCODE);
+    buildHuffman(distCode, lengths, INFLATE_MAX_DCODE);
+
+    return inflateCodes(s, lengthCode, distCode);
+}
+
+static InflateStatus inflateDynamic(InflateState &s)
+{
+    static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    uint32_t lengthCount, distCount, codeCount;
+    if (!readBits(s, 5, lengthCount) || !readBits(s, 5, distCount) || !readBits(s, 4, codeCount))
+    {
+        return INFLATE_ERR_TRUNCATED;
+    }
+    lengthCount += 257;
+    distCount += 1;
+    codeCount += 4;
+    if (lengthCount > INFLATE_MAX_LCODE || distCount > INFLATE_MAX_DCODE)
+    {
+        return INFLATE_ERR_FORMAT;
+    }
+
+    uint8_t lengths[INFLATE_MAX_LCODE + INFLATE_MAX_DCODE] = {};
+    for (uint8_t i = 0; i < codeCount; i++)
+    {
+        uint32_t length;
+        if (!readBits(s, 3, length))
+        {
+            return INFLATE_ERR_TRUNCATED;
+        }
+        lengths[order[i]] = (uint8_t)length;
+    }
+
+    uint16_t lengthSymbols[INFLATE_MAX_LCODE], distSymbols[INFLATE_MAX_DCODE];
+    Huffman lengthCode = {{}, lengthSymbols};
+    Huffman distCode = {{}, distSymbols};
+
+    // The code lengths themselves are Huffman coded, with the length table's storage
+    if (!buildHuffman(lengthCode, lengths, 19))
+    {
+        return INFLATE_ERR_FORMAT;
+    }
+
+    uint16_t index = 0;
+    while (index < lengthCount + distCount)
+    {
+        int32_t symbol = decodeSymbol(s, lengthCode);
+        if (symbol < 0)
+        {
+            return symbolError(symbol);
+        }
+        if (symbol < 16)
+        {
+            lengths[index++] = (uint8_t)symbol;
+            continue;
+        }
+
+        uint8_t repeated = 0;
+        uint32_t count;
+        bool ok;
+        if (symbol == 16)
+        {
+            if (index == 0)
+            {
+                return INFLATE_ERR_FORMAT;
+            }
+            repeated = lengths[index - 1];
+            ok = readBits(s, 2, count);
+            count += 3;
+        }
+        else if (symbol == 17)
+        {
+            ok = readBits(s, 3, count);
+            count += 3;
+        }
+        else
+        {
+            ok = readBits(s, 7, count);
+            count += 11;
+        }
+        if (!ok)
+        {
+            return INFLATE_ERR_TRUNCATED;
+        }
+        if (index + count > lengthCount + distCount)
+        {
+            return INFLATE_ERR_FORMAT;
+        }
+        while (count-- > 0)
+        {
+            lengths[index++] = repeated;
+        }
+    }
+
+    if (lengths[256] == 0 || !buildHuffman(lengthCode, lengths, (uint16_t)lengthCount) ||
+        !buildHuffman(distCode, &lengths[lengthCount], (uint16_t)distCount))
+    {
+        return INFLATE_ERR_FORMAT;
+    }
+    return inflateCodes(s, lengthCode, distCode);
+}
+
+InflateStatus inflateRaw(const uint8_t *in, size_t inLength, uint8_t *out, size_t outSize, size_t &outLength,
+                         size_t &consumed)
+{
+    InflateState s = {in, inLength, 0, 0, 0, out, outSize, 0};
+    InflateStatus status = INFLATE_OK;
+
+    uint32_t last = 0;
+    while (status == INFLATE_OK && !last)
+    {
+        uint32_t type;
+        if (!readBits(s, 1, last) || !readBits(s, 2, type))
+        {
+            status = INFLATE_ERR_TRUNCATED;
+            break;
+        }
+
+        if (type == 0)
+            status = inflateStored(s);
+        else if (type == 1)
+            status = inflateFixed(s);
+        else if (type == 2)
+            status = inflateDynamic(s);
+        else
+            status = INFLATE_ERR_FORMAT;
+    }
+
+    outLength = s.outPos;
+    consumed = s.inPos; // Unused bits of the last byte are padding
+    return status;
+}
+
+bool isGzip(const uint8_t *data, size_t length)
+{
+    return length >= 18 && data[0] == 0x1F && data[1] == 0x8B && data[2] == 8;
+}
+
+InflateStatus gunzip(const uint8_t *in, size_t inLength, uint8_t *out, size_t outSize, size_t &outLength)
+{
+    outLength = 0;
+    if (!isGzip(in, inLength))
+    {
+        return INFLATE_ERR_FORMAT;
+    }
+
+    uint8_t flags = in[3];
+    size_t pos = 10;
+    if (flags & 0x04) // FEXTRA
+    {
+        if (inLength < pos + 2)
+        {
+            return INFLATE_ERR_TRUNCATED;
+        }
+        pos += 2 + (in[pos] | (in[pos + 1] << 8));
+    }
+    for (uint8_t flag = 0x08; flag <= 0x10; flag <<= 1) // FNAME, FCOMMENT
+    {
+        if (flags & flag)
+        {
+            while (pos < inLength && in[pos] != 0)
+            {
+                pos++;
+            }
+            pos++;
+        }
+    }
+    if (flags & 0x02) // FHCRC
+    {
+        pos += 2;
+    }
+    if (pos >= inLength)
+    {
+        return INFLATE_ERR_TRUNCATED;
+    }
+
+    size_t consumed;
+    InflateStatus status = inflateRaw(&in[pos], inLength - pos, out, outSize, outLength, consumed);
+    if (status != INFLATE_OK)
+    {
+        return status;
+    }
+
+    pos += consumed;
+    if (inLength - pos < 8)
+    {
+        return INFLATE_ERR_TRUNCATED;
+    }
+    uint32_t crc = in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16) | ((uint32_t)in[pos + 3] << 24);
+    uint32_t size = in[pos + 4] | (in[pos + 5] << 8) | (in[pos + 6] << 16) | ((uint32_t)in[pos + 7] << 24);
+    if (crc != crc32(out, outLength) || size != (uint32_t)outLength)
+    {
+        return INFLATE_ERR_CHECK;
+    }
+    return INFLATE_OK;
+}
+
+// Bitwise, reflected 0xEDB88320; gzip trailers are the only user
+uint32_t crc32(const void *data, size_t length, uint32_t crc)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    crc = ~crc;
+    while (length-- > 0)
+    {
+        crc ^= *bytes++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
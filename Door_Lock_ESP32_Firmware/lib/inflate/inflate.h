@@ -0,0 +1,30 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Small one-shot DEFLATE (RFC 1951) and gzip (RFC 1952) decoder. The output
+// buffer doubles as the history window, so there is no 32 KB window to
+// allocate, but the whole result must fit in it: compress each piece that
+// is decoded on its own as its own gzip member.
+
+enum InflateStatus
+{
+    INFLATE_OK = 0,
+    INFLATE_ERR_FORMAT,    // Not gzip/deflate, or a corrupt stream
+    INFLATE_ERR_TRUNCATED, // Input ended inside the stream
+    INFLATE_ERR_FULL,      // Output does not fit
+    INFLATE_ERR_CHECK,     // gzip CRC-32 or length mismatch
+};
+
+// `consumed` is the number of input bytes the stream took
+InflateStatus inflateRaw(const uint8_t *in, size_t inLength, uint8_t *out, size_t outSize, size_t &outLength,
+                         size_t &consumed);
+InflateStatus gunzip(const uint8_t *in, size_t inLength, uint8_t *out, size_t outSize, size_t &outLength);
+
+bool isGzip(const uint8_t *data, size_t length);
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
+
+#endif
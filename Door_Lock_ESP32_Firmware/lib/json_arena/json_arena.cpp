@@ -0,0 +1,116 @@
+#include "json_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps every block aligned for doubles and 64-bit integers
+static size_t alignUp(size_t length)
+{
+    return (length + 7) & ~(size_t)7;
+}
+
+void *JsonArena::allocate(size_t length)
+{
+    allocationCount++;
+
+    size_t needed = alignUp(length);
+    if (top + sizeof(Block) + needed > size)
+    {
+        void *spilled = malloc(length);
+        if (spilled != nullptr)
+        {
+            spillCount++;
+            live++;
+        }
+        return spilled;
+    }
+
+    Block *block = reinterpret_cast<Block *>(buffer + top);
+    block->length = needed;
+    block->below = last;
+    last = top + 1;
+    top += sizeof(Block) + needed;
+    live++;
+
+    if (top > peak)
+    {
+        peak = top;
+    }
+    return block + 1;
+}
+
+void JsonArena::deallocate(void *pointer)
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+
+    if (!owns(pointer))
+    {
+        free(pointer);
+    }
+    else
+    {
+        blockOf(pointer).below |= FREED;
+
+        // Pop every freed block from the top
+        while (last != 0)
+        {
+            Block *block = reinterpret_cast<Block *>(buffer + last - 1);
+            if ((block->below & FREED) == 0)
+            {
+                break;
+            }
+            top = last - 1;
+            last = block->below & ~FREED;
+        }
+    }
+
+    if (live > 0 && --live == 0)
+    {
+        top = 0;
+        last = 0;
+        resetCount++;
+    }
+}
+
+void *JsonArena::reallocate(void *pointer, size_t length)
+{
+    if (pointer == nullptr)
+    {
+        return allocate(length);
+    }
+    if (!owns(pointer))
+    {
+        return realloc(pointer, length);
+    }
+
+    Block &block = blockOf(pointer);
+    size_t needed = alignUp(length);
+    size_t offset = static_cast<uint8_t *>(pointer) - buffer - sizeof(Block);
+
+    // The top block grows and shrinks in place
+    if (offset + 1 == last && offset + sizeof(Block) + needed <= size)
+    {
+        block.length = needed;
+        top = offset + sizeof(Block) + needed;
+        if (top > peak)
+        {
+            peak = top;
+        }
+        return pointer;
+    }
+    if (needed <= block.length)
+    {
+        return pointer;
+    }
+
+    void *moved = allocate(length);
+    if (moved == nullptr)
+    {
+        return nullptr;
+    }
+    memcpy(moved, pointer, block.length);
+    deallocate(pointer);
+    return moved;
+}
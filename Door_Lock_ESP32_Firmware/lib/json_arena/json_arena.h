@@ -0,0 +1,56 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+
+// ArduinoJson allocator over a fixed buffer, for the documents built while
+// handling one request. Blocks are stacked; a freed block on top is popped
+// at once, and the whole arena starts over when its last block is freed,
+// i.e. when the request's documents go out of scope. A request that does
+// not fit spills to the heap and is counted. Not thread safe: one task only.
+class JsonArena : public ArduinoJson::Allocator
+{
+public:
+    JsonArena(void *buffer, size_t size) : buffer(static_cast<uint8_t *>(buffer)), size(size) {}
+
+    void *allocate(size_t length) override;
+    void deallocate(void *pointer) override;
+    void *reallocate(void *pointer, size_t length) override;
+
+    size_t capacity() const { return size; }
+    size_t used() const { return top; }
+    size_t highWater() const { return peak; }
+    uint32_t allocations() const { return allocationCount; }
+    uint32_t spills() const { return spillCount; } // Allocations that went to the heap
+    uint32_t resets() const { return resetCount; }
+
+private:
+    struct Block
+    {
+        uint32_t length;
+        uint32_t below; // Offset of the block underneath plus one, 0 for none; top bit set once freed
+    };
+
+    static const uint32_t FREED = 0x80000000;
+
+    bool owns(const void *pointer) const
+    {
+        return pointer >= buffer && pointer < buffer + size;
+    }
+    Block &blockOf(void *pointer) { return *reinterpret_cast<Block *>(static_cast<uint8_t *>(pointer) - sizeof(Block)); }
+
+    uint8_t *buffer;
+    size_t size;
+    size_t top = 0;
+    uint32_t last = 0; // Offset of the top block plus one, 0 when empty
+    uint32_t live = 0; // Blocks not yet freed, heap spills included
+
+    size_t peak = 0;
+    uint32_t allocationCount = 0;
+    uint32_t spillCount = 0;
+    uint32_t resetCount = 0;
+};
+
+#endif
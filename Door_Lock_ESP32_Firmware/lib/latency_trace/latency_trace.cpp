@@ -0,0 +1,119 @@
+#include "latency_trace.h"
+
+uint8_t LatencyHistogram::bucketOf(uint32_t us)
+{
+    if (us < LATENCY_SUB_BUCKETS)
+    {
+        return us;
+    }
+
+    uint8_t log2 = 31 - __builtin_clz(us);
+    if (log2 >= LATENCY_MAX_LOG2)
+    {
+        return LATENCY_BUCKETS - 1;
+    }
+
+    // The two bits below the leading one pick the sub-bucket
+    uint8_t sub = (us >> (log2 - 2)) & (LATENCY_SUB_BUCKETS - 1);
+    return (log2 - 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint32_t LatencyHistogram::bucketUpper(uint8_t bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    uint8_t log2 = bucket / LATENCY_SUB_BUCKETS + 1;
+    uint32_t sub = bucket % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (log2 - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint32_t us)
+{
+    buckets[bucketOf(us)]++;
+    total++;
+    if (us > maxUs)
+    {
+        maxUs = us;
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        buckets[i] = 0;
+    }
+    total = 0;
+    maxUs = 0;
+}
+
+uint32_t LatencyHistogram::percentile(uint8_t pct) const
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the sample, rounded up so p100 is the last one
+    uint32_t rank = ((uint64_t)total * pct + 99) / 100;
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            // The last bucket has no upper bound of its own
+            uint32_t upper = i == LATENCY_BUCKETS - 1 ? maxUs : bucketUpper(i);
+            return upper < maxUs ? upper : maxUs;
+        }
+    }
+    return maxUs;
+}
+
+#if LATENCY_TRACE
+void LatencyTrace::reset()
+{
+    for (uint8_t i = 0; i < TRACE_STAGE_COUNT; i++)
+    {
+        stages[i].reset();
+    }
+}
+#endif
+
+const char *LatencyTrace::stageName(TraceStage stage)
+{
+    switch (stage)
+    {
+    case TRACE_GET_IMAGE:
+        return "getImage";
+    case TRACE_IMAGE2TZ:
+        return "image2Tz";
+    case TRACE_SEARCH:
+        return "fingerSearch";
+    case TRACE_LOOKUP:
+        return "memberLookup";
+    case TRACE_AUTHORIZE:
+        return "authorize";
+    case TRACE_DECISION:
+        return "decision";
+    case TRACE_GRANT:
+        return "grant";
+    case TRACE_EVENT_QUEUE:
+        return "eventQueue";
+    case TRACE_ATTENDANCE:
+        return "attendance";
+    case TRACE_PUBLISH:
+        return "publish";
+    case TRACE_STAGE_COUNT:
+        break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,117 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+#include "hal_clock.h"
+
+// Build with -D LATENCY_TRACE=1 to time the access path. When it is 0
+// the trace objects are empty and every call compiles to nothing.
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE 0
+#endif
+
+// Log-linear buckets: 4 per power of two up to 2^24 us (~16 s), so a
+// reported percentile is at most 25% above the true value
+#define LATENCY_SUB_BUCKETS 4
+#define LATENCY_MAX_LOG2    24
+#define LATENCY_BUCKETS     ((LATENCY_MAX_LOG2 - 1) * LATENCY_SUB_BUCKETS)
+
+enum TraceStage
+{
+    TRACE_GET_IMAGE = 0,
+    TRACE_IMAGE2TZ,
+    TRACE_SEARCH,
+    TRACE_LOOKUP,
+    TRACE_AUTHORIZE,
+    TRACE_DECISION,    // getImage up to the access decision
+    TRACE_GRANT,       // getImage up to the lock relay switching
+    TRACE_EVENT_QUEUE, // Decision until loop() picks the event up
+    TRACE_ATTENDANCE,  // Journal append
+    TRACE_PUBLISH,     // Outbox write and publish attempt
+    TRACE_STAGE_COUNT,
+};
+
+class LatencyHistogram
+{
+public:
+    void record(uint32_t us);
+    void reset();
+
+    // Upper bound of the bucket holding the pct-th percentile, 0 when empty
+    uint32_t percentile(uint8_t pct) const;
+    uint32_t count() const { return total; }
+    uint32_t max() const { return maxUs; }
+
+    static uint8_t bucketOf(uint32_t us);
+    static uint32_t bucketUpper(uint8_t bucket);
+
+private:
+    uint32_t buckets[LATENCY_BUCKETS] = {};
+    uint32_t total = 0;
+    uint32_t maxUs = 0;
+};
+
+// One histogram per stage. Each stage must only be recorded from a single
+// task; readers may see a sample half-counted, which is fine for a report.
+class LatencyTrace
+{
+public:
+#if LATENCY_TRACE
+    void record(TraceStage stage, uint32_t us) { stages[stage].record(us); }
+    const LatencyHistogram &stage(TraceStage stage) const { return stages[stage]; }
+    void reset();
+#else
+    void record(TraceStage, uint32_t) {}
+    void reset() {}
+#endif
+
+    static const char *stageName(TraceStage stage);
+
+#if LATENCY_TRACE
+private:
+    LatencyHistogram stages[TRACE_STAGE_COUNT];
+#endif
+};
+
+// Times consecutive stages: mark() records the time since the previous
+// mark, total() the time since the lap started. A null trace is allowed.
+class TraceLap
+{
+public:
+#if LATENCY_TRACE
+    TraceLap(LatencyTrace *trace, hal::Clock &clock) : trace(trace), clock(clock)
+    {
+        startUs = lastUs = clock.micros();
+    }
+
+    void mark(TraceStage stage)
+    {
+        uint32_t now = clock.micros();
+        if (trace != nullptr)
+        {
+            trace->record(stage, now - lastUs);
+        }
+        lastUs = now;
+    }
+
+    void total(TraceStage stage)
+    {
+        if (trace != nullptr)
+        {
+            trace->record(stage, clock.micros() - startUs);
+        }
+    }
+
+private:
+    LatencyTrace *trace;
+    hal::Clock &clock;
+    uint32_t startUs;
+    uint32_t lastUs;
+#else
+    TraceLap(LatencyTrace *, hal::Clock &) {}
+    void mark(TraceStage) {}
+    void total(TraceStage) {}
+#endif
+};
+
+#endif
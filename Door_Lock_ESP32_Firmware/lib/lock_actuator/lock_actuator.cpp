@@ -0,0 +1,156 @@
+#include "lock_actuator.h"
+
+void LockActuator::begin()
+{
+    gpio.mode(config.relayPin, hal::GPIO_MODE_OUTPUT);
+    setRelay(false);
+
+    if (config.doorPin != LOCK_NO_PIN)
+    {
+        gpio.mode(config.doorPin, hal::GPIO_MODE_INPUT_PULLUP);
+    }
+    doorWasOpen = readDoor();
+    current = LOCK_LOCKED;
+}
+
+void LockActuator::setRelay(bool energized)
+{
+    gpio.write(config.relayPin, energized == config.relayActiveHigh);
+}
+
+bool LockActuator::readDoor()
+{
+    if (config.doorPin == LOCK_NO_PIN)
+    {
+        return false;
+    }
+    return gpio.read(config.doorPin) == config.doorOpenHigh;
+}
+
+void LockActuator::unlock()
+{
+    setRelay(true);
+    unlockedAtMs = clock.millis();
+    unlockCount++;
+
+    // Someone is already holding the door, keep waiting for it to close
+    if (current == LOCK_LOCKED || current == LOCK_RELOCK_PENDING)
+    {
+        current = doorWasOpen ? LOCK_DOOR_OPEN : LOCK_UNLOCKED;
+    }
+}
+
+void LockActuator::lock()
+{
+    setRelay(false);
+    current = LOCK_LOCKED;
+}
+
+// A door propped open or a contact stuck reading open must not leave the
+// strike energized for good
+LockEvent LockActuator::relockHeldOpen()
+{
+    lock();
+    heldCount++;
+    return LOCK_EVENT_HELD_OPEN;
+}
+
+LockEvent LockActuator::update()
+{
+    uint32_t now = clock.millis();
+    bool open = readDoor();
+    bool opened = open && !doorWasOpen;
+    bool closed = !open && doorWasOpen;
+    doorWasOpen = open;
+
+    switch (current)
+    {
+    case LOCK_LOCKED:
+        if (opened)
+        {
+            forcedCount++;
+            return LOCK_EVENT_FORCED_OPEN;
+        }
+        return closed ? LOCK_EVENT_DOOR_CLOSED : LOCK_EVENT_NONE;
+
+    case LOCK_UNLOCKED:
+        if (opened)
+        {
+            current = LOCK_DOOR_OPEN;
+            return LOCK_EVENT_DOOR_OPENED;
+        }
+        if (now - unlockedAtMs >= config.pulseMs)
+        {
+            lock();
+            return LOCK_EVENT_RELOCKED;
+        }
+        return LOCK_EVENT_NONE;
+
+    case LOCK_DOOR_OPEN:
+        if (now - unlockedAtMs >= config.maxOpenMs)
+        {
+            return relockHeldOpen();
+        }
+        if (closed)
+        {
+            current = LOCK_RELOCK_PENDING;
+            closedAtMs = now;
+            return LOCK_EVENT_DOOR_CLOSED;
+        }
+        return LOCK_EVENT_NONE;
+
+    case LOCK_RELOCK_PENDING:
+        if (now - unlockedAtMs >= config.maxOpenMs)
+        {
+            return relockHeldOpen();
+        }
+        if (opened)
+        {
+            current = LOCK_DOOR_OPEN;
+            return LOCK_EVENT_DOOR_OPENED;
+        }
+        if (now - closedAtMs >= config.relockDelayMs)
+        {
+            lock();
+            return LOCK_EVENT_RELOCKED;
+        }
+        return LOCK_EVENT_NONE;
+    }
+    return LOCK_EVENT_NONE;
+}
+
+const char *LockActuator::stateName(LockState state)
+{
+    switch (state)
+    {
+    case LOCK_LOCKED:
+        return "locked";
+    case LOCK_UNLOCKED:
+        return "unlocked";
+    case LOCK_DOOR_OPEN:
+        return "doorOpen";
+    case LOCK_RELOCK_PENDING:
+        return "relockPending";
+    }
+    return "unknown";
+}
+
+const char *LockActuator::eventName(LockEvent event)
+{
+    switch (event)
+    {
+    case LOCK_EVENT_NONE:
+        return "none";
+    case LOCK_EVENT_RELOCKED:
+        return "relocked";
+    case LOCK_EVENT_DOOR_OPENED:
+        return "doorOpened";
+    case LOCK_EVENT_DOOR_CLOSED:
+        return "doorClosed";
+    case LOCK_EVENT_FORCED_OPEN:
+        return "forcedOpen";
+    case LOCK_EVENT_HELD_OPEN:
+        return "heldOpen";
+    }
+    return "unknown";
+}
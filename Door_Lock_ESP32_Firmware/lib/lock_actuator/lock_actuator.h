@@ -0,0 +1,80 @@
+#ifndef LOCK_ACTUATOR_H
+#define LOCK_ACTUATOR_H
+
+#include <stdint.h>
+#include "hal_gpio.h"
+#include "hal_clock.h"
+
+#define LOCK_NO_PIN 0xFF
+
+struct LockConfig
+{
+    uint8_t relayPin;
+    bool relayActiveHigh;
+    uint8_t doorPin;        // Door contact, LOCK_NO_PIN when not fitted
+    bool doorOpenHigh;      // Level the contact reads while the door is open
+    uint32_t pulseMs;       // How long to stay unlocked if nobody opens the door
+    uint32_t relockDelayMs; // Wait after the door closes before relocking
+    uint32_t maxOpenMs;     // Relock anyway this long after unlock(), e.g. a stuck contact
+};
+
+enum LockState
+{
+    LOCK_LOCKED = 0,
+    LOCK_UNLOCKED,       // Relay energized, door still closed
+    LOCK_DOOR_OPEN,      // Someone went through, relock once it closes
+    LOCK_RELOCK_PENDING, // Door closed again, relock delay running
+};
+
+enum LockEvent
+{
+    LOCK_EVENT_NONE = 0,
+    LOCK_EVENT_RELOCKED,
+    LOCK_EVENT_DOOR_OPENED,
+    LOCK_EVENT_DOOR_CLOSED,
+    LOCK_EVENT_FORCED_OPEN, // Door opened while locked
+    LOCK_EVENT_HELD_OPEN,   // Still open after maxOpenMs, relocked regardless
+};
+
+// Door strike/magnet relay with auto-relock. unlock() only sets the pin,
+// so it can sit right behind the access decision; update() handles the
+// timing and the door contact and must be called every few tens of ms.
+class LockActuator
+{
+public:
+    LockActuator(hal::Gpio &gpio, hal::Clock &clock, const LockConfig &config)
+        : gpio(gpio), clock(clock), config(config) {}
+
+    void begin();
+    void unlock();
+    void lock();
+    LockEvent update();
+
+    LockState state() const { return current; }
+    bool doorOpen() const { return doorWasOpen; }
+    uint32_t unlocks() const { return unlockCount; }
+    uint32_t forcedOpens() const { return forcedCount; }
+    uint32_t heldOpens() const { return heldCount; }
+
+    static const char *stateName(LockState state);
+    static const char *eventName(LockEvent event);
+
+private:
+    void setRelay(bool energized);
+    LockEvent relockHeldOpen();
+    bool readDoor();
+
+    hal::Gpio &gpio;
+    hal::Clock &clock;
+    LockConfig config;
+
+    LockState current = LOCK_LOCKED;
+    bool doorWasOpen = false;
+    uint32_t unlockedAtMs = 0;
+    uint32_t closedAtMs = 0;
+    uint32_t unlockCount = 0;
+    uint32_t forcedCount = 0;
+    uint32_t heldCount = 0;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "member_import.h"
+#include <stdlib.h>
+#include <string.h>
+#include "civil_time.h"
+#include "inflate.h"
+
+static int8_t base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+// Returns false for bad input or when `out` is too small
+static bool base64Decode(const char *in, size_t length, uint8_t *out, size_t outSize, size_t &outLength)
+{
+    uint32_t bits = 0;
+    uint8_t count = 0;
+    outLength = 0;
+
+    for (size_t i = 0; i < length && in[i] != '='; i++)
+    {
+        int8_t value = base64Value(in[i]);
+        if (value < 0)
+        {
+            return false;
+        }
+        bits = bits << 6 | (uint32_t)value;
+        if (++count == 4)
+        {
+            if (outLength + 3 > outSize)
+            {
+                return false;
+            }
+            out[outLength++] = bits >> 16;
+            out[outLength++] = bits >> 8;
+            out[outLength++] = bits;
+            bits = 0;
+            count = 0;
+        }
+    }
+
+    // 2 or 3 leftover characters carry 1 or 2 bytes
+    if (count == 1 || outLength + (count == 0 ? 0 : count - 1) > outSize)
+    {
+        return false;
+    }
+    if (count == 2)
+    {
+        out[outLength++] = bits >> 4;
+    }
+    else if (count == 3)
+    {
+        out[outLength++] = bits >> 10;
+        out[outLength++] = bits >> 2;
+    }
+    return true;
+}
+
+MemberImportStatus MemberImport::begin(uint32_t id, bool replace)
+{
+    abort();
+
+    work = static_cast<uint8_t *>(
+        malloc(MEMBER_IMPORT_CHUNK_MAX + MEMBER_IMPORT_INFLATE_MAX + MEMBER_STORE_BATCH * sizeof(MemberRecord)));
+    if (work == nullptr)
+    {
+        return IMPORT_ERR_MEMORY;
+    }
+    if (store.beginImport(replace) != MEMBER_STORE_OK)
+    {
+        release();
+        return IMPORT_ERR_STORE;
+    }
+
+    batch = reinterpret_cast<MemberRecord *>(work + MEMBER_IMPORT_CHUNK_MAX + MEMBER_IMPORT_INFLATE_MAX);
+    batchCount = 0;
+    open = true;
+    importId = id;
+    next = 0;
+    importedCount = 0;
+    rejectedCount = 0;
+    lineLength = 0;
+    lineTooLong = false;
+    return IMPORT_OK;
+}
+
+MemberImportStatus MemberImport::chunk(uint32_t id, uint32_t seq, const char *data, size_t length, bool gzip)
+{
+    if (!open || id != importId)
+    {
+        return id == committedId && id != 0 ? IMPORT_OK : IMPORT_ERR_NOT_OPEN;
+    }
+    if (seq < next)
+    {
+        return IMPORT_OK;
+    }
+    if (seq > next)
+    {
+        return IMPORT_ERR_SEQUENCE;
+    }
+
+    if (!gzip)
+    {
+        MemberImportStatus status = feed(data, length);
+        if (status != IMPORT_OK)
+        {
+            return fail(status);
+        }
+        next++;
+        return IMPORT_OK;
+    }
+
+    uint8_t *compressed = work;
+    uint8_t *inflated = work + MEMBER_IMPORT_CHUNK_MAX;
+    size_t compressedLength = 0;
+    size_t inflatedLength = 0;
+    if (!base64Decode(data, length, compressed, MEMBER_IMPORT_CHUNK_MAX, compressedLength) ||
+        gunzip(compressed, compressedLength, inflated, MEMBER_IMPORT_INFLATE_MAX, inflatedLength) != INFLATE_OK)
+    {
+        return fail(IMPORT_ERR_DECODE);
+    }
+
+    MemberImportStatus status = feed(reinterpret_cast<const char *>(inflated), inflatedLength);
+    if (status != IMPORT_OK)
+    {
+        return fail(status);
+    }
+    next++;
+    return IMPORT_OK;
+}
+
+MemberImportStatus MemberImport::commit(uint32_t id)
+{
+    if (!open || id != importId)
+    {
+        return id == committedId && id != 0 ? IMPORT_OK : IMPORT_ERR_NOT_OPEN;
+    }
+
+    // The stream need not end with a newline
+    MemberImportStatus status = parseLine();
+    if (status == IMPORT_OK)
+    {
+        status = flush();
+    }
+    if (status != IMPORT_OK)
+    {
+        return fail(status);
+    }
+
+    open = false;
+    release();
+    if (store.commitImport() != MEMBER_STORE_OK)
+    {
+        return IMPORT_ERR_STORE;
+    }
+    committedId = id;
+    return IMPORT_OK;
+}
+
+void MemberImport::abort()
+{
+    if (open)
+    {
+        store.abortImport();
+    }
+    open = false;
+    release();
+}
+
+MemberImportStatus MemberImport::fail(MemberImportStatus status)
+{
+    abort();
+    return status;
+}
+
+void MemberImport::release()
+{
+    free(work);
+    work = nullptr;
+    batch = nullptr;
+    batchCount = 0;
+}
+
+MemberImportStatus MemberImport::flush()
+{
+    uint16_t count = batchCount;
+    batchCount = 0;
+    return store.importRecords(batch, count) == MEMBER_STORE_OK ? IMPORT_OK : IMPORT_ERR_STORE;
+}
+
+// Split into lines, carrying a partial last line over to the next chunk
+MemberImportStatus MemberImport::feed(const char *text, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = text[i];
+        if (c == '\n')
+        {
+            MemberImportStatus status = parseLine();
+            if (status != IMPORT_OK)
+            {
+                return status;
+            }
+        }
+        else if (lineLength < sizeof(line))
+        {
+            line[lineLength++] = c;
+        }
+        else
+        {
+            lineTooLong = true;
+        }
+    }
+    return IMPORT_OK;
+}
+
+MemberImportStatus MemberImport::parseLine()
+{
+    size_t length = lineLength;
+    bool tooLong = lineTooLong;
+    lineLength = 0;
+    lineTooLong = false;
+
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' '))
+    {
+        length--;
+    }
+    if (length == 0 && !tooLong)
+    {
+        return IMPORT_OK;
+    }
+
+    MemberRecord record;
+    bool valid = false;
+    if (!tooLong)
+    {
+        JsonDocument doc(allocator);
+        valid = !deserializeJson(doc, line, length) && memberRecordFromJson(doc.as<JsonObjectConst>(), record);
+    }
+
+    if (valid && record.subsEndInSec == 0)
+    {
+        record.subsEndInSec = isoDayStart(record.subscriptionEnd, localOffsetSeconds);
+    }
+
+    // Slot 0 is never a sensor slot
+    uint16_t capacity = store.capacity();
+    if (!valid || record.punchingId1 == 0 || record.punchingId1 >= capacity || record.punchingId2 >= capacity)
+    {
+        rejectedCount++;
+        return IMPORT_OK;
+    }
+
+    // Members usually arrive in slot order, so most batches are full
+    bool follows = batchCount > 0 && record.punchingId1 == batch[0].punchingId1 + batchCount;
+    if (batchCount == MEMBER_STORE_BATCH || (batchCount > 0 && !follows))
+    {
+        MemberImportStatus status = flush();
+        if (status != IMPORT_OK)
+        {
+            return status;
+        }
+    }
+    batch[batchCount++] = record;
+    importedCount++;
+    return IMPORT_OK;
+}
+
+const char *MemberImport::statusName(MemberImportStatus status)
+{
+    switch (status)
+    {
+    case IMPORT_OK:
+        return "ok";
+    case IMPORT_ERR_NOT_OPEN:
+        return "not open";
+    case IMPORT_ERR_SEQUENCE:
+        return "sequence";
+    case IMPORT_ERR_DECODE:
+        return "decode";
+    case IMPORT_ERR_STORE:
+        return "store";
+    case IMPORT_ERR_MEMORY:
+        return "memory";
+    case IMPORT_STATUS_COUNT:
+        break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,79 @@
+#ifndef MEMBER_IMPORT_H
+#define MEMBER_IMPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+#include "member_store.h"
+
+#define MEMBER_IMPORT_LINE_MAX    256  //Longest member line (one JSON object)
+#define MEMBER_IMPORT_CHUNK_MAX   1024 //Decoded chunk, before inflating
+#define MEMBER_IMPORT_INFLATE_MAX 4096 //Inflated chunk
+
+enum MemberImportStatus
+{
+    IMPORT_OK = 0,
+    IMPORT_ERR_NOT_OPEN, // No import with this id
+    IMPORT_ERR_SEQUENCE, // A chunk is missing
+    IMPORT_ERR_DECODE,   // Bad base64 or gzip, or a chunk too large
+    IMPORT_ERR_STORE,    // Staging file could not be written or swapped in
+    IMPORT_ERR_MEMORY,
+    IMPORT_STATUS_COUNT
+};
+
+// Bulk member import, fed one MQTT chunk at a time. The stream is NDJSON,
+// one member object per line in the members.json field names, and a line
+// may span chunks. Lines that are too long or not a valid member are
+// counted as rejected and skipped. A gzip chunk is base64 of a complete
+// gzip member of its own. Records go to the store's staging file as they
+// are parsed and become live together in commit(). Merging overwrites
+// slots by punchingId1, replacing starts from an empty store.
+class MemberImport
+{
+public:
+    MemberImport(MemberStore &store, ArduinoJson::Allocator *allocator, int32_t localOffsetSeconds)
+        : store(store), allocator(allocator), localOffsetSeconds(localOffsetSeconds) {}
+
+    // A new id drops whatever import was open
+    MemberImportStatus begin(uint32_t id, bool replace);
+    // Chunks before nextSeq() are duplicates and are ignored
+    MemberImportStatus chunk(uint32_t id, uint32_t seq, const char *data, size_t length, bool gzip);
+    MemberImportStatus commit(uint32_t id);
+    void abort();
+
+    bool active() const { return open; }
+    uint32_t id() const { return importId; }
+    uint32_t nextSeq() const { return next; }
+    uint16_t imported() const { return importedCount; }
+    uint16_t rejected() const { return rejectedCount; }
+
+    static const char *statusName(MemberImportStatus status);
+
+private:
+    MemberImportStatus feed(const char *text, size_t length);
+    MemberImportStatus parseLine();
+    MemberImportStatus flush();
+    MemberImportStatus fail(MemberImportStatus status);
+    void release();
+
+    MemberStore &store;
+    ArduinoJson::Allocator *allocator;
+    int32_t localOffsetSeconds;
+
+    bool open = false;
+    uint32_t importId = 0;
+    uint32_t committedId = 0; // Lets a resent last chunk be acknowledged again
+    uint32_t next = 0;
+    uint16_t importedCount = 0;
+    uint16_t rejectedCount = 0;
+
+    // Decoded chunk, inflated chunk and a batch of records; only while open
+    uint8_t *work = nullptr;
+    MemberRecord *batch = nullptr;
+    uint16_t batchCount = 0;
+    char line[MEMBER_IMPORT_LINE_MAX];
+    size_t lineLength = 0;
+    bool lineTooLong = false;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "member_index.h"
+#include <string.h>
+#include <new>
+
+bool MemberIndex::begin(uint16_t capacity)
+{
+    if (entries != nullptr)
+    {
+        if (capacity <= slots)
+        {
+            clear();
+            return true;
+        }
+        delete[] entries;
+        entries = nullptr;
+    }
+
+    entries = new (std::nothrow) MemberEntry[capacity];
+    if (entries == nullptr)
+    {
+        slots = 0;
+        return false;
+    }
+
+    slots = capacity;
+    clear();
+    return true;
+}
+
+void MemberIndex::clear()
+{
+    if (entries != nullptr)
+    {
+        memset(entries, 0, sizeof(MemberEntry) * slots);
+    }
+    usedCount = 0;
+}
+
+bool MemberIndex::put(uint16_t punchingId, const char *userId, uint8_t userType, uint32_t subsEndInSec)
+{
+    if (punchingId >= slots || (userId != nullptr && strlen(userId) >= MEMBER_USER_ID_LEN))
+    {
+        return false;
+    }
+
+    MemberEntry &entry = entries[punchingId];
+    if (!entry.used)
+    {
+        usedCount++;
+    }
+
+    entry.subsEndInSec = subsEndInSec;
+    entry.userType = userType;
+    entry.used = true;
+    strcpy(entry.userId, userId != nullptr ? userId : "");
+    return true;
+}
+
+bool MemberIndex::remove(uint16_t punchingId)
+{
+    if (punchingId >= slots || !entries[punchingId].used)
+    {
+        return false;
+    }
+
+    memset(&entries[punchingId], 0, sizeof(MemberEntry));
+    usedCount--;
+    return true;
+}
+
+const MemberEntry *MemberIndex::find(uint16_t punchingId) const
+{
+    if (punchingId >= slots || !entries[punchingId].used)
+    {
+        return nullptr;
+    }
+    return &entries[punchingId];
+}
@@ -0,0 +1,39 @@
+#ifndef MEMBER_INDEX_H
+#define MEMBER_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MEMBER_USER_ID_LEN 24
+
+// Only the fields authenticateUser() needs, so a scan never touches flash
+struct MemberEntry
+{
+    uint32_t subsEndInSec;
+    uint8_t userType;
+    bool used;
+    char userId[MEMBER_USER_ID_LEN];
+};
+
+// In-RAM table keyed by punching ID (fingerprint sensor slot).
+// Allocated once at boot, lookups are constant time and allocation free.
+class MemberIndex
+{
+public:
+    bool begin(uint16_t capacity);
+    void clear();
+
+    bool put(uint16_t punchingId, const char *userId, uint8_t userType, uint32_t subsEndInSec);
+    bool remove(uint16_t punchingId);
+    const MemberEntry *find(uint16_t punchingId) const;
+
+    uint16_t capacity() const { return slots; }
+    uint16_t count() const { return usedCount; }
+
+private:
+    MemberEntry *entries = nullptr;
+    uint16_t slots = 0;
+    uint16_t usedCount = 0;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "member_list.h"
+
+void memberListItem(MemberListStream &stream, const JsonDocument &item)
+{
+    bool separate = stream.count > 0 && stream.separator != 0;
+    if (stream.out == nullptr)
+    {
+        stream.length += wireMeasure(item, stream.encoding) + (separate ? 1 : 0);
+    }
+    else
+    {
+        if (separate)
+        {
+            stream.out->write((uint8_t)stream.separator);
+        }
+        wireSerialize(item, stream.encoding, *stream.out);
+    }
+    stream.count++;
+}
+
+MemberListStatus memberListPublish(hal::MqttTransport &transport, const char *topic, WireEncoding encoding,
+                                   const JsonDocument &envelope, MemberListWalk walk, void *ctx)
+{
+    MemberListStream stream = {nullptr, encoding, 0, 0, 0};
+    if (!walk(stream, ctx))
+    {
+        return MEMBER_LIST_ERR_READ;
+    }
+
+    // The element count is only needed by MessagePack, which prefixes arrays
+    WireListFrame frame;
+    if (!wireListFrame(envelope, encoding, stream.count, frame))
+    {
+        return MEMBER_LIST_ERR_FRAME;
+    }
+    if (frame.separator != 0 && stream.count > 1)
+    {
+        stream.length += stream.count - 1;
+    }
+
+    size_t length = frame.headLength + stream.length + frame.tailLength;
+    if (!transport.beginPublish(topic, length, false))
+    {
+        return MEMBER_LIST_ERR_PUBLISH;
+    }
+
+    BufferedPrint out(transport);
+    out.write(frame.head, frame.headLength);
+    stream = {&out, encoding, 0, 0, frame.separator};
+    bool ok = walk(stream, ctx);
+    out.write((const uint8_t *)frame.tail, frame.tailLength);
+    out.flush();
+    transport.endPublish();
+
+    return ok ? MEMBER_LIST_OK : MEMBER_LIST_ERR_TRUNCATED;
+}
+
+const char *memberListStatusName(MemberListStatus status)
+{
+    switch (status)
+    {
+    case MEMBER_LIST_OK:
+        return "ok";
+    case MEMBER_LIST_ERR_READ:
+        return "read failed";
+    case MEMBER_LIST_ERR_FRAME:
+        return "bad envelope";
+    case MEMBER_LIST_ERR_PUBLISH:
+        return "publish refused";
+    case MEMBER_LIST_ERR_TRUNCATED:
+        return "truncated";
+    case MEMBER_LIST_STATUS_COUNT:
+        break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,47 @@
+#ifndef MEMBER_LIST_H
+#define MEMBER_LIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+#include "buffered_print.h"
+#include "hal_mqtt.h"
+#include "wire_format.h"
+
+enum MemberListStatus
+{
+    MEMBER_LIST_OK = 0,
+    MEMBER_LIST_ERR_READ,      // The walk failed before anything was sent
+    MEMBER_LIST_ERR_FRAME,     // Envelope does not end with an empty array
+    MEMBER_LIST_ERR_PUBLISH,   // Broker refused the streamed publish
+    MEMBER_LIST_ERR_TRUNCATED, // The walk failed while writing, the message is short
+    MEMBER_LIST_STATUS_COUNT
+};
+
+// State shared by the two passes over a streamed member list
+struct MemberListStream
+{
+    BufferedPrint *out; // nullptr while measuring
+    WireEncoding encoding;
+    size_t length;
+    uint16_t count;
+    char separator;
+};
+
+// Calls memberListItem() once per element, in the same order on both passes
+typedef bool (*MemberListWalk)(MemberListStream &stream, void *ctx);
+
+// Measures or writes one element. Each element is its own small document,
+// so the memory used does not depend on the length of the list.
+void memberListItem(MemberListStream &stream, const JsonDocument &item);
+
+// Streams a list of members: a first pass measures the payload for the MQTT
+// header, the second one writes it element by element. `envelope` ends with
+// the empty array the elements go in. On MEMBER_LIST_ERR_TRUNCATED the
+// caller should drop the session so the broker discards the message.
+MemberListStatus memberListPublish(hal::MqttTransport &transport, const char *topic, WireEncoding encoding,
+                                   const JsonDocument &envelope, MemberListWalk walk, void *ctx);
+
+const char *memberListStatusName(MemberListStatus status);
+
+#endif
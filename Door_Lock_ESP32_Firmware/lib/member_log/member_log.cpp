@@ -0,0 +1,222 @@
+#include "member_log.h"
+#include "crc16.h"
+#include "slot_bitmap.h"
+#include <string.h>
+
+// Entries read per flash access while walking the ring
+#define MEMBER_LOG_BATCH 8
+
+static size_t entryOffset(uint32_t revision, uint16_t slotCount)
+{
+    return sizeof(MemberLogHeader) + (size_t)(revision % slotCount) * sizeof(MemberLogEntry);
+}
+
+static uint16_t entryCrc(const MemberLogEntry &entry)
+{
+    MemberLogEntry copy = entry;
+    copy.crc = 0;
+    return crc16Ccitt(&copy, sizeof(copy));
+}
+
+bool MemberLog::begin(uint32_t storeRevision)
+{
+    bool valid = slotCount > 0 && fileSystem.exists(path) &&
+                 fileSystem.readAt(path, 0, &header, sizeof(header)) == sizeof(header) &&
+                 header.magic == MEMBER_LOG_MAGIC && header.version == MEMBER_LOG_VERSION &&
+                 header.entrySize == sizeof(MemberLogEntry) && header.slotCount == slotCount &&
+                 fileSystem.size(path) >= entryOffset(slotCount - 1, slotCount) + sizeof(MemberLogEntry);
+
+    if (!valid && !format())
+    {
+        return false;
+    }
+
+    // Recover the newest intact entry
+    newest = header.baseRevision;
+    MemberLogEntry entries[MEMBER_LOG_BATCH];
+    for (uint16_t first = 0; first < slotCount; first += MEMBER_LOG_BATCH)
+    {
+        uint16_t count = slotCount - first < MEMBER_LOG_BATCH ? slotCount - first : MEMBER_LOG_BATCH;
+        size_t bytes = count * sizeof(MemberLogEntry);
+        if (fileSystem.readAt(path, entryOffset(first, slotCount), entries, bytes) != bytes)
+        {
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++)
+        {
+            const MemberLogEntry &entry = entries[i];
+            if (entry.revision > newest && entry.revision % slotCount == first + i && entry.crc == entryCrc(entry))
+            {
+                newest = entry.revision;
+            }
+        }
+    }
+
+    if (newest < storeRevision)
+    {
+        return reset(storeRevision);
+    }
+    return true;
+}
+
+bool MemberLog::format()
+{
+    if (!fileSystem.create(path))
+    {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = MEMBER_LOG_MAGIC;
+    header.version = MEMBER_LOG_VERSION;
+    header.entrySize = sizeof(MemberLogEntry);
+    header.slotCount = slotCount;
+
+    bool ok = fileSystem.append(path, &header, sizeof(header)) == sizeof(header);
+
+    MemberLogEntry empty[MEMBER_LOG_BATCH];
+    memset(empty, 0, sizeof(empty));
+    for (uint16_t first = 0; ok && first < slotCount; first += MEMBER_LOG_BATCH)
+    {
+        uint16_t count = slotCount - first < MEMBER_LOG_BATCH ? slotCount - first : MEMBER_LOG_BATCH;
+        size_t bytes = count * sizeof(MemberLogEntry);
+        ok = fileSystem.append(path, empty, bytes) == bytes;
+    }
+    return ok;
+}
+
+bool MemberLog::writeHeader()
+{
+    return fileSystem.writeAt(path, 0, &header, sizeof(header)) == sizeof(header);
+}
+
+bool MemberLog::append(uint16_t slot, MemberChange change, const char *userId)
+{
+    MemberLogEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.revision = newest + 1;
+    entry.slot = slot;
+    entry.change = change;
+    strncpy(entry.userId, userId != nullptr ? userId : "", sizeof(entry.userId) - 1);
+    entry.crc = entryCrc(entry);
+
+    if (fileSystem.writeAt(path, entryOffset(entry.revision, slotCount), &entry, sizeof(entry)) != sizeof(entry))
+    {
+        return false;
+    }
+    newest = entry.revision;
+    return true;
+}
+
+bool MemberLog::reset(uint32_t revision)
+{
+    header.baseRevision = revision;
+    if (!writeHeader())
+    {
+        return false;
+    }
+    newest = revision;
+    return true;
+}
+
+uint32_t MemberLog::oldest() const
+{
+    return newest - header.baseRevision >= slotCount ? newest - slotCount + 1 : header.baseRevision + 1;
+}
+
+// Entries `first` to `first + count - 1`, which must not wrap around the
+// ring. Returns how many are intact, stopping at the first that is not.
+uint16_t MemberLog::readEntries(uint32_t first, uint16_t count, MemberLogEntry *entries)
+{
+    size_t bytes = count * sizeof(MemberLogEntry);
+    if (fileSystem.readAt(path, entryOffset(first, slotCount), entries, bytes) != bytes)
+    {
+        return 0;
+    }
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (entries[i].revision != first + i || entries[i].crc != entryCrc(entries[i]))
+        {
+            return i;
+        }
+    }
+    return count;
+}
+
+bool MemberLog::changesSince(uint32_t since, MemberChangeVisitor visitor, void *ctx)
+{
+    if (!covers(since))
+    {
+        return false;
+    }
+
+    MemberLogEntry entries[MEMBER_LOG_BATCH];
+
+    // Oldest first: which slots were empty at `since`
+    SlotBitmap seen;
+    SlotBitmap wasEmpty;
+    for (uint32_t first = since + 1; first <= newest;)
+    {
+        uint32_t count = newest - first + 1;
+        uint16_t toRingEnd = slotCount - first % slotCount;
+        count = count < MEMBER_LOG_BATCH ? count : MEMBER_LOG_BATCH;
+        count = count < toRingEnd ? count : toRingEnd;
+
+        if (readEntries(first, count, entries) != count)
+        {
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++)
+        {
+            if (!seen.test(entries[i].slot))
+            {
+                seen.set(entries[i].slot);
+                if (entries[i].change == MEMBER_CHANGE_ADD)
+                {
+                    wasEmpty.set(entries[i].slot);
+                }
+            }
+        }
+        first += count;
+    }
+
+    // Newest first: the state each slot ended up in
+    SlotBitmap visited;
+    for (uint32_t last = newest; last > since;)
+    {
+        uint32_t count = last - since;
+        uint16_t fromRingStart = last % slotCount + 1;
+        count = count < MEMBER_LOG_BATCH ? count : MEMBER_LOG_BATCH;
+        count = count < fromRingStart ? count : fromRingStart;
+
+        uint32_t first = last - count + 1;
+        if (readEntries(first, count, entries) != count)
+        {
+            return false;
+        }
+        for (uint16_t i = count; i-- > 0;)
+        {
+            const MemberLogEntry &entry = entries[i];
+            if (visited.test(entry.slot))
+            {
+                continue;
+            }
+            visited.set(entry.slot);
+
+            bool isEmpty = entry.change == MEMBER_CHANGE_DELETE;
+            bool wasEmptyBefore = wasEmpty.test(entry.slot);
+            if (isEmpty && wasEmptyBefore)
+            {
+                continue;
+            }
+
+            MemberChange change = isEmpty ? MEMBER_CHANGE_DELETE : wasEmptyBefore ? MEMBER_CHANGE_ADD : MEMBER_CHANGE_UPDATE;
+            if (!visitor(entry.slot, change, entry.userId, ctx))
+            {
+                return true;
+            }
+        }
+        last = first - 1;
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef MEMBER_LOG_H
+#define MEMBER_LOG_H
+
+#include <stdint.h>
+#include "hal_fs.h"
+#include "member_index.h"
+
+#define MEMBER_LOG_MAGIC   0x474C4D55 // "UMLG"
+#define MEMBER_LOG_VERSION 1
+
+enum MemberChange
+{
+    MEMBER_CHANGE_ADD = 1,
+    MEMBER_CHANGE_UPDATE,
+    MEMBER_CHANGE_DELETE,
+};
+
+// On-disk layout of the change log: MemberLogHeader, then `slotCount`
+// fixed entries used as a ring. The change with revision r lives in entry
+// r % slotCount; entries at or below baseRevision are history that was
+// dropped (an import replaced the whole store).
+struct MemberLogHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entrySize;
+    uint16_t slotCount;
+    uint16_t reserved0;
+    uint32_t baseRevision;
+    uint32_t reserved[4];
+};
+
+struct MemberLogEntry
+{
+    uint32_t revision;
+    uint16_t slot;
+    uint8_t change;
+    uint8_t reserved0;
+    uint16_t crc; // CRC-16 of the entry with this field zeroed
+    uint16_t reserved1;
+    char userId[MEMBER_USER_ID_LEN]; // Member before a delete, after an add or update
+};
+
+static_assert(sizeof(MemberLogHeader) == 32, "MemberLogHeader layout changed");
+static_assert(sizeof(MemberLogEntry) == 36, "MemberLogEntry layout changed");
+
+// Called once per slot with its net change; return false to stop
+typedef bool (*MemberChangeVisitor)(uint16_t slot, MemberChange change, const char *userId, void *ctx);
+
+// The last `slotCount` changes to the member store, so a server can catch
+// up from the revision it last saw instead of reloading every member.
+class MemberLog
+{
+public:
+    MemberLog(hal::FileSystem &fileSystem, const char *path, uint16_t slotCount)
+        : fileSystem(fileSystem), path(path), slotCount(slotCount) {}
+
+    // `storeRevision` is the revision the store last recorded. A log that
+    // is behind it missed changes, so its history is dropped.
+    bool begin(uint32_t storeRevision);
+    bool append(uint16_t slot, MemberChange change, const char *userId);
+    // Starts the history over at a new revision
+    bool reset(uint32_t revision);
+
+    uint32_t revision() const { return newest; }
+    uint32_t oldest() const; // Oldest revision still held, revision() + 1 when empty
+    bool covers(uint32_t since) const { return since + 1 >= oldest() && since <= newest; }
+
+    // Net change of every slot touched after `since`: ADD when the slot was
+    // empty at `since`, DELETE when it is empty now, UPDATE otherwise. A
+    // slot added and deleted again is skipped. False if !covers(since).
+    bool changesSince(uint32_t since, MemberChangeVisitor visitor, void *ctx);
+
+private:
+    bool format();
+    bool writeHeader();
+    uint16_t readEntries(uint32_t first, uint16_t count, MemberLogEntry *entries);
+
+    hal::FileSystem &fileSystem;
+    const char *path;
+    uint16_t slotCount;
+    MemberLogHeader header = {};
+    uint32_t newest = 0;
+};
+
+#endif
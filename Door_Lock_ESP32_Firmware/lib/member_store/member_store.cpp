@@ -0,0 +1,480 @@
+#include "member_store.h"
+#include "crc16.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint16_t recordCrc(const MemberRecord &record)
+{
+    MemberRecord copy = record;
+    copy.crc = 0;
+    return crc16Ccitt(&copy, sizeof(copy));
+}
+
+static size_t slotOffset(uint16_t slot)
+{
+    return sizeof(MemberStoreHeader) + (size_t)slot * sizeof(MemberRecord);
+}
+
+static void copyField(char *dest, size_t size, const char *src)
+{
+    strncpy(dest, src != nullptr ? src : "", size - 1);
+    dest[size - 1] = '\0';
+}
+
+MemberStoreStatus MemberStore::begin(uint16_t capacity)
+{
+    // An import was cut off: finish its swap, or drop it if it never got there
+    if (fileSystem.exists(stagingPath()))
+    {
+        if (fileSystem.exists(path))
+        {
+            fileSystem.remove(stagingPath());
+        }
+        else
+        {
+            fileSystem.rename(stagingPath(), path);
+        }
+    }
+
+    if (!fileSystem.exists(path))
+    {
+        return format(capacity);
+    }
+
+    MemberStoreHeader stored;
+    size_t got = fileSystem.readAt(path, 0, &stored, sizeof(stored));
+    size_t fileSize = fileSystem.size(path);
+
+    if (got != sizeof(stored) || stored.magic != MEMBER_STORE_MAGIC ||
+        stored.version != MEMBER_STORE_VERSION || stored.recordSize != sizeof(MemberRecord) ||
+        fileSize < slotOffset(stored.capacity))
+    {
+        return MEMBER_STORE_ERR_FORMAT;
+    }
+
+    header = stored;
+
+    // The log may be one change ahead of the header, see recordChange()
+    if (log != nullptr)
+    {
+        if (!log->begin(header.revision))
+        {
+            return MEMBER_STORE_ERR_IO;
+        }
+        header.revision = log->revision();
+    }
+
+    if (header.capacity < capacity)
+    {
+        return grow(path, capacity);
+    }
+    return MEMBER_STORE_OK;
+}
+
+MemberStoreStatus MemberStore::format(uint16_t capacity)
+{
+    // Carry the revision on, so a server never mistakes the empty store
+    // for one it has seen
+    uint32_t revision = header.revision;
+    if (log != nullptr && log->begin(revision))
+    {
+        revision = log->revision();
+    }
+
+    if (!fileSystem.create(path))
+    {
+        return MEMBER_STORE_ERR_OPEN;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = MEMBER_STORE_MAGIC;
+    header.version = MEMBER_STORE_VERSION;
+    header.recordSize = sizeof(MemberRecord);
+    header.capacity = 0;
+    header.revision = revision + 1;
+
+    if (fileSystem.append(path, &header, sizeof(header)) != sizeof(header))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    if (log != nullptr && !log->reset(header.revision))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+
+    return grow(path, capacity);
+}
+
+// Append empty slots, then publish the new capacity in the header
+MemberStoreStatus MemberStore::grow(const char *file, uint16_t capacity)
+{
+    MemberRecord empty[MEMBER_STORE_BATCH];
+    memset(empty, 0, sizeof(empty));
+    for (uint16_t slot = header.capacity; slot < capacity;)
+    {
+        uint16_t count = capacity - slot;
+        if (count > MEMBER_STORE_BATCH)
+        {
+            count = MEMBER_STORE_BATCH;
+        }
+
+        size_t bytes = count * sizeof(MemberRecord);
+        if (fileSystem.append(file, empty, bytes) != bytes)
+        {
+            return MEMBER_STORE_ERR_IO;
+        }
+        slot += count;
+    }
+
+    header.capacity = capacity;
+    if (fileSystem.writeAt(file, 0, &header, sizeof(header)) != sizeof(header))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    return MEMBER_STORE_OK;
+}
+
+MemberStoreStatus MemberStore::read(uint16_t slot, MemberRecord &record)
+{
+    if (slot >= header.capacity)
+    {
+        return MEMBER_STORE_ERR_RANGE;
+    }
+
+    if (fileSystem.readAt(path, slotOffset(slot), &record, sizeof(record)) != sizeof(record))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    if (!record.used)
+    {
+        return MEMBER_STORE_NOT_FOUND;
+    }
+    return record.crc == recordCrc(record) ? MEMBER_STORE_OK : MEMBER_STORE_ERR_CRC;
+}
+
+MemberStoreStatus MemberStore::write(MemberRecord &record)
+{
+    if (record.punchingId1 >= header.capacity)
+    {
+        return MEMBER_STORE_ERR_RANGE;
+    }
+
+    MemberRecord old;
+    MemberChange kind = read(record.punchingId1, old) == MEMBER_STORE_NOT_FOUND ? MEMBER_CHANGE_ADD : MEMBER_CHANGE_UPDATE;
+
+    record.used = 1;
+    record.crc = recordCrc(record);
+    return recordChange(record.punchingId1, record, kind, record.userId);
+}
+
+MemberStoreStatus MemberStore::erase(uint16_t slot)
+{
+    if (slot >= header.capacity)
+    {
+        return MEMBER_STORE_ERR_RANGE;
+    }
+
+    MemberRecord empty;
+    memset(&empty, 0, sizeof(empty));
+
+    MemberRecord old;
+    if (read(slot, old) == MEMBER_STORE_NOT_FOUND)
+    {
+        return writeLive(slot, empty);
+    }
+    old.userId[MEMBER_USER_ID_LEN - 1] = '\0';
+    return recordChange(slot, empty, MEMBER_CHANGE_DELETE, old.userId);
+}
+
+// Logged before it is made: a power cut in between costs the server a
+// needless refetch of the slot, never a missed change
+MemberStoreStatus MemberStore::recordChange(uint16_t slot, const MemberRecord &record, MemberChange kind,
+                                            const char *userId)
+{
+    if (log != nullptr && !log->append(slot, kind, userId))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    header.revision = log != nullptr ? log->revision() : header.revision + 1;
+
+    MemberStoreStatus status = writeLive(slot, record);
+    if (status != MEMBER_STORE_OK)
+    {
+        return status;
+    }
+    if (fileSystem.writeAt(path, 0, &header, sizeof(header)) != sizeof(header))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    return MEMBER_STORE_OK;
+}
+
+// Changes made while an import is open go to its staging copy too, so the
+// swap does not undo them
+MemberStoreStatus MemberStore::writeLive(uint16_t slot, const MemberRecord &record)
+{
+    MemberStoreStatus status = writeSlot(path, slot, record);
+    if (status == MEMBER_STORE_OK && staging)
+    {
+        status = writeSlot(stagingPath(), slot, record);
+    }
+    return status;
+}
+
+MemberStoreStatus MemberStore::writeSlot(const char *file, uint16_t slot, const MemberRecord &record)
+{
+    if (fileSystem.writeAt(file, slotOffset(slot), &record, sizeof(record)) != sizeof(record))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    return MEMBER_STORE_OK;
+}
+
+MemberStoreStatus MemberStore::forEach(MemberVisitor visitor, void *ctx)
+{
+    MemberRecord batch[MEMBER_STORE_BATCH];
+    uint16_t slot = 0;
+
+    while (slot < header.capacity)
+    {
+        uint16_t want = header.capacity - slot;
+        if (want > MEMBER_STORE_BATCH)
+        {
+            want = MEMBER_STORE_BATCH;
+        }
+
+        size_t bytes = want * sizeof(MemberRecord);
+        if (fileSystem.readAt(path, slotOffset(slot), batch, bytes) != bytes)
+        {
+            return MEMBER_STORE_ERR_IO;
+        }
+
+        for (uint16_t i = 0; i < want; i++)
+        {
+            // Records with a bad CRC were torn by a power cut, skip them
+            if (batch[i].used && batch[i].crc == recordCrc(batch[i]))
+            {
+                if (!visitor(batch[i], ctx))
+                {
+                    return MEMBER_STORE_OK;
+                }
+            }
+        }
+        slot += want;
+    }
+
+    return MEMBER_STORE_OK;
+}
+
+const char *MemberStore::stagingPath()
+{
+    if (stagingFile[0] == '\0')
+    {
+        snprintf(stagingFile, sizeof(stagingFile), "%s.new", path);
+    }
+    return stagingFile;
+}
+
+// Header and every slot, batch by batch
+MemberStoreStatus MemberStore::copyTo(const char *file)
+{
+    if (!fileSystem.create(file) || fileSystem.append(file, &header, sizeof(header)) != sizeof(header))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+
+    MemberRecord batch[MEMBER_STORE_BATCH];
+    for (uint16_t slot = 0; slot < header.capacity;)
+    {
+        uint16_t count = header.capacity - slot;
+        if (count > MEMBER_STORE_BATCH)
+        {
+            count = MEMBER_STORE_BATCH;
+        }
+
+        size_t bytes = count * sizeof(MemberRecord);
+        if (fileSystem.readAt(path, slotOffset(slot), batch, bytes) != bytes ||
+            fileSystem.append(file, batch, bytes) != bytes)
+        {
+            return MEMBER_STORE_ERR_IO;
+        }
+        slot += count;
+    }
+    return MEMBER_STORE_OK;
+}
+
+MemberStoreStatus MemberStore::beginImport(bool replace)
+{
+    abortImport();
+
+    MemberStoreStatus status;
+    if (replace)
+    {
+        // Same header, every slot empty
+        uint16_t capacity = header.capacity;
+        MemberStoreHeader fresh = header;
+        fresh.capacity = 0;
+        if (!fileSystem.create(stagingPath()) ||
+            fileSystem.append(stagingPath(), &fresh, sizeof(fresh)) != sizeof(fresh))
+        {
+            return MEMBER_STORE_ERR_IO;
+        }
+        header.capacity = 0;
+        status = grow(stagingPath(), capacity);
+        header.capacity = capacity;
+    }
+    else
+    {
+        status = copyTo(stagingPath());
+    }
+
+    if (status != MEMBER_STORE_OK)
+    {
+        fileSystem.remove(stagingPath());
+        return status;
+    }
+    staging = true;
+    return MEMBER_STORE_OK;
+}
+
+// Records for consecutive slots, starting at records[0].punchingId1,
+// go out in one write
+MemberStoreStatus MemberStore::importRecords(MemberRecord *records, uint16_t count)
+{
+    if (!staging)
+    {
+        return MEMBER_STORE_ERR_OPEN;
+    }
+    if (count == 0)
+    {
+        return MEMBER_STORE_OK;
+    }
+
+    uint16_t first = records[0].punchingId1;
+    if (first + count > header.capacity)
+    {
+        return MEMBER_STORE_ERR_RANGE;
+    }
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (records[i].punchingId1 != first + i)
+        {
+            return MEMBER_STORE_ERR_RANGE;
+        }
+        records[i].used = 1;
+        records[i].crc = recordCrc(records[i]);
+    }
+
+    size_t bytes = count * sizeof(MemberRecord);
+    if (fileSystem.writeAt(stagingPath(), slotOffset(first), records, bytes) != bytes)
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    return MEMBER_STORE_OK;
+}
+
+MemberStoreStatus MemberStore::commitImport()
+{
+    if (!staging)
+    {
+        return MEMBER_STORE_ERR_OPEN;
+    }
+    staging = false;
+
+    // One revision for the whole import; the log cannot describe it, so
+    // its history starts over and older revisions need a full copy
+    MemberStoreHeader committed = header;
+    committed.revision++;
+    if (fileSystem.writeAt(stagingPath(), 0, &committed, sizeof(committed)) != sizeof(committed))
+    {
+        fileSystem.remove(stagingPath());
+        return MEMBER_STORE_ERR_IO;
+    }
+
+    // The file system cannot rename over a file, so begin() finishes the
+    // swap if power goes between these two
+    if (!fileSystem.remove(path) || !fileSystem.rename(stagingPath(), path))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    header = committed;
+    if (log != nullptr && !log->reset(header.revision))
+    {
+        return MEMBER_STORE_ERR_IO;
+    }
+    return MEMBER_STORE_OK;
+}
+
+void MemberStore::abortImport()
+{
+    if (staging || fileSystem.exists(stagingPath()))
+    {
+        fileSystem.remove(stagingPath());
+    }
+    staging = false;
+}
+
+struct FindByUserIdCtx
+{
+    const char *userId;
+    MemberRecord *record;
+    bool found;
+};
+
+static bool matchUserId(const MemberRecord &record, void *ctx)
+{
+    FindByUserIdCtx *find = static_cast<FindByUserIdCtx *>(ctx);
+    if (strncmp(record.userId, find->userId, MEMBER_USER_ID_LEN) == 0)
+    {
+        *find->record = record;
+        find->found = true;
+        return false;
+    }
+    return true;
+}
+
+MemberStoreStatus MemberStore::findByUserId(const char *userId, MemberRecord &record)
+{
+    FindByUserIdCtx ctx = {userId, &record, false};
+    MemberStoreStatus status = forEach(matchUserId, &ctx);
+    if (status != MEMBER_STORE_OK)
+    {
+        return status;
+    }
+    return ctx.found ? MEMBER_STORE_OK : MEMBER_STORE_NOT_FOUND;
+}
+
+bool memberRecordFromJson(JsonObjectConst member, MemberRecord &record)
+{
+    memset(&record, 0, sizeof(record));
+
+    // A cut userId would never match the one the server deletes or updates by
+    const char *userId = member["userId"] | "";
+    if (userId[0] == '\0' || strlen(userId) >= MEMBER_USER_ID_LEN)
+    {
+        return false;
+    }
+
+    copyField(record.userId, sizeof(record.userId), userId);
+    copyField(record.name, sizeof(record.name), member["name"] | "");
+    copyField(record.subscriptionEnd, sizeof(record.subscriptionEnd), member["subscriptionEnd"] | "");
+    record.userType = member["userType"] | 0;
+    record.subsEndInSec = member["subsEndInSec"] | 0;
+    record.punchingId1 = member["punchingId1"] | 0;
+    record.punchingId2 = member["punchingId2"] | 0;
+    return true;
+}
+
+void memberRecordToJson(const MemberRecord &record, JsonObject member)
+{
+    member["userId"] = record.userId;
+    member["name"] = record.name;
+    member["userType"] = record.userType;
+    member["subscriptionEnd"] = record.subscriptionEnd;
+    member["subsEndInSec"] = record.subsEndInSec;
+    member["punchingId1"] = record.punchingId1;
+    if (record.punchingId2 != 0)
+    {
+        member["punchingId2"] = record.punchingId2;
+    }
+}
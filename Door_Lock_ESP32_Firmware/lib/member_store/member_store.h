@@ -0,0 +1,115 @@
+#ifndef MEMBER_STORE_H
+#define MEMBER_STORE_H
+
+#include <stdint.h>
+#include "hal_fs.h"
+#include <ArduinoJson.h>
+#include "member_index.h"
+#include "member_log.h"
+
+#define MEMBER_STORE_MAGIC   0x4D424D55 // "UMBM"
+#define MEMBER_STORE_VERSION 1
+
+#define MEMBER_NAME_LEN     32
+#define MEMBER_SUBS_END_LEN 28
+
+#define MEMBER_STORE_PATH_LEN 32 //Room for the staging file name
+#define MEMBER_STORE_BATCH    8  //Records per flash access when scanning or importing
+
+// On-disk layout of /members.bin (little endian, no implicit padding):
+//   MemberStoreHeader, then `capacity` MemberRecord slots.
+// Slot N holds the member whose punchingId1 is N, so every add, delete
+// or subscription update is a single in-place record write.
+struct MemberStoreHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint16_t capacity;
+    uint16_t reserved0;
+    uint32_t revision; // Bumped by every change, never goes back
+    uint32_t reserved[4];
+};
+
+struct MemberRecord
+{
+    uint8_t used;
+    uint8_t userType;
+    uint16_t punchingId1;
+    uint16_t punchingId2; // 0 when the member has a single finger
+    uint16_t crc;         // CRC-16 of the record with this field zeroed
+    uint32_t subsEndInSec;
+    char userId[MEMBER_USER_ID_LEN];
+    char name[MEMBER_NAME_LEN];
+    char subscriptionEnd[MEMBER_SUBS_END_LEN];
+};
+
+static_assert(sizeof(MemberStoreHeader) == 32, "MemberStoreHeader layout changed");
+static_assert(sizeof(MemberRecord) == 96, "MemberRecord layout changed");
+
+enum MemberStoreStatus
+{
+    MEMBER_STORE_OK = 0,
+    MEMBER_STORE_ERR_OPEN,
+    MEMBER_STORE_ERR_IO,
+    MEMBER_STORE_ERR_FORMAT,
+    MEMBER_STORE_ERR_RANGE,
+    MEMBER_STORE_ERR_CRC,
+    MEMBER_STORE_NOT_FOUND,
+};
+
+// Return false from the visitor to stop iterating
+typedef bool (*MemberVisitor)(const MemberRecord &record, void *ctx);
+
+class MemberStore
+{
+public:
+    // Changes are recorded in `log` when one is given
+    MemberStore(hal::FileSystem &fileSystem, const char *path, MemberLog *log = nullptr)
+        : fileSystem(fileSystem), path(path), log(log) {}
+
+    MemberStoreStatus begin(uint16_t capacity);
+    MemberStoreStatus format(uint16_t capacity);
+
+    MemberStoreStatus read(uint16_t slot, MemberRecord &record);
+    MemberStoreStatus write(MemberRecord &record);
+    MemberStoreStatus erase(uint16_t slot);
+
+    MemberStoreStatus findByUserId(const char *userId, MemberRecord &record);
+    MemberStoreStatus forEach(MemberVisitor visitor, void *ctx);
+
+    // Bulk import: records go to a staging copy ("<path>.new") that replaces
+    // the live file in one step in commitImport(). A power cut before that
+    // leaves the old file; one during the swap is finished by begin().
+    MemberStoreStatus beginImport(bool replace);
+    MemberStoreStatus importRecords(MemberRecord *records, uint16_t count);
+    MemberStoreStatus commitImport();
+    void abortImport();
+    bool importing() const { return staging; }
+
+    uint16_t capacity() const { return header.capacity; }
+    uint32_t revision() const { return header.revision; }
+
+private:
+    MemberStoreStatus recordChange(uint16_t slot, const MemberRecord &record, MemberChange kind, const char *userId);
+    MemberStoreStatus writeLive(uint16_t slot, const MemberRecord &record);
+    MemberStoreStatus writeSlot(const char *file, uint16_t slot, const MemberRecord &record);
+    MemberStoreStatus grow(const char *file, uint16_t capacity);
+    MemberStoreStatus copyTo(const char *file);
+    const char *stagingPath();
+
+    hal::FileSystem &fileSystem;
+    const char *path;
+    MemberLog *log;
+    MemberStoreHeader header = {};
+    char stagingFile[MEMBER_STORE_PATH_LEN] = "";
+    bool staging = false;
+};
+
+// JSON import/export, used for deviceInfo and the members.json converter.
+// A userId that is missing or MEMBER_USER_ID_LEN characters or longer is
+// refused rather than cut.
+bool memberRecordFromJson(JsonObjectConst member, MemberRecord &record);
+void memberRecordToJson(const MemberRecord &record, JsonObject member);
+
+#endif
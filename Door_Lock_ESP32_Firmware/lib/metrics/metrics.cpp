@@ -0,0 +1,45 @@
+#include "metrics.h"
+
+const char *Metrics::name(MetricId id)
+{
+    switch (id)
+    {
+    case METRIC_HEAP_FREE:
+        return "heap";
+    case METRIC_HEAP_MIN:
+        return "heapMin";
+    case METRIC_HEAP_LARGEST:
+        return "heapBlock";
+    case METRIC_PSRAM_FREE:
+        return "psram";
+    case METRIC_PSRAM_SIZE:
+        return "psramSize";
+    case METRIC_STACK_LOOP:
+        return "stkLoop";
+    case METRIC_STACK_FINGERPRINT:
+        return "stkFp";
+    case METRIC_STACK_MQTT:
+        return "stkMqtt";
+    case METRIC_ARENA_PEAK:
+        return "arenaPeak";
+    case METRIC_ARENA_SPILLS:
+        return "arenaSpill";
+    case METRIC_FP_SCANS:
+        return "fpScan";
+    case METRIC_FP_TOUCHES:
+        return "fpTouch";
+    case METRIC_FP_BUSY_US:
+        return "fpBusyUs";
+    case METRIC_ALLOC_COMMANDS:
+        return "allocCmd";
+    case METRIC_ALLOC_ACCESS:
+        return "allocAccess";
+    case METRIC_ALLOC_TELEMETRY:
+        return "allocTele";
+    case METRIC_ALLOC_MQTT:
+        return "allocMqtt";
+    case METRIC_COUNT:
+        break;
+    }
+    return "unknown";
+}
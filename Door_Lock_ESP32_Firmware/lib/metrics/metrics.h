@@ -0,0 +1,51 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+
+enum MetricId : uint8_t
+{
+    // Gauges, refreshed by a periodic sample
+    METRIC_HEAP_FREE = 0,
+    METRIC_HEAP_MIN,          // Lowest free heap since boot
+    METRIC_HEAP_LARGEST,      // Largest block malloc can still hand out
+    METRIC_PSRAM_FREE,
+    METRIC_PSRAM_SIZE,
+    METRIC_STACK_LOOP,        // Stack high-water marks: bytes never used
+    METRIC_STACK_FINGERPRINT,
+    METRIC_STACK_MQTT,
+    METRIC_ARENA_PEAK,        // Most of the JSON arena ever in use
+    METRIC_ARENA_SPILLS,      // JSON allocations that did not fit and went to the heap
+
+    // Counters, only ever increase
+    METRIC_FP_SCANS,          // Sensor polls
+    METRIC_FP_TOUCHES,
+    METRIC_FP_BUSY_US,        // Time spent inside checkFingerprint()
+    METRIC_ALLOC_COMMANDS,    // JSON allocations per subsystem
+    METRIC_ALLOC_ACCESS,
+    METRIC_ALLOC_TELEMETRY,
+    METRIC_ALLOC_MQTT,
+    METRIC_COUNT,
+};
+
+// Fixed table of 32-bit values. Updates are single relaxed atomic
+// operations, so any task (the fingerprint task included) may bump a
+// counter without taking a lock; readers get each value whole but not a
+// snapshot of all of them at one instant.
+class Metrics
+{
+public:
+    void add(MetricId id, uint32_t amount = 1) { values[id].fetch_add(amount, std::memory_order_relaxed); }
+    void set(MetricId id, uint32_t value) { values[id].store(value, std::memory_order_relaxed); }
+    uint32_t get(MetricId id) const { return values[id].load(std::memory_order_relaxed); }
+
+    // Short key used in the telemetry message
+    static const char *name(MetricId id);
+    static bool isCounter(MetricId id) { return id >= METRIC_FP_SCANS; }
+
+private:
+    std::atomic<uint32_t> values[METRIC_COUNT] = {};
+};
+
+#endif
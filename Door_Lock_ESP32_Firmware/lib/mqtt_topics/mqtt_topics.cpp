@@ -0,0 +1,74 @@
+#include "mqtt_topics.h"
+#include <stdio.h>
+#include <string.h>
+
+// Last path element of each device topic, indexed by TopicId
+static const char *const topicSuffixes[TOPIC_COUNT] = {nullptr, nullptr, "command", "callback", "telemetry"};
+
+// NVS reads IDs back into MQTT_TOPIC_ID_LEN buffers, longer ones would
+// come back truncated after a reboot
+static bool validId(const char *id)
+{
+    return id != nullptr && id[0] != '\0' && strnlen(id, MQTT_TOPIC_ID_LEN) < MQTT_TOPIC_ID_LEN;
+}
+
+MqttTopics::MqttTopics()
+{
+    clear();
+}
+
+void MqttTopics::clear()
+{
+    memset(topics, 0, sizeof(topics));
+    snprintf(topics[TOPIC_REGISTER], MQTT_TOPIC_LEN, MQTT_TOPIC_ROOT "/registerDevice");
+
+    // Same strings the firmware used before registration, "unimanage////callback"
+    for (uint8_t id = TOPIC_COMMAND; id < TOPIC_COUNT; id++)
+    {
+        snprintf(topics[id], MQTT_TOPIC_LEN, MQTT_TOPIC_ROOT "////%s", topicSuffixes[id]);
+    }
+    isRegistered = false;
+}
+
+bool MqttTopics::build(const char *companyId, const char *branchId, const char *deviceCode)
+{
+    clear();
+    if (!validId(companyId) || !validId(branchId) || !validId(deviceCode))
+    {
+        return false;
+    }
+
+    char built[TOPIC_COUNT][MQTT_TOPIC_LEN];
+    for (uint8_t id = TOPIC_COMMAND; id < TOPIC_COUNT; id++)
+    {
+        int length = snprintf(built[id], MQTT_TOPIC_LEN, MQTT_TOPIC_ROOT "/%s/%s/%s/%s",
+                              companyId, branchId, deviceCode, topicSuffixes[id]);
+        if (length < 0 || length >= MQTT_TOPIC_LEN)
+        {
+            return false;
+        }
+    }
+
+    for (uint8_t id = TOPIC_COMMAND; id < TOPIC_COUNT; id++)
+    {
+        memcpy(topics[id], built[id], MQTT_TOPIC_LEN);
+    }
+    isRegistered = true;
+    return true;
+}
+
+TopicId MqttTopics::match(const char *topic) const
+{
+    if (topic == nullptr)
+    {
+        return TOPIC_NONE;
+    }
+    for (uint8_t id = TOPIC_REGISTER; id < TOPIC_COUNT; id++)
+    {
+        if (strcmp(topic, topics[id]) == 0)
+        {
+            return (TopicId)id;
+        }
+    }
+    return TOPIC_NONE;
+}
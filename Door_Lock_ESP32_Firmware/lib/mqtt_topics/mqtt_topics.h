@@ -0,0 +1,46 @@
+#ifndef MQTT_TOPICS_H
+#define MQTT_TOPICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MQTT_TOPIC_LEN 128
+#define MQTT_TOPIC_ROOT "unimanage"
+#define MQTT_TOPIC_ID_LEN 32 // Company, branch and device IDs as kept in NVS
+
+enum TopicId : uint8_t
+{
+    TOPIC_NONE = 0,
+    TOPIC_REGISTER,  // Shared topic for devices not registered yet
+    TOPIC_COMMAND,   // Server -> device
+    TOPIC_CALLBACK,  // Device -> server replies and events
+    TOPIC_TELEMETRY, // Device -> server periodic reports
+    TOPIC_COUNT,
+};
+
+// The device topics, formatted once into fixed buffers when the IDs are
+// loaded from NVS or received at registration. Lookups never allocate.
+class MqttTopics
+{
+public:
+    MqttTopics();
+
+    // Builds unimanage/<company>/<branch>/<device>/<suffix> for every
+    // device topic. False when an ID is missing, an ID has
+    // MQTT_TOPIC_ID_LEN characters or more, or a topic is too long; the
+    // topics are then left unregistered.
+    bool build(const char *companyId, const char *branchId, const char *deviceCode);
+    void clear();
+
+    bool registered() const { return isRegistered; }
+    const char *get(TopicId id) const { return topics[id < TOPIC_COUNT ? id : TOPIC_NONE]; }
+
+    // TOPIC_NONE when the topic is not one of ours
+    TopicId match(const char *topic) const;
+
+private:
+    char topics[TOPIC_COUNT][MQTT_TOPIC_LEN];
+    bool isRegistered = false;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "outbox.h"
+#include "crc16.h"
+#include <string.h>
+
+static size_t slotOffset(uint32_t seq, uint16_t slotCount)
+{
+    return sizeof(OutboxHeader) + (size_t)(seq % slotCount) * OUTBOX_SLOT_SIZE;
+}
+
+static uint16_t slotCrc(const OutboxSlotHeader &slot, const uint8_t *payload)
+{
+    uint16_t crc = crc16Ccitt(&slot.seq, sizeof(slot.seq));
+    crc = crc16Ccitt(&slot.length, sizeof(slot.length), crc);
+    return crc16Ccitt(payload, slot.length, crc);
+}
+
+bool Outbox::begin(uint16_t slotCount, bool dropOldest)
+{
+    this->dropOldest = dropOldest;
+
+    bool valid = fileSystem.exists(path) &&
+                 fileSystem.readAt(path, 0, &header, sizeof(header)) == sizeof(header) &&
+                 header.magic == OUTBOX_MAGIC && header.version == OUTBOX_VERSION &&
+                 header.slotSize == OUTBOX_SLOT_SIZE && header.slotCount == slotCount &&
+                 fileSystem.size(path) >= slotOffset(slotCount - 1, slotCount) + OUTBOX_SLOT_SIZE;
+
+    if (!valid && !format(slotCount))
+    {
+        return false;
+    }
+
+    // Recover the ring position from the newest intact unacked slot
+    uint32_t newest = header.ackedSeq;
+    for (uint16_t i = 0; i < slotCount; i++)
+    {
+        OutboxSlotHeader slot;
+        if (fileSystem.readAt(path, sizeof(OutboxHeader) + (size_t)i * OUTBOX_SLOT_SIZE, &slot, sizeof(slot)) == sizeof(slot) &&
+            slot.seq > newest && slot.seq % slotCount == i && slot.length <= OUTBOX_PAYLOAD_LEN)
+        {
+            newest = slot.seq;
+        }
+    }
+
+    headSeq = newest + 1;
+    tailSeq = header.ackedSeq + 1;
+    if (headSeq - tailSeq > slotCount)
+    {
+        tailSeq = headSeq - slotCount;
+    }
+    sendSeq = tailSeq;
+    return true;
+}
+
+bool Outbox::format(uint16_t slotCount)
+{
+    if (!fileSystem.create(path))
+    {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = OUTBOX_MAGIC;
+    header.version = OUTBOX_VERSION;
+    header.slotSize = OUTBOX_SLOT_SIZE;
+    header.slotCount = slotCount;
+
+    bool ok = fileSystem.append(path, &header, sizeof(header)) == sizeof(header);
+
+    uint8_t empty[OUTBOX_SLOT_SIZE];
+    memset(empty, 0, sizeof(empty));
+    for (uint16_t i = 0; ok && i < slotCount; i++)
+    {
+        ok = fileSystem.append(path, empty, sizeof(empty)) == sizeof(empty);
+    }
+    return ok;
+}
+
+bool Outbox::writeHeader()
+{
+    return fileSystem.writeAt(path, 0, &header, sizeof(header)) == sizeof(header);
+}
+
+uint32_t Outbox::push(const uint8_t *payload, uint16_t length)
+{
+    if (length > OUTBOX_PAYLOAD_LEN || header.slotCount == 0)
+    {
+        droppedCount++;
+        return 0;
+    }
+
+    if (headSeq - tailSeq >= header.slotCount)
+    {
+        droppedCount++;
+        if (!dropOldest)
+        {
+            return 0;
+        }
+
+        // Overwrite the oldest unacked message
+        tailSeq++;
+        if (sendSeq < tailSeq)
+        {
+            sendSeq = tailSeq;
+        }
+    }
+
+    OutboxSlotHeader slot;
+    slot.seq = headSeq;
+    slot.length = length;
+    slot.crc = slotCrc(slot, payload);
+
+    // Header and payload go out in one write
+    uint8_t data[OUTBOX_SLOT_SIZE];
+    memcpy(data, &slot, sizeof(slot));
+    memcpy(&data[sizeof(slot)], payload, length);
+
+    size_t bytes = sizeof(slot) + length;
+    if (fileSystem.writeAt(path, slotOffset(slot.seq, header.slotCount), data, bytes) != bytes)
+    {
+        return 0;
+    }
+    return headSeq++;
+}
+
+bool Outbox::readSlot(uint32_t seq, OutboxSlotHeader &slot, uint8_t *payload)
+{
+    uint8_t data[OUTBOX_SLOT_SIZE];
+    if (fileSystem.readAt(path, slotOffset(seq, header.slotCount), data, sizeof(data)) != sizeof(data))
+    {
+        return false;
+    }
+
+    memcpy(&slot, data, sizeof(slot));
+    if (slot.seq != seq || slot.length > OUTBOX_PAYLOAD_LEN)
+    {
+        return false;
+    }
+
+    memcpy(payload, &data[sizeof(slot)], slot.length);
+    return slot.crc == slotCrc(slot, payload);
+}
+
+bool Outbox::peek(uint8_t *payload, uint16_t &length, uint32_t &seq)
+{
+    while (sendSeq < headSeq)
+    {
+        OutboxSlotHeader slot;
+        if (readSlot(sendSeq, slot, payload))
+        {
+            length = slot.length;
+            seq = slot.seq;
+            return true;
+        }
+
+        // Torn by a power cut, nothing to resend
+        droppedCount++;
+        sendSeq++;
+    }
+    return false;
+}
+
+void Outbox::markSent(uint32_t seq)
+{
+    if (seq >= sendSeq && seq < headSeq)
+    {
+        sendSeq = seq + 1;
+    }
+}
+
+bool Outbox::ack(uint32_t seq)
+{
+    if (seq >= headSeq)
+    {
+        seq = headSeq - 1;
+    }
+    if (seq < tailSeq)
+    {
+        return true;
+    }
+
+    tailSeq = seq + 1;
+    if (sendSeq < tailSeq)
+    {
+        sendSeq = tailSeq;
+    }
+
+    header.ackedSeq = seq;
+    return writeHeader();
+}
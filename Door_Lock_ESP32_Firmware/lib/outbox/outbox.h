@@ -0,0 +1,76 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdint.h>
+#include "hal_fs.h"
+
+#define OUTBOX_MAGIC   0x584F4255 // "UBOX"
+#define OUTBOX_VERSION 1
+
+#define OUTBOX_SLOT_SIZE   256
+#define OUTBOX_PAYLOAD_LEN (OUTBOX_SLOT_SIZE - sizeof(OutboxSlotHeader))
+
+// On-disk layout of the outbox file: OutboxHeader, then `slotCount`
+// fixed slots used as a ring. Message `seq` lives in slot seq % slotCount.
+struct OutboxHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t slotSize;
+    uint16_t slotCount;
+    uint16_t reserved0;
+    uint32_t ackedSeq; // Highest sequence number the server confirmed
+    uint32_t reserved[4];
+};
+
+struct OutboxSlotHeader
+{
+    uint32_t seq;
+    uint16_t length;
+    uint16_t crc; // CRC-16 of seq, length and payload
+};
+
+static_assert(sizeof(OutboxHeader) == 32, "OutboxHeader layout changed");
+static_assert(sizeof(OutboxSlotHeader) == 8, "OutboxSlotHeader layout changed");
+
+// Persistent store-and-forward queue for outbound MQTT messages.
+// Messages stay on flash until the server acks their sequence number;
+// after a reconnect everything unacked is sent again.
+class Outbox
+{
+public:
+    Outbox(hal::FileSystem &fileSystem, const char *path) : fileSystem(fileSystem), path(path) {}
+
+    bool begin(uint16_t slotCount, bool dropOldest);
+
+    // Returns the sequence number given to the message, 0 if it was rejected
+    uint32_t push(const uint8_t *payload, uint16_t length);
+
+    // Next message to transmit, false when everything was sent
+    bool peek(uint8_t *payload, uint16_t &length, uint32_t &seq);
+    void markSent(uint32_t seq);
+    void rewind() { sendSeq = tailSeq; }
+    bool ack(uint32_t seq);
+
+    uint32_t nextSeq() const { return headSeq; }
+    uint32_t pending() const { return headSeq - tailSeq; }
+    uint32_t unsent() const { return headSeq - sendSeq; }
+    uint32_t dropped() const { return droppedCount; }
+
+private:
+    bool format(uint16_t slotCount);
+    bool writeHeader();
+    bool readSlot(uint32_t seq, OutboxSlotHeader &slot, uint8_t *payload);
+
+    hal::FileSystem &fileSystem;
+    const char *path;
+    OutboxHeader header = {};
+    bool dropOldest = true;
+
+    uint32_t headSeq = 1; // Next sequence number to assign
+    uint32_t tailSeq = 1; // Oldest message not yet acked
+    uint32_t sendSeq = 1; // Next message to transmit
+    uint32_t droppedCount = 0;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "slot_bitmap.h"
+#include <string.h>
+
+// Words are kept little endian so bytes() matches the sensor's layout
+
+void SlotBitmap::clear()
+{
+    memset(words, 0, sizeof(words));
+}
+
+void SlotBitmap::loadPage(uint8_t page, const uint8_t *data)
+{
+    if (page >= SLOT_BITMAP_PAGES)
+    {
+        return;
+    }
+    memcpy(reinterpret_cast<uint8_t *>(words) + page * SLOT_BITMAP_PAGE_BYTES, data, SLOT_BITMAP_PAGE_BYTES);
+}
+
+void SlotBitmap::set(uint16_t slot)
+{
+    if (slot < SLOT_BITMAP_BITS)
+    {
+        words[slot / 32] |= 1UL << (slot % 32);
+    }
+}
+
+void SlotBitmap::reset(uint16_t slot)
+{
+    if (slot < SLOT_BITMAP_BITS)
+    {
+        words[slot / 32] &= ~(1UL << (slot % 32));
+    }
+}
+
+bool SlotBitmap::test(uint16_t slot) const
+{
+    return slot < SLOT_BITMAP_BITS && (words[slot / 32] & (1UL << (slot % 32))) != 0;
+}
+
+uint16_t SlotBitmap::findFirstFree(uint16_t first, uint16_t limit) const
+{
+    if (limit > SLOT_BITMAP_BITS)
+    {
+        limit = SLOT_BITMAP_BITS;
+    }
+
+    uint16_t slot = first;
+    while (slot < limit)
+    {
+        // Ignore bits below `slot` in its word, then skip full words
+        uint32_t freeBits = ~words[slot / 32] & (0xFFFFFFFFUL << (slot % 32));
+        if (freeBits != 0)
+        {
+            uint16_t found = (slot & ~31) + __builtin_ctz(freeBits);
+            return found < limit ? found : 0;
+        }
+        slot = (slot & ~31) + 32;
+    }
+    return 0;
+}
+
+uint16_t SlotBitmap::count() const
+{
+    uint16_t total = 0;
+    for (size_t i = 0; i < SLOT_BITMAP_BITS / 32; i++)
+    {
+        total += __builtin_popcount(words[i]);
+    }
+    return total;
+}
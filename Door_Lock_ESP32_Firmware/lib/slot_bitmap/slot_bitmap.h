@@ -0,0 +1,35 @@
+#ifndef SLOT_BITMAP_H
+#define SLOT_BITMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The sensor reports its template index table in pages of 32 bytes
+// (256 slots). Bit j of byte i in page p is slot p * 256 + i * 8 + j.
+#define SLOT_BITMAP_PAGE_BYTES 32
+#define SLOT_BITMAP_PAGES      4
+#define SLOT_BITMAP_BITS       (SLOT_BITMAP_PAGES * SLOT_BITMAP_PAGE_BYTES * 8)
+
+// RAM copy of which sensor slots hold a template
+class SlotBitmap
+{
+public:
+    void clear();
+    void loadPage(uint8_t page, const uint8_t *data);
+
+    void set(uint16_t slot);
+    void reset(uint16_t slot);
+    bool test(uint16_t slot) const;
+
+    // First free slot in [first, limit), or 0 when there is none
+    uint16_t findFirstFree(uint16_t first, uint16_t limit) const;
+    uint16_t count() const;
+
+    const uint8_t *bytes() const { return reinterpret_cast<const uint8_t *>(words); }
+    size_t sizeBytes() const { return sizeof(words); }
+
+private:
+    uint32_t words[SLOT_BITMAP_BITS / 32] = {};
+};
+
+#endif
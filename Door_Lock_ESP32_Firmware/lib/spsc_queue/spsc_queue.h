@@ -0,0 +1,69 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Bounded lock-free queue for exactly one producer task and one consumer
+// task. Capacity must be a power of two. A push into a full queue is
+// dropped and counted rather than blocking the producer.
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    bool push(const T &item)
+    {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        size_t tail = tailIndex.load(std::memory_order_acquire);
+        if (head - tail >= N)
+        {
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[head & (N - 1)] = item;
+        headIndex.store(head + 1, std::memory_order_release);
+
+        size_t depth = head + 1 - tail;
+        if (depth > peakDepth.load(std::memory_order_relaxed))
+        {
+            peakDepth.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        size_t head = headIndex.load(std::memory_order_acquire);
+        if (tail == head)
+        {
+            return false;
+        }
+
+        item = items[tail & (N - 1)];
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t depth() const
+    {
+        return headIndex.load(std::memory_order_acquire) - tailIndex.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return N; }
+    size_t peak() const { return peakDepth.load(std::memory_order_relaxed); }
+    uint32_t drops() const { return dropCount.load(std::memory_order_relaxed); }
+
+private:
+    T items[N];
+    std::atomic<size_t> headIndex{0};
+    std::atomic<size_t> tailIndex{0};
+    std::atomic<size_t> peakDepth{0};
+    std::atomic<uint32_t> dropCount{0};
+};
+
+#endif
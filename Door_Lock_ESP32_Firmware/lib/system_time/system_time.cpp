@@ -0,0 +1,163 @@
+#include "system_time.h"
+
+SystemTime::Anchor SystemTime::current() const
+{
+    for (;;)
+    {
+        uint32_t seen = generation.load(std::memory_order_acquire);
+        Anchor anchor = anchors[seen & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (generation.load(std::memory_order_relaxed) == seen)
+        {
+            return anchor;
+        }
+    }
+}
+
+void SystemTime::publish(const Anchor &next)
+{
+    uint32_t seen = generation.load(std::memory_order_relaxed);
+    anchors[(seen + 1) & 1] = next;
+    generation.store(seen + 1, std::memory_order_release);
+}
+
+int64_t SystemTime::project(const Anchor &anchor, uint64_t monoUs, int64_t *slewLeft)
+{
+    // Milliseconds keep the products in range for months between anchors
+    int64_t elapsedUs = monoUs > anchor.monoUs ? (int64_t)(monoUs - anchor.monoUs) : 0;
+    int64_t elapsedMs = elapsedUs / 1000;
+    int64_t timeUs = anchor.timeUs + elapsedUs + elapsedMs * anchor.driftPpb / 1000000;
+
+    int64_t slewSize = anchor.slewUs < 0 ? -anchor.slewUs : anchor.slewUs;
+    int64_t applied = elapsedMs * (int64_t)anchor.slewPpm / 1000;
+    if (applied > slewSize)
+    {
+        applied = slewSize;
+    }
+    if (anchor.slewUs < 0)
+    {
+        applied = -applied;
+    }
+
+    if (slewLeft != nullptr)
+    {
+        *slewLeft = anchor.slewUs - applied;
+    }
+    return timeUs + applied;
+}
+
+int64_t SystemTime::nowUs()
+{
+    if (!valid())
+    {
+        return 0;
+    }
+
+    Anchor anchor = current();
+    int64_t now = project(anchor, clock.micros64(), nullptr);
+
+    // Readers on other tasks may have seen a later instant of an older anchor
+    std::atomic<int64_t> &returned = lastReturned[anchor.epoch & 1];
+    int64_t last = returned.load(std::memory_order_relaxed);
+    while (now > last && !returned.compare_exchange_weak(last, now, std::memory_order_relaxed))
+    {
+    }
+    return now > last ? now : last;
+}
+
+int64_t SystemTime::slewRemainingUs()
+{
+    int64_t left = 0;
+    if (valid())
+    {
+        project(current(), clock.micros64(), &left);
+    }
+    return left;
+}
+
+SystemTimeAdjust SystemTime::discipline(int64_t referenceUs, uint64_t atUs, uint32_t toleranceUs)
+{
+    sampleCount++;
+
+    if (!valid())
+    {
+        publish({atUs, referenceUs, 0, 0, 0, 0});
+        haveBaseline = false;
+        if (toleranceUs <= config.driftSampleToleranceUs)
+        {
+            haveBaseline = true;
+            baselineRefUs = referenceUs;
+            baselineMonoUs = atUs;
+        }
+        lastOffset = 0;
+        return TIME_ADJUST_INITIAL;
+    }
+
+    Anchor previous = current();
+    int64_t slewLeft;
+    int64_t now = project(previous, atUs, &slewLeft);
+    int64_t offset = referenceUs - now;
+    lastOffset = offset;
+
+    Anchor next = {atUs, now, previous.driftPpb, slewLeft, previous.slewPpm, previous.epoch};
+
+    // Rate of the monotonic counter against the reference, from two precise samples
+    if (toleranceUs <= config.driftSampleToleranceUs)
+    {
+        int64_t monoSpan = (int64_t)(atUs - baselineMonoUs);
+        int64_t refSpan = referenceUs - baselineRefUs;
+        int64_t error = refSpan - monoSpan;
+        bool consistent = haveBaseline && (error < 0 ? -error : error) <= monoSpan / 1000; // Within 1000 ppm
+
+        if (!haveBaseline || !consistent)
+        {
+            // First precise sample, or the reference jumped since the last one
+            haveBaseline = true;
+            baselineRefUs = referenceUs;
+            baselineMonoUs = atUs;
+        }
+        else if (monoSpan >= (int64_t)config.driftMinBaselineS * 1000000)
+        {
+            int64_t measuredPpb = error * 1000000000 / monoSpan;
+            int64_t driftPpb = haveDrift ? previous.driftPpb + (measuredPpb - previous.driftPpb) / 4 : measuredPpb;
+            int64_t limitPpb = (int64_t)config.driftMaxPpm * 1000;
+            next.driftPpb = (int32_t)(driftPpb > limitPpb ? limitPpb : driftPpb < -limitPpb ? -limitPpb : driftPpb);
+            haveDrift = true;
+
+            baselineRefUs = referenceUs;
+            baselineMonoUs = atUs;
+        }
+    }
+
+    SystemTimeAdjust result = TIME_ADJUST_NONE;
+    int64_t thresholdUs = (int64_t)config.stepThresholdMs * 1000;
+    if (offset > thresholdUs)
+    {
+        // Behind: jumping forward keeps the clock monotonic
+        next.timeUs = referenceUs;
+        next.slewUs = 0;
+        stepCount++;
+        result = TIME_ADJUST_STEP;
+    }
+    else if (offset < -(int64_t)config.stepBackThresholdMs * 1000)
+    {
+        // Too far ahead to slew in reasonable time; the clock was wrong
+        next.timeUs = referenceUs;
+        next.slewUs = 0;
+        next.epoch++;
+        lastReturned[next.epoch & 1].store(0, std::memory_order_relaxed);
+        stepBackCount++;
+        result = TIME_ADJUST_STEP_BACK;
+    }
+    else if (offset > (int64_t)toleranceUs || offset < -(int64_t)toleranceUs)
+    {
+        // A large lead runs the clock slow at aheadSlewPpm, it never stands still
+        next.slewUs = offset;
+        next.slewPpm = offset < -thresholdUs ? config.aheadSlewPpm : config.slewMaxPpm;
+        slewCount++;
+        result = TIME_ADJUST_SLEW;
+    }
+
+    publish(next);
+    return result;
+}
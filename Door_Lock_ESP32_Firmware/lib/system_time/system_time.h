@@ -0,0 +1,103 @@
+#ifndef SYSTEM_TIME_H
+#define SYSTEM_TIME_H
+
+#include <stdint.h>
+#include <atomic>
+#include "hal_clock.h"
+
+struct SystemTimeConfig
+{
+    uint32_t slewMaxPpm;             // Fastest rate an offset is worked off at
+    uint32_t stepThresholdMs;        // Clock behind by more is stepped, ahead by more slewed at aheadSlewPpm
+    uint32_t aheadSlewPpm;           // Rate a lead beyond stepThresholdMs is worked off at
+    uint32_t stepBackThresholdMs;    // Clock ahead by more is stepped back
+    uint32_t driftMaxPpm;            // Frequency correction is clamped to this
+    uint32_t driftMinBaselineS;      // Shortest span between two samples used for drift
+    uint32_t driftSampleToleranceUs; // Only samples this precise feed the drift estimate
+};
+
+// What discipline() did with a reference sample
+enum SystemTimeAdjust
+{
+    TIME_ADJUST_NONE = 0,  // Within the sample's tolerance
+    TIME_ADJUST_INITIAL,   // First sample, the clock was set
+    TIME_ADJUST_SLEW,      // Offset is being worked off gradually
+    TIME_ADJUST_STEP,      // Clock was behind by more than stepThresholdMs
+    TIME_ADJUST_STEP_BACK, // Clock was ahead by more than stepBackThresholdMs
+};
+
+// Wall clock kept in software on top of the monotonic microsecond counter,
+// so reading it costs no bus transaction. Reference samples (RTC second
+// edges, NTP) correct its phase by slewing and its rate through a drift
+// estimate. A clock that is behind by a lot is stepped forward, one that is
+// ahead is slowed down, so time does not run backwards. The exception is a
+// clock ahead by more than stepBackThresholdMs, which is stepped back.
+//
+// discipline() and resetDriftBaseline() belong to one task; now*() may be
+// called from any task and does not block.
+class SystemTime
+{
+public:
+    SystemTime(hal::Clock &clock, const SystemTimeConfig &config) : clock(clock), config(config) {}
+
+    // Feed a reference: it read referenceUs (unix microseconds) at the
+    // monotonic instant atUs, give or take toleranceUs
+    SystemTimeAdjust discipline(int64_t referenceUs, uint64_t atUs, uint32_t toleranceUs);
+    // The reference itself was changed (RTC rewritten), old samples no longer compare
+    void resetDriftBaseline() { haveBaseline = false; }
+
+    bool valid() const { return generation.load(std::memory_order_acquire) != 0; }
+    // Unix time, 0 until the first reference sample
+    int64_t nowUs();
+    int64_t nowMs() { return nowUs() / 1000; }
+    uint32_t unixTime() { return (uint32_t)(nowUs() / 1000000); }
+
+    // Offset still being slewed, and the frequency correction in parts per billion
+    int64_t slewRemainingUs();
+    int32_t driftPpb() const { return current().driftPpb; }
+    int64_t lastOffsetUs() const { return lastOffset; }
+    uint32_t samples() const { return sampleCount; }
+    uint32_t slews() const { return slewCount; }
+    uint32_t steps() const { return stepCount; }
+    uint32_t stepBacks() const { return stepBackCount; }
+
+private:
+    // Time at anchor.monoUs, and how it advances from there
+    struct Anchor
+    {
+        uint64_t monoUs;
+        int64_t timeUs;
+        int32_t driftPpb;
+        int64_t slewUs;   // Offset to work off from monoUs on, signed
+        uint32_t slewPpm; // Rate it is worked off at
+        uint32_t epoch;   // Bumped by a step back
+    };
+
+    Anchor current() const;
+    void publish(const Anchor &next);
+    static int64_t project(const Anchor &anchor, uint64_t monoUs, int64_t *slewLeft);
+
+    hal::Clock &clock;
+    SystemTimeConfig config;
+
+    // Two anchors; the writer fills the one readers are not using and then
+    // bumps the generation, a reader retries if it moved under it
+    Anchor anchors[2] = {};
+    std::atomic<uint32_t> generation{0};
+    // Latest time handed out, per epoch so a reader still on the anchor
+    // before a step back cannot hold the clock at the old time
+    std::atomic<int64_t> lastReturned[2] = {{0}, {0}};
+
+    bool haveBaseline = false;
+    bool haveDrift = false;
+    int64_t baselineRefUs = 0;
+    uint64_t baselineMonoUs = 0;
+
+    int64_t lastOffset = 0;
+    uint32_t sampleCount = 0;
+    uint32_t slewCount = 0;
+    uint32_t stepCount = 0;
+    uint32_t stepBackCount = 0;
+};
+
+#endif
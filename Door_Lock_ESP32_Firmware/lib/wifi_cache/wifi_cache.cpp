@@ -0,0 +1,81 @@
+#include "wifi_cache.h"
+#include <string.h>
+#include "crc16.h"
+
+static uint16_t ssidCrc(const char *ssid)
+{
+    return crc16Ccitt(ssid, strlen(ssid));
+}
+
+bool WiFiCache::load(const char *ssid, WiFiLink &link)
+{
+    if (!store.getBytes(WIFI_LINK_KEY, &link, sizeof(link)))
+    {
+        return false;
+    }
+    return link.version == WIFI_LINK_VERSION && link.channel != 0 && link.ssidCrc == ssidCrc(ssid);
+}
+
+bool WiFiCache::save(const char *ssid, WiFiLink link)
+{
+    link.version = WIFI_LINK_VERSION;
+    link.ssidCrc = ssidCrc(ssid);
+    link.reserved = 0;
+
+    WiFiLink stored;
+    if (store.getBytes(WIFI_LINK_KEY, &stored, sizeof(stored)) && memcmp(&stored, &link, sizeof(link)) == 0)
+    {
+        return false;
+    }
+
+    writeCount++;
+    return store.putBytes(WIFI_LINK_KEY, &link, sizeof(link));
+}
+
+void WiFiCache::forget()
+{
+    store.remove(WIFI_LINK_KEY);
+    store.remove("ssid");
+    store.remove("password");
+    store.remove("haveWiFiCred");
+}
+
+bool WiFiCache::loadCredentials(char *ssid, char *password)
+{
+    if (!store.getBool("haveWiFiCred", false) || !store.getString("ssid", ssid, WIFI_SSID_LEN))
+    {
+        return false;
+    }
+    if (!store.getString("password", password, WIFI_PASSWORD_LEN))
+    {
+        password[0] = '\0';
+    }
+    return ssid[0] != '\0';
+}
+
+bool WiFiCache::saveCredentials(const char *ssid, const char *password)
+{
+    bool changed = putStringIfChanged("ssid", ssid, WIFI_SSID_LEN);
+    changed |= putStringIfChanged("password", password, WIFI_PASSWORD_LEN);
+
+    if (!store.getBool("haveWiFiCred", false))
+    {
+        writeCount++;
+        store.putBool("haveWiFiCred", true);
+        changed = true;
+    }
+    return changed;
+}
+
+bool WiFiCache::putStringIfChanged(const char *key, const char *value, size_t size)
+{
+    char stored[WIFI_PASSWORD_LEN];
+    if (store.getString(key, stored, size) && strcmp(stored, value) == 0)
+    {
+        return false;
+    }
+
+    writeCount++;
+    store.putString(key, value);
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <stdint.h>
+#include "hal_kv.h"
+
+#define WIFI_LINK_KEY     "wifiLink"
+#define WIFI_LINK_VERSION 1
+
+#define WIFI_SSID_LEN     33 // 32 characters and the terminator
+#define WIFI_PASSWORD_LEN 65
+
+// Where the last successful connection ended up. Stored as one NVS blob
+// so the next boot can join the same access point without a scan.
+struct WiFiLink
+{
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint16_t ssidCrc; // Ties the entry to the network it was learned on
+    uint16_t reserved;
+    uint32_t ip; // Last DHCP lease, as IPAddress converts to uint32_t
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+static_assert(sizeof(WiFiLink) == 28, "WiFiLink layout changed");
+
+// Wi-Fi credentials and link details in NVS. Every store call compares
+// with what is already saved first, so a reconnect to the same access
+// point costs no flash writes.
+class WiFiCache
+{
+public:
+    explicit WiFiCache(hal::KeyValueStore &store) : store(store) {}
+
+    // Cached link for this network, false when there is none
+    bool load(const char *ssid, WiFiLink &link);
+    // True when something changed and was written
+    bool save(const char *ssid, WiFiLink link);
+    // Drops the link and the credentials
+    void forget();
+
+    // Buffers of WIFI_SSID_LEN and WIFI_PASSWORD_LEN, false when none are saved
+    bool loadCredentials(char *ssid, char *password);
+    bool saveCredentials(const char *ssid, const char *password);
+
+    uint32_t writes() const { return writeCount; }
+
+private:
+    bool putStringIfChanged(const char *key, const char *value, size_t size);
+
+    hal::KeyValueStore &store;
+    uint32_t writeCount = 0;
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include "wifi_manager.h"
+#include <string.h>
+
+static void copyString(char *to, const char *from, size_t size)
+{
+    strncpy(to, from != nullptr ? from : "", size - 1);
+    to[size - 1] = '\0';
+}
+
+uint8_t WiFiManager::begin()
+{
+    if (!cache.loadCredentials(stationSsid, stationPassword))
+    {
+        current = WIFI_MGR_UNCONFIGURED;
+        return startAp();
+    }
+    return startAttempt(clock.millis());
+}
+
+uint8_t WiFiManager::update()
+{
+    uint32_t now = clock.millis();
+    uint8_t events = serviceScan();
+
+    switch (current)
+    {
+    case WIFI_MGR_UNCONFIGURED:
+        break;
+
+    case WIFI_MGR_CONNECTING:
+        if (radio.stationConnected())
+        {
+            events |= joined(now);
+        }
+        else if (now - attemptStart >= (attemptFast ? config.fastConnectTimeoutMs : config.connectTimeoutMs))
+        {
+            events |= attemptFailed(now);
+        }
+        break;
+
+    case WIFI_MGR_ONLINE:
+        if (!radio.stationConnected())
+        {
+            // First retry right away, the access point may only have blinked
+            dropCount++;
+            outageStart = now;
+            backoff.reset();
+            nextAttemptAt = now;
+            current = WIFI_MGR_WAITING;
+            events |= WIFI_EVENT_DISCONNECTED;
+        }
+        else if (apStopPending && (int32_t)(now - apStopAt) >= 0)
+        {
+            apStopPending = false;
+            events |= stopAp();
+        }
+        break;
+
+    case WIFI_MGR_WAITING:
+        if ((int32_t)(now - nextAttemptAt) >= 0)
+        {
+            events |= startAttempt(now);
+        }
+        break;
+    }
+    return events;
+}
+
+void WiFiManager::setCredentials(const char *ssid, const char *password)
+{
+    copyString(stationSsid, ssid, sizeof(stationSsid));
+    copyString(stationPassword, password, sizeof(stationPassword));
+
+    // The setup page is still open on the access point, keep it up
+    radio.disconnectStation();
+    backoff.reset();
+    failuresInRow = 0;
+    fastFailed = false;
+    apStopPending = false;
+    outageStart = clock.millis();
+    startAttempt(outageStart);
+}
+
+void WiFiManager::forget()
+{
+    stationSsid[0] = '\0';
+    stationPassword[0] = '\0';
+    radio.disconnectStation();
+    cache.forget();
+    current = WIFI_MGR_UNCONFIGURED;
+    apStopPending = false;
+    startAp();
+}
+
+uint8_t WiFiManager::startAttempt(uint32_t now)
+{
+    if (current != WIFI_MGR_WAITING && current != WIFI_MGR_CONNECTING)
+    {
+        outageStart = now;
+    }
+
+    WiFiLink link;
+    attemptFast = !fastFailed && cache.load(stationSsid, link);
+    if (attemptFast)
+    {
+        hal::WiFiStationInfo lease = {};
+        lease.ip = link.ip;
+        lease.gateway = link.gateway;
+        lease.subnet = link.subnet;
+        lease.dns = link.dns;
+        bool useLease = config.cacheIp && link.ip != 0;
+        radio.beginStation(stationSsid, stationPassword, link.channel, link.bssid, useLease ? &lease : nullptr);
+    }
+    else
+    {
+        radio.beginStation(stationSsid, stationPassword, 0, nullptr, nullptr);
+    }
+
+    attemptCount++;
+    attemptStart = now;
+    current = WIFI_MGR_CONNECTING;
+    return WIFI_EVENT_NONE;
+}
+
+uint8_t WiFiManager::attemptFailed(uint32_t now)
+{
+    radio.disconnectStation();
+    failureCount++;
+
+    // A stale cache entry is not the network's fault, go straight to a scan
+    if (attemptFast)
+    {
+        fastFailed = true;
+        return startAttempt(now);
+    }
+
+    uint8_t events = WIFI_EVENT_NONE;
+    if (failuresInRow < 255)
+    {
+        failuresInRow++;
+    }
+    if (failuresInRow >= config.apFallbackFailures && !apUp)
+    {
+        events |= startAp();
+    }
+
+    nextAttemptAt = now + backoff.next(random());
+    current = WIFI_MGR_WAITING;
+    return events;
+}
+
+uint8_t WiFiManager::joined(uint32_t now)
+{
+    lastConnectMs = now - outageStart;
+    if (firstConnectMs == 0)
+    {
+        firstConnectMs = lastConnectMs > 0 ? lastConnectMs : 1;
+    }
+    lastFast = attemptFast;
+    fastFailed = false;
+    failuresInRow = 0;
+    backoff.reset();
+    current = WIFI_MGR_ONLINE;
+
+    cache.saveCredentials(stationSsid, stationPassword);
+    hal::WiFiStationInfo info;
+    if (radio.stationInfo(info))
+    {
+        WiFiLink link = {};
+        memcpy(link.bssid, info.bssid, sizeof(link.bssid));
+        link.channel = info.channel;
+        link.ip = info.ip;
+        link.gateway = info.gateway;
+        link.subnet = info.subnet;
+        link.dns = info.dns;
+        cache.save(stationSsid, link);
+    }
+
+    if (apUp)
+    {
+        apStopPending = true;
+        apStopAt = now + config.apLingerMs;
+    }
+    return WIFI_EVENT_CONNECTED;
+}
+
+uint8_t WiFiManager::serviceScan()
+{
+    // Scanning hops channels, which would break a join in progress
+    if (scanRequested && !scanRunning && current != WIFI_MGR_CONNECTING)
+    {
+        scanRequested = false;
+        scanRunning = radio.startScan();
+        if (!scanRunning)
+        {
+            networksFound = 0;
+            return WIFI_EVENT_SCAN_DONE;
+        }
+    }
+
+    if (!scanRunning)
+    {
+        return WIFI_EVENT_NONE;
+    }
+
+    int found = radio.scanComplete();
+    if (found == -1)
+    {
+        return WIFI_EVENT_NONE;
+    }
+    scanRunning = false;
+    networksFound = found > 0 ? found : 0;
+    return WIFI_EVENT_SCAN_DONE;
+}
+
+uint8_t WiFiManager::startAp()
+{
+    if (apUp)
+    {
+        return WIFI_EVENT_NONE;
+    }
+    radio.startAccessPoint(config.apSsid, config.apPassword);
+    apUp = true;
+    return WIFI_EVENT_AP_STARTED;
+}
+
+uint8_t WiFiManager::stopAp()
+{
+    if (!apUp)
+    {
+        return WIFI_EVENT_NONE;
+    }
+    radio.stopAccessPoint();
+    apUp = false;
+    return WIFI_EVENT_AP_STOPPED;
+}
+
+const char *WiFiManager::stateName(WiFiManagerState state)
+{
+    switch (state)
+    {
+    case WIFI_MGR_UNCONFIGURED:
+        return "unconfigured";
+    case WIFI_MGR_CONNECTING:
+        return "connecting";
+    case WIFI_MGR_ONLINE:
+        return "online";
+    case WIFI_MGR_WAITING:
+        return "waiting";
+    }
+    return "unknown";
+}
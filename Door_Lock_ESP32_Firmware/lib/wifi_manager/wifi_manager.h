@@ -0,0 +1,124 @@
+#ifndef WIFI_MANAGER_H
+#define WIFI_MANAGER_H
+
+#include <stdint.h>
+#include "hal_wifi.h"
+#include "hal_clock.h"
+#include "wifi_cache.h"
+#include "backoff.h"
+
+struct WiFiManagerConfig
+{
+    const char *apSsid;
+    const char *apPassword;
+    uint32_t connectTimeoutMs;     // Full connect: scan, then join
+    uint32_t fastConnectTimeoutMs; // Join the cached BSSID/channel
+    uint32_t backoffBaseMs;
+    uint32_t backoffMaxMs;
+    uint8_t apFallbackFailures; // Failed attempts in a row before the AP comes up
+    uint32_t apLingerMs;        // AP kept this long after joining, so the setup page can finish
+    bool cacheIp;               // Reuse the last DHCP lease on fast connects
+};
+
+enum WiFiManagerState
+{
+    WIFI_MGR_UNCONFIGURED = 0, // No credentials, access point only
+    WIFI_MGR_CONNECTING,       // Waiting for the station to join
+    WIFI_MGR_ONLINE,
+    WIFI_MGR_WAITING, // Backing off before the next attempt
+};
+
+// Returned by update(), several may be set at once
+enum WiFiManagerEvent : uint8_t
+{
+    WIFI_EVENT_NONE = 0,
+    WIFI_EVENT_CONNECTED = 1 << 0,
+    WIFI_EVENT_DISCONNECTED = 1 << 1,
+    WIFI_EVENT_AP_STARTED = 1 << 2,
+    WIFI_EVENT_AP_STOPPED = 1 << 3,
+    WIFI_EVENT_SCAN_DONE = 1 << 4,
+};
+
+// Station connection handled as a state machine polled from loop(). A lost
+// link is retried with backoff; the setup access point only comes up after
+// apFallbackFailures failed attempts, and then runs next to the station so
+// retries and provisioning go on together. Nothing in here waits.
+class WiFiManager
+{
+public:
+    typedef uint32_t (*RandomSource)();
+
+    WiFiManager(hal::WiFiRadio &radio, hal::Clock &clock, WiFiCache &cache, RandomSource random,
+                const WiFiManagerConfig &config)
+        : radio(radio), clock(clock), cache(cache), random(random), config(config),
+          backoff(config.backoffBaseMs, config.backoffMaxMs) {}
+
+    // Connects with the saved credentials, or opens the access point
+    uint8_t begin();
+    uint8_t update();
+
+    // New credentials from the setup page. They are saved once they work.
+    void setCredentials(const char *ssid, const char *password);
+    // Drops the credentials and goes back to provisioning
+    void forget();
+    // Scan on the next update() that is not in the middle of a join
+    void requestScan() { scanRequested = true; }
+
+    WiFiManagerState state() const { return current; }
+    bool online() const { return current == WIFI_MGR_ONLINE; }
+    bool apActive() const { return apUp; }
+    bool scanning() const { return scanRunning || scanRequested; }
+    int scanCount() const { return networksFound; }
+    const char *ssid() const { return stationSsid; }
+
+    uint32_t connectMs() const { return lastConnectMs; }
+    uint32_t bootConnectMs() const { return firstConnectMs; }
+    bool fastConnected() const { return lastFast; }
+    uint32_t attempts() const { return attemptCount; }
+    uint32_t failures() const { return failureCount; }
+    uint32_t drops() const { return dropCount; }
+
+    static const char *stateName(WiFiManagerState state);
+
+private:
+    uint8_t startAttempt(uint32_t now);
+    uint8_t attemptFailed(uint32_t now);
+    uint8_t joined(uint32_t now);
+    uint8_t serviceScan();
+    uint8_t startAp();
+    uint8_t stopAp();
+
+    hal::WiFiRadio &radio;
+    hal::Clock &clock;
+    WiFiCache &cache;
+    RandomSource random;
+    WiFiManagerConfig config;
+    Backoff backoff;
+
+    WiFiManagerState current = WIFI_MGR_UNCONFIGURED;
+    char stationSsid[WIFI_SSID_LEN] = "";
+    char stationPassword[WIFI_PASSWORD_LEN] = "";
+    bool apUp = false;
+    uint32_t apStopAt = 0;
+    bool apStopPending = false;
+
+    bool attemptFast = false;
+    bool fastFailed = false; // Cached link did not work, scan until the next success
+    uint32_t attemptStart = 0;
+    uint32_t nextAttemptAt = 0;
+    uint32_t outageStart = 0;
+    uint8_t failuresInRow = 0;
+
+    bool scanRequested = false;
+    bool scanRunning = false;
+    int networksFound = 0;
+
+    uint32_t lastConnectMs = 0;
+    uint32_t firstConnectMs = 0;
+    bool lastFast = false;
+    uint32_t attemptCount = 0;
+    uint32_t failureCount = 0;
+    uint32_t dropCount = 0;
+};
+
+#endif
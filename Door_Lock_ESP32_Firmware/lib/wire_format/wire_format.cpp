@@ -0,0 +1,123 @@
+#include "wire_format.h"
+#include <string.h>
+
+const char *wireEncodingName(WireEncoding encoding)
+{
+    return encoding == WIRE_MSGPACK ? "msgpack" : "json";
+}
+
+bool wireEncodingFromName(const char *name, WireEncoding &encoding)
+{
+    if (name == nullptr)
+    {
+        return false;
+    }
+    if (strcmp(name, "json") == 0)
+    {
+        encoding = WIRE_JSON;
+        return true;
+    }
+    if (strcmp(name, "msgpack") == 0)
+    {
+        encoding = WIRE_MSGPACK;
+        return true;
+    }
+    return false;
+}
+
+WireEncoding wireNegotiate(JsonArrayConst offered)
+{
+    for (JsonVariantConst name : offered)
+    {
+        WireEncoding encoding;
+        if (wireEncodingFromName(name.as<const char *>(), encoding))
+        {
+            return encoding;
+        }
+    }
+    return WIRE_JSON;
+}
+
+size_t wireMeasure(const JsonDocument &doc, WireEncoding encoding)
+{
+    return encoding == WIRE_MSGPACK ? measureMsgPack(doc) : measureJson(doc);
+}
+
+size_t wireSerialize(const JsonDocument &doc, WireEncoding encoding, void *buffer, size_t size)
+{
+    char *out = static_cast<char *>(buffer);
+    return encoding == WIRE_MSGPACK ? serializeMsgPack(doc, out, size) : serializeJson(doc, out, size);
+}
+
+bool wireIsMsgPack(const uint8_t *data, size_t length)
+{
+    if (length == 0)
+    {
+        return false;
+    }
+    // fixmap, map16 or map32
+    return (data[0] & 0xF0) == 0x80 || data[0] == 0xDE || data[0] == 0xDF;
+}
+
+DeserializationError wireDeserialize(JsonDocument &doc, const uint8_t *data, size_t length)
+{
+    if (wireIsMsgPack(data, length))
+    {
+        return deserializeMsgPack(doc, data, length);
+    }
+    return deserializeJson(doc, data, length);
+}
+
+bool wireListFrame(const JsonDocument &envelope, WireEncoding encoding, uint32_t count, WireListFrame &frame)
+{
+    size_t length = wireMeasure(envelope, encoding);
+    if (length + 1 > sizeof(frame.head))
+    {
+        return false;
+    }
+    wireSerialize(envelope, encoding, frame.head, sizeof(frame.head));
+
+    if (encoding == WIRE_MSGPACK)
+    {
+        // The empty array is the last byte (fixarray 0), swap in the real count
+        if (frame.head[length - 1] != 0x90 || length + 4 > sizeof(frame.head))
+        {
+            return false;
+        }
+        uint8_t *p = &frame.head[length - 1];
+        if (count < 16)
+        {
+            *p++ = 0x90 | count;
+        }
+        else if (count <= 0xFFFF)
+        {
+            *p++ = 0xDC;
+            *p++ = count >> 8;
+            *p++ = count;
+        }
+        else
+        {
+            *p++ = 0xDD;
+            *p++ = count >> 24;
+            *p++ = count >> 16;
+            *p++ = count >> 8;
+            *p++ = count;
+        }
+        frame.headLength = p - frame.head;
+        frame.tail = "";
+        frame.tailLength = 0;
+        frame.separator = 0;
+        return true;
+    }
+
+    // Compact JSON ends with "[]}", split between the brackets
+    if (length < 3 || memcmp(&frame.head[length - 3], "[]}", 3) != 0)
+    {
+        return false;
+    }
+    frame.headLength = length - 2;
+    frame.tail = "]}";
+    frame.tailLength = 2;
+    frame.separator = ',';
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ArduinoJson.h>
+
+// Payload encoding of MQTT messages, agreed with the server at registration
+enum WireEncoding : uint8_t
+{
+    WIRE_JSON = 0, // Compact JSON
+    WIRE_MSGPACK = 1,
+};
+
+#define WIRE_LIST_HEAD_MAX 96
+
+const char *wireEncodingName(WireEncoding encoding);
+bool wireEncodingFromName(const char *name, WireEncoding &encoding);
+
+// First encoding in the server's preference list that the device speaks,
+// WIRE_JSON when the list is missing or has nothing usable
+WireEncoding wireNegotiate(JsonArrayConst offered);
+
+size_t wireMeasure(const JsonDocument &doc, WireEncoding encoding);
+// Needs room for one extra byte, like serializeJson() into a char buffer
+size_t wireSerialize(const JsonDocument &doc, WireEncoding encoding, void *buffer, size_t size);
+
+template <typename TWriter>
+size_t wireSerialize(const JsonDocument &doc, WireEncoding encoding, TWriter &out)
+{
+    return encoding == WIRE_MSGPACK ? serializeMsgPack(doc, out) : serializeJson(doc, out);
+}
+
+// Commands are accepted in either encoding whatever was negotiated.
+// A JSON command starts with '{', a MessagePack one with a map marker.
+bool wireIsMsgPack(const uint8_t *data, size_t length);
+DeserializationError wireDeserialize(JsonDocument &doc, const uint8_t *data, size_t length);
+
+// Bytes around a list that is streamed element by element. The envelope
+// must be an object whose last member is an empty array, e.g.
+// {"type":"deviceInfo","members":[]}; head ends where the elements start.
+struct WireListFrame
+{
+    uint8_t head[WIRE_LIST_HEAD_MAX];
+    size_t headLength;
+    const char *tail;
+    size_t tailLength;
+    char separator; // Written between elements, 0 for none
+};
+
+bool wireListFrame(const JsonDocument &envelope, WireEncoding encoding, uint32_t count, WireListFrame &frame);
+
+#endif
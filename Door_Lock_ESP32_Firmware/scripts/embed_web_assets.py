@@ -0,0 +1,97 @@
+# Compiles web/ into include/web_assets.h as gzip-compressed byte arrays.
+# Runs before every build (extra_scripts = pre:...) and can also be run
+# directly with python3. The header is only rewritten when it changes.
+import gzip
+import os
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "web")
+OUTPUT = os.path.join(PROJECT_DIR, "include", "web_assets.h")
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+}
+
+
+def symbol(name):
+    return "web_" + "".join(c if c.isalnum() else "_" for c in name)
+
+
+def byte_rows(data, per_row=16):
+    for i in range(0, len(data), per_row):
+        yield "    " + ", ".join("0x%02x" % b for b in data[i:i + per_row]) + ","
+
+
+def generate():
+    lines = [
+        "// Generated by scripts/embed_web_assets.py from web/, do not edit",
+        "#ifndef WEB_ASSETS_H",
+        "#define WEB_ASSETS_H",
+        "",
+        "#include <stdint.h>",
+        "#include <stddef.h>",
+        "",
+        "// Served with Content-Encoding: gzip straight from flash",
+        "struct WebAsset",
+        "{",
+        "    const char *path;",
+        "    const char *contentType;",
+        "    const uint8_t *data;",
+        "    size_t length;",
+        "    size_t rawLength;",
+        "};",
+        "",
+    ]
+
+    assets = []
+    for name in sorted(os.listdir(WEB_DIR)):
+        extension = os.path.splitext(name)[1]
+        if extension not in CONTENT_TYPES:
+            continue
+        with open(os.path.join(WEB_DIR, name), "rb") as source:
+            raw = source.read()
+        # mtime=0 keeps the output identical for identical input
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        assets.append((name, extension, len(raw), len(packed)))
+
+        lines.append("// %s: %u bytes, %u gzipped" % (name, len(raw), len(packed)))
+        lines.append("static const uint8_t %s[] = {" % symbol(name))
+        lines.extend(byte_rows(packed))
+        lines.append("};")
+        lines.append("")
+
+    lines.append("static const WebAsset webAssets[] = {")
+    for name, extension, raw_length, _ in assets:
+        lines.append('    {"/%s", "%s", %s, sizeof(%s), %u},' % (
+            name, CONTENT_TYPES[extension], symbol(name), symbol(name), raw_length))
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif")
+    lines.append("")
+    return "\n".join(lines), assets
+
+
+def main():
+    text, assets = generate()
+    current = None
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as existing:
+            current = existing.read()
+    if text != current:
+        with open(OUTPUT, "w") as header:
+            header.write(text)
+    for name, _, raw_length, packed_length in assets:
+        print("web asset %-12s %6u -> %5u bytes" % (name, raw_length, packed_length))
+
+
+main()
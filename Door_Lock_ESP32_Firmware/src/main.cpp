@@ -11,6 +11,32 @@
 #include <RTCLib.h>
 #include <NTPClient.h>
 #include <WiFiUdp.h>
+#include "member_index.h"
+#include "member_store.h"
+#include "member_import.h"
+#include "attendance_journal.h"
+#include "enrollment.h"
+#include "spsc_queue.h"
+#include "slot_bitmap.h"
+#include "outbox.h"
+#include "backoff.h"
+#include "command_queue.h"
+#include "command_router.h"
+#include "buffered_print.h"
+#include "member_list.h"
+#include "hal_arduino.h"
+#include "access_control.h"
+#include "latency_trace.h"
+#include "lock_actuator.h"
+#include "wire_format.h"
+#include "mqtt_topics.h"
+#include "wifi_cache.h"
+#include "wifi_manager.h"
+#include "web_assets.h"
+#include "system_time.h"
+#include "civil_time.h"
+#include "json_arena.h"
+#include "metrics.h"
 
 // Create RTC object
 RTC_DS3231 rtc;
@@ -23,406 +49,638 @@ bool rtcInitialized = true;
 HardwareSerial mySerial(2); // UART2 (TX2=17, RX2=16)
 Adafruit_Fingerprint finger = Adafruit_Fingerprint(&mySerial);
 
+uint32_t getCurrentTimestamp();
+
+// Hardware seen through the HAL, so the libraries also build natively
+ArduinoFileSystem flash(SPIFFS);
+ArduinoFingerprintSensor fingerprintSensor(finger);
+ArduinoClock systemClock(getCurrentTimestamp);
+ArduinoGpio gpio;
+
+// Wall clock kept off esp_timer; the RTC is read once at boot and then only
+// to discipline it, see serviceSystemTime()
+SystemTime systemTime(systemClock, {SYSTIME_SLEW_MAX_PPM, SYSTIME_STEP_THRESHOLD_MS, SYSTIME_AHEAD_SLEW_PPM,
+                                    SYSTIME_STEP_BACK_MS, SYSTIME_DRIFT_MAX_PPM, SYSTIME_DRIFT_BASELINE_S,
+                                    SYSTIME_EDGE_TOLERANCE_US});
+
+// Punching ID -> member lookup used on every scan
+MemberIndex memberIndex;
+// Recent member changes, so the server can sync deltas
+MemberLog memberLog(flash, "/members.log", MEMBER_LOG_SLOTS);
+// Fixed-record member file, one slot per sensor ID
+MemberStore memberStore(flash, "/members.bin", &memberLog);
+// Append-only per-day punch log
+AttendanceJournal attendanceJournal(flash, "/attendance");
+// Enrollment in progress and the member it will be stored as
+Enrollment enrollment(fingerprintSensor, ENROLL_CAPTURE_TIMEOUT_MS, ENROLL_LIFT_TIMEOUT_MS, ENROLL_POLL_INTERVAL_MS);
+MemberRecord pendingMember;
+
+// Access decision handed from the fingerprint task to loop()
+struct AccessEvent
+{
+    uint32_t timestamp;
+    uint16_t punchingId;
+    bool granted;
+    uint32_t decidedUs; // micros() at the decision, for the trace
+};
+
+TaskHandle_t fingerprintTaskHandle = nullptr;
+// Heap, stacks and activity counters, see sampleMetrics(); the fingerprint
+// task bumps its counters here lock-free
+Metrics metrics;
+SemaphoreHandle_t sensorMutex = nullptr;         // UART2 sensor is shared with enrollment and admin commands
+portMUX_TYPE memberIndexLock = portMUX_INITIALIZER_UNLOCKED;
+SpscQueue<AccessEvent, FP_EVENT_QUEUE_LEN> accessEvents;
+
+bool lookupMember(uint16_t punchingId, MemberEntry &entry, void *ctx);
+AccessControl accessControl(fingerprintSensor, systemClock, lookupMember, nullptr);
+
+// Per-stage timings of the access path, empty unless LATENCY_TRACE is set
+LatencyTrace latencyTrace;
+
+// Driven from the fingerprint task only
+LockActuator doorLock(gpio, systemClock, {LOCK_RELAY_PIN, LOCK_RELAY_ACTIVE_HIGH, DOOR_SENSOR_PIN, DOOR_OPEN_HIGH, LOCK_PULSE_MS, LOCK_RELOCK_DELAY_MS, LOCK_MAX_OPEN_MS});
+
+// Occupied template slots on the sensor, read from its index table
+SlotBitmap sensorSlots;
+bool sensorSlotsLoaded = false;
+
+// Attendance and command results waiting for the broker
+Outbox outbox(flash, "/outbox.bin");
+
+// Every JsonDocument built in loop() takes its memory from here rather than
+// the heap; the arena starts over once a request's documents are gone
+alignas(8) static uint8_t requestArenaBuffer[JSON_ARENA_SIZE];
+JsonArena requestArena(requestArenaBuffer, sizeof(requestArenaBuffer));
+
+// Bulk member import arriving in chunks over MQTT
+MemberImport memberImport(memberStore, &requestArena, TIME_OFFSET);
+unsigned long memberImportLastChunkAt = 0;
+
+// Charges the arena allocations made while in scope to one subsystem
+struct AllocScope
+{
+    explicit AllocScope(MetricId counter) : counter(counter), start(requestArena.allocations()) {}
+    ~AllocScope() { metrics.add(counter, requestArena.allocations() - start); }
+
+    MetricId counter;
+    uint32_t start;
+};
+
+// Free heap against the largest block it can still hand out, over time
+struct HeapSample
+{
+    uint32_t uptimeMin;
+    uint32_t freeHeap;
+    uint32_t largestBlock;
+    uint32_t minFreeHeap;
+    uint16_t arenaHighWater;
+};
+static HeapSample heapHistory[HEAP_HISTORY_SLOTS];
+static uint8_t heapHistoryCount = 0;
+static uint8_t heapHistoryNext = 0;
+
+// Holds the sensor for the rest of the scope
+struct SensorLock
+{
+    SensorLock() { xSemaphoreTake(sensorMutex, portMAX_DELAY); }
+    ~SensorLock() { xSemaphoreGive(sensorMutex); }
+};
+
 // Create objects
 WebServer server(80);
 Preferences nvs;
+PreferencesStore settings(nvs);
+
+// Credentials and last access point, rewritten only when they change
+WiFiCache wifiCache(settings);
+ArduinoWiFiRadio wifiRadio;
 
 // Variables
-String ssid = "";
-String password = "";
 bool wifiConnected = false;
-String scannedNetworks = "";
+// Result of the last scan, deduplicated, served by /networks.json
+hal::WiFiNetwork scannedNetworks[WIFI_SCAN_MAX];
+uint8_t scannedCount = 0;
 
-static String incomingJSON;
-static bool haveNewCommand = false;
+// Commands received in mqttCallback(), waiting for dispatchCommands()
+static CommandQueue<CMD_QUEUE_SLOTS, MQTT_MAX_BUFFER_SIZE> commandQueue;
+static uint32_t busyRepliesPending = 0;
 
 WiFiClient mqttClient;
 PubSubClient mqtt(mqttClient); // initialize MQTT client
+PubSubTransport mqttTransport(mqtt);
+
+// Broker connection state. mqtt.connect() runs on mqttConnectTask so a
+// dead broker never blocks loop(); loop() leaves `mqtt` alone meanwhile.
+enum MqttLinkState
+{
+    MQTT_LINK_WAITING,    // Backing off before the next attempt
+    MQTT_LINK_CONNECTING, // mqttConnectTask owns the client
+    MQTT_LINK_ONLINE,
+};
+
+MqttLinkState mqttLink = MQTT_LINK_WAITING;
+Backoff mqttBackoff(MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_MAX_MS);
+TaskHandle_t mqttConnectTaskHandle = nullptr;
+std::atomic<bool> mqttConnectDone{false};
+std::atomic<bool> mqttConnectOk{false};
+unsigned long mqttNextAttemptAt = 0;
+unsigned long mqttDisconnectedSince = 0;
+uint32_t mqttReconnectAttempts = 0;
+uint32_t mqttReconnectFailures = 0;
+uint32_t mqttDisconnectedMs = 0; // Total time offline, completed outages only
 
 // SoftAP credentials
 const char *ap_ssid = "SmartBulb_Setup";
 const char *ap_password = "12345678";
 
-String companyID;
-String branchID;
-String deviceCode;
-const char *defaultTopic = "unimanage/registerDevice";
+// Station retries and the setup AP, serviced from loop() without blocking
+WiFiManager wifiManager(wifiRadio, systemClock, wifiCache, esp_random,
+                        {ap_ssid, ap_password, WIFI_CONNECT_TIMEOUT_MS, WIFI_FAST_CONNECT_TIMEOUT_MS,
+                         WIFI_BACKOFF_BASE_MS, WIFI_BACKOFF_MAX_MS, WIFI_AP_FALLBACK_FAILURES,
+                         WIFI_AP_LINGER_MS, WIFI_CACHE_IP});
+
+// Register/command/callback/telemetry topics, rebuilt only when the IDs change
+MqttTopics topics;
+
+// Payload encoding agreed at registration, kept in NVS as "wireEnc"
+WireEncoding wireEncoding = WIRE_JSON;
 
 int responseCode = 0;
 
 // Function declarations
-void connectToWiFi();
-void startSoftAP();
-void setupSoftAPServer();
-void setupNormalMode();
-void scanWiFiNetworks();
-String getSetupPageHTML();
+void serviceWiFi();
+void handleWiFiEvents(uint8_t events);
+void setupWebServer();
+void sendAsset(const char *path);
+void sendNetworkList();
+void sendWiFiStatus();
+void printHttpStats();
+void buildNetworkList();
 void setupMQTT();
+void serviceMqtt();
+void dispatchCommands();
+void receiveFromMobile(const char *data, size_t length);
+bool mqttOnline();
+void mqttConnectTask(void *param);
+void loadTopics();
+void publishJson(const char *topic, const JsonDocument &doc);
+void negotiateWireEncoding(JsonDocument &doc, const char *type);
+void printWireComparison();
+void printLatencyReport();
+void publishLatencyReport();
+void sendJsonResponse(const JsonDocument &doc);
+void queueJsonResponse(JsonDocument &doc);
+void drainOutbox();
 void resetDevice(bool type);
 bool addUser(const JsonObject &newMember);
-void logAttendance(String user_id, String timestamp, String status);
+void logAttendance(uint16_t punchingId, uint32_t timestamp, uint8_t direction);
+void attendanceReport(const char *date);
 void setupAttendanceDir();
 void cleanupAttendance(int daysToKeep);
 void setupFPSensor();
-uint8_t saveFingerprint(uint16_t id);
+void serviceEnrollment();
+void publishEnrollProgress();
+bool commitEnrolledUser();
 uint16_t getNextAvailableID();
+bool readSensorSlots();
+void reportSensorSlots();
 JsonDocument getSPIFFSStatus();
-bool deleteUser(const String &userId);
+void checkHeap();
+void printHeapHistory();
+void sampleMetrics();
+void publishMetrics();
+void printStats();
+bool deleteUser(const char *userId);
+bool updateSubscription(const char *userId, const char *subscriptionEnd);
+void importMembers(JsonDocument &doc);
+void serviceMemberImport();
+void reindexMembers();
 void deviceInfo();
-uint32_t dateStringToSeconds(String dateString);
+void syncMembers(JsonVariantConst since);
 uint32_t getCurrentTimestamp();
-bool authenticateUser(JsonObject &obj);
-void checkFingerprint();
-bool authenticateUser(JsonObject &obj);
-int getIndexByBioId(uint16_t bio_id, JsonDocument &doc);
+void setupSystemTime();
+void serviceSystemTime();
+void printSystemTime();
+bool checkFingerprint();
+void fingerprintTask(void *param);
+void startFingerprintTask();
+void processAccessEvents();
+void serviceDoorLock();
+void reportDoorAlarm(const char *type, uint32_t count, uint32_t &reported);
+void reportDoorAlarms();
+bool loadMemberIndex();
+void indexMember(const MemberRecord &record);
+bool setupMemberStore();
+bool migrateMembersJson();
+
+// Advance the Wi-Fi manager once per loop() pass
+void serviceWiFi()
+{
+    handleWiFiEvents(wifiManager.update());
+}
 
-void connectToWiFi()
+void handleWiFiEvents(uint8_t events)
 {
-    Serial.println("Connecting to WiFi: " + ssid);
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid.c_str(), password.c_str());
+    if (events & WIFI_EVENT_CONNECTED)
+    {
+        wifiConnected = true;
+        Serial.printf("WiFi Connected to %s in %u ms (%s)\n", wifiManager.ssid(), wifiManager.connectMs(),
+                      wifiManager.fastConnected() ? "fast" : "scan");
+        Serial.println("IP Address: " + WiFi.localIP().toString());
+    }
 
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20)
+    if (events & WIFI_EVENT_DISCONNECTED)
     {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+        wifiConnected = false;
+        Serial.println("WiFi connection lost, retrying in the background");
     }
 
-    if (WiFi.status() == WL_CONNECTED)
+    if (events & WIFI_EVENT_AP_STARTED)
     {
-        wifiConnected = true;
-        Serial.println("");
-        Serial.println("WiFi Connected!");
-        Serial.println("IP Address: " + WiFi.localIP().toString());
+        IPAddress IPAdd = WiFi.softAPIP();
+        Serial.println("SoftAP IP address: " + IPAdd.toString());
+        Serial.println("Connect to WiFi: " + String(ap_ssid));
+        Serial.println("Password: " + String(ap_password));
+        Serial.println("Open browser and go to: http://" + IPAdd.toString());
 
-        // Save to nvs
-        nvs.putString("ssid", ssid);
-        nvs.putString("password", password);
-        nvs.putBool("haveWiFiCred", true);
+        // Fill the network list for the setup page
+        wifiManager.requestScan();
+    }
 
-        // Stop any existing server and start in normal mode
-        server.stop();
-        delay(1000);
-        setupNormalMode();
-        setupMQTT();
+    if (events & WIFI_EVENT_AP_STOPPED)
+    {
+        Serial.println("SoftAP stopped");
     }
-    else
+
+    if (events & WIFI_EVENT_SCAN_DONE)
     {
-        Serial.println("");
-        Serial.println("Failed to connect to WiFi. Starting SoftAP mode...");
-        startSoftAP();
+        buildNetworkList();
     }
 }
 
-void startSoftAP()
+enum HttpRoute
 {
-    Serial.println("Starting SoftAP mode...");
-    WiFi.mode(WIFI_AP);
-    WiFi.softAP(ap_ssid, ap_password);
-
-    IPAddress IPAdd = WiFi.softAPIP();
-    Serial.println("SoftAP IP address: " + IPAdd.toString());
-    Serial.println("Connect to WiFi: " + String(ap_ssid));
-    Serial.println("Password: " + String(ap_password));
-    Serial.println("Open browser and go to: http://" + IPAdd.toString());
-
-    // Scan for available networks
-    scanWiFiNetworks();
-
-    setupSoftAPServer();
+    HTTP_ROUTE_PAGE = 0, // "/" and the static assets
+    HTTP_ROUTE_NETWORKS,
+    HTTP_ROUTE_STATUS,
+    HTTP_ROUTE_SCAN,
+    HTTP_ROUTE_SAVE,
+    HTTP_ROUTE_RESET,
+    HTTP_ROUTE_COUNT,
+};
+
+// Per-route response time and what the request did to the heap, "http" command
+struct HttpRouteStats
+{
+    const char *name;
+    uint32_t requests;
+    uint32_t totalUs;
+    uint32_t maxUs;
+    int32_t heapDelta;    // Free heap after minus before, summed
+    int32_t largestDelta; // Same for the largest free block
+};
+
+static HttpRouteStats httpStats[HTTP_ROUTE_COUNT] = {
+    {"page"}, {"networks"}, {"status"}, {"scan"}, {"save"}, {"reset"},
+};
+
+static void timedRoute(HttpRoute route, void (*handler)())
+{
+    uint32_t freeBefore = ESP.getFreeHeap();
+    uint32_t largestBefore = ESP.getMaxAllocHeap();
+    uint32_t start = micros();
+
+    handler();
+
+    uint32_t elapsed = micros() - start;
+    HttpRouteStats &stats = httpStats[route];
+    stats.requests++;
+    stats.totalUs += elapsed;
+    stats.maxUs = elapsed > stats.maxUs ? elapsed : stats.maxUs;
+    stats.heapDelta += (int32_t)ESP.getFreeHeap() - (int32_t)freeBefore;
+    stats.largestDelta += (int32_t)ESP.getMaxAllocHeap() - (int32_t)largestBefore;
 }
 
-void setupSoftAPServer()
+// Routes are registered once; pages depend on the state at request time.
+// Static pages come from include/web_assets.h (generated from web/ at build
+// time) and only the small JSON endpoints are built per request.
+void setupWebServer()
 {
-    // Serve the WiFi setup page
     server.on("/", HTTP_GET, []()
-              {
-    String html = getSetupPageHTML();
-    server.send(200, "text/html", html); });
+              { timedRoute(HTTP_ROUTE_PAGE, []()
+                           { sendAsset(wifiManager.online() ? "/status.html" : "/setup.html"); }); });
+
+    for (const WebAsset &asset : webAssets)
+    {
+        server.on(asset.path, HTTP_GET, []()
+                  { timedRoute(HTTP_ROUTE_PAGE, []()
+                               { sendAsset(server.uri().c_str()); }); });
+    }
+
+    server.on("/networks.json", HTTP_GET, []()
+              { timedRoute(HTTP_ROUTE_NETWORKS, sendNetworkList); });
+
+    server.on("/status.json", HTTP_GET, []()
+              { timedRoute(HTTP_ROUTE_STATUS, sendWiFiStatus); });
 
-    // Handle WiFi scan refresh
+    // Start a background scan, the setup page polls /networks.json for the result
     server.on("/scan", HTTP_GET, []()
-              {
-    scanWiFiNetworks();
-    String html = getSetupPageHTML();
-    server.send(200, "text/html", html); });
+              { timedRoute(HTTP_ROUTE_SCAN, []()
+                           {
+    wifiManager.requestScan();
+    server.send(202, "application/json", "{\"scanning\":true}"); }); });
 
     // Handle WiFi credentials submission
     server.on("/save", HTTP_POST, []()
-              {
+              { timedRoute(HTTP_ROUTE_SAVE, []()
+                           {
     if (server.hasArg("ssid") && server.hasArg("password")) {
-      String newSSID = server.arg("ssid");
-      String newPassword = server.arg("password");
-      
       Serial.println("Received WiFi credentials:");
-      Serial.println("SSID: " + newSSID);
-      Serial.println("Password: " + newPassword);
-      
-      
-      // Update global variables
-      ssid = newSSID;
-      password = newPassword;
-      
-      String response = "<!DOCTYPE html><html><head>";
-      response += "<meta charset='UTF-8'>";
-      response += "<title>Smart Bulb Setup</title>";
-      response += "<meta name='viewport' content='width=device-width,initial-scale=1'>";
-      response += "<style>body{font-family:Arial;text-align:center;margin:50px;background:#f0f0f0;}</style></head>";
-      response += "<body><h2>WiFi Credentials Saved!</h2>";
-      response += "<p>Your smart bulb will now try to connect to: <strong>" + newSSID + "</strong></p>";
-      response += "<p>Please wait while connecting...</p>";
-      response += "<div id='status'>Connecting...</div>";
-      response += "<script>";
-      response += "setTimeout(function(){";
-      response += "document.getElementById('status').innerHTML = 'Please check your device status';";
-      response += "}, 10000);";
-      response += "</script>";
-      response += "</body></html>";
-      
-      server.send(200, "text/html", response);
-      
-      // Wait a moment then try to connect
-      delay(2000);
-      
-      // Stop SoftAP server
-      server.stop();
-      
-      // Try to connect to WiFi
-      connectToWiFi();
+      Serial.println("SSID: " + server.arg("ssid"));
+
+      // The AP stays up while the station joins, so the saved page keeps working
+      wifiManager.setCredentials(server.arg("ssid").c_str(), server.arg("password").c_str());
+      sendAsset("/saved.html");
     } else {
       server.send(400, "text/plain", "Missing SSID or Password");
-    } });
+    } }); });
 
     // Handle reset request
     server.on("/reset", HTTP_GET, []()
-              {
+              { timedRoute(HTTP_ROUTE_RESET, []()
+                           {
     nvs.clear();
-    String response = "<!DOCTYPE html><html><head><title>Smart Bulb</title>";
-    response += "<meta name='viewport' content='width=device-width,initial-scale=1'>";
-    response += "<style>body{font-family:Arial;text-align:center;margin:50px;}</style></head>";
-    response += "<body><h2>WiFi Settings Reset</h2>";
-    response += "<p>WiFi credentials have been cleared.</p>";
-    response += "<p>Device will restart in SoftAP mode...</p>";
-    response += "</body></html>";
-    server.send(200, "text/html", response);
-    
-    delay(2000);
-    ssid = "";
-    password = "";
-    startSoftAP(); });
+    sendAsset("/reset.html");
+    wifiConnected = false;
+    wifiManager.forget(); }); });
 
     server.begin();
-    Serial.println("SoftAP HTTP server started");
+    Serial.println("HTTP server started");
 }
 
-void setupNormalMode()
+// Gzipped page straight from flash, the browser inflates it
+void sendAsset(const char *path)
 {
-    // Setup server routes for normal operation
-    server.on("/", HTTP_GET, []()
-              {
-    String html = "<!DOCTYPE html><html><head>";
-    html += "<meta charset='UTF-8'>";
-    html += "<title>Smart Bulb</title>";
-    html += "<meta name='viewport' content='width=device-width,initial-scale=1'>";
-    html += "<style>";
-    html += "body{font-family:Arial;text-align:center;margin:50px;background:#f0f0f0;}";
-    html += ".container{max-width:400px;margin:0 auto;background:white;padding:30px;border-radius:10px;box-shadow:0 2px 10px rgba(0,0,0,0.1);}";
-    html += ".status{color:green;font-weight:bold;font-size:18px;}";
-    html += ".info{background:#e7f3ff;padding:15px;border-radius:5px;margin:20px 0;}";
-    html += "button{background:#f44336;color:white;padding:10px 20px;border:none;border-radius:5px;cursor:pointer;margin-top:20px;}";
-    html += "button:hover{background:#d32f2f;}";
-    html += "</style></head>";
-    html += "<body><div class='container'>";
-    html += "<h2>Smart Bulb Online</h2>";
-    html += "<div class='status'>Connected Successfully!</div>";
-    html += "<div class='info'>";
-    html += "<p><strong>WiFi Network:</strong> " + ssid + "</p>";
-    html += "<p><strong>IP Address:</strong> " + WiFi.localIP().toString() + "</p>";
-    html += "<p><strong>Signal Strength:</strong> " + String(WiFi.RSSI()) + " dBm</p>";
-    html += "</div>";
-    html += "<p>Your smart bulb is now connected to your WiFi network.</p>";
-    html += "<button onclick='if(confirm(\"Reset WiFi settings?\")) window.location.href=\"/reset\"'>Reset WiFi Settings</button>";
-    html += "</div></body></html>";
-    server.send(200, "text/html", html); });
-
-    server.on("/reset", HTTP_GET, []()
-              {
-    nvs.clear();
-    String response = "<!DOCTYPE html><html><head><title>Smart Bulb</title>";
-    response += "<meta name='viewport' content='width=device-width,initial-scale=1'>";
-    response += "<style>body{font-family:Arial;text-align:center;margin:50px;}</style></head>";
-    response += "<body><h2>WiFi Settings Reset</h2>";
-    response += "<p>WiFi credentials have been cleared.</p>";
-    response += "<p>Device will restart in setup mode...</p>";
-    response += "</body></html>";
-    server.send(200, "text/html", response);
-    
-    delay(2000);
-    ssid = "";
-    password = "";
-    wifiConnected = false;
-    startSoftAP(); });
+    for (const WebAsset &asset : webAssets)
+    {
+        if (strcmp(asset.path, path) == 0)
+        {
+            server.sendHeader("Content-Encoding", "gzip");
+            server.send_P(200, asset.contentType, (const char *)asset.data, asset.length);
+            return;
+        }
+    }
+    server.send(404, "text/plain", "Not found");
+}
 
-    server.begin();
-    Serial.println("Normal mode HTTP server started");
+// Writes value as a JSON string, escaping what an SSID may contain
+static size_t jsonString(char *out, size_t size, const char *value)
+{
+    size_t used = 0;
+    out[used++] = '"';
+    for (; *value != '\0' && used + 7 < size; value++)
+    {
+        unsigned char c = *value;
+        if (c == '"' || c == '\\')
+        {
+            out[used++] = '\\';
+            out[used++] = c;
+        }
+        else if (c < 0x20)
+        {
+            used += snprintf(&out[used], size - used, "\\u%04x", c);
+        }
+        else
+        {
+            out[used++] = c;
+        }
+    }
+    out[used++] = '"';
+    out[used] = '\0';
+    return used;
 }
 
-void scanWiFiNetworks()
+// {"scanning":false,"networks":[{"ssid":"..","rssi":-60,"open":false},..]}
+// sent with chunked encoding, one network per chunk
+void sendNetworkList()
 {
-    Serial.println("Scanning for WiFi networks...");
-    WiFi.mode(WIFI_AP_STA); // Enable both AP and STA mode for scanning
+    char chunk[48 + 6 * sizeof(hal::WiFiNetwork::ssid)];
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
 
-    int networkCount = WiFi.scanNetworks();
-    scannedNetworks = "";
+    int length = snprintf(chunk, sizeof(chunk), "{\"scanning\":%s,\"networks\":[",
+                          wifiManager.scanning() ? "true" : "false");
+    server.sendContent(chunk, length);
 
-    if (networkCount == 0)
+    for (uint8_t i = 0; i < scannedCount; i++)
     {
-        Serial.println("No networks found");
-        scannedNetworks = "<option value=''>No networks found</option>";
+        const hal::WiFiNetwork &network = scannedNetworks[i];
+        length = snprintf(chunk, sizeof(chunk), "%s{\"ssid\":", i > 0 ? "," : "");
+        length += jsonString(&chunk[length], sizeof(chunk) - length - 32, network.ssid);
+        length += snprintf(&chunk[length], sizeof(chunk) - length, ",\"rssi\":%d,\"open\":%s}",
+                           network.rssi, network.open ? "true" : "false");
+        server.sendContent(chunk, length);
     }
-    else
+
+    server.sendContent("]}", 2);
+    server.sendContent("", 0); // Last chunk
+}
+
+void sendWiFiStatus()
+{
+    char body[64 + 6 * WIFI_SSID_LEN];
+    IPAddress ip = WiFi.localIP();
+
+    int length = snprintf(body, sizeof(body), "{\"state\":\"%s\",\"ssid\":",
+                          WiFiManager::stateName(wifiManager.state()));
+    length += jsonString(&body[length], sizeof(body) - length - 48, wifiManager.ssid());
+    length += snprintf(&body[length], sizeof(body) - length, ",\"ip\":\"%u.%u.%u.%u\",\"rssi\":%d}",
+                       ip[0], ip[1], ip[2], ip[3], wifiConnected ? WiFi.RSSI() : 0);
+    server.send_P(200, "application/json", body, length);
+}
+
+void printHttpStats()
+{
+    Serial.println("Route      requests  avg us  max us  heap delta  largest block delta");
+    for (const HttpRouteStats &stats : httpStats)
     {
-        Serial.printf("Found %d networks:\n", networkCount);
+        Serial.printf("%-10s %8u %7u %7u %11d %20d\n", stats.name, stats.requests,
+                      stats.requests > 0 ? stats.totalUs / stats.requests : 0, stats.maxUs,
+                      stats.heapDelta, stats.largestDelta);
+    }
+}
 
-        // Build HTML options for dropdown
-        for (int i = 0; i < networkCount; i++)
-        {
-            String networkSSID = WiFi.SSID(i);
-            int networkRSSI = WiFi.RSSI(i);
-            wifi_auth_mode_t encryptionType = WiFi.encryptionType(i);
-
-            // Skip hidden networks
-            if (networkSSID.length() == 0)
-                continue;
-
-            // Remove duplicates
-            if (scannedNetworks.indexOf("value='" + networkSSID + "'") != -1)
-                continue;
-
-            String signalIcon = "";
-            if (networkRSSI > -50)
-                signalIcon = "Strong";
-            else if (networkRSSI > -60)
-                signalIcon = "Good";
-            else if (networkRSSI > -70)
-                signalIcon = "Fair";
-            else
-                signalIcon = "Weak";
+// Keep the strongest entry of every SSID from the finished background scan
+void buildNetworkList()
+{
+    int networkCount = wifiManager.scanCount();
+    scannedCount = 0;
+    Serial.printf("Found %d networks\n", networkCount);
 
-            String lockIcon = (encryptionType == WIFI_AUTH_OPEN) ? "Open" : "Secured";
+    for (int i = 0; i < networkCount; i++)
+    {
+        hal::WiFiNetwork network;
+        if (!wifiRadio.scanEntry(i, network))
+            break;
 
-            scannedNetworks += "<option value='" + networkSSID + "'>";
-            scannedNetworks += networkSSID + " (" + signalIcon + ", " + lockIcon;
-            scannedNetworks += ", " + String(networkRSSI) + " dBm)</option>";
+        // Skip hidden networks
+        if (network.ssid[0] == '\0')
+            continue;
 
-            Serial.printf("%d: %s (%d dBm) %s\n", i + 1, networkSSID.c_str(), networkRSSI,
-                          (encryptionType == WIFI_AUTH_OPEN) ? "Open" : "Secured");
-        }
+        // Remove duplicates, the radio reports the strongest first
+        bool duplicate = false;
+        for (uint8_t j = 0; j < scannedCount && !duplicate; j++)
+            duplicate = strcmp(scannedNetworks[j].ssid, network.ssid) == 0;
+        if (duplicate || scannedCount == WIFI_SCAN_MAX)
+            continue;
+
+        scannedNetworks[scannedCount++] = network;
+        Serial.printf("%d: %s (%d dBm) %s\n", i + 1, network.ssid, network.rssi, network.open ? "Open" : "Secured");
     }
 
-    WiFi.scanDelete(); // Free memory
+    wifiRadio.scanDelete(); // Free memory
     Serial.println("WiFi scan completed");
 }
 
-String getSetupPageHTML()
-{
-    String html = "<!DOCTYPE html><html><head>";
-    html += "<meta charset='UTF-8'>";
-    html += "<title>Smart Bulb WiFi Setup</title>";
-    html += "<meta name='viewport' content='width=device-width,initial-scale=1'>";
-    html += "<style>";
-    html += "body{font-family:Arial,sans-serif;margin:0;padding:20px;background:#f0f0f0;}";
-    html += ".container{max-width:400px;margin:0 auto;background:white;padding:30px;border-radius:10px;box-shadow:0 2px 10px rgba(0,0,0,0.1);}";
-    html += "h2{color:#333;text-align:center;margin-bottom:30px;}";
-    html += "label{display:block;margin:15px 0 5px;color:#555;font-weight:bold;}";
-    html += "select,input[type='password']{width:100%;padding:12px;border:2px solid #ddd;border-radius:5px;font-size:16px;box-sizing:border-box;background:white;}";
-    html += "select:focus,input[type='password']:focus{border-color:#4CAF50;outline:none;}";
-    html += "button{width:100%;background:#4CAF50;color:white;padding:12px;border:none;border-radius:5px;font-size:18px;cursor:pointer;margin-top:20px;}";
-    html += "button:hover{background:#45a049;}";
-    html += ".refresh-btn{background:#2196F3;margin-bottom:10px;font-size:14px;padding:8px;}";
-    html += ".refresh-btn:hover{background:#1976D2;}";
-    html += ".info{background:#e7f3ff;padding:15px;border-radius:5px;margin-bottom:20px;font-size:14px;}";
-    html += ".manual-entry{margin-top:20px;padding-top:20px;border-top:1px solid #ddd;}";
-    html += ".manual-entry a{color:#666;text-decoration:none;font-size:14px;}";
-    html += ".manual-entry a:hover{color:#333;}";
-    html += "</style></head><body>";
-
-    html += "<div class='container'>";
-    html += "<h2>Smart Bulb Setup</h2>";
-    html += "<div class='info'>Select your WiFi network from the list below</div>";
-
-    html += "<form action='/save' method='POST'>";
-
-    html += "<label for='ssid'>Available WiFi Networks:</label>";
-    html += "<select id='ssid' name='ssid' required>";
-    html += "<option value=''>-- Select WiFi Network --</option>";
-    html += scannedNetworks;
-    html += "</select>";
-
-    html += "<button type='button' class='refresh-btn' onclick='window.location.href=\"/scan\"'>Refresh Networks</button>";
-
-    html += "<label for='password'>WiFi Password:</label>";
-    html += "<input type='password' id='password' name='password' required placeholder='Enter WiFi password'>";
-
-    html += "<button type='submit'>Connect to WiFi</button>";
-    html += "</form>";
-
-    html += "<div class='manual-entry'>";
-    html += "<a href='#' onclick='toggleManualEntry()'>Enter network manually</a>";
-    html += "</div>";
-
-    html += "</div>";
-
-    html += "<script>";
-    html += "function toggleManualEntry() {";
-    html += "  var select = document.getElementById('ssid');";
-    html += "  if (select.tagName === 'SELECT') {";
-    html += "    var input = document.createElement('input');";
-    html += "    input.type = 'text';";
-    html += "    input.id = 'ssid';";
-    html += "    input.name = 'ssid';";
-    html += "    input.placeholder = 'Enter WiFi network name manually';";
-    html += "    input.required = true;";
-    html += "    input.style.cssText = select.style.cssText;";
-    html += "    select.parentNode.replaceChild(input, select);";
-    html += "  }";
-    html += "}";
-    html += "</script>";
-
-    html += "</body></html>";
-    return html;
+// Build the device topics from the IDs saved at registration
+void loadTopics()
+{
+    if (!nvs.getBool("haveRegistered", false))
+    {
+        topics.clear();
+        return;
+    }
+
+    char companyId[MQTT_TOPIC_ID_LEN] = "";
+    char branchId[MQTT_TOPIC_ID_LEN] = "";
+    char deviceCode[MQTT_TOPIC_ID_LEN] = "";
+    nvs.getString("companyID", companyId, sizeof(companyId));
+    nvs.getString("branchID", branchId, sizeof(branchId));
+    nvs.getString("deviceCode", deviceCode, sizeof(deviceCode));
+
+    if (!topics.build(companyId, branchId, deviceCode))
+    {
+        Serial.println("Warning: Empty or invalid company/branch/device IDs");
+    }
 }
 
+// Best effort: dropped when the broker is not connected
 void sendJsonResponse(const JsonDocument &doc)
 {
-    String jsonStr;
-    serializeJsonPretty(doc, jsonStr);
+    publishJson(topics.get(TOPIC_CALLBACK), doc);
+}
 
-    if (mqtt.connected())
+// Serialized straight into the socket, so the message is never copied into
+// a String and is not limited by the MQTT buffer size
+void publishJson(const char *topic, const JsonDocument &doc)
+{
+    if (!mqttOnline())
     {
-        String topic = "unimanage/" + companyID + "/" + branchID + "/" + deviceCode + "/callback";
-        mqtt.publish(topic.c_str(), jsonStr.c_str());
+        return;
     }
+
+    if (!mqtt.beginPublish(topic, wireMeasure(doc, wireEncoding), false))
+    {
+        Serial.println("Failed to publish response");
+        return;
+    }
+
+    BufferedPrint out(mqttTransport);
+    wireSerialize(doc, wireEncoding, out);
+    out.flush();
+    mqtt.endPublish();
 }
 
-void mqttCallback(char *topic, byte *payload, unsigned int length)
+// For messages the server must not miss. The message gets a "seq" field
+// and stays in the flash outbox until the server acks that number.
+void queueJsonResponse(JsonDocument &doc)
 {
-    Serial.println("callback of mqtt");
-    if (strcmp(topic, ("unimanage/" + companyID + "/" + branchID + "/" + deviceCode + "/command").c_str()) == 0 || strcmp(topic, defaultTopic) == 0)
+    doc["seq"] = outbox.nextSeq();
+
+    size_t length = wireMeasure(doc, wireEncoding);
+    if (length > OUTBOX_PAYLOAD_LEN)
     {
-        char msg[length + 1];
-        memcpy(msg, payload, length);
-        msg[length] = '\0'; // Ensure null-termination
-        incomingJSON = String(msg);
-        haveNewCommand = true;
+        Serial.println("Message too large for outbox, sending directly");
+        doc.remove("seq");
+        sendJsonResponse(doc);
+        return;
     }
-    else
+
+    uint8_t payload[OUTBOX_PAYLOAD_LEN + 1];
+    wireSerialize(doc, wireEncoding, payload, sizeof(payload));
+
+    if (outbox.push(payload, length) == 0)
     {
-        Serial.print("topic name: ");
-        Serial.println(topic);
+        Serial.println("Outbox full, message dropped");
     }
+    drainOutbox();
+}
+
+// Publish queued messages, at most OUTBOX_DRAIN_BATCH every OUTBOX_DRAIN_INTERVAL_MS
+void drainOutbox()
+{
+    static unsigned long lastDrain = 0;
+
+    if (!mqttOnline() || outbox.unsent() == 0 || millis() - lastDrain < OUTBOX_DRAIN_INTERVAL_MS)
+    {
+        return;
+    }
+    lastDrain = millis();
+
+    const char *topic = topics.get(TOPIC_CALLBACK);
+    uint8_t payload[OUTBOX_PAYLOAD_LEN];
+    uint16_t length;
+    uint32_t seq;
+
+    for (uint8_t sent = 0; sent < OUTBOX_DRAIN_BATCH && outbox.peek(payload, length, seq); sent++)
+    {
+        if (!mqtt.publish(topic, payload, length))
+        {
+            break;
+        }
+        outbox.markSent(seq);
+    }
+}
+
+// Replying here would reuse the client buffer, so loop() sends it
+static void queueCommand(const uint8_t *payload, unsigned int length)
+{
+    if (!commandQueue.push(payload, length))
+    {
+        busyRepliesPending++;
+    }
+}
+
+typedef void (*TopicHandler)(const uint8_t *payload, unsigned int length);
+
+struct TopicRoute
+{
+    TopicId topic;
+    TopicHandler handler;
+};
+
+static const TopicRoute topicRoutes[] = {
+    {TOPIC_COMMAND, queueCommand},
+    {TOPIC_REGISTER, queueCommand},
+};
+
+// Runs inside mqtt.loop(); matches against the prebuilt topics only
+void mqttCallback(char *topic, byte *payload, unsigned int length)
+{
+    TopicId id = topics.match(topic);
+    for (const TopicRoute &route : topicRoutes)
+    {
+        if (route.topic == id)
+        {
+            route.handler(payload, length);
+            return;
+        }
+    }
+
+    Serial.print("topic name: ");
+    Serial.println(topic);
 }
 
 //reconnectMqtt
@@ -465,148 +723,449 @@ void reconnectMQTT()
 }
 */
 
+// Called once mqttConnectTask reports a successful connect
 void reconnectMQTT()
 {
-    Serial.println("Connecting with MQTT server..");
-    JsonDocument doc;
+    Serial.println("Connected With MQTT Server");
+    AllocScope allocs(METRIC_ALLOC_MQTT);
+    JsonDocument doc(&requestArena);
 
     doc["type"] = "mqtt_status";
     doc["message"] = mqtt.state();
 
-    if (mqtt.connect("UNI_Manage"))
-    {
-        Serial.println("Connected With MQTT Server");
+    // Resend everything the server has not acked yet
+    outbox.rewind();
 
-        if (nvs.getBool("haveRegistered"))
-        {
-            companyID = nvs.getString("companyID", "");
-            branchID = nvs.getString("branchID", "");
-            deviceCode = nvs.getString("deviceCode", "");
-            
-            // Check if we have valid IDs before subscribing
-            if (companyID.length() > 0 && branchID.length() > 0 && deviceCode.length() > 0)
-            {
-                String topicName = "unimanage/" + companyID + "/" + branchID + "/" + deviceCode + "/command";
-                mqtt.subscribe(topicName.c_str());
-                Serial.println("Subscribed to topic: " + topicName);
-            }
-            else
-            {
-                Serial.println("Warning: Empty company/branch/device IDs");
-                mqtt.subscribe(defaultTopic);
-                Serial.println("Subscribed to default topic: " + String(defaultTopic));
-            }
-        }
-        else
-        {
-            mqtt.subscribe(defaultTopic);
-            Serial.println("Subscribed to default topic: " + String(defaultTopic));
-        }
-
-        doc["status"] = "success";
+    // loadTopics() left them unregistered if the saved IDs were unusable
+    if (topics.registered())
+    {
+        mqtt.subscribe(topics.get(TOPIC_COMMAND));
+        Serial.printf("Subscribed to topic: %s\n", topics.get(TOPIC_COMMAND));
     }
     else
     {
-        Serial.print("MQTT connection failed, rc=");
-        Serial.print(mqtt.state());
-        doc["status"] = "failed";
+        mqtt.subscribe(topics.get(TOPIC_REGISTER));
+        Serial.printf("Subscribed to default topic: %s\n", topics.get(TOPIC_REGISTER));
     }
+
+    doc["status"] = "success";
+    doc["encoding"] = wireEncodingName(wireEncoding);
+    doc["attempts"] = mqttReconnectAttempts;
+    doc["failures"] = mqttReconnectFailures;
+    doc["disconnectedMs"] = mqttDisconnectedMs;
+    doc["wifiBootConnectMs"] = wifiManager.bootConnectMs();
+    doc["wifiConnectMs"] = wifiManager.connectMs();
+    doc["wifiFast"] = wifiManager.fastConnected();
+    doc["wifiDrops"] = wifiManager.drops();
     sendJsonResponse(doc);
 }
 
-void setupMQTT()
+// Run queued commands in arrival order and report any that were refused
+void dispatchCommands()
 {
-    mqtt.setServer(IP, 1883);
-    mqtt.setCallback(mqttCallback);
-    mqtt.setBufferSize(MQTT_MAX_BUFFER_SIZE);
+    AllocScope allocs(METRIC_ALLOC_COMMANDS);
+    size_t length;
+    const char *command;
+    while ((command = commandQueue.front(length)) != nullptr)
+    {
+        receiveFromMobile(command, length);
+        commandQueue.pop();
+    }
+
+    if (busyRepliesPending > 0)
+    {
+        JsonDocument doc(&requestArena);
+        doc["type"] = "error";
+        doc["status"] = "busy";
+        doc["message"] = "Command queue full";
+        doc["rejected"] = busyRepliesPending;
+        doc["droppedTotal"] = commandQueue.dropped() + commandQueue.oversized();
+        sendJsonResponse(doc);
+        busyRepliesPending = 0;
+    }
 }
 
-// Function to handle incoming BLE data
-void receiveFromMobile(String data)
+bool mqttOnline()
 {
-    Serial.print("📥 Received from mobile: ");
-    Serial.println(data);
+    return mqttLink == MQTT_LINK_ONLINE && mqtt.connected();
+}
 
-    if (data.length() > 0)
+// Blocks in mqtt.connect() on behalf of loop(), one attempt per notification
+void mqttConnectTask(void *param)
+{
+    for (;;)
     {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, data);
-        if (error)
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        mqttConnectOk = mqtt.connect("UNI_Manage");
+        mqttConnectDone = true;
+    }
+}
+
+// Reconnect state machine, advanced once per loop() pass
+void serviceMqtt()
+{
+    unsigned long now = millis();
+
+    switch (mqttLink)
+    {
+    case MQTT_LINK_ONLINE:
+        if (mqtt.connected())
         {
-            if (error == DeserializationError::NoMemory)
-                Serial.println("no memory in heap");
-            else
-                Serial.printf("JSON parse error: %s\n", error.c_str());
             return;
         }
-        String commandType = doc["type"].as<String>();
-        if (commandType == "registerDevice" && !nvs.getBool("haveRegistered"))
+        Serial.println("MQTT connection lost");
+        mqttLink = MQTT_LINK_WAITING;
+        mqttDisconnectedSince = now;
+        mqttBackoff.reset();
+        mqttNextAttemptAt = now;
+        return;
+
+    case MQTT_LINK_WAITING:
+        if (WiFi.status() != WL_CONNECTED || mqttConnectTaskHandle == nullptr ||
+            (long)(now - mqttNextAttemptAt) < 0)
         {
-            deviceCode = doc["deviceCode"].as<String>();
-            branchID = doc["branchID"].as<String>();
-            companyID = doc["companyID"].as<String>();
-            nvs.putString("deviceCode", deviceCode);
-            nvs.putString("branchID", branchID);
-            nvs.putString("companyID", companyID);
-            nvs.putBool("haveRegistered", true);
-            mqtt.subscribe(("unimanage/" + companyID + "/" + branchID + "/" + deviceCode + "/command").c_str());
-            mqtt.unsubscribe(defaultTopic);
+            return;
         }
-        else if (commandType == "enrollUser")
-        {
-            addUser(doc.as<JsonObject>()) ? doc["status"] = 1 : doc["status"] = 0;
+        Serial.println("Connecting with MQTT server..");
+        mqttReconnectAttempts++;
+        mqttConnectDone = false;
+        mqttLink = MQTT_LINK_CONNECTING;
+        xTaskNotifyGive(mqttConnectTaskHandle);
+        return;
 
-            doc["type"] = "enrollUser";
-            doc["message"] = responseCode;
-            sendJsonResponse(doc);
-        }
-        else if (commandType == "spiffsStatus")
+    case MQTT_LINK_CONNECTING:
+        if (!mqttConnectDone)
         {
-            sendJsonResponse(getSPIFFSStatus());
+            return;
         }
-        else if (commandType == "deleteUser")
+
+        if (mqttConnectOk)
         {
-            deleteUser(doc["userId"]) ? doc["status"] = 1 : doc["status"] = 0;
-            sendJsonResponse(doc);
+            mqttDisconnectedMs += now - mqttDisconnectedSince;
+            mqttBackoff.reset();
+            mqttLink = MQTT_LINK_ONLINE;
+            reconnectMQTT();
         }
-        else if (commandType == "deviceInfo")
+        else
         {
-            deviceInfo();
+            uint32_t wait = mqttBackoff.next(esp_random());
+            mqttReconnectFailures++;
+            Serial.printf("MQTT connection failed, rc=%d, retry in %u ms\n", mqtt.state(), wait);
+            mqttNextAttemptAt = now + wait;
+            mqttLink = MQTT_LINK_WAITING;
         }
-        else
+        return;
+    }
+}
+
+void setupMQTT()
+{
+    mqtt.setServer(IP, 1883);
+    mqtt.setCallback(mqttCallback);
+    mqtt.setBufferSize(MQTT_MAX_BUFFER_SIZE);
+
+    // Bound a single attempt: TCP connect, then waiting for CONNACK
+    mqttClient.setTimeout(MQTT_CONNECT_TIMEOUT_S);
+    mqtt.setSocketTimeout(MQTT_CONNECT_TIMEOUT_S);
+
+    if (mqttConnectTaskHandle == nullptr)
+    {
+        mqttDisconnectedSince = millis();
+        xTaskCreatePinnedToCore(mqttConnectTask, "mqttConnect", MQTT_TASK_STACK, nullptr,
+                                1, &mqttConnectTaskHandle, ARDUINO_RUNNING_CORE);
+    }
+}
+
+static void replyCommandError(JsonDocument &doc, const char *message)
+{
+    doc.clear();
+    doc["type"] = "error";
+    doc["status"] = "failed";
+    doc["message"] = message;
+    sendJsonResponse(doc);
+}
+
+static void replyInvalidCommand(JsonDocument &doc)
+{
+    replyCommandError(doc, "Invalid command");
+}
+
+static void registerDeviceCommand(JsonDocument &doc, void *ctx)
+{
+    if (topics.registered())
+    {
+        replyInvalidCommand(doc);
+        return;
+    }
+
+    const char *deviceCode = doc["deviceCode"] | "";
+    const char *branchId = doc["branchID"] | "";
+    const char *companyId = doc["companyID"] | "";
+    if (!topics.build(companyId, branchId, deviceCode))
+    {
+        Serial.println("Registration rejected: empty or too long IDs");
+        char message[64];
+        snprintf(message, sizeof(message), "Company, branch and device IDs must be 1 to %u characters",
+                 MQTT_TOPIC_ID_LEN - 1);
+        replyCommandError(doc, message);
+        return;
+    }
+
+    nvs.putString("deviceCode", deviceCode);
+    nvs.putString("branchID", branchId);
+    nvs.putString("companyID", companyId);
+    nvs.putBool("haveRegistered", true);
+    mqtt.subscribe(topics.get(TOPIC_COMMAND));
+    mqtt.unsubscribe(topics.get(TOPIC_REGISTER));
+    negotiateWireEncoding(doc, "registerDevice");
+}
+
+static void setEncodingCommand(JsonDocument &doc, void *ctx)
+{
+    negotiateWireEncoding(doc, "setEncoding");
+}
+
+static void enrollUserCommand(JsonDocument &doc, void *ctx)
+{
+    // On success the reply is sent when the enrollment finishes
+    if (!addUser(doc.as<JsonObject>()))
+    {
+        doc["status"] = 0;
+        doc["type"] = "enrollUser";
+        doc["message"] = responseCode;
+        if (responseCode == F_USER_ID_LONG)
         {
-            doc.clear();
-            doc["type"] = "error";
-            doc["status"] = "failed";
-            doc["message"] = "Invalid command";
-            sendJsonResponse(doc);
+            doc["maxUserIdLength"] = MEMBER_USER_ID_LEN - 1;
         }
+        queueJsonResponse(doc);
+    }
+}
+
+static void cancelEnrollCommand(JsonDocument &doc, void *ctx)
+{
+    doc["status"] = enrollment.active() ? 1 : 0;
+    enrollment.cancel();
+    queueJsonResponse(doc);
+}
+
+static void spiffsStatusCommand(JsonDocument &doc, void *ctx)
+{
+    sendJsonResponse(getSPIFFSStatus());
+}
+
+static void deleteUserCommand(JsonDocument &doc, void *ctx)
+{
+    doc["status"] = deleteUser(doc["userId"] | "") ? 1 : 0;
+    queueJsonResponse(doc);
+}
+
+static void updateSubscriptionCommand(JsonDocument &doc, void *ctx)
+{
+    doc["status"] = updateSubscription(doc["userId"] | "", doc["subscriptionEnd"] | "") ? 1 : 0;
+    queueJsonResponse(doc);
+}
+
+static void importMembersCommand(JsonDocument &doc, void *ctx)
+{
+    importMembers(doc);
+}
+
+static void ackCommand(JsonDocument &doc, void *ctx)
+{
+    // Server confirms every queued message up to this sequence number
+    outbox.ack(doc["seq"].as<uint32_t>());
+}
+
+static void attendanceReportCommand(JsonDocument &doc, void *ctx)
+{
+    attendanceReport(doc["date"] | "");
+}
+
+static void sensorSlotsCommand(JsonDocument &doc, void *ctx)
+{
+    reportSensorSlots();
+}
+
+static void deviceInfoCommand(JsonDocument &doc, void *ctx)
+{
+    deviceInfo();
+}
+
+static void syncMembersCommand(JsonDocument &doc, void *ctx)
+{
+    syncMembers(doc["revision"]);
+}
+
+static void unknownCommand(JsonDocument &doc, void *ctx)
+{
+    replyInvalidCommand(doc);
+}
+
+static const CommandRoute commandRoutes[] = {
+    {"registerDevice", registerDeviceCommand},
+    {"setEncoding", setEncodingCommand},
+    {"enrollUser", enrollUserCommand},
+    {"cancelEnroll", cancelEnrollCommand},
+    {"spiffsStatus", spiffsStatusCommand},
+    {"deleteUser", deleteUserCommand},
+    {"updateSubscription", updateSubscriptionCommand},
+    {"importMembers", importMembersCommand},
+    {"ack", ackCommand},
+    {"attendanceReport", attendanceReportCommand},
+    {"sensorSlots", sensorSlotsCommand},
+    {"deviceInfo", deviceInfoCommand},
+    {"syncMembers", syncMembersCommand},
+};
+
+static CommandRouter commandRouter(commandRoutes, unknownCommand, &requestArena, nullptr);
+
+// Function to handle incoming BLE data
+void receiveFromMobile(const char *data, size_t length)
+{
+    const uint8_t *payload = (const uint8_t *)data;
+
+    Serial.print("📥 Received from mobile: ");
+    if (wireIsMsgPack(payload, length))
+        Serial.printf("(msgpack, %u bytes)\n", length);
+    else
+        Serial.println(data);
+
+    CommandStatus status = commandRouter.dispatch(payload, length);
+    if (status == COMMAND_ERR_MEMORY)
+        Serial.println("no memory in heap");
+    else if (status == COMMAND_ERR_PARSE)
+        Serial.printf("Command parse error: %s\n", commandRouter.parseError());
+}
+
+// The server lists the encodings it accepts, most preferred first. The
+// reply still goes out in the previous encoding so the server can read it.
+void negotiateWireEncoding(JsonDocument &doc, const char *type)
+{
+    WireEncoding chosen = wireNegotiate(doc["encodings"]);
+    nvs.putUChar("wireEnc", chosen);
+
+    doc.clear();
+    doc["type"] = type;
+    doc["status"] = 1;
+    doc["encoding"] = wireEncodingName(chosen);
+    JsonArray supported = doc["encodings"].to<JsonArray>();
+    supported.add(wireEncodingName(WIRE_MSGPACK));
+    supported.add(wireEncodingName(WIRE_JSON));
+    sendJsonResponse(doc);
+
+    wireEncoding = chosen;
+    Serial.printf("Payload encoding: %s\n", wireEncodingName(wireEncoding));
+}
+
+static bool streamMemberRecord(const MemberRecord &record, void *ctx)
+{
+    // One small document per record, so the heap used does not depend on
+    // the number of members
+    JsonDocument member(&requestArena);
+    memberRecordToJson(record, member.to<JsonObject>());
+    memberListItem(*static_cast<MemberListStream *>(ctx), member);
+    return true;
+}
+
+static bool walkAllMembers(MemberListStream &stream, void *ctx)
+{
+    return memberStore.forEach(streamMemberRecord, &stream) == MEMBER_STORE_OK;
+}
+
+// The member now in the slot with its "op", or only the IDs of a deleted one
+static bool streamMemberChange(uint16_t slot, MemberChange change, const char *userId, void *ctx)
+{
+    JsonDocument item(&requestArena);
+    MemberRecord record;
+    if (change != MEMBER_CHANGE_DELETE && memberStore.read(slot, record) == MEMBER_STORE_OK)
+    {
+        memberRecordToJson(record, item.to<JsonObject>());
+        item["op"] = change == MEMBER_CHANGE_ADD ? "add" : "update";
+    }
+    else
+    {
+        item["op"] = "delete";
+        item["userId"] = userId;
+        item["punchingId1"] = slot;
+    }
+    memberListItem(*static_cast<MemberListStream *>(ctx), item);
+    return true;
+}
+
+static bool walkMemberChanges(MemberListStream &stream, void *ctx)
+{
+    return memberLog.changesSince(*static_cast<uint32_t *>(ctx), streamMemberChange, &stream);
+}
+
+// Members on the callback topic, false when nothing was published
+bool publishMemberList(const JsonDocument &envelope, MemberListWalk walk, void *ctx)
+{
+    MemberListStatus status = memberListPublish(mqttTransport, topics.get(TOPIC_CALLBACK), wireEncoding, envelope, walk, ctx);
+    if (status != MEMBER_LIST_OK)
+    {
+        Serial.printf("Member list failed: %s\n", memberListStatusName(status));
+    }
+
+    if (status == MEMBER_LIST_ERR_TRUNCATED)
+    {
+        // The announced length no longer matches what was written, drop
+        // the session so the broker discards the partial message
+        mqtt.disconnect();
+        return true;
     }
+    return status == MEMBER_LIST_OK;
 }
 
+// Every member in the store
 void deviceInfo()
 {
-    File file = SPIFFS.open("/members.json", "r");
-    if (!file)
+    if (!mqttOnline())
     {
-        Serial.println("Failed to open members file");
         return;
     }
 
-    String fileContent = file.readString();
-    file.close();
-
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, fileContent);
+    JsonDocument envelope(&requestArena);
+    envelope["type"] = "deviceInfo";
+    envelope["timeStamp"] = getCurrentTimestamp();
+    envelope["revision"] = memberStore.revision();
+    envelope["members"].to<JsonArray>();
+    publishMemberList(envelope, walkAllMembers, nullptr);
+}
 
-    if (error)
+// Members changed since the revision the server last saw, one element per
+// punching ID, or all of them when the log does not reach back that far:
+// {"type":"syncMembers","since":40,"revision":42,"full":false,"changes":[...]}
+// {"type":"syncMembers","revision":42,"full":true,"members":[...]}
+// An "update" may put a different member in the slot.
+void syncMembers(JsonVariantConst since)
+{
+    if (!mqttOnline())
     {
-        Serial.println("Failed to parse JSON");
         return;
     }
-    doc["timeStamp"] = getCurrentTimestamp();
 
-    sendJsonResponse(doc);
+    JsonDocument envelope(&requestArena);
+    uint32_t from = since.as<uint32_t>();
+    if (!since.isNull() && memberLog.covers(from))
+    {
+        envelope["type"] = "syncMembers";
+        envelope["since"] = from;
+        envelope["revision"] = memberStore.revision();
+        envelope["full"] = false;
+        envelope["changes"].to<JsonArray>();
+        if (publishMemberList(envelope, walkMemberChanges, &from))
+        {
+            return;
+        }
+        // A damaged log entry, send everything instead
+        envelope.clear();
+    }
+
+    envelope["type"] = "syncMembers";
+    envelope["revision"] = memberStore.revision();
+    envelope["full"] = true;
+    envelope["members"].to<JsonArray>();
+    publishMemberList(envelope, walkAllMembers, nullptr);
 }
 
 void resetDevice(bool type)
@@ -616,14 +1175,13 @@ void resetDevice(bool type)
     nvs.clear();
     SPIFFS.format();
 
-    finger.emptyDatabase();
-
-    JsonDocument initialDoc;
-    JsonArray array = initialDoc.to<JsonArray>();
+    {
+        SensorLock lock;
+        fingerprintSensor.emptyDatabase();
+        sensorSlots.clear();
+    }
 
-    File writeFile = SPIFFS.open("/members.json", "w");
-    serializeJson(initialDoc, writeFile);
-    writeFile.close();
+    memberStore.format(MAX_CAPACITY);
 
     ESP.restart();
 }
@@ -659,236 +1217,470 @@ bool saveJsonToFile(JsonDocument &doc, const char *filename)
     File file = SPIFFS.open(filename, "w");
     if (!file)
     {
-        Serial.println("Failed to open file for writing");
-        return false;
+        Serial.println("Failed to open file for writing");
+        return false;
+    }
+
+    if (serializeJson(doc, file) == 0)
+    {
+        Serial.println("Failed to write to file");
+        file.close();
+        return false;
+    }
+
+    file.close();
+    Serial.println("JSON saved to file successfully");
+    return true;
+}
+
+// Function to add a new user.
+/*
+bool addUser(const JsonObject &newMember)
+{
+    uint16_t id = getNextAvailableID();
+
+    Serial.println("id: " + id);
+
+    if (id == 0)
+        return 0;
+
+    if (saveFingerprint(id) != true)
+        return 0;
+
+    newMember.remove("type");
+    newMember["punchingId1"] = id;
+    newMember["subsEndInSec"] = dateStringToSeconds(newMember["subscriptionEnd"]);
+
+    JsonDocument members;
+
+    if (!loadJsonFromFile(members, "/members.json"))
+    {
+        return 0;
+    }
+
+    JsonArray membersArray = members.as<JsonArray>();
+
+    JsonObject addedMember = membersArray.createNestedObject();
+
+    for (JsonPair kv : newMember)
+    {
+        addedMember[kv.key()] = kv.value();
+    }
+
+    saveJsonToFile(members, "/members.json");
+
+    nvs.putUShort("lastUsedID", (id));
+
+    return true;
+}
+
+*/
+
+// Start enrolling a new user. The member is stored by commitEnrolledUser()
+// once serviceEnrollment() has the template in the sensor.
+bool addUser(const JsonObject &newMember)
+{
+    // Every path sets responseCode, the reply carries it as "message"
+    responseCode = F_OK;
+    if (enrollment.active())
+    {
+        Serial.println("Enrollment already in progress");
+        responseCode = F_ENROLL_BUSY;
+        return false;
+    }
+
+    if (!memberRecordFromJson(newMember, pendingMember))
+    {
+        bool tooLong = strlen(newMember["userId"] | "") >= MEMBER_USER_ID_LEN;
+        Serial.println(tooLong ? "userId too long" : "Missing userId");
+        responseCode = tooLong ? F_USER_ID_LONG : F_NO_USER_ID;
+        return false;
+    }
+
+    SensorLock lock;
+    uint16_t id = getNextAvailableID();
+
+    Serial.println("Assigned ID: " + String(id));
+
+    if (id == 0)
+    {
+        Serial.println("Failed to get available ID");
+        return false;
+    }
+
+    pendingMember.punchingId1 = id;
+    pendingMember.punchingId2 = 0;
+    pendingMember.subsEndInSec = isoDayStart(newMember["subscriptionEnd"].as<const char *>(), TIME_OFFSET);
+
+    enrollment.start(id, millis());
+    Serial.print("Waiting for valid finger to enroll as #");
+    Serial.println(id);
+    publishEnrollProgress();
+
+    return true;
+}
+
+// Advance a running enrollment by one step, called from loop()
+void serviceEnrollment()
+{
+    bool changed;
+    {
+        SensorLock lock;
+        changed = enrollment.update(millis());
+    }
+
+    if (!changed)
+    {
+        return;
+    }
+
+    publishEnrollProgress();
+
+    if (!enrollment.finished())
+    {
+        return;
+    }
+
+    JsonDocument doc(&requestArena);
+    doc["type"] = "enrollUser";
+    doc["userId"] = pendingMember.userId;
+    doc["punchingId"] = enrollment.id();
+
+    if (enrollment.stage() != ENROLL_DONE)
+    {
+        responseCode = F_ENROLL_FAILED;
+    }
+    else if (commitEnrolledUser())
+    {
+        responseCode = F_OK;
+    }
+    else
+    {
+        responseCode = F_STORE_FAILED;
     }
 
-    if (serializeJson(doc, file) == 0)
+    if (responseCode == F_OK)
     {
-        Serial.println("Failed to write to file");
-        file.close();
-        return false;
+        doc["status"] = 1;
+    }
+    else
+    {
+        doc["status"] = 0;
+        doc["stage"] = Enrollment::stageName(enrollment.stage());
+        doc["error"] = enrollment.lastError();
     }
+    doc["message"] = responseCode;
+    queueJsonResponse(doc);
 
-    file.close();
-    Serial.println("JSON saved to file successfully");
-    return true;
+    enrollment.reset();
 }
 
-// Function to add a new user.
-/*
-bool addUser(const JsonObject &newMember)
+void publishEnrollProgress()
 {
-    uint16_t id = getNextAvailableID();
+    const char *stage = Enrollment::stageName(enrollment.stage());
+    Serial.println("Enrollment #" + String(enrollment.id()) + ": " + stage);
+
+    JsonDocument doc(&requestArena);
+    doc["type"] = "enrollProgress";
+    doc["userId"] = pendingMember.userId;
+    doc["punchingId"] = enrollment.id();
+    doc["stage"] = stage;
+    sendJsonResponse(doc);
+}
 
-    Serial.println("id: " + id);
+// Store the member whose template has just been saved on the sensor
+bool commitEnrolledUser()
+{
+    if (memberStore.write(pendingMember) != MEMBER_STORE_OK)
+    {
+        Serial.println("Failed to save members file");
+        SensorLock lock;
+        fingerprintSensor.deleteModel(pendingMember.punchingId1);
+        return false;
+    }
 
-    if (id == 0)
-        return 0;
+    indexMember(pendingMember);
+    sensorSlots.set(pendingMember.punchingId1);
 
-    if (saveFingerprint(id) != true)
-        return 0;
+    Serial.println("User added successfully with ID: " + String(pendingMember.punchingId1));
 
-    newMember.remove("type");
-    newMember["punchingId1"] = id;
-    newMember["subsEndInSec"] = dateStringToSeconds(newMember["subscriptionEnd"]);
+    return true;
+}
 
-    JsonDocument members;
+// Function to delete user
+bool deleteUser(const char *userId)
+{
+    MemberRecord member;
+    MemberStoreStatus status = memberStore.findByUserId(userId, member);
 
-    if (!loadJsonFromFile(members, "/members.json"))
+    if (status != MEMBER_STORE_OK)
     {
-        return 0;
+        Serial.print("User with ID '");
+        Serial.print(userId);
+        Serial.println("' not found");
+        return false;
     }
 
-    JsonArray membersArray = members.as<JsonArray>();
-
-    JsonObject addedMember = membersArray.createNestedObject();
+    // Print user details before deletion
+    Serial.println("Found user to delete:");
+    Serial.print("  User ID: ");
+    Serial.println(member.userId);
+    Serial.print("  Name: ");
+    Serial.println(member.name);
+    Serial.print("  User Type: ");
+    Serial.println(member.userType);
+    Serial.print("  Subscription End: ");
+    Serial.println(member.subscriptionEnd);
+    Serial.print("  Punching ID: ");
+    Serial.println(member.punchingId1);
+
+    // Delete fingerPrint data from sensor
+    {
+        SensorLock lock;
+        fingerprintSensor.deleteModel(member.punchingId1);
+        sensorSlots.reset(member.punchingId1);
+        if (member.punchingId2 != 0)
+        {
+            fingerprintSensor.deleteModel(member.punchingId2);
+            sensorSlots.reset(member.punchingId2);
+        }
+    }
 
-    for (JsonPair kv : newMember)
+    portENTER_CRITICAL(&memberIndexLock);
+    memberIndex.remove(member.punchingId1);
+    if (member.punchingId2 != 0)
     {
-        addedMember[kv.key()] = kv.value();
+        memberIndex.remove(member.punchingId2);
     }
+    portEXIT_CRITICAL(&memberIndexLock);
 
-    saveJsonToFile(members, "/members.json");
-
-    nvs.putUShort("lastUsedID", (id));
+    if (memberStore.erase(member.punchingId1) != MEMBER_STORE_OK)
+    {
+        Serial.println("Failed to update members file");
+        return false;
+    }
 
+    Serial.print("Successfully deleted user: ");
+    Serial.println(userId);
     return true;
 }
 
-*/
-
-bool addUser(const JsonObject &newMember)
+// Rewrite the subscription end of one member record in place
+bool updateSubscription(const char *userId, const char *subscriptionEnd)
 {
-    uint16_t id = getNextAvailableID();
-
-    Serial.println("Assigned ID: " + String(id));
-
-    if (id == 0)
+    MemberRecord member;
+    if (memberStore.findByUserId(userId, member) != MEMBER_STORE_OK)
     {
-        Serial.println("Failed to get available ID");
+        Serial.printf("User with ID '%s' not found\n", userId);
         return false;
     }
 
-    if (saveFingerprint(id) != true)
+    strncpy(member.subscriptionEnd, subscriptionEnd, MEMBER_SUBS_END_LEN - 1);
+    member.subscriptionEnd[MEMBER_SUBS_END_LEN - 1] = '\0';
+    member.subsEndInSec = isoDayStart(subscriptionEnd, TIME_OFFSET);
+
+    if (memberStore.write(member) != MEMBER_STORE_OK)
     {
-        Serial.println("Failed to save fingerprint");
+        Serial.println("Failed to update members file");
         return false;
     }
 
-    // Create a copy of the member object to modify
-    JsonDocument tempDoc;
-    JsonObject modifiableMember = tempDoc.to<JsonObject>();
-    
-    // Copy all data except "type"
-    for (JsonPair kv : newMember)
+    indexMember(member);
+    Serial.printf("Subscription updated for: %s\n", userId);
+    return true;
+}
+
+// One chunk of a bulk import, see MemberImport for the stream format:
+// {"type":"importMembers","id":7,"seq":0,"replace":true,"gzip":true,"data":"...","last":false}
+// Seq 0 opens the import. Every chunk is answered with the sequence number
+// expected next; the answer to the last one says whether it was committed.
+void importMembers(JsonDocument &doc)
+{
+    uint32_t id = doc["id"] | 0;
+    uint32_t seq = doc["seq"] | 0;
+    bool last = doc["last"] | false;
+    MemberImportStatus status = IMPORT_OK;
+
+    if (doc["abort"] | false)
     {
-        if (strcmp(kv.key().c_str(), "type") != 0)
+        if (memberImport.active() && memberImport.id() == id)
         {
-            modifiableMember[kv.key()] = kv.value();
+            memberImport.abort();
         }
+        last = false;
     }
-    
-    modifiableMember["punchingId1"] = id;
-    modifiableMember["subsEndInSec"] = dateStringToSeconds(modifiableMember["subscriptionEnd"]);
-
-    JsonDocument members;
-
-    if (!loadJsonFromFile(members, "/members.json"))
+    else
     {
-        Serial.println("Failed to load members file");
-        return false;
+        if (seq == 0 && !(memberImport.active() && memberImport.id() == id))
+        {
+            status = memberImport.begin(id, doc["replace"] | false);
+        }
+        if (status == IMPORT_OK)
+        {
+            JsonString data = doc["data"].as<JsonString>();
+            status = memberImport.chunk(id, seq, data.c_str(), data.size(), doc["gzip"] | false);
+        }
+        if (status == IMPORT_OK && last)
+        {
+            status = memberImport.commit(id);
+            if (status == IMPORT_OK)
+            {
+                reindexMembers();
+                Serial.printf("Member import %u committed: %u imported, %u rejected\n", id, memberImport.imported(),
+                              memberImport.rejected());
+            }
+        }
+        memberImportLastChunkAt = millis();
     }
 
-    JsonArray membersArray = members.as<JsonArray>();
+    if (status != IMPORT_OK)
+    {
+        Serial.printf("Member import %u, chunk %u: %s\n", id, seq, MemberImport::statusName(status));
+    }
 
-    JsonObject addedMember = membersArray.createNestedObject();
+    doc.clear();
+    doc["type"] = "importMembers";
+    doc["id"] = id;
+    doc["status"] = status == IMPORT_OK ? 1 : 0;
+    doc["message"] = MemberImport::statusName(status);
+    doc["next"] = memberImport.nextSeq();
+    doc["imported"] = memberImport.imported();
+    doc["rejected"] = memberImport.rejected();
+    doc["revision"] = memberStore.revision();
 
-    for (JsonPair kv : modifiableMember)
+    // Chunk acks are resent on demand, the outcome must not get lost
+    if (last)
     {
-        addedMember[kv.key()] = kv.value();
+        doc["committed"] = status == IMPORT_OK;
+        queueJsonResponse(doc);
     }
-
-    if (!saveJsonToFile(members, "/members.json"))
+    else
     {
-        Serial.println("Failed to save members file");
-        return false;
+        sendJsonResponse(doc);
     }
-
-    nvs.putUShort("lastUsedID", id);
-    Serial.println("User added successfully with ID: " + String(id));
-
-    return true;
 }
 
-// Function to delete user
-bool deleteUser(const String &userId)
+// Drop an import the server stopped sending
+void serviceMemberImport()
 {
-    // Parse JSON
-    JsonDocument doc; // Adjust size based on your needs
-    loadJsonFromFile(doc, "/members.json");
+    if (memberImport.active() && millis() - memberImportLastChunkAt > MEMBER_IMPORT_TIMEOUT_MS)
+    {
+        Serial.printf("Member import %u timed out waiting for chunk %u\n", memberImport.id(), memberImport.nextSeq());
+        memberImport.abort();
+    }
+}
 
-    // Get the array of members
-    JsonArray membersArray = doc.as<JsonArray>();
-    bool userFound = false;
-    int indexToRemove = -1;
+// Bring the index in line with the store after an import. Entries are
+// overwritten and stale ones removed one by one, so a member known before
+// and after the import is never refused in between.
+void reindexMembers()
+{
+    SlotBitmap stored;
+    memberStore.forEach([](const MemberRecord &record, void *ctx) -> bool
+                        {
+        SlotBitmap *stored = static_cast<SlotBitmap *>(ctx);
+        indexMember(record);
+        stored->set(record.punchingId1);
+        if (record.punchingId2 != 0)
+        {
+            stored->set(record.punchingId2);
+        }
+        return true; }, &stored);
 
-    // Find the user by userId
-    for (int i = 0; i < membersArray.size(); i++)
+    // The sensor has no slots past the bitmap
+    uint16_t limit = memberIndex.capacity() < SLOT_BITMAP_BITS ? memberIndex.capacity() : SLOT_BITMAP_BITS;
+    for (uint16_t id = 1; id < limit; id++)
     {
-        JsonObject member = membersArray[i];
-        if (member["userId"].as<String>() == userId)
+        if (!stored.test(id))
         {
-            userFound = true;
-            indexToRemove = i;
-
-            // Print user details before deletion
-            Serial.println("Found user to delete:");
-            Serial.print("  User ID: ");
-            Serial.println(member["userId"].as<String>());
-            Serial.print("  Name: ");
-            Serial.println(member["name"].as<String>());
-            Serial.print("  User Type: ");
-            Serial.println(member["userType"].as<int>());
-            Serial.print("  Subscription End: ");
-            Serial.println(member["subscriptionEnd"].as<String>());
-            Serial.print("  Punching ID: ");
-            Serial.println(member["punchingId"].as<int>());
-
-            // Delete fingerPrint data from sensor
-            finger.deleteModel(member["punchingId"].as<int>());
-
-            break;
+            portENTER_CRITICAL(&memberIndexLock);
+            memberIndex.remove(id);
+            portEXIT_CRITICAL(&memberIndexLock);
         }
     }
+}
+
+void logAttendance(uint16_t punchingId, uint32_t timestamp, uint8_t direction)
+{
+    TraceLap lap(&latencyTrace, systemClock);
 
-    if (!userFound)
+    if (!attendanceJournal.append(punchingId, timestamp, direction))
     {
-        Serial.print("User with ID '");
-        Serial.print(userId);
-        Serial.println("' not found");
-        return false;
+        Serial.println("Failed to write attendance record");
     }
+    lap.mark(TRACE_ATTENDANCE);
 
-    // Remove the user from array
-    membersArray.remove(indexToRemove);
+    const MemberEntry *user = memberIndex.find(punchingId);
+    const char *userId = user != nullptr ? user->userId : "";
+    Serial.printf("Attendance logged for %s\n", userId);
 
-    saveJsonToFile(doc, "/members.json");
-
-    Serial.print("Successfully deleted user: ");
-    Serial.println(userId);
-    return true;
+    // Optionally send to MQTT server
+    JsonDocument mqttDoc(&requestArena);
+    mqttDoc["type"] = "attendance";
+    mqttDoc["user_id"] = userId;
+    mqttDoc["punchingId"] = punchingId;
+    mqttDoc["timestamp"] = timestamp;
+    mqttDoc["status"] = direction == ATTENDANCE_OUT ? "OUT" : "IN";
+    queueJsonResponse(mqttDoc);
+    lap.mark(TRACE_PUBLISH);
 }
 
-void logAttendance(String user_id, String timestamp, String status)
+// Pair IN/OUT punches of one day into the export format of dataFormat.json
+static bool addAttendanceToReport(const AttendanceRecord &record, void *ctx)
 {
-    String date = timestamp.substring(0, 10); // Extract YYYY-MM-DD
-    String filePath = "/attendance/" + date + ".json";
+    JsonArray entries = *static_cast<JsonArray *>(ctx);
+
+    // Members the index no longer knows are reported by punching ID. The
+    // pointer, not the char array, makes ArduinoJson copy the userId.
+    const MemberEntry *user = memberIndex.find(record.punchingId);
+    const char *userId = user != nullptr ? user->userId : nullptr;
 
-    File file = SPIFFS.open(filePath, FILE_READ);
-    DynamicJsonDocument doc(2048);
-    JsonArray records;
+    uint32_t secondOfDay = record.timestamp % 86400;
+    char clock[9];
+    snprintf(clock, sizeof(clock), "%02u:%02u:%02u", secondOfDay / 3600, (secondOfDay / 60) % 60, secondOfDay % 60);
 
-    if (file)
+    if (record.direction == ATTENDANCE_OUT)
     {
-        DeserializationError error = deserializeJson(doc, file);
-        file.close();
-        if (error)
+        for (int i = entries.size() - 1; i >= 0; i--)
         {
-            Serial.println("Failed to parse attendance file: " + String(error.c_str()));
-            doc.clear();
+            JsonObject entry = entries[i];
+            bool sameMember = userId != nullptr ? entry["member_id"] == userId : entry["member_id"] == record.punchingId;
+            if (sameMember && !entry["checkOut"].is<const char *>())
+            {
+                entry["checkOut"] = clock;
+                return true;
+            }
         }
-        records = doc.as<JsonArray>();
+    }
+
+    JsonObject entry = entries.add<JsonObject>();
+    if (userId != nullptr)
+    {
+        entry["member_id"] = userId;
     }
     else
     {
-        records = doc.to<JsonArray>();
+        entry["member_id"] = record.punchingId;
     }
+    entry[record.direction == ATTENDANCE_OUT ? "checkOut" : "checkIn"] = clock;
+    return true;
+}
 
-    // Add new attendance record
-    JsonObject record = records.createNestedObject();
-    record["user_id"] = user_id;
-    record["timestamp"] = timestamp;
-    record["status"] = status;
+// Generate the JSON attendance of one day (YYYY-MM-DD) from the journal
+void attendanceReport(const char *date)
+{
+    uint32_t dayStart = isoDayStart(date, TIME_OFFSET);
 
-    // Write back to file
-    file = SPIFFS.open(filePath, FILE_WRITE);
-    if (!file)
+    JsonDocument doc(&requestArena);
+    doc["type"] = "attendance";
+    JsonArray entries = doc[date].to<JsonArray>();
+
+    if (dayStart == 0 || !attendanceJournal.forEachOfDay(dayStart, addAttendanceToReport, &entries))
     {
-        Serial.println("Failed to open attendance file for writing");
-        return;
+        doc["status"] = 0;
     }
-    serializeJson(doc, file);
-    file.close();
-    Serial.println("Attendance logged for " + user_id);
 
-    // Optionally send to MQTT server
-    JsonDocument mqttDoc;
-    mqttDoc["type"] = "attendance";
-    mqttDoc["user_id"] = user_id;
-    mqttDoc["timestamp"] = timestamp;
-    mqttDoc["status"] = status;
-    sendJsonResponse(mqttDoc);
+    sendJsonResponse(doc);
 }
 
 // Function to create attendance directory if it doesn't exist
@@ -906,7 +1698,7 @@ JsonDocument getSPIFFSStatus()
     // Initialize SPIFFS if not already initialized
     if (!SPIFFS.begin(true))
     {
-        JsonDocument errorDoc;
+        JsonDocument errorDoc(&requestArena);
         errorDoc["error"] = "SPIFFS Mount Failed";
         return errorDoc;
     }
@@ -927,7 +1719,7 @@ JsonDocument getSPIFFSStatus()
         }
     }
 
-    JsonDocument doc;
+    JsonDocument doc(&requestArena);
 
     // Get partition information
     size_t totalBytes = SPIFFS.totalBytes();
@@ -987,18 +1779,34 @@ JsonDocument getSPIFFSStatus()
     return doc;
 }
 
+// Delete journal days (YYYYMMDD.bin) older than daysToKeep
 void cleanupAttendance(int daysToKeep)
 {
+    uint32_t now = getCurrentTimestamp();
+    if (now == 0)
+    {
+        return; // Clock not set yet
+    }
+    int32_t oldestKept = (int32_t)(now / 86400) - daysToKeep;
+
     File root = SPIFFS.open("/attendance");
     File file = root.openNextFile();
-    String currentDate = "2025-06-08"; // Replace with actual date
     while (file)
     {
-        String fileName = file.name();
-        String fileDate = fileName.substring(11, 21); // Extract YYYY-MM-DD
-        // Compare fileDate with currentDate - daysToKeep
-        // Delete if older (implement date comparison logic)
+        char path[ATTENDANCE_PATH_LEN];
+        strncpy(path, file.path(), sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        file.close();
         file = root.openNextFile();
+
+        const char *name = strrchr(path, '/');
+        IsoDateTime day;
+        if (isoParse(name != nullptr ? name + 1 : path, 8, day) == ISO_OK &&
+            daysFromCivil(day.date.year, day.date.month, day.date.day) < oldestKept)
+        {
+            SPIFFS.remove(path);
+            Serial.printf("Removed %s\n", path);
+        }
     }
 }
 
@@ -1056,377 +1864,884 @@ void checkFingerprint()
 }
 */
 
-void checkFingerprint()
+// Copies the entry under the spinlock, loop() may be updating the index
+bool lookupMember(uint16_t punchingId, MemberEntry &entry, void *ctx)
 {
-    int fingerprintID = -1;
-    if (finger.getImage() == FINGERPRINT_OK)
+    bool found = false;
+    portENTER_CRITICAL(&memberIndexLock);
+    const MemberEntry *indexed = memberIndex.find(punchingId);
+    if (indexed != nullptr)
     {
-        if (finger.image2Tz() == FINGERPRINT_OK)
-        {
-            if (finger.fingerSearch() == FINGERPRINT_OK)
-            {
-                fingerprintID = finger.fingerID;
-                JsonDocument doc;
-                
-                if (!loadJsonFromFile(doc, "/members.json"))
-                {
-                    Serial.println("Failed to load members file");
-                    return;
-                }
+        entry = *indexed;
+        found = true;
+    }
+    portEXIT_CRITICAL(&memberIndexLock);
+    return found;
+}
 
-                int index = getIndexByBioId(fingerprintID, doc);
-                
-                if (index == -1)
-                {
-                    Serial.println("User not found in database");
-                    return;
-                }
+// Runs on the fingerprint task. Decides access and hands the result to
+// loop() through accessEvents, so storage and MQTT never delay the door.
+// Returns true when a finger was on the sensor.
+bool checkFingerprint()
+{
+    SensorLock lock;
 
-                JsonObject user = doc[index];
-                
-                // Check if user object is valid
-                if (user.isNull())
-                {
-                    Serial.println("Invalid user object");
-                    return;
-                }
+    // An enrollment owns the sensor until it finishes
+    if (enrollment.active())
+    {
+        return false;
+    }
+    metrics.add(METRIC_FP_SCANS);
 
-                serializeJsonPretty(user, Serial);
+    TraceLap lap(&latencyTrace, systemClock);
+    AccessDecision decision;
+    AccessResult result = accessControl.scan(decision);
 
-                if (authenticateUser(user))
-                {
-                    Serial.println("Access granted - welcome");
-                    // Log attendance
-                    String timestamp = String(getCurrentTimestamp());
-                    Serial.println("current time stamp" + timestamp);
-                    // logAttendance(user["userId"].as<String>(), timestamp, "IN");
-                }
-                else
-                {
-                    Serial.println("Access denied - subscription expired or invalid");
-                }
-            }
-            else
+    // scan() has already unlocked the door
+    if (result == ACCESS_GRANTED)
+    {
+        lap.total(TRACE_GRANT);
+    }
+
+    switch (result)
+    {
+    case ACCESS_NO_FINGER:
+    case ACCESS_SENSOR_ERROR:
+        return false;
+    case ACCESS_BAD_IMAGE:
+        Serial.println("Failed to convert fingerprint image");
+        return true;
+    case ACCESS_NO_MATCH:
+        Serial.println("Fingerprint not found in database");
+        return true;
+    case ACCESS_UNKNOWN_MEMBER:
+        Serial.println("User not found in database");
+        return true;
+    case ACCESS_GRANTED:
+        Serial.println("Access granted - welcome");
+        break;
+    case ACCESS_DENIED:
+        Serial.println("Access denied - subscription expired or invalid");
+        break;
+    }
+
+    Serial.printf("User: %s, type: %u, subscription end: %u, now: %u\n", decision.member.userId,
+                  decision.member.userType, decision.member.subsEndInSec, decision.timestamp);
+
+    AccessEvent event;
+    event.timestamp = decision.timestamp;
+    event.punchingId = decision.punchingId;
+    event.granted = decision.result == ACCESS_GRANTED;
+    event.decidedUs = micros();
+
+    if (!accessEvents.push(event))
+    {
+        Serial.println("Access event queue full, event dropped");
+    }
+    return true;
+}
+
+#if FP_TOUCH_PIN >= 0
+// Sensor touch output: wake the scan task, nothing else in interrupt context
+void IRAM_ATTR onFingerTouch()
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(fingerprintTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+#endif
+
+// Polls the sensor quickly for FP_TOUCH_BURST_MS after a touch edge or a
+// detected finger. In between it sleeps until the next touch, or polls
+// every FP_IDLE_POLL_MS when no touch line is wired. A touch line that
+// never fires still gets a scan every FP_TOUCH_FALLBACK_MS.
+void fingerprintTask(void *param)
+{
+#if FP_TOUCH_PIN >= 0
+    const uint32_t idleMs = FP_IDLE_WAKE_MS; // Only the door contact to watch
+#else
+    const uint32_t idleMs = FP_IDLE_POLL_MS;
+#endif
+    uint32_t burstUntil = millis();
+#if FP_TOUCH_PIN >= 0
+    uint32_t lastScan = millis();
+#endif
+
+    for (;;)
+    {
+        bool bursting = (int32_t)(burstUntil - millis()) > 0;
+
+#if FP_TOUCH_PIN >= 0
+        if (bursting || millis() - lastScan >= FP_TOUCH_FALLBACK_MS)
+#endif
+        {
+#if FP_TOUCH_PIN >= 0
+            lastScan = millis();
+#endif
+            uint32_t start = micros();
+            if (checkFingerprint())
             {
-                Serial.println("Fingerprint not found in database");
+                burstUntil = millis() + FP_TOUCH_BURST_MS;
+                bursting = true;
             }
+            metrics.add(METRIC_FP_BUSY_US, micros() - start);
+        }
+        serviceDoorLock();
+
+        // The lock also needs frequent updates while it is open
+        uint32_t waitMs = bursting || doorLock.state() != LOCK_LOCKED ? FP_SCAN_INTERVAL_MS : idleMs;
+
+#if FP_TOUCH_PIN >= 0
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs)) > 0)
+        {
+            metrics.add(METRIC_FP_TOUCHES);
+            burstUntil = millis() + FP_TOUCH_BURST_MS;
+        }
+#else
+        vTaskDelay(pdMS_TO_TICKS(waitMs));
+#endif
+    }
+}
+
+// Auto-relock and door contact, runs on the fingerprint task
+void serviceDoorLock()
+{
+    LockEvent event = doorLock.update();
+    if (event == LOCK_EVENT_FORCED_OPEN)
+    {
+        Serial.println("WARNING: Door opened while locked");
+    }
+    else if (event == LOCK_EVENT_HELD_OPEN)
+    {
+        Serial.println("WARNING: Door held open, relocked");
+    }
+    else if (event != LOCK_EVENT_NONE)
+    {
+        Serial.printf("Door: %s\n", LockActuator::eventName(event));
+    }
+}
+
+// Publish door alarms counted by the fingerprint task
+void reportDoorAlarm(const char *type, uint32_t count, uint32_t &reported)
+{
+    if (count == reported)
+    {
+        return;
+    }
+
+    JsonDocument doc(&requestArena);
+    doc["type"] = type;
+    doc["count"] = count - reported;
+    doc["timestamp"] = getCurrentTimestamp();
+    queueJsonResponse(doc);
+    reported = count;
+}
+
+void reportDoorAlarms()
+{
+    static uint32_t forcedReported = 0;
+    static uint32_t heldReported = 0;
+    AllocScope allocs(METRIC_ALLOC_ACCESS);
+
+    reportDoorAlarm("doorForced", doorLock.forcedOpens(), forcedReported);
+    reportDoorAlarm("doorHeldOpen", doorLock.heldOpens(), heldReported);
+}
+
+void startFingerprintTask()
+{
+    accessControl.setTrace(&latencyTrace);
+    accessControl.setLock(&doorLock);
+    xTaskCreatePinnedToCore(fingerprintTask, "fingerprint", FP_TASK_STACK, nullptr,
+                            FP_TASK_PRIORITY, &fingerprintTaskHandle, FP_TASK_CORE);
+
+#if FP_TOUCH_PIN >= 0
+    // Pull towards the idle level so an unconnected line reads "no finger"
+    pinMode(FP_TOUCH_PIN, FP_TOUCH_ACTIVE_HIGH ? INPUT_PULLDOWN : INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(FP_TOUCH_PIN), onFingerTouch, FP_TOUCH_ACTIVE_HIGH ? RISING : FALLING);
+    Serial.printf("Fingerprint scanning on touch (GPIO %d)\n", FP_TOUCH_PIN);
+#else
+    Serial.printf("Fingerprint polling every %u ms\n", FP_IDLE_POLL_MS);
+#endif
+}
+
+// Persist and publish the decisions made by the fingerprint task
+void processAccessEvents()
+{
+    AllocScope allocs(METRIC_ALLOC_ACCESS);
+    AccessEvent event;
+    while (accessEvents.pop(event))
+    {
+        latencyTrace.record(TRACE_EVENT_QUEUE, micros() - event.decidedUs);
+
+        if (event.granted)
+        {
+            uint8_t direction = attendanceJournal.nextDirection(event.punchingId, event.timestamp);
+            logAttendance(event.punchingId, event.timestamp, direction);
         }
         else
         {
-            Serial.println("Failed to convert fingerprint image");
+            JsonDocument doc(&requestArena);
+            doc["type"] = "accessDenied";
+            doc["punchingId"] = event.punchingId;
+            doc["timestamp"] = event.timestamp;
+            queueJsonResponse(doc);
         }
     }
 }
 
-bool authenticateUser(JsonObject &obj)
+// Caller must hold the sensor lock
+uint16_t getNextAvailableID()
+{
+    if (!sensorSlotsLoaded && !readSensorSlots())
+    {
+        responseCode = F_SEN_COMMU;
+        return 0; // Error: Cannot communicate with sensor
+    }
+
+    // Slot 0 is never handed out, 0 means "no ID"
+    uint16_t id = sensorSlots.findFirstFree(1, MAX_CAPACITY);
+    if (id == 0)
+    {
+        responseCode = F_SEN_FULL;
+        return 0; // Error: Sensor storage is full
+    }
+
+    return id;
+}
+
+// Read the sensor's template index table (a few packets) into sensorSlots.
+// Caller must hold the sensor lock.
+bool readSensorSlots()
 {
-    Serial.println("current time stamp: " + getCurrentTimestamp());
-    Serial.println("user time stamp: " + obj["subsEndInSec"].as<uint32_t>());
-    if (obj["userType"] == 1)
+    uint8_t pages = (MAX_CAPACITY + 255) / 256;
+    if (pages > SLOT_BITMAP_PAGES)
     {
-        return true;
+        pages = SLOT_BITMAP_PAGES;
     }
-    else if (obj["subsEndInSec"].as<uint32_t>() >= getCurrentTimestamp())
+
+    sensorSlots.clear();
+    for (uint8_t page = 0; page < pages; page++)
     {
-        return true;
+        uint8_t bits[FP_INDEX_PAGE_BYTES];
+        if (fingerprintSensor.readIndexPage(page, bits) != FINGERPRINT_OK)
+        {
+            Serial.printf("Failed to read sensor index table page %u\n", page);
+            sensorSlotsLoaded = false;
+            return false;
+        }
+        sensorSlots.loadPage(page, bits);
     }
-    return false;
+
+    sensorSlotsLoaded = true;
+    Serial.printf("Sensor slots in use: %u\n", sensorSlots.count());
+    return true;
 }
 
-uint8_t saveFingerprint(uint16_t id)
+struct SlotReconcileCtx
 {
-    Serial.print("Waiting for valid finger to enroll as #");
-    Serial.println(id);
-    int p = -1;
+    SlotBitmap memberSlots;
+    JsonArray missingTemplates;
+};
 
-    while (p != FINGERPRINT_OK)
+static bool reconcileMember(const MemberRecord &record, void *ctx)
+{
+    SlotReconcileCtx *reconcile = static_cast<SlotReconcileCtx *>(ctx);
+
+    uint16_t ids[] = {record.punchingId1, record.punchingId2};
+    for (uint16_t id : ids)
     {
-        p = finger.getImage();
-        switch (p)
+        if (id == 0)
         {
-        case FINGERPRINT_OK:
-            Serial.println("Image taken");
-            break;
-        case FINGERPRINT_NOFINGER:
-            Serial.print(".");
-            break;
-        case FINGERPRINT_PACKETRECIEVEERR:
-            Serial.println("Communication error");
-            break;
-        case FINGERPRINT_IMAGEFAIL:
-            Serial.println("Imaging error");
-            break;
-        default:
-            Serial.println("Unknown error");
-            break;
+            continue;
+        }
+        reconcile->memberSlots.set(id);
+        if (!sensorSlots.test(id))
+        {
+            reconcile->missingTemplates.add(id);
         }
     }
+    return true;
+}
 
-    // OK success!
+// Publish the slot bitmap and how it disagrees with the member store
+void reportSensorSlots()
+{
+    JsonDocument doc(&requestArena);
+    doc["type"] = "sensorSlots";
 
-    p = finger.image2Tz(1);
-    switch (p)
     {
-    case FINGERPRINT_OK:
-        Serial.println("Image converted");
-        break;
-    case FINGERPRINT_IMAGEMESS:
-        Serial.println("Image too messy");
-        return p;
-    case FINGERPRINT_PACKETRECIEVEERR:
-        Serial.println("Communication error");
-        return p;
-    case FINGERPRINT_FEATUREFAIL:
-        Serial.println("Could not find fingerprint features");
-        return p;
-    case FINGERPRINT_INVALIDIMAGE:
-        Serial.println("Could not find fingerprint features");
-        return p;
-    default:
-        Serial.println("Unknown error");
-        return p;
-    }
-
-    Serial.println("Remove finger");
-    delay(2000);
-    p = 0;
-    while (p != FINGERPRINT_NOFINGER)
-    {
-        p = finger.getImage();
-    }
-    Serial.print("ID ");
-    Serial.println(id);
-    p = -1;
-    Serial.println("Place same finger again");
-    while (p != FINGERPRINT_OK)
-    {
-        p = finger.getImage();
-        switch (p)
+        SensorLock lock;
+        if (!readSensorSlots())
         {
-        case FINGERPRINT_OK:
-            Serial.println("Image taken");
-            break;
-        case FINGERPRINT_NOFINGER:
-            Serial.print(".");
-            break;
-        case FINGERPRINT_PACKETRECIEVEERR:
-            Serial.println("Communication error");
-            break;
-        case FINGERPRINT_IMAGEFAIL:
-            Serial.println("Imaging error");
-            break;
-        default:
-            Serial.println("Unknown error");
-            break;
+            doc["status"] = 0;
+            doc["message"] = F_SEN_COMMU;
+            sendJsonResponse(doc);
+            return;
         }
     }
 
-    // OK success!
+    doc["status"] = 1;
+    doc["capacity"] = MAX_CAPACITY;
+    doc["used"] = sensorSlots.count();
 
-    p = finger.image2Tz(2);
-    switch (p)
+    // Hex dump, byte i bit j is slot i * 8 + j
+    char hex[SLOT_BITMAP_BITS / 4 + 1];
+    size_t bytes = (MAX_CAPACITY + 7) / 8;
+    if (bytes > sensorSlots.sizeBytes())
     {
-    case FINGERPRINT_OK:
-        Serial.println("Image converted");
-        break;
-    case FINGERPRINT_IMAGEMESS:
-        Serial.println("Image too messy");
-        return p;
-    case FINGERPRINT_PACKETRECIEVEERR:
-        Serial.println("Communication error");
-        return p;
-    case FINGERPRINT_FEATUREFAIL:
-        Serial.println("Could not find fingerprint features");
-        return p;
-    case FINGERPRINT_INVALIDIMAGE:
-        Serial.println("Could not find fingerprint features");
-        return p;
-    default:
-        Serial.println("Unknown error");
-        return p;
-    }
-
-    // OK converted!
-    Serial.print("Creating model for #");
-    Serial.println(id);
+        bytes = sensorSlots.sizeBytes();
+    }
+    for (size_t i = 0; i < bytes; i++)
+    {
+        snprintf(&hex[i * 2], 3, "%02x", sensorSlots.bytes()[i]);
+    }
+    hex[bytes * 2] = '\0';
+    doc["bitmap"] = hex;
+
+    // Members whose template is gone, and templates nobody owns
+    SlotReconcileCtx ctx;
+    ctx.missingTemplates = doc["missingTemplates"].to<JsonArray>();
+    memberStore.forEach(reconcileMember, &ctx);
 
-    p = finger.createModel();
-    if (p == FINGERPRINT_OK)
+    JsonArray orphanTemplates = doc["orphanTemplates"].to<JsonArray>();
+    for (uint16_t id = 1; id < MAX_CAPACITY; id++)
     {
-        Serial.println("Prints matched!");
+        if (sensorSlots.test(id) && !ctx.memberSlots.test(id))
+        {
+            orphanTemplates.add(id);
+        }
     }
-    else if (p == FINGERPRINT_PACKETRECIEVEERR)
+
+    sendJsonResponse(doc);
+}
+
+// Add one stored member to the in-RAM index
+void indexMember(const MemberRecord &record)
+{
+    portENTER_CRITICAL(&memberIndexLock);
+    memberIndex.put(record.punchingId1, record.userId, record.userType, record.subsEndInSec);
+    if (record.punchingId2 != 0)
     {
-        Serial.println("Communication error");
-        return p;
+        memberIndex.put(record.punchingId2, record.userId, record.userType, record.subsEndInSec);
     }
-    else if (p == FINGERPRINT_ENROLLMISMATCH)
+    portEXIT_CRITICAL(&memberIndexLock);
+}
+
+// Build the punching ID index from the member store once at boot
+bool loadMemberIndex()
+{
+    if (!memberIndex.begin(MAX_CAPACITY))
     {
-        Serial.println("Fingerprints did not match");
-        return p;
+        Serial.println("Failed to allocate member index");
+        return false;
     }
-    else
+
+    MemberStoreStatus status = memberStore.forEach([](const MemberRecord &record, void *) -> bool
+                                                   {
+        indexMember(record);
+        return true; }, nullptr);
+
+    if (status != MEMBER_STORE_OK)
     {
-        Serial.println("Unknown error");
-        return p;
+        Serial.println("Failed to read members file");
+        return false;
     }
 
-    Serial.print("ID ");
-    Serial.println(id);
-    p = finger.storeModel(id);
-    if (p == FINGERPRINT_OK)
+    Serial.printf("Member index loaded: %u entries\n", memberIndex.count());
+    return true;
+}
+
+// Open /members.bin, creating it (and converting a legacy members.json) if needed
+bool setupMemberStore()
+{
+    MemberStoreStatus status = memberStore.begin(MAX_CAPACITY);
+    if (status == MEMBER_STORE_ERR_FORMAT)
     {
-        Serial.println("Stored!");
+        Serial.println("Members file has an unknown format, recreating it");
+        status = memberStore.format(MAX_CAPACITY);
     }
-    else if (p == FINGERPRINT_PACKETRECIEVEERR)
+
+    if (status != MEMBER_STORE_OK)
     {
-        Serial.println("Communication error");
-        return p;
+        Serial.printf("Failed to open members file: %d\n", status);
+        return false;
     }
-    else if (p == FINGERPRINT_BADLOCATION)
+
+    if (SPIFFS.exists("/members.json"))
     {
-        Serial.println("Could not store in that location");
-        return p;
+        migrateMembersJson();
     }
-    else if (p == FINGERPRINT_FLASHERR)
+    return true;
+}
+
+// One-time converter from the old members.json array to the record store
+bool migrateMembersJson()
+{
+    JsonDocument doc;
+    if (!loadJsonFromFile(doc, "/members.json"))
     {
-        Serial.println("Error writing to flash");
-        return p;
+        return false;
     }
-    else
+
+    uint16_t converted = 0;
+    for (JsonObjectConst member : doc.as<JsonArrayConst>())
     {
-        Serial.println("Unknown error");
-        return p;
+        MemberRecord record;
+        if (!memberRecordFromJson(member, record) || memberStore.write(record) != MEMBER_STORE_OK)
+        {
+            Serial.println("Skipping member: " + member["userId"].as<String>());
+            continue;
+        }
+        converted++;
     }
 
+    SPIFFS.rename("/members.json", "/members.json.bak");
+    Serial.printf("Converted %u members from members.json\n", converted);
     return true;
 }
 
-uint16_t getNextAvailableID()
+// Seconds from the software clock, 0 until the RTC or NTP has set it
+uint32_t getCurrentTimestamp()
 {
-    // Get last used ID from Preferences, default to 0 if not set
-    uint16_t lastUsedID = nvs.getUShort("lastUsedID", 0);
+    return systemTime.unixTime();
+}
 
-    // Get current template count
-    if (finger.getTemplateCount() != FINGERPRINT_OK)
+// Edge search state: the RTC only counts whole seconds, so its time is
+// pinned down to the instant its seconds register changes
+static bool rtcEdgeSearching = false;
+static uint32_t rtcEdgeSearchStart = 0;
+static uint32_t rtcLastSample = 0;
+static uint8_t rtcLastSecond = 0;
+static uint64_t rtcLastReadUs = 0;
+// NTP found the RTC off; it is rewritten from that NTP sample on the next
+// second boundary, before it is trusted again
+static bool rtcStale = false;
+static int64_t rtcRewriteRefUs = 0;
+static uint64_t rtcRewriteAtUs = 0;
+
+void setupSystemTime()
+{
+    if (!rtcInitialized)
     {
-        responseCode = F_SEN_COMMU;
-        return 0; // Error: Cannot communicate with sensor
+        Serial.println("No RTC, time stays unknown until NTP");
+        return;
     }
 
-    // Check if storage is full
-    if (finger.templateCount >= MAX_CAPACITY)
+    // Somewhere inside the current second, the first edge search narrows it down
+    DateTime now = rtc.now();
+    systemTime.discipline((int64_t)now.unixtime() * 1000000 + 500000, systemClock.micros64(), 500000);
+    Serial.printf("System time set from RTC: %u\n", now.unixtime());
+}
+
+// A clock that far ahead has stamped punches in the future, tell the server
+static void reportClockStepBack(const char *source)
+{
+    AllocScope allocs(METRIC_ALLOC_TELEMETRY);
+    long long aheadS = -systemTime.lastOffsetUs() / 1000000;
+    Serial.printf("WARNING: Clock was %lld s ahead of %s, stepped back\n", aheadS, source);
+
+    JsonDocument doc(&requestArena);
+    doc["type"] = "clockStepBack";
+    doc["source"] = source;
+    doc["aheadSeconds"] = aheadS;
+    doc["timestamp"] = getCurrentTimestamp();
+    queueJsonResponse(doc);
+}
+
+// Write the RTC on a second boundary of the NTP time, so its second edges
+// line up with NTP while the software clock is still slewing towards it
+static void rewriteRtc()
+{
+    int64_t ntpNowUs = rtcRewriteRefUs + (int64_t)(systemClock.micros64() - rtcRewriteAtUs);
+    if (ntpNowUs % 1000000 > SYSTIME_EDGE_POLL_MS * 1000)
     {
-        responseCode = F_SEN_FULL;
-        return 0; // Error: Sensor storage is full
+        return;
+    }
+
+    rtc.adjust(DateTime((uint32_t)(ntpNowUs / 1000000)));
+    systemTime.resetDriftBaseline();
+    rtcStale = false;
+    rtcEdgeSearching = false;
+    rtcLastSample = millis();
+    Serial.println("RTC rewritten from NTP");
+}
+
+void serviceSystemTime()
+{
+    if (!rtcInitialized)
+    {
+        return;
+    }
+    if (rtcStale)
+    {
+        rewriteRtc();
+        return;
+    }
+
+    uint32_t now = millis();
+    uint64_t nowUs = systemClock.micros64();
+    if (!rtcEdgeSearching)
+    {
+        if (rtcLastSample != 0 && now - rtcLastSample < SYSTIME_RTC_SAMPLE_MS)
+        {
+            return;
+        }
+        rtcEdgeSearching = true;
+        rtcEdgeSearchStart = now;
+        rtcLastSecond = rtc.now().second();
+        rtcLastReadUs = nowUs;
+        return;
     }
 
-    if (lastUsedID < MAX_CAPACITY - 1)
+    if (nowUs - rtcLastReadUs < SYSTIME_EDGE_POLL_MS * 1000)
     {
-        // Update lastUsedID in Preferences
-        return lastUsedID + 1;
+        return;
     }
 
-    // Step 1: Scan for gaps (unused IDs) from 1 to lastUsedID
-    for (uint16_t id = 1; id <= lastUsedID; id++)
+    DateTime rtcNow = rtc.now();
+    uint64_t readUs = systemClock.micros64();
+    if (rtcNow.second() != rtcLastSecond)
     {
-        if (finger.loadModel(id) == FINGERPRINT_BADLOCATION)
+        // The edge fell between the two reads
+        uint64_t windowUs = readUs - rtcLastReadUs;
+        if (windowUs <= 2 * SYSTIME_EDGE_TOLERANCE_US)
         {
-            // Found an unused ID
-            return id;
+            SystemTimeAdjust adjust = systemTime.discipline((int64_t)rtcNow.unixtime() * 1000000,
+                                                            rtcLastReadUs + windowUs / 2, windowUs / 2);
+            if (adjust == TIME_ADJUST_STEP_BACK)
+            {
+                reportClockStepBack("RTC");
+            }
+            else if (adjust != TIME_ADJUST_NONE)
+            {
+                Serial.printf("RTC offset %lld us, drift %d ppb\n", (long long)systemTime.lastOffsetUs(), systemTime.driftPpb());
+            }
+            rtcEdgeSearching = false;
+            rtcLastSample = now;
+            return;
         }
+        rtcLastSecond = rtcNow.second();
     }
+    rtcLastReadUs = readUs;
 
-    return 0;
+    if (now - rtcEdgeSearchStart > SYSTIME_EDGE_SEARCH_MS)
+    {
+        // loop() too slow to catch the edge closely, try again next period
+        rtcEdgeSearching = false;
+        rtcLastSample = now;
+    }
 }
 
-// Placeholder for getting user_id from bio_id
-int getIndexByBioId(uint16_t bio_id, JsonDocument &doc)
+// NTP checks the software clock once per TIME_SYNC_DELAY. An offset is
+// slewed, and the RTC is rewritten from the NTP sample right away.
+void syncRTCWithNTP()
 {
-    JsonArray userArr = doc.as<JsonArray>();
+    if (!wifiConnected)
+    {
+        return;
+    }
 
-    for (int i = 0; i < userArr.size(); i++)
+    if (timeClient.update())
     {
-        JsonObject user = userArr[i];
-        if (user["punchingId1"] == bio_id || user["punchingId2"] == bio_id)
+        uint64_t atUs = systemClock.micros64();
+        // NTPClient truncates to whole seconds, take the middle of that second
+        int64_t ntpUs = (int64_t)timeClient.getEpochTime() * 1000000 + 500000;
+
+        SystemTimeAdjust adjust = systemTime.discipline(ntpUs, atUs, SYSTIME_NTP_TOLERANCE_US);
+        Serial.printf("NTP offset %lld ms\n", (long long)(systemTime.lastOffsetUs() / 1000));
+
+        if (adjust == TIME_ADJUST_STEP_BACK)
+        {
+            reportClockStepBack("NTP");
+        }
+        if (adjust != TIME_ADJUST_NONE && rtcInitialized)
         {
-            return i;
+            rtcStale = true;
+            rtcRewriteRefUs = ntpUs;
+            rtcRewriteAtUs = atUs;
         }
     }
-    return -1;
 }
 
-// Placeholder for getting current timestamp
-uint32_t getCurrentTimestamp()
+void printSystemTime()
 {
-    if (rtcInitialized)
+    int64_t nowMs = systemTime.nowMs();
+    Serial.printf("Current timestamp: %lld.%03lld\n", (long long)(nowMs / 1000), (long long)(nowMs % 1000));
+    Serial.printf("Samples: %u, slews: %u, steps: %u, steps back: %u\n", systemTime.samples(), systemTime.slews(),
+                  systemTime.steps(), systemTime.stepBacks());
+    Serial.printf("Last offset: %lld us, slew left: %lld us, drift: %d ppb\n", (long long)systemTime.lastOffsetUs(),
+                  (long long)systemTime.slewRemainingUs(), systemTime.driftPpb());
+    Serial.printf("RTC: %s\n", !rtcInitialized ? "missing" : rtcStale ? "waiting to be rewritten" : "in use");
+}
+
+// p50/p95/p99 of every traced stage, in microseconds
+void printLatencyReport()
+{
+#if LATENCY_TRACE
+    Serial.println("Stage          count      p50      p95      p99      max (us)");
+    for (uint8_t i = 0; i < TRACE_STAGE_COUNT; i++)
     {
-        DateTime now = rtc.now();
-        return now.unixtime();
+        const LatencyHistogram &stage = latencyTrace.stage((TraceStage)i);
+        Serial.printf("%-12s %7u %8u %8u %8u %8u\n", LatencyTrace::stageName((TraceStage)i), stage.count(),
+                      stage.percentile(50), stage.percentile(95), stage.percentile(99), stage.max());
     }
-    return 0;
+#else
+    Serial.println("Latency tracing is disabled (build with -D LATENCY_TRACE=1)");
+#endif
 }
 
-uint32_t dateStringToSeconds(String dateString)
+void publishLatencyReport()
 {
-    // Remove 'T' and everything after it (time portion)
-    int tIndex = dateString.indexOf('T');
-    if (tIndex != -1)
+#if LATENCY_TRACE
+    if (!topics.registered())
+    {
+        return;
+    }
+
+    AllocScope allocs(METRIC_ALLOC_TELEMETRY);
+    JsonDocument doc(&requestArena);
+    doc["type"] = "latency";
+    doc["timeStamp"] = getCurrentTimestamp();
+
+    JsonObject stages = doc["stages"].to<JsonObject>();
+    for (uint8_t i = 0; i < TRACE_STAGE_COUNT; i++)
     {
-        dateString = dateString.substring(0, tIndex);
+        const LatencyHistogram &histogram = latencyTrace.stage((TraceStage)i);
+        if (histogram.count() == 0)
+        {
+            continue;
+        }
+
+        JsonObject stage = stages[LatencyTrace::stageName((TraceStage)i)].to<JsonObject>();
+        stage["n"] = histogram.count();
+        stage["p50"] = histogram.percentile(50);
+        stage["p95"] = histogram.percentile(95);
+        stage["p99"] = histogram.percentile(99);
+        stage["max"] = histogram.max();
     }
 
-    // Parse year, month, day
-    int year = dateString.substring(0, 4).toInt();
-    int month = dateString.substring(5, 7).toInt();
-    int day = dateString.substring(8, 10).toInt();
+    publishJson(topics.get(TOPIC_TELEMETRY), doc);
+#endif
+}
+
+// Encoded size and encode time of one message, averaged over a few runs
+static void compareWireMessage(const char *type, const JsonDocument &doc)
+{
+    const uint8_t runs = 50;
+    uint8_t buffer[MQTT_MAX_BUFFER_SIZE];
+    size_t sizes[3];
+    uint32_t times[3];
 
-    // Validate parsed values
-    if (year < 1970 || year > 2100 || month < 1 || month > 12 || day < 1 || day > 31)
+    for (uint8_t format = 0; format < 3; format++)
     {
-        Serial.println("Invalid date format!");
-        return 0;
+        uint32_t start = micros();
+        for (uint8_t i = 0; i < runs; i++)
+        {
+            if (format == 0)
+                sizes[0] = serializeJsonPretty(doc, (char *)buffer, sizeof(buffer));
+            else
+                sizes[format] = wireSerialize(doc, format == 1 ? WIRE_JSON : WIRE_MSGPACK, buffer, sizeof(buffer));
+        }
+        times[format] = (micros() - start) / runs;
     }
 
-    // Create DateTime object with time set to 00:00:00
-    DateTime dt(year, month, day, 0, 0, 0);
+    Serial.printf("%-14s %6u %6u %6u  %6u %6u %6u\n", type, sizes[0], sizes[1], sizes[2],
+                  times[0], times[1], times[2]);
+}
+
+// Pretty JSON (the old format), compact JSON and MessagePack side by side
+// for each message the device sends
+void printWireComparison()
+{
+    uint32_t now = getCurrentTimestamp();
+    Serial.printf("Payload encoding: %s\n", wireEncodingName(wireEncoding));
+    Serial.println("Message         bytes: pretty  json msgpack   us: pretty  json msgpack");
+
+    JsonDocument doc;
+    doc["type"] = "attendance";
+    doc["user_id"] = "EMP-000123";
+    doc["punchingId"] = 123;
+    doc["timestamp"] = now;
+    doc["status"] = "IN";
+    doc["seq"] = outbox.nextSeq();
+    compareWireMessage("attendance", doc);
+
+    doc.clear();
+    doc["type"] = "accessDenied";
+    doc["punchingId"] = 123;
+    doc["timestamp"] = now;
+    doc["seq"] = outbox.nextSeq();
+    compareWireMessage("accessDenied", doc);
+
+    doc.clear();
+    doc["type"] = "enrollProgress";
+    doc["userId"] = "EMP-000123";
+    doc["punchingId"] = 123;
+    doc["stage"] = Enrollment::stageName(ENROLL_DONE);
+    compareWireMessage("enrollProgress", doc);
+
+    doc.clear();
+    doc["type"] = "mqtt_status";
+    doc["message"] = 0;
+    doc["status"] = "success";
+    doc["encoding"] = wireEncodingName(wireEncoding);
+    doc["attempts"] = mqttReconnectAttempts;
+    doc["failures"] = mqttReconnectFailures;
+    doc["disconnectedMs"] = mqttDisconnectedMs;
+    compareWireMessage("mqtt_status", doc);
+
+    // deviceInfo is streamed one record at a time, so one member stands in
+    doc.clear();
+    MemberRecord member = {};
+    strcpy(member.userId, "EMP-000123");
+    strcpy(member.name, "Member Name");
+    strcpy(member.subscriptionEnd, "2026-12-31T00:00:00.000Z");
+    member.subsEndInSec = 1798675200;
+    member.punchingId1 = 123;
+    memberRecordToJson(member, doc.to<JsonObject>());
+    compareWireMessage("member", doc);
+
+    doc = getSPIFFSStatus();
+    compareWireMessage("spiffsStatus", doc);
+
+#if LATENCY_TRACE
+    doc.clear();
+    doc["type"] = "latency";
+    doc["timeStamp"] = now;
+    JsonObject stages = doc["stages"].to<JsonObject>();
+    for (uint8_t i = 0; i < TRACE_STAGE_COUNT; i++)
+    {
+        JsonObject stage = stages[LatencyTrace::stageName((TraceStage)i)].to<JsonObject>();
+        stage["n"] = 1000;
+        stage["p50"] = 12000;
+        stage["p95"] = 48000;
+        stage["p99"] = 96000;
+        stage["max"] = 150000;
+    }
+    compareWireMessage("latency", doc);
+#endif
+}
 
-    // Return Unix timestamp
-    return dt.unixtime();
+// Share of the free heap that is not in the largest free block, in percent
+static uint8_t heapFragmentation(uint32_t freeHeap, uint32_t largestBlock)
+{
+    return freeHeap == 0 ? 0 : (uint8_t)(100 - (uint64_t)largestBlock * 100 / freeHeap);
 }
 
-void syncRTCWithNTP()
+void printMemoryInfo()
+{
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+
+    Serial.println("=== Memory Info ===");
+    Serial.printf("Free heap: %u bytes\n", freeHeap);
+    Serial.printf("Heap size: %u bytes\n", ESP.getHeapSize());
+    Serial.printf("Largest free block: %u bytes (%u%% fragmented)\n", largestBlock, heapFragmentation(freeHeap, largestBlock));
+    Serial.printf("Free PSRAM: %u bytes\n", ESP.getFreePsram());
+    Serial.printf("Min free heap: %u bytes\n", ESP.getMinFreeHeap());
+    Serial.printf("JSON arena: %u/%u bytes high water, %u allocations, %u spilled to heap\n",
+                  requestArena.highWater(), requestArena.capacity(), requestArena.allocations(), requestArena.spills());
+    Serial.printf("Member index: %u bytes, allocated at boot\n", memberIndex.capacity() * sizeof(MemberEntry));
+    Serial.println("==================");
+}
+
+// Warns on a low or fragmented heap and keeps one sample per hour
+void checkHeap()
 {
-    if (!wifiConnected || !rtcInitialized)
+    static uint32_t lastSample = 0;
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    uint8_t fragmentation = heapFragmentation(freeHeap, largestBlock);
+
+    if (freeHeap < HEAP_LOW_WARN_BYTES || fragmentation > HEAP_FRAGMENTATION_WARN)
+    {
+        Serial.println(freeHeap < HEAP_LOW_WARN_BYTES ? "WARNING: Low memory!" : "WARNING: Heap fragmented!");
+        printMemoryInfo();
+    }
+
+    if (heapHistoryCount > 0 && millis() - lastSample < HEAP_HISTORY_INTERVAL_MS)
     {
         return;
     }
+    lastSample = millis();
 
-    if (timeClient.update())
+    HeapSample &sample = heapHistory[heapHistoryNext];
+    sample.uptimeMin = millis() / 60000;
+    sample.freeHeap = freeHeap;
+    sample.largestBlock = largestBlock;
+    sample.minFreeHeap = ESP.getMinFreeHeap();
+    sample.arenaHighWater = requestArena.highWater();
+
+    heapHistoryNext = (heapHistoryNext + 1) % HEAP_HISTORY_SLOTS;
+    if (heapHistoryCount < HEAP_HISTORY_SLOTS)
+    {
+        heapHistoryCount++;
+    }
+}
+
+// Refreshes the gauges; stack marks are in bytes on the ESP32
+void sampleMetrics()
+{
+    metrics.set(METRIC_HEAP_FREE, ESP.getFreeHeap());
+    metrics.set(METRIC_HEAP_MIN, ESP.getMinFreeHeap());
+    metrics.set(METRIC_HEAP_LARGEST, ESP.getMaxAllocHeap());
+    metrics.set(METRIC_PSRAM_FREE, ESP.getFreePsram());
+    metrics.set(METRIC_PSRAM_SIZE, ESP.getPsramSize());
+
+    metrics.set(METRIC_STACK_LOOP, uxTaskGetStackHighWaterMark(nullptr));
+    if (fingerprintTaskHandle != nullptr)
+    {
+        metrics.set(METRIC_STACK_FINGERPRINT, uxTaskGetStackHighWaterMark(fingerprintTaskHandle));
+    }
+    if (mqttConnectTaskHandle != nullptr)
     {
-        Serial.print("Syncing RTC with NTP... ");
+        metrics.set(METRIC_STACK_MQTT, uxTaskGetStackHighWaterMark(mqttConnectTaskHandle));
+    }
 
-        unsigned long epochTime = timeClient.getEpochTime();
+    metrics.set(METRIC_ARENA_PEAK, requestArena.highWater());
+    metrics.set(METRIC_ARENA_SPILLS, requestArena.spills());
+}
 
-        // Convert to DateTime object
-        DateTime ntpTime = DateTime(epochTime);
+// {"type":"metrics","timeStamp":..,"up":..,"m":{"heap":..,..}} on the telemetry topic
+void publishMetrics()
+{
+    sampleMetrics();
 
-        // Get current RTC time for comparison
-        DateTime rtcTime = rtc.now();
+    AllocScope allocs(METRIC_ALLOC_TELEMETRY);
+    JsonDocument doc(&requestArena);
+    doc["type"] = "metrics";
+    doc["timeStamp"] = getCurrentTimestamp();
+    doc["up"] = millis() / 1000;
 
-        rtc.adjust(ntpTime);
+    JsonObject values = doc["m"].to<JsonObject>();
+    for (uint8_t i = 0; i < METRIC_COUNT; i++)
+    {
+        values[Metrics::name((MetricId)i)] = metrics.get((MetricId)i);
     }
+
+    publishJson(topics.get(TOPIC_TELEMETRY), doc);
 }
 
+void printStats()
+{
+    sampleMetrics();
+    for (uint8_t i = 0; i < METRIC_COUNT; i++)
+    {
+        Serial.printf("%-12s %10u%s\n", Metrics::name((MetricId)i), metrics.get((MetricId)i),
+                      Metrics::isCounter((MetricId)i) ? "" : " (gauge)");
+    }
+}
 
-void printMemoryInfo()
+void printHeapHistory()
 {
-    Serial.println("=== Memory Info ===");
-    Serial.println("Free heap: " + String(ESP.getFreeHeap()) + " bytes");
-    Serial.println("Heap size: " + String(ESP.getHeapSize()) + " bytes");
-    Serial.println("Free PSRAM: " + String(ESP.getFreePsram()) + " bytes");
-    Serial.println("Min free heap: " + String(ESP.getMinFreeHeap()) + " bytes");
-    Serial.println("==================");
+    Serial.println("Uptime min  free heap  largest block  frag %  min free  arena high water");
+    uint8_t first = (heapHistoryNext + HEAP_HISTORY_SLOTS - heapHistoryCount) % HEAP_HISTORY_SLOTS;
+    for (uint8_t i = 0; i < heapHistoryCount; i++)
+    {
+        const HeapSample &sample = heapHistory[(first + i) % HEAP_HISTORY_SLOTS];
+        Serial.printf("%10u %10u %14u %7u %9u %17u\n", sample.uptimeMin, sample.freeHeap, sample.largestBlock,
+                      heapFragmentation(sample.freeHeap, sample.largestBlock), sample.minFreeHeap, sample.arenaHighWater);
+    }
 }
 
 /*
@@ -1538,6 +2853,11 @@ void setup()
     Serial.println("Smart Bulb Starting...");
     printMemoryInfo(); // Check initial memory
 
+    sensorMutex = xSemaphoreCreateMutex();
+
+    // Relay off before anything slow happens
+    doorLock.begin();
+
     // Initialize SPIFFS
     if (!SPIFFS.begin(true))
     { 
@@ -1560,32 +2880,52 @@ void setup()
         Serial.println("RTC initialized successfully");
         rtcInitialized = true;
     }
+    setupSystemTime();
 
     setupAttendanceDir();
 
     // Initialize fingerprint sensor
     setupFPSensor();
+    readSensorSlots();
+    setupMemberStore();
+    loadMemberIndex();
+
+    if (outbox.begin(OUTBOX_SLOTS, OUTBOX_DROP_OLDEST))
+    {
+        Serial.printf("Outbox: %u messages waiting\n", outbox.pending());
+    }
+    else
+    {
+        Serial.println("Failed to open outbox");
+    }
     
     // Initialize nvs
     nvs.begin("UniManage", false);
 
+    loadTopics();
+    wireEncoding = nvs.getUChar("wireEnc", WIRE_JSON) == WIRE_MSGPACK ? WIRE_MSGPACK : WIRE_JSON;
+    Serial.printf("Payload encoding: %s\n", wireEncodingName(wireEncoding));
+
     // Initialize time client
     timeClient.begin();
 
-    if (nvs.getBool("haveWiFiCred", false))
+    // Door scanning runs on its own task from here on
+    startFingerprintTask();
+
+    // Both run in the background from here on, see serviceWiFi()/serviceMqtt()
+    setupWebServer();
+    setupMQTT();
+
+    uint8_t wifiEvents = wifiManager.begin();
+    if (wifiManager.state() == WIFI_MGR_UNCONFIGURED)
     {
-        // Try to load saved WiFi credentials
-        ssid = nvs.getString("ssid", "");
-        password = nvs.getString("password", "");
-        Serial.println("Found saved WiFi credentials");
-        Serial.println("SSID: " + ssid);
-        connectToWiFi();
+        Serial.println("No saved WiFi credentials found");
     }
     else
     {
-        Serial.println("No saved WiFi credentials found");
-        startSoftAP();
+        Serial.printf("Connecting to saved WiFi: %s\n", wifiManager.ssid());
     }
+    handleWiFiEvents(wifiEvents);
     
     printMemoryInfo(); // Check memory after initialization
 }
@@ -1597,32 +2937,27 @@ void loop()
     static unsigned long lastTimeSync = 0;
     
     server.handleClient();
-    
-    if (mqtt.connected())
+
+    serviceWiFi();
+    serviceMqtt();
+    if (mqttOnline())
     {
         mqtt.loop();
     }
 
-    checkFingerprint();
-
-    // Check WiFi connection status periodically
-    if (wifiConnected && WiFi.status() != WL_CONNECTED)
+    if (enrollment.active())
     {
-        Serial.println("WiFi connection lost! Starting SoftAP mode...");
-        wifiConnected = false;
-        startSoftAP();
+        serviceEnrollment();
     }
 
-    if (haveNewCommand)
-    {
-        haveNewCommand = false;
-        receiveFromMobile(incomingJSON);
-    }
+    processAccessEvents();
+    reportDoorAlarms();
+    drainOutbox();
 
-    if (WiFi.status() == WL_CONNECTED && !mqtt.connected())
-    {
-        reconnectMQTT();
-    }
+    dispatchCommands();
+    serviceMemberImport();
+
+    serviceSystemTime();
 
     // Sync time every 60 seconds
     if (millis() - lastTimeSync > 60000)
@@ -1632,16 +2967,29 @@ void loop()
     }
 
     // Check memory every 30 seconds
-    if (millis() - lastMemoryCheck > 30000)
+    if (millis() - lastMemoryCheck > HEAP_CHECK_INTERVAL_MS)
     {
-        if (ESP.getFreeHeap() < 10000) // Less than 10KB free
-        {
-            Serial.println("WARNING: Low memory!");
-            printMemoryInfo();
-        }
+        checkHeap();
         lastMemoryCheck = millis();
     }
 
+    static unsigned long lastMetricsPublish = 0;
+    if (millis() - lastMetricsPublish > METRICS_PUBLISH_INTERVAL_MS && mqttOnline() && topics.registered())
+    {
+        publishMetrics();
+        lastMetricsPublish = millis();
+    }
+
+#if LATENCY_TRACE
+    static unsigned long lastLatencyReport = 0;
+    // Held back while offline, the first pass after reconnecting sends it
+    if (millis() - lastLatencyReport > LATENCY_REPORT_INTERVAL_MS && mqttOnline() && topics.registered())
+    {
+        publishLatencyReport();
+        lastLatencyReport = millis();
+    }
+#endif
+
     if (Serial.available())
     {
         String Sdata = Serial.readStringUntil('\n');
@@ -1661,9 +3009,77 @@ void loop()
         {
             printMemoryInfo();
         }
+        else if (Sdata == "heap")
+        {
+            printHeapHistory();
+        }
+        else if (Sdata == "stats")
+        {
+            printStats();
+        }
+        else if (Sdata == "scan")
+        {
+            // Rates since the previous "scan" command
+            static uint32_t lastAt = 0, lastScans = 0, lastBusyUs = 0, lastTouches = 0;
+            uint32_t now = millis();
+            uint32_t scans = metrics.get(METRIC_FP_SCANS), busyUs = metrics.get(METRIC_FP_BUSY_US);
+            uint32_t touches = metrics.get(METRIC_FP_TOUCHES);
+            float seconds = (now - lastAt) / 1000.0;
+
+            Serial.printf("Scan task: %.1f polls/s, %.2f%% busy, %u touches over %.0f s\n",
+                          (scans - lastScans) / seconds, (busyUs - lastBusyUs) / (seconds * 10000.0),
+                          touches - lastTouches, seconds);
+            lastAt = now;
+            lastScans = scans;
+            lastBusyUs = busyUs;
+            lastTouches = touches;
+        }
+        else if (Sdata == "lock")
+        {
+            Serial.printf("Lock: %s, door %s, unlocks %u, forced opens %u\n",
+                          LockActuator::stateName(doorLock.state()), doorLock.doorOpen() ? "open" : "closed",
+                          doorLock.unlocks(), doorLock.forcedOpens());
+        }
+        else if (Sdata == "latency")
+        {
+            printLatencyReport();
+        }
+        else if (Sdata == "queue")
+        {
+            Serial.printf("Access events: depth %u/%u, peak %u, dropped %u\n",
+                          accessEvents.depth(), accessEvents.capacity(), accessEvents.peak(), accessEvents.drops());
+            Serial.printf("Outbox: pending %u, unsent %u, dropped %u\n",
+                          outbox.pending(), outbox.unsent(), outbox.dropped());
+            Serial.printf("Commands: depth %u/%u, peak %u, dropped %u, oversized %u\n",
+                          commandQueue.depth(), commandQueue.capacity(), commandQueue.peak(),
+                          commandQueue.dropped(), commandQueue.oversized());
+        }
+        else if (Sdata == "mqtt")
+        {
+            unsigned long offline = mqttLink == MQTT_LINK_ONLINE ? 0 : millis() - mqttDisconnectedSince;
+            Serial.printf("MQTT: state %d, attempts %u, failures %u, offline %u ms total, %lu ms now\n",
+                          mqttLink, mqttReconnectAttempts, mqttReconnectFailures, mqttDisconnectedMs, offline);
+        }
+        else if (Sdata == "http")
+        {
+            printHttpStats();
+        }
+        else if (Sdata == "wifi")
+        {
+            Serial.printf("WiFi: %s, AP %s, connect %u ms (%s), first after boot %u ms\n",
+                          WiFiManager::stateName(wifiManager.state()), wifiManager.apActive() ? "on" : "off",
+                          wifiManager.connectMs(), wifiManager.fastConnected() ? "fast" : "scan",
+                          wifiManager.bootConnectMs());
+            Serial.printf("WiFi: attempts %u, failures %u, drops %u, NVS writes %u\n", wifiManager.attempts(),
+                          wifiManager.failures(), wifiManager.drops(), wifiCache.writes());
+        }
+        else if (Sdata == "wire")
+        {
+            printWireComparison();
+        }
         else if (Sdata == "time")
         {
-            Serial.println("Current timestamp: " + String(getCurrentTimestamp()));
+            printSystemTime();
         }
     }
 }
\ No newline at end of file
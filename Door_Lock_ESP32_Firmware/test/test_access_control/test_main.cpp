@@ -0,0 +1,235 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "access_control.h"
+#include "attendance_journal.h"
+#include "member_index.h"
+#include "outbox.h"
+#include "sim_clock.h"
+#include "sim_fingerprint.h"
+#include "sim_fs.h"
+
+#define CAPACITY 32
+#define FINGER   0xF1
+#define STRANGER 0xF2
+#define SLOT     7
+#define DAY      86400
+
+static MemberIndex members;
+static SimClock simClock;
+
+static bool lookup(uint16_t punchingId, MemberEntry &entry, void *ctx)
+{
+    const MemberEntry *found = static_cast<MemberIndex *>(ctx)->find(punchingId);
+    if (found == nullptr)
+    {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+void setUp(void)
+{
+    simClock = SimClock();
+    members.begin(CAPACITY);
+    members.clear();
+}
+
+void tearDown(void) {}
+
+// A finger that stays on the glass for the whole scan
+static AccessResult scanFinger(AccessControl &access, SimFingerprintSensor &sensor, uint32_t finger,
+                               AccessDecision &decision)
+{
+    sensor.touch(finger, 1000);
+    AccessResult result = access.scan(decision);
+    simClock.advanceMs(2000);
+    return result;
+}
+
+void test_no_finger(void)
+{
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_NO_FINGER, access.scan(decision));
+    TEST_ASSERT_EQUAL(1, sensor.commands());
+}
+
+void test_granted(void)
+{
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    members.put(SLOT, "member-7", 0, simClock.unixTime() + DAY);
+    sensor.setTemplate(SLOT, FINGER);
+
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_GRANTED, scanFinger(access, sensor, FINGER, decision));
+    TEST_ASSERT_EQUAL(ACCESS_GRANTED, decision.result);
+    TEST_ASSERT_EQUAL(SLOT, decision.punchingId);
+    TEST_ASSERT_EQUAL_STRING("member-7", decision.member.userId);
+    TEST_ASSERT_EQUAL(3, sensor.commands());
+}
+
+// The subscription runs to the end of its last day, admins are never refused
+void test_expired_and_admin(void)
+{
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    members.put(SLOT, "member-7", 0, simClock.unixTime() - 1);
+    members.put(SLOT + 1, "admin-8", 1, 0);
+    sensor.setTemplate(SLOT, FINGER);
+    sensor.setTemplate(SLOT + 1, STRANGER);
+
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_DENIED, scanFinger(access, sensor, FINGER, decision));
+    TEST_ASSERT_EQUAL_STRING("member-7", decision.member.userId);
+    TEST_ASSERT_EQUAL(ACCESS_GRANTED, scanFinger(access, sensor, STRANGER, decision));
+
+    MemberEntry member = {};
+    member.subsEndInSec = 1000;
+    TEST_ASSERT_TRUE(AccessControl::authorize(member, 1000));
+    TEST_ASSERT_FALSE(AccessControl::authorize(member, 1001));
+}
+
+void test_unknown_finger_and_member(void)
+{
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    sensor.setTemplate(SLOT, FINGER);
+
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_NO_MATCH, scanFinger(access, sensor, STRANGER, decision));
+    // Template on the sensor, member deleted from the index
+    TEST_ASSERT_EQUAL(ACCESS_UNKNOWN_MEMBER, scanFinger(access, sensor, FINGER, decision));
+    TEST_ASSERT_EQUAL(SLOT, decision.punchingId);
+}
+
+// A UART error at each step maps to the result loop() acts on
+void test_sensor_errors(void)
+{
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    members.put(SLOT, "member-7", 0, simClock.unixTime() + DAY);
+    sensor.setTemplate(SLOT, FINGER);
+    AccessDecision decision;
+
+    sensor.failNext(FINGERPRINT_PACKETRECIEVEERR);
+    TEST_ASSERT_EQUAL(ACCESS_SENSOR_ERROR, scanFinger(access, sensor, FINGER, decision));
+
+    sensor.failNext(FINGERPRINT_OK);
+    sensor.failNext(FINGERPRINT_IMAGEMESS);
+    TEST_ASSERT_EQUAL(ACCESS_BAD_IMAGE, scanFinger(access, sensor, FINGER, decision));
+
+    sensor.failNext(FINGERPRINT_OK);
+    sensor.failNext(FINGERPRINT_OK);
+    sensor.failNext(FINGERPRINT_PACKETRECIEVEERR);
+    TEST_ASSERT_EQUAL(ACCESS_SENSOR_ERROR, scanFinger(access, sensor, FINGER, decision));
+
+    // Nothing stuck: the next scan goes through
+    TEST_ASSERT_EQUAL(ACCESS_GRANTED, scanFinger(access, sensor, FINGER, decision));
+}
+
+// A whole scan fits in the UART and processing time of its three commands
+void test_scan_latency(void)
+{
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    members.put(SLOT, "member-7", 0, simClock.unixTime() + DAY);
+    sensor.setTemplate(SLOT, FINGER);
+
+    sensor.touch(FINGER, 1000);
+    uint64_t start = simClock.elapsedUs();
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_GRANTED, access.scan(decision));
+    SimFingerprintTiming timing;
+    uint32_t work = timing.getImageUs + timing.image2TzUs + timing.searchUs;
+    TEST_ASSERT_UINT32_WITHIN(20000, work, (uint32_t)(simClock.elapsedUs() - start));
+}
+
+static bool countPunch(const AttendanceRecord &record, void *ctx)
+{
+    TEST_ASSERT_EQUAL(SLOT, record.punchingId);
+    (*static_cast<int *>(ctx))++;
+    return true;
+}
+
+// What processAccessEvents() does with each decision: a grant is punched
+// into the journal, IN then OUT, and both reach the outbox
+void test_decisions_reach_journal_and_outbox(void)
+{
+    RamFileSystem fs(simClock);
+    SimFingerprintSensor sensor(simClock, CAPACITY);
+    AccessControl access(sensor, simClock, lookup, &members);
+    AttendanceJournal journal(fs, "/attendance");
+    Outbox outbox(fs, "/outbox.bin");
+    TEST_ASSERT_TRUE(outbox.begin(8, true));
+    members.put(SLOT, "member-7", 0, simClock.unixTime() + DAY);
+    members.put(SLOT + 1, "member-8", 0, simClock.unixTime() - DAY);
+    sensor.setTemplate(SLOT, FINGER);
+    sensor.setTemplate(SLOT + 1, STRANGER);
+
+    const uint32_t fingers[] = {FINGER, STRANGER, FINGER};
+    for (uint32_t finger : fingers)
+    {
+        AccessDecision decision;
+        AccessResult result = scanFinger(access, sensor, finger, decision);
+        TEST_ASSERT_TRUE(result == ACCESS_GRANTED || result == ACCESS_DENIED);
+
+        char message[96];
+        int length;
+        if (result == ACCESS_GRANTED)
+        {
+            uint8_t direction = journal.nextDirection(decision.punchingId, decision.timestamp);
+            TEST_ASSERT_TRUE(journal.append(decision.punchingId, decision.timestamp, direction));
+            length = snprintf(message, sizeof(message), "{\"type\":\"attendance\",\"status\":\"%s\"}",
+                              direction == ATTENDANCE_OUT ? "OUT" : "IN");
+        }
+        else
+        {
+            length = snprintf(message, sizeof(message), "{\"type\":\"accessDenied\",\"punchingId\":%u}",
+                              decision.punchingId);
+        }
+        TEST_ASSERT_NOT_EQUAL(0, outbox.push(reinterpret_cast<const uint8_t *>(message), (uint16_t)length));
+        simClock.advanceMs(60000);
+    }
+
+    const char *expected[] = {"\"IN\"", "accessDenied", "\"OUT\""};
+    uint8_t payload[OUTBOX_PAYLOAD_LEN + 1];
+    uint16_t length;
+    uint32_t seq;
+    for (const char *text : expected)
+    {
+        TEST_ASSERT_TRUE(outbox.peek(payload, length, seq));
+        payload[length] = '\0';
+        TEST_ASSERT_NOT_NULL(strstr(reinterpret_cast<char *>(payload), text));
+        outbox.markSent(seq);
+    }
+    TEST_ASSERT_FALSE(outbox.peek(payload, length, seq));
+
+    int punches = 0;
+    TEST_ASSERT_TRUE(journal.forEachOfDay(simClock.unixTime(), countPunch, &punches));
+    TEST_ASSERT_EQUAL(2, punches);
+}
+
+void test_result_names(void)
+{
+    TEST_ASSERT_EQUAL_STRING("granted", AccessControl::resultName(ACCESS_GRANTED));
+    TEST_ASSERT_EQUAL_STRING("noMatch", AccessControl::resultName(ACCESS_NO_MATCH));
+    TEST_ASSERT_EQUAL_STRING("unknown", AccessControl::resultName((AccessResult)99));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_no_finger);
+    RUN_TEST(test_granted);
+    RUN_TEST(test_expired_and_admin);
+    RUN_TEST(test_unknown_finger_and_member);
+    RUN_TEST(test_sensor_errors);
+    RUN_TEST(test_scan_latency);
+    RUN_TEST(test_decisions_reach_journal_and_outbox);
+    RUN_TEST(test_result_names);
+    return UNITY_END();
+}
@@ -0,0 +1,264 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string>
+#include "attendance_journal.h"
+#include "civil_time.h"
+#include "sim_clock.h"
+#include "sim_fs.h"
+
+#define DAY       1735689600 // 2025-01-01
+#define DAY_PATH  "/attendance/20250101.bin"
+#define MEMBER_A  12
+#define MEMBER_B  40
+
+struct Replay
+{
+    AttendanceRecord records[64];
+    size_t count;
+};
+
+static bool collect(const AttendanceRecord &record, void *ctx)
+{
+    Replay &replay = *static_cast<Replay *>(ctx);
+    if (replay.count < 64)
+    {
+        replay.records[replay.count++] = record;
+    }
+    return true;
+}
+
+static Replay replayDay(AttendanceJournal &journal, uint32_t timestamp)
+{
+    Replay replay = {};
+    TEST_ASSERT_TRUE(journal.forEachOfDay(timestamp, collect, &replay));
+    return replay;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_day_path(void)
+{
+    RamFileSystem fs;
+    AttendanceJournal journal(fs, "/attendance");
+    char path[ATTENDANCE_PATH_LEN];
+    journal.dayPath(DAY + 86399, path, sizeof(path));
+    TEST_ASSERT_EQUAL_STRING(DAY_PATH, path);
+    journal.dayPath(DAY + 86400, path, sizeof(path));
+    TEST_ASSERT_EQUAL_STRING("/attendance/20250102.bin", path);
+}
+
+void test_append_and_replay(void)
+{
+    RamFileSystem fs;
+    AttendanceJournal journal(fs, "/attendance");
+    TEST_ASSERT_TRUE(journal.append(MEMBER_A, DAY + 100, ATTENDANCE_IN));
+    TEST_ASSERT_TRUE(journal.append(MEMBER_B, DAY + 200, ATTENDANCE_IN));
+    TEST_ASSERT_TRUE(journal.append(MEMBER_A, DAY + 300, ATTENDANCE_OUT));
+    TEST_ASSERT_TRUE(journal.append(MEMBER_A, DAY + 86400, ATTENDANCE_IN)); // Next day's file
+
+    TEST_ASSERT_EQUAL(3 * sizeof(AttendanceRecord), fs.size(DAY_PATH));
+    Replay replay = replayDay(journal, DAY);
+    TEST_ASSERT_EQUAL(3, replay.count);
+    TEST_ASSERT_EQUAL(MEMBER_A, replay.records[0].punchingId);
+    TEST_ASSERT_EQUAL_UINT32(DAY + 100, replay.records[0].timestamp);
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, replay.records[0].direction);
+    TEST_ASSERT_EQUAL(MEMBER_B, replay.records[1].punchingId);
+    TEST_ASSERT_EQUAL(ATTENDANCE_OUT, replay.records[2].direction);
+    TEST_ASSERT_EQUAL(1, replayDay(journal, DAY + 86400).count);
+    TEST_ASSERT_EQUAL(0, replayDay(journal, DAY + 2 * 86400).count);
+}
+
+void test_reopen_keeps_records(void)
+{
+    RamFileSystem fs;
+    {
+        AttendanceJournal journal(fs, "/attendance");
+        journal.append(MEMBER_A, DAY + 100, ATTENDANCE_IN);
+        journal.append(MEMBER_B, DAY + 200, ATTENDANCE_IN);
+    }
+
+    AttendanceJournal reopened(fs, "/attendance");
+    Replay replay = replayDay(reopened, DAY);
+    TEST_ASSERT_EQUAL(2, replay.count);
+    TEST_ASSERT_EQUAL(MEMBER_B, replay.records[1].punchingId);
+
+    TEST_ASSERT_TRUE(reopened.append(MEMBER_B, DAY + 300, ATTENDANCE_OUT));
+    TEST_ASSERT_EQUAL(3, replayDay(reopened, DAY).count);
+    TEST_ASSERT_EQUAL_UINT32(0, reopened.corruptRecords());
+}
+
+// Power cut in the middle of an append: the next one pads the partial
+// record so it and every later record stay aligned
+void test_truncated_record_is_padded(void)
+{
+    RamFileSystem fs;
+    AttendanceJournal journal(fs, "/attendance");
+    journal.append(MEMBER_A, DAY + 100, ATTENDANCE_IN);
+    journal.append(MEMBER_B, DAY + 200, ATTENDANCE_IN);
+    TEST_ASSERT_TRUE(fs.truncate(DAY_PATH, sizeof(AttendanceRecord) + 4));
+
+    AttendanceJournal reopened(fs, "/attendance");
+    TEST_ASSERT_EQUAL(1, replayDay(reopened, DAY).count);
+
+    TEST_ASSERT_TRUE(reopened.append(MEMBER_A, DAY + 300, ATTENDANCE_OUT));
+    TEST_ASSERT_TRUE(reopened.append(MEMBER_B, DAY + 400, ATTENDANCE_OUT));
+    TEST_ASSERT_EQUAL(4 * sizeof(AttendanceRecord), fs.size(DAY_PATH));
+
+    Replay replay = replayDay(reopened, DAY);
+    TEST_ASSERT_EQUAL(3, replay.count);
+    TEST_ASSERT_EQUAL_UINT32(DAY + 100, replay.records[0].timestamp);
+    TEST_ASSERT_EQUAL_UINT32(DAY + 300, replay.records[1].timestamp);
+    TEST_ASSERT_EQUAL_UINT32(DAY + 400, replay.records[2].timestamp);
+    TEST_ASSERT_GREATER_THAN(0, reopened.corruptRecords());
+}
+
+void test_corrupt_record_is_skipped(void)
+{
+    RamFileSystem fs;
+    AttendanceJournal journal(fs, "/attendance");
+    journal.append(MEMBER_A, DAY + 100, ATTENDANCE_IN);
+    journal.append(MEMBER_B, DAY + 200, ATTENDANCE_IN);
+    journal.append(MEMBER_A, DAY + 300, ATTENDANCE_OUT);
+
+    uint8_t flipped = 0x5A;
+    fs.writeAt(DAY_PATH, sizeof(AttendanceRecord) + 1, &flipped, 1);
+
+    Replay replay = replayDay(journal, DAY);
+    TEST_ASSERT_EQUAL(2, replay.count);
+    TEST_ASSERT_EQUAL_UINT32(DAY + 300, replay.records[1].timestamp);
+    TEST_ASSERT_EQUAL_UINT32(1, journal.corruptRecords());
+}
+
+void test_direction_alternates_per_member(void)
+{
+    RamFileSystem fs;
+    AttendanceJournal journal(fs, "/attendance");
+
+    uint8_t direction = journal.nextDirection(MEMBER_A, DAY + 100);
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, direction);
+    journal.append(MEMBER_A, DAY + 100, direction);
+
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, journal.nextDirection(MEMBER_B, DAY + 150));
+    journal.append(MEMBER_B, DAY + 150, ATTENDANCE_IN);
+
+    direction = journal.nextDirection(MEMBER_A, DAY + 200);
+    TEST_ASSERT_EQUAL(ATTENDANCE_OUT, direction);
+    journal.append(MEMBER_A, DAY + 200, direction);
+
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, journal.nextDirection(MEMBER_A, DAY + 300));
+    TEST_ASSERT_EQUAL(ATTENDANCE_OUT, journal.nextDirection(MEMBER_B, DAY + 300));
+
+    // A new day starts everyone outside
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, journal.nextDirection(MEMBER_B, DAY + 86400 + 10));
+}
+
+// After a reboot the direction comes from the day's file
+void test_direction_survives_restart(void)
+{
+    RamFileSystem fs;
+    {
+        AttendanceJournal journal(fs, "/attendance");
+        journal.append(MEMBER_A, DAY + 100, journal.nextDirection(MEMBER_A, DAY + 100));
+        journal.append(MEMBER_B, DAY + 150, journal.nextDirection(MEMBER_B, DAY + 150));
+        journal.append(MEMBER_B, DAY + 200, journal.nextDirection(MEMBER_B, DAY + 200));
+    }
+
+    AttendanceJournal reopened(fs, "/attendance");
+    TEST_ASSERT_EQUAL(ATTENDANCE_OUT, reopened.nextDirection(MEMBER_A, DAY + 300));
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, reopened.nextDirection(MEMBER_B, DAY + 300));
+
+    // Only the first punch of the day replays the file
+    uint32_t ops = fs.operations();
+    reopened.append(MEMBER_A, DAY + 300, ATTENDANCE_OUT);
+    uint32_t appendOps = fs.operations() - ops;
+    ops = fs.operations();
+    TEST_ASSERT_EQUAL(ATTENDANCE_IN, reopened.nextDirection(MEMBER_A, DAY + 400));
+    TEST_ASSERT_EQUAL_UINT32(0, fs.operations() - ops);
+    TEST_ASSERT_LESS_OR_EQUAL(2, appendOps);
+}
+
+// The logAttendance() the journal replaced: read the day's JSON array, add
+// one object and write the whole file back. Same bytes as its
+// serializeJson() output, so only the flash access pattern is compared.
+static bool appendJsonDay(RamFileSystem &fs, const char *userId, uint32_t timestamp, const char *status)
+{
+    CivilDate date = civilFromDays(timestamp / 86400);
+    uint32_t second = timestamp % 86400;
+    char path[40];
+    char record[128];
+    snprintf(path, sizeof(path), "/attendance/%04d-%02u-%02u.json", (int)date.year, (unsigned)date.month,
+             (unsigned)date.day);
+    snprintf(record, sizeof(record),
+             "{\"user_id\":\"%s\",\"timestamp\":\"%04d-%02u-%02u %02u:%02u:%02u\",\"status\":\"%s\"}", userId,
+             (int)date.year, (unsigned)date.month, (unsigned)date.day, second / 3600, second / 60 % 60,
+             second % 60, status);
+
+    std::string text;
+    if (fs.exists(path))
+    {
+        text.resize(fs.size(path));
+        fs.readAt(path, 0, &text[0], text.size());
+    }
+    if (text.size() < 2)
+    {
+        text = std::string("[") + record + "]";
+    }
+    else
+    {
+        text.insert(text.size() - 1, std::string(",") + record);
+    }
+    return fs.create(path) && fs.append(path, text.data(), text.size()) == text.size();
+}
+
+// A busy day on one door, timed against the simulated SPIFFS costs
+void test_benchmark_against_json_rewrite(void)
+{
+    const uint32_t punches = 400;
+    char message[160];
+
+    SimClock jsonClock;
+    RamFileSystem jsonFs(jsonClock);
+    for (uint32_t i = 0; i < punches; i++)
+    {
+        char userId[24];
+        snprintf(userId, sizeof(userId), "member-%03u", i % 150);
+        TEST_ASSERT_TRUE(appendJsonDay(jsonFs, userId, DAY + 21600 + i * 90, i % 2 == 0 ? "IN" : "OUT"));
+    }
+
+    SimClock clock;
+    RamFileSystem fs(clock);
+    AttendanceJournal journal(fs, "/attendance");
+    for (uint32_t i = 0; i < punches; i++)
+    {
+        uint16_t punchingId = 1 + i % 150;
+        uint32_t timestamp = DAY + 21600 + i * 90;
+        TEST_ASSERT_TRUE(journal.append(punchingId, timestamp, journal.nextDirection(punchingId, timestamp)));
+    }
+
+    double jsonUs = (double)jsonClock.elapsedUs() / punches;
+    double journalUs = (double)clock.elapsedUs() / punches;
+    snprintf(message, sizeof(message), "json rewrite: %.0f punches/s, %.0f bytes written/punch",
+             1e6 / jsonUs, (double)jsonFs.bytesWritten() / punches);
+    TEST_MESSAGE(message);
+    snprintf(message, sizeof(message), "journal:      %.0f punches/s, %.0f bytes written/punch",
+             1e6 / journalUs, (double)fs.bytesWritten() / punches);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(punches * sizeof(AttendanceRecord), fs.bytesWritten());
+    TEST_ASSERT_LESS_THAN_UINT32((uint32_t)(jsonClock.elapsedUs() / 10), (uint32_t)clock.elapsedUs());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_day_path);
+    RUN_TEST(test_append_and_replay);
+    RUN_TEST(test_reopen_keeps_records);
+    RUN_TEST(test_truncated_record_is_padded);
+    RUN_TEST(test_corrupt_record_is_skipped);
+    RUN_TEST(test_direction_alternates_per_member);
+    RUN_TEST(test_direction_survives_restart);
+    RUN_TEST(test_benchmark_against_json_rewrite);
+    return UNITY_END();
+}
@@ -0,0 +1,90 @@
+#include <unity.h>
+#include <random>
+#include "backoff.h"
+
+// MQTT reconnect values from the firmware's config.h
+#define BASE_MS 1000
+#define MAX_MS  60000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Each delay lies in [window / 2, window], the window doubles up to the cap
+void test_window_doubles_to_cap(void)
+{
+    Backoff low(BASE_MS, MAX_MS);
+    Backoff high(BASE_MS, MAX_MS);
+    uint32_t window = BASE_MS;
+    for (int attempt = 0; attempt < 12; attempt++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(window / 2, low.next(0));
+        TEST_ASSERT_EQUAL_UINT32(window, high.next(window / 2));
+        window = window * 2 > MAX_MS ? MAX_MS : window * 2;
+    }
+    TEST_ASSERT_EQUAL(12, low.attempts());
+}
+
+void test_reset(void)
+{
+    Backoff backoff(BASE_MS, MAX_MS);
+    for (int i = 0; i < 5; i++)
+    {
+        backoff.next(0);
+    }
+    backoff.reset();
+    TEST_ASSERT_EQUAL(0, backoff.attempts());
+    TEST_ASSERT_EQUAL_UINT32(BASE_MS / 2, backoff.next(0));
+}
+
+// Hundreds of failures in a row: the counter stops, the delay stays capped
+void test_long_outage_saturates(void)
+{
+    Backoff backoff(BASE_MS, MAX_MS);
+    for (int i = 0; i < 1000; i++)
+    {
+        uint32_t delay = backoff.next(i * 7919u);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_MS, delay);
+    }
+    TEST_ASSERT_EQUAL(255, backoff.attempts());
+    TEST_ASSERT_EQUAL_UINT32(MAX_MS / 2, backoff.next(0));
+}
+
+// A fleet that lost the broker together: after a few failures the retries
+// are spread over half the window instead of landing in the same second
+void test_fleet_is_spread(void)
+{
+    const int devices = 1000;
+    const int attempts = 6;
+    std::mt19937 random(42);
+    uint32_t buckets[MAX_MS / 1000 + 1] = {};
+
+    for (int device = 0; device < devices; device++)
+    {
+        Backoff backoff(BASE_MS, MAX_MS);
+        uint32_t delay = 0;
+        for (int attempt = 0; attempt < attempts; attempt++)
+        {
+            delay = backoff.next(random());
+        }
+        buckets[delay / 1000]++;
+    }
+
+    // Sixth window is 32 s: delays fall in 16..32 s, about 60 per second
+    uint32_t busiest = 0;
+    for (uint32_t count : buckets)
+    {
+        busiest = count > busiest ? count : busiest;
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, buckets[15]);
+    TEST_ASSERT_LESS_THAN_UINT32(devices / 8, busiest);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_window_doubles_to_cap);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_long_outage_saturates);
+    RUN_TEST(test_fleet_is_spread);
+    return UNITY_END();
+}
@@ -0,0 +1,190 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "civil_time.h"
+
+#define FIRST_DAY  0     // 1970-01-01
+#define LAST_DAY   47846 // 2100-12-31
+#define TIME_OFFSET 19800
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// The parser the firmware used before civil_time: String slicing and
+// RTClib's DateTime, ported with std::string and RTClib's date2days()
+static const uint8_t rtcDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30};
+
+static uint32_t oldDateStringToSeconds(std::string dateString)
+{
+    size_t tIndex = dateString.find('T');
+    if (tIndex != std::string::npos)
+    {
+        dateString = dateString.substr(0, tIndex);
+    }
+
+    int year = atoi(dateString.substr(0, 4).c_str());
+    int month = atoi(dateString.substr(5, 2).c_str());
+    int day = atoi(dateString.substr(8, 2).c_str());
+    if (year < 1970 || year > 2100 || month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        return 0;
+    }
+
+    uint16_t y = year >= 2000 ? year - 2000 : year;
+    uint16_t days = day;
+    for (int i = 1; i < month; i++)
+    {
+        days += rtcDaysInMonth[i - 1];
+    }
+    if (month > 2 && y % 4 == 0)
+    {
+        days++;
+    }
+    days += 365 * y + (y + 3) / 4 - 1;
+    return days * 86400UL + 946684800UL;
+}
+
+static void formatDay(char *text, size_t size, const CivilDate &date, bool extended)
+{
+    snprintf(text, size, extended ? "%04d-%02u-%02u" : "%04d%02u%02u", (int)date.year, date.month, date.day);
+}
+
+// Every day from 1970 to 2100 converts both ways and follows the one before
+void test_every_day_round_trips(void)
+{
+    CivilDate previous = civilFromDays(FIRST_DAY - 1);
+    TEST_ASSERT_EQUAL_INT32(1969, previous.year);
+    for (int32_t days = FIRST_DAY; days <= LAST_DAY; days++)
+    {
+        CivilDate date = civilFromDays(days);
+        TEST_ASSERT_EQUAL_INT32(days, daysFromCivil(date.year, date.month, date.day));
+        TEST_ASSERT_TRUE(date.day >= 1 && date.day <= daysInMonth(date.year, date.month));
+
+        if (date.day > 1)
+        {
+            TEST_ASSERT_EQUAL_INT32(previous.year, date.year);
+            TEST_ASSERT_EQUAL_UINT8(previous.month, date.month);
+            TEST_ASSERT_EQUAL_UINT8(previous.day + 1, date.day);
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL_UINT8(daysInMonth(previous.year, previous.month), previous.day);
+            TEST_ASSERT_EQUAL_UINT8(previous.month == 12 ? 1 : previous.month + 1, date.month);
+        }
+        previous = date;
+    }
+    TEST_ASSERT_EQUAL_INT32(2100, previous.year);
+    TEST_ASSERT_EQUAL_UINT8(12, previous.month);
+    TEST_ASSERT_EQUAL_UINT8(31, previous.day);
+}
+
+// Both ISO spellings of every day, bare and with a time and offset
+void test_every_day_parses(void)
+{
+    char text[40];
+    for (int32_t days = FIRST_DAY; days <= LAST_DAY; days++)
+    {
+        CivilDate date = civilFromDays(days);
+        uint32_t dayStart = (uint32_t)days * 86400;
+
+        formatDay(text, sizeof(text), date, true);
+        TEST_ASSERT_EQUAL_UINT32(dayStart, isoDayStart(text, TIME_OFFSET));
+        formatDay(text, sizeof(text), date, false);
+        TEST_ASSERT_EQUAL_UINT32(dayStart, isoDayStart(text, TIME_OFFSET));
+
+        // 12:00 local, written as UTC
+        formatDay(text, sizeof(text), date, true);
+        strcat(text, "T06:30:00.250Z");
+        TEST_ASSERT_EQUAL_UINT32(dayStart, isoDayStart(text, TIME_OFFSET));
+    }
+}
+
+// Same answer as the old parser wherever RTClib could represent the date
+void test_matches_old_parser(void)
+{
+    char text[40];
+    for (int32_t days = daysFromCivil(2000, 1, 1); days < daysFromCivil(2100, 1, 1); days++)
+    {
+        formatDay(text, sizeof(text), civilFromDays(days), true);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(oldDateStringToSeconds(text), isoDayStart(text, 0), text);
+        strcat(text, "T00:00:00");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(oldDateStringToSeconds(text), isoDayStart(text, 0), text);
+    }
+}
+
+void test_rejects_impossible_dates(void)
+{
+    IsoDateTime value;
+    TEST_ASSERT_EQUAL(ISO_OK, isoParse("2024-02-29", 10, value));
+    TEST_ASSERT_EQUAL(ISO_OUT_OF_RANGE, isoParse("2025-02-29", 10, value));
+    TEST_ASSERT_EQUAL(ISO_OUT_OF_RANGE, isoParse("2100-02-29", 10, value));
+    TEST_ASSERT_EQUAL(ISO_OK, isoParse("2000-02-29", 10, value));
+    TEST_ASSERT_EQUAL(ISO_OUT_OF_RANGE, isoParse("2025-13-01", 10, value));
+    TEST_ASSERT_EQUAL(ISO_OUT_OF_RANGE, isoParse("2025-06-08T24:00", 16, value));
+    TEST_ASSERT_EQUAL(ISO_BAD_FORMAT, isoParse("2025-6-8", 8, value));
+    TEST_ASSERT_EQUAL(ISO_BAD_FORMAT, isoParse("2025-06-08X", 11, value));
+    TEST_ASSERT_EQUAL(ISO_BAD_FORMAT, isoParse("2025-0608", 9, value));
+
+    // The old parser let day 31 through in every month
+    TEST_ASSERT_NOT_EQUAL(0, oldDateStringToSeconds("2025-02-31"));
+    TEST_ASSERT_EQUAL_UINT32(0, isoDayStart("2025-02-31", 0));
+    TEST_ASSERT_EQUAL_UINT32(0, isoDayStart("1969-12-31", 0));
+    TEST_ASSERT_EQUAL_UINT32(0, isoDayStart(nullptr, 0));
+}
+
+// An offset moves a late UTC time onto the next local day
+void test_offset_crosses_midnight(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(1749340800, isoDayStart("2025-06-07T20:00:00Z", TIME_OFFSET));
+    TEST_ASSERT_EQUAL_UINT32(1749254400, isoDayStart("2025-06-07T18:00:00Z", TIME_OFFSET));
+    TEST_ASSERT_EQUAL_UINT32(1749340800, isoDayStart("2025-06-07T20:00:00-05:00", 0));
+    TEST_ASSERT_EQUAL_UINT32(1749254400, isoDayStart("20250607T0600+0530", 0));
+}
+
+void test_benchmark_against_old_parser(void)
+{
+    const int32_t first = daysFromCivil(2000, 1, 1);
+    const int32_t count = daysFromCivil(2100, 1, 1) - first;
+    static char dates[36525][32]; // 2000-01-01 up to 2099-12-31
+    for (int32_t i = 0; i < count; i++)
+    {
+        formatDay(dates[i], sizeof(dates[i]), civilFromDays(first + i), true);
+        strcat(dates[i], "T00:00:00.000Z");
+    }
+
+    uint64_t oldSum = 0, newSum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < count; i++)
+    {
+        oldSum += oldDateStringToSeconds(dates[i]);
+    }
+    double oldNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < count; i++)
+    {
+        newSum += isoDayStart(dates[i], 0);
+    }
+    double newNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+    TEST_ASSERT_EQUAL_UINT64(oldSum, newSum);
+
+    char message[96];
+    snprintf(message, sizeof(message), "dateStringToSeconds: %.1f ns per date (4 string copies)", oldNs);
+    TEST_MESSAGE(message);
+    snprintf(message, sizeof(message), "isoDayStart:         %.1f ns per date (no allocation)", newNs);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_day_round_trips);
+    RUN_TEST(test_every_day_parses);
+    RUN_TEST(test_matches_old_parser);
+    RUN_TEST(test_rejects_impossible_dates);
+    RUN_TEST(test_offset_crosses_midnight);
+    RUN_TEST(test_benchmark_against_old_parser);
+    return UNITY_END();
+}
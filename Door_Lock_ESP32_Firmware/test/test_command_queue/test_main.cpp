@@ -0,0 +1,131 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "command_queue.h"
+#include "config.h"
+
+static void push(CommandQueue<3, 16> &queue, const char *command)
+{
+    queue.push(reinterpret_cast<const uint8_t *>(command), strlen(command));
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fifo_order(void)
+{
+    CommandQueue<3, 16> queue;
+    size_t length;
+    TEST_ASSERT_NULL(queue.front(length));
+
+    push(queue, "one");
+    push(queue, "two");
+    TEST_ASSERT_EQUAL_STRING("one", queue.front(length));
+    TEST_ASSERT_EQUAL(3, length);
+    queue.pop();
+    TEST_ASSERT_EQUAL_STRING("two", queue.front(length));
+    queue.pop();
+    TEST_ASSERT_NULL(queue.front(length));
+    queue.pop(); // Popping an empty queue is harmless
+    TEST_ASSERT_EQUAL(0, queue.depth());
+}
+
+void test_full_queue_drops(void)
+{
+    CommandQueue<3, 16> queue;
+    push(queue, "a");
+    push(queue, "b");
+    push(queue, "c");
+    TEST_ASSERT_FALSE(queue.push(reinterpret_cast<const uint8_t *>("d"), 1));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.dropped());
+    TEST_ASSERT_EQUAL(3, queue.peak());
+
+    size_t length;
+    TEST_ASSERT_EQUAL_STRING("a", queue.front(length));
+}
+
+// A payload of exactly SLOT_SIZE bytes still gets its terminator
+void test_oversized_rejected(void)
+{
+    CommandQueue<3, 16> queue;
+    char payload[18];
+    memset(payload, 'x', sizeof(payload));
+    TEST_ASSERT_FALSE(queue.push(reinterpret_cast<const uint8_t *>(payload), 17));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.oversized());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.dropped());
+
+    TEST_ASSERT_TRUE(queue.push(reinterpret_cast<const uint8_t *>(payload), 16));
+    size_t length;
+    TEST_ASSERT_EQUAL(16, strlen(queue.front(length)));
+}
+
+// Head and tail run round the slots many times, order is kept
+void test_wraps_around(void)
+{
+    CommandQueue<3, 16> queue;
+    char command[16];
+    size_t length;
+    int next = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        snprintf(command, sizeof(command), "c%d", i);
+        push(queue, command);
+        if (queue.depth() == 2)
+        {
+            snprintf(command, sizeof(command), "c%d", next++);
+            TEST_ASSERT_EQUAL_STRING(command, queue.front(length));
+            queue.pop();
+        }
+    }
+    TEST_ASSERT_EQUAL(1, queue.depth());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.dropped());
+}
+
+// Fifty commands arrive before loop() gets to dispatch any. The queue
+// keeps what fits; every other push fails, which is where queueCommand()
+// counts a busy reply, and dropped() counts the same commands.
+void test_burst_overflow_is_counted(void)
+{
+    static CommandQueue<CMD_QUEUE_SLOTS, MQTT_MAX_BUFFER_SIZE> queue;
+    const uint32_t burst = 50;
+    char command[32];
+    uint32_t busyReplies = 0;
+
+    for (uint32_t i = 0; i < burst; i++)
+    {
+        int length = snprintf(command, sizeof(command), "{\"type\":\"ack\",\"seq\":%u}", i);
+        if (!queue.push(reinterpret_cast<const uint8_t *>(command), length))
+        {
+            busyReplies++;
+        }
+    }
+    TEST_ASSERT_EQUAL(CMD_QUEUE_SLOTS, queue.depth());
+    TEST_ASSERT_EQUAL(CMD_QUEUE_SLOTS, queue.peak());
+    TEST_ASSERT_EQUAL_UINT32(burst - CMD_QUEUE_SLOTS, queue.dropped());
+    TEST_ASSERT_EQUAL_UINT32(queue.dropped(), busyReplies);
+
+    // dispatchCommands() gets the first commands, in order, and no others
+    size_t length;
+    for (uint32_t i = 0; i < CMD_QUEUE_SLOTS; i++)
+    {
+        snprintf(command, sizeof(command), "{\"type\":\"ack\",\"seq\":%u}", i);
+        TEST_ASSERT_EQUAL_STRING(command, queue.front(length));
+        queue.pop();
+    }
+    TEST_ASSERT_NULL(queue.front(length));
+
+    // The next command after the burst is taken again
+    TEST_ASSERT_TRUE(queue.push(reinterpret_cast<const uint8_t *>(command), strlen(command)));
+    TEST_ASSERT_EQUAL_UINT32(burst - CMD_QUEUE_SLOTS, queue.dropped());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_full_queue_drops);
+    RUN_TEST(test_oversized_rejected);
+    RUN_TEST(test_wraps_around);
+    RUN_TEST(test_burst_overflow_is_counted);
+    return UNITY_END();
+}
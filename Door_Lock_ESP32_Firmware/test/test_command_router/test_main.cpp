@@ -0,0 +1,295 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "command_router.h"
+#include "enrollment.h"
+#include "json_arena.h"
+#include "member_store.h"
+#include "outbox.h"
+#include "sim_clock.h"
+#include "sim_fingerprint.h"
+#include "sim_fs.h"
+#include "wire_format.h"
+
+// Same values as the firmware's config.h
+#define CAPTURE_TIMEOUT_MS 30000
+#define LIFT_TIMEOUT_MS    15000
+#define POLL_INTERVAL_MS   50
+
+#define CAPACITY 32
+
+alignas(8) static uint8_t arenaBuffer[4096];
+
+// Handlers record what they saw here
+struct Calls
+{
+    int first;
+    int second;
+    int fallback;
+    char type[32];
+    uint32_t value;
+};
+
+static Calls calls;
+
+void setUp(void)
+{
+    memset(&calls, 0, sizeof(calls));
+}
+
+void tearDown(void) {}
+
+static void record(JsonDocument &doc, void *ctx)
+{
+    strncpy(calls.type, doc["type"] | "", sizeof(calls.type) - 1);
+    calls.value = doc["value"] | 0;
+    TEST_ASSERT_EQUAL_PTR(&calls, ctx);
+}
+
+static void firstCommand(JsonDocument &doc, void *ctx)
+{
+    calls.first++;
+    record(doc, ctx);
+}
+
+static void secondCommand(JsonDocument &doc, void *ctx)
+{
+    calls.second++;
+    record(doc, ctx);
+}
+
+static void fallbackCommand(JsonDocument &doc, void *ctx)
+{
+    calls.fallback++;
+    record(doc, ctx);
+}
+
+static const CommandRoute routes[] = {
+    {"first", firstCommand},
+    {"second", secondCommand},
+};
+
+static CommandStatus dispatchText(CommandRouter &router, const char *text)
+{
+    return router.dispatch(reinterpret_cast<const uint8_t *>(text), strlen(text));
+}
+
+void test_routes_by_type(void)
+{
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CommandRouter router(routes, fallbackCommand, &arena, &calls);
+
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, "{\"type\":\"second\",\"value\":7}"));
+    TEST_ASSERT_EQUAL(0, calls.first);
+    TEST_ASSERT_EQUAL(1, calls.second);
+    TEST_ASSERT_EQUAL_STRING("second", calls.type);
+    TEST_ASSERT_EQUAL_UINT32(7, calls.value);
+
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, "{\"value\":1,\"type\":\"first\"}"));
+    TEST_ASSERT_EQUAL(1, calls.first);
+    TEST_ASSERT_EQUAL(0, calls.fallback);
+    TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+// The fallback gets the parsed command so it can reply to it
+void test_unknown_type_goes_to_fallback(void)
+{
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CommandRouter router(routes, fallbackCommand, &arena, &calls);
+
+    TEST_ASSERT_EQUAL(COMMAND_UNKNOWN, dispatchText(router, "{\"type\":\"third\",\"value\":3}"));
+    TEST_ASSERT_EQUAL(1, calls.fallback);
+    TEST_ASSERT_EQUAL_STRING("third", calls.type);
+    TEST_ASSERT_EQUAL(COMMAND_UNKNOWN, dispatchText(router, "{\"value\":3}"));
+    TEST_ASSERT_EQUAL(COMMAND_UNKNOWN, dispatchText(router, "{\"type\":\"First\"}"));
+    TEST_ASSERT_EQUAL(3, calls.fallback);
+    TEST_ASSERT_EQUAL(0, calls.first + calls.second);
+
+    CommandRouter silent(routes, nullptr, &arena, &calls);
+    TEST_ASSERT_EQUAL(COMMAND_UNKNOWN, dispatchText(silent, "{\"type\":\"third\"}"));
+    TEST_ASSERT_EQUAL(3, calls.fallback);
+}
+
+void test_bad_input_reaches_no_handler(void)
+{
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CommandRouter router(routes, fallbackCommand, &arena, &calls);
+
+    TEST_ASSERT_EQUAL(COMMAND_EMPTY, router.dispatch(nullptr, 0));
+    TEST_ASSERT_EQUAL(COMMAND_ERR_PARSE, dispatchText(router, "{\"type\":\"first\""));
+    TEST_ASSERT_TRUE(strlen(router.parseError()) > 0);
+    TEST_ASSERT_EQUAL(COMMAND_ERR_PARSE, dispatchText(router, "type=first"));
+    TEST_ASSERT_EQUAL(0, calls.first + calls.second + calls.fallback);
+    TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+// Refuses every allocation, as a heap with nothing left would
+class NoMemory : public ArduinoJson::Allocator
+{
+public:
+    void *allocate(size_t size) override { return nullptr; }
+    void deallocate(void *p) override {}
+    void *reallocate(void *p, size_t size) override { return nullptr; }
+};
+
+void test_out_of_memory(void)
+{
+    NoMemory noMemory;
+    CommandRouter router(routes, fallbackCommand, &noMemory, &calls);
+    TEST_ASSERT_EQUAL(COMMAND_ERR_MEMORY, dispatchText(router, "{\"type\":\"first\",\"value\":1}"));
+    TEST_ASSERT_EQUAL(0, calls.first + calls.fallback);
+}
+
+// MessagePack commands take the same routes
+void test_msgpack_command(void)
+{
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CommandRouter router(routes, fallbackCommand, &arena, &calls);
+
+    uint8_t payload[64];
+    size_t length;
+    {
+        JsonDocument command(&arena);
+        command["type"] = "first";
+        command["value"] = 42;
+        length = wireSerialize(command, WIRE_MSGPACK, payload, sizeof(payload));
+    }
+    TEST_ASSERT_TRUE(wireIsMsgPack(payload, length));
+    TEST_ASSERT_EQUAL(COMMAND_OK, router.dispatch(payload, length));
+    TEST_ASSERT_EQUAL(1, calls.first);
+    TEST_ASSERT_EQUAL_UINT32(42, calls.value);
+}
+
+// The firmware's own state, handed to the handlers as ctx instead of globals
+struct Device
+{
+    SimClock clock;
+    RamFileSystem fs;
+    SimFingerprintSensor sensor;
+    MemberStore store;
+    Outbox outbox;
+    Enrollment enrollment;
+
+    Device()
+        : fs(clock), sensor(clock, CAPACITY), store(fs, "/members.bin"), outbox(fs, "/outbox.bin"),
+          enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS) {}
+};
+
+// Same as queueJsonResponse(): a "seq" field, then into the outbox
+static void queueReply(Device &device, JsonDocument &doc)
+{
+    doc["seq"] = device.outbox.nextSeq();
+    uint8_t payload[OUTBOX_PAYLOAD_LEN];
+    size_t length = wireSerialize(doc, WIRE_JSON, payload, sizeof(payload));
+    TEST_ASSERT_NOT_EQUAL(0, device.outbox.push(payload, (uint16_t)length));
+}
+
+static void enrollUserCommand(JsonDocument &doc, void *ctx)
+{
+    Device &device = *static_cast<Device *>(ctx);
+    doc["status"] = device.enrollment.start(doc["punchingId"] | 0, device.clock.millis()) ? 1 : 0;
+    queueReply(device, doc);
+}
+
+static void cancelEnrollCommand(JsonDocument &doc, void *ctx)
+{
+    Device &device = *static_cast<Device *>(ctx);
+    doc["status"] = device.enrollment.active() ? 1 : 0;
+    device.enrollment.cancel();
+    queueReply(device, doc);
+}
+
+static void deleteUserCommand(JsonDocument &doc, void *ctx)
+{
+    Device &device = *static_cast<Device *>(ctx);
+    MemberRecord record;
+    bool deleted = device.store.findByUserId(doc["userId"] | "", record) == MEMBER_STORE_OK &&
+                   device.sensor.deleteModel(record.punchingId1) == FINGERPRINT_OK &&
+                   device.store.erase(record.punchingId1) == MEMBER_STORE_OK;
+    doc["status"] = deleted ? 1 : 0;
+    queueReply(device, doc);
+}
+
+static void ackCommand(JsonDocument &doc, void *ctx)
+{
+    static_cast<Device *>(ctx)->outbox.ack(doc["seq"].as<uint32_t>());
+}
+
+static const CommandRoute deviceRoutes[] = {
+    {"enrollUser", enrollUserCommand},
+    {"cancelEnroll", cancelEnrollCommand},
+    {"deleteUser", deleteUserCommand},
+    {"ack", ackCommand},
+};
+
+// Commands as they arrive over MQTT, all the way to the store, the sensor
+// and the outbox, on simulated hardware
+void test_commands_drive_device(void)
+{
+    static Device device;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, device.store.begin(CAPACITY));
+    TEST_ASSERT_TRUE(device.outbox.begin(8, true));
+    MemberRecord member;
+    memset(&member, 0, sizeof(member));
+    member.punchingId1 = 5;
+    strcpy(member.userId, "member-5");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, device.store.write(member));
+    device.sensor.setTemplate(5, 0xF5);
+
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CommandRouter router(deviceRoutes, nullptr, &arena, &device);
+
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, "{\"type\":\"deleteUser\",\"userId\":\"member-5\"}"));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_NOT_FOUND, device.store.read(5, member));
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, "{\"type\":\"deleteUser\",\"userId\":\"member-5\"}"));
+
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, "{\"type\":\"enrollUser\",\"punchingId\":9}"));
+    TEST_ASSERT_TRUE(device.enrollment.active());
+    TEST_ASSERT_EQUAL(9, device.enrollment.id());
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, "{\"type\":\"cancelEnroll\"}"));
+    device.enrollment.update(device.clock.millis());
+    TEST_ASSERT_FALSE(device.enrollment.active());
+
+    // One reply per command, the second delete failed
+    TEST_ASSERT_EQUAL_UINT32(4, device.outbox.pending());
+    uint8_t payload[OUTBOX_PAYLOAD_LEN];
+    uint16_t length;
+    uint32_t seq;
+    const char *expected[] = {"\"status\":1", "\"status\":0", "\"status\":1", "\"status\":1"};
+    for (const char *status : expected)
+    {
+        TEST_ASSERT_TRUE(device.outbox.peek(payload, length, seq));
+        payload[length] = '\0';
+        TEST_ASSERT_NOT_NULL(strstr(reinterpret_cast<char *>(payload), status));
+        device.outbox.markSent(seq);
+    }
+
+    char ack[40];
+    snprintf(ack, sizeof(ack), "{\"type\":\"ack\",\"seq\":%u}", seq);
+    TEST_ASSERT_EQUAL(COMMAND_OK, dispatchText(router, ack));
+    TEST_ASSERT_EQUAL_UINT32(0, device.outbox.pending());
+    TEST_ASSERT_EQUAL(COMMAND_UNKNOWN, dispatchText(router, "{\"type\":\"reboot\"}"));
+    TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+void test_status_names(void)
+{
+    for (int status = COMMAND_OK; status < COMMAND_STATUS_COUNT; status++)
+    {
+        TEST_ASSERT_NOT_EQUAL(0, strcmp("unknown", CommandRouter::statusName((CommandStatus)status)));
+    }
+    TEST_ASSERT_EQUAL_STRING("unknown", CommandRouter::statusName(COMMAND_STATUS_COUNT));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_routes_by_type);
+    RUN_TEST(test_unknown_type_goes_to_fallback);
+    RUN_TEST(test_bad_input_reaches_no_handler);
+    RUN_TEST(test_out_of_memory);
+    RUN_TEST(test_msgpack_command);
+    RUN_TEST(test_commands_drive_device);
+    RUN_TEST(test_status_names);
+    return UNITY_END();
+}
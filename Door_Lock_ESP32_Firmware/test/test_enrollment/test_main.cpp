@@ -0,0 +1,204 @@
+#include <unity.h>
+#include "enrollment.h"
+#include "sim_clock.h"
+#include "sim_fingerprint.h"
+
+// Same values as the firmware's config.h
+#define CAPTURE_TIMEOUT_MS 30000
+#define LIFT_TIMEOUT_MS    15000
+#define POLL_INTERVAL_MS   50
+
+#define SLOT     17
+#define FINGER   1001
+#define LOOP_MS  5 // Time the rest of loop() takes between two update() calls
+
+static SimClock simClock;
+
+void setUp(void)
+{
+    simClock = SimClock();
+}
+
+void tearDown(void) {}
+
+// Drive update() the way loop() does until the enrollment ends, and check
+// that no call blocks longer than one capture
+static EnrollStage run(Enrollment &enrollment, SimFingerprintSensor &sensor, uint32_t &longestCallUs)
+{
+    longestCallUs = 0;
+    for (int i = 0; i < 100000 && !enrollment.finished(); i++)
+    {
+        uint64_t before = simClock.elapsedUs();
+        uint32_t commands = sensor.commands();
+        enrollment.update(simClock.millis());
+        TEST_ASSERT_LESS_OR_EQUAL(2, sensor.commands() - commands);
+        uint32_t callUs = (uint32_t)(simClock.elapsedUs() - before);
+        if (callUs > longestCallUs)
+        {
+            longestCallUs = callUs;
+        }
+        simClock.advanceMs(LOOP_MS);
+    }
+    return enrollment.stage();
+}
+
+void test_enrolls_and_matches(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    TEST_ASSERT_TRUE(enrollment.start(SLOT, simClock.millis()));
+    TEST_ASSERT_TRUE(enrollment.active());
+    TEST_ASSERT_FALSE(enrollment.start(SLOT + 1, simClock.millis()));
+
+    sensor.touch(FINGER, 800, 1000);  // Placed after a second
+    sensor.touch(FINGER, 800, 3000);  // Lifted, then placed again
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_DONE, run(enrollment, sensor, longestCallUs));
+    TEST_ASSERT_EQUAL(FINGERPRINT_OK, enrollment.lastError());
+    TEST_ASSERT_EQUAL(SLOT, enrollment.id());
+    TEST_ASSERT_LESS_THAN(250000, longestCallUs); // getImage + image2Tz at 57600 baud
+
+    // The stored template is found by a normal scan
+    sensor.touch(FINGER, 500);
+    TEST_ASSERT_EQUAL(FINGERPRINT_OK, sensor.getImage());
+    TEST_ASSERT_EQUAL(FINGERPRINT_OK, sensor.image2Tz(1));
+    TEST_ASSERT_EQUAL(FINGERPRINT_OK, sensor.fingerSearch(1));
+    TEST_ASSERT_EQUAL(SLOT, sensor.fingerID());
+
+    enrollment.reset();
+    TEST_ASSERT_EQUAL(ENROLL_IDLE, enrollment.stage());
+    TEST_ASSERT_FALSE(enrollment.finished());
+}
+
+void test_different_fingers_fail(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+    sensor.touch(FINGER, 800, 500);
+    sensor.touch(FINGER + 1, 800, 2000);
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_FAILED, run(enrollment, sensor, longestCallUs));
+    TEST_ASSERT_EQUAL(FINGERPRINT_ENROLLMISMATCH, enrollment.lastError());
+}
+
+void test_no_finger_times_out(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_TIMEOUT, run(enrollment, sensor, longestCallUs));
+    TEST_ASSERT_EQUAL(FINGERPRINT_TIMEOUT, enrollment.lastError());
+    TEST_ASSERT_UINT32_WITHIN(500, CAPTURE_TIMEOUT_MS, simClock.millis());
+}
+
+void test_finger_left_on_times_out(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+    sensor.touch(FINGER, 60000);
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_TIMEOUT, run(enrollment, sensor, longestCallUs));
+    TEST_ASSERT_UINT32_WITHIN(500, LIFT_TIMEOUT_MS, simClock.millis());
+}
+
+// A smudged image is retried, a broken UART link ends the enrollment
+void test_bad_image_retried(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+    sensor.touch(FINGER, 1500);
+    sensor.touch(FINGER, 800, 3000);
+    sensor.failNext(FINGERPRINT_OK);        // getImage
+    sensor.failNext(FINGERPRINT_IMAGEMESS); // image2Tz
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_DONE, run(enrollment, sensor, longestCallUs));
+}
+
+void test_communication_error_fails(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+    sensor.touch(FINGER, 800);
+    sensor.failNext(FINGERPRINT_PACKETRECIEVEERR);
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_FAILED, run(enrollment, sensor, longestCallUs));
+    TEST_ASSERT_EQUAL(FINGERPRINT_PACKETRECIEVEERR, enrollment.lastError());
+}
+
+void test_store_failure_reported(void)
+{
+    SimFingerprintSensor sensor(simClock, 10);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis()); // Beyond the sensor's capacity
+    sensor.touch(FINGER, 800);
+    sensor.touch(FINGER, 800, 2000);
+
+    uint32_t longestCallUs;
+    TEST_ASSERT_EQUAL(ENROLL_FAILED, run(enrollment, sensor, longestCallUs));
+    TEST_ASSERT_EQUAL(FINGERPRINT_BADLOCATION, enrollment.lastError());
+}
+
+void test_cancel(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+    TEST_ASSERT_FALSE(enrollment.update(simClock.millis())); // No finger yet
+
+    uint32_t commands = sensor.commands();
+    enrollment.cancel();
+    TEST_ASSERT_TRUE(enrollment.update(simClock.millis()));
+    TEST_ASSERT_EQUAL(ENROLL_CANCELLED, enrollment.stage());
+    TEST_ASSERT_EQUAL_UINT32(commands, sensor.commands());
+    TEST_ASSERT_EQUAL_STRING("cancelled", Enrollment::stageName(enrollment.stage()));
+
+    // A new enrollment can start once the finished one is seen
+    TEST_ASSERT_TRUE(enrollment.start(SLOT, simClock.millis()));
+    TEST_ASSERT_EQUAL(ENROLL_CAPTURE_1, enrollment.stage());
+}
+
+// Calls inside the poll interval do not talk to the sensor
+void test_poll_interval(void)
+{
+    SimFingerprintSensor sensor(simClock, 100);
+    Enrollment enrollment(sensor, CAPTURE_TIMEOUT_MS, LIFT_TIMEOUT_MS, POLL_INTERVAL_MS);
+    enrollment.start(SLOT, simClock.millis());
+
+    uint32_t polledAt = simClock.millis();
+    enrollment.update(polledAt);
+    uint32_t commands = sensor.commands();
+    while (simClock.millis() - polledAt < POLL_INTERVAL_MS)
+    {
+        enrollment.update(simClock.millis());
+        simClock.advanceMs(1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(commands, sensor.commands());
+    enrollment.update(simClock.millis());
+    TEST_ASSERT_EQUAL_UINT32(commands + 1, sensor.commands());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_enrolls_and_matches);
+    RUN_TEST(test_different_fingers_fail);
+    RUN_TEST(test_no_finger_times_out);
+    RUN_TEST(test_finger_left_on_times_out);
+    RUN_TEST(test_bad_image_retried);
+    RUN_TEST(test_communication_error_fails);
+    RUN_TEST(test_store_failure_reported);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_poll_interval);
+    return UNITY_END();
+}
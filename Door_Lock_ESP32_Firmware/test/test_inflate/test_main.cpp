@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "inflate.h"
+
+// "hello hello hello hello\n", gzip with fixed Huffman codes
+static const uint8_t fixedGzip[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0x57,
+    0xc8, 0x40, 0x27, 0xb9, 0x00, 0x00, 0x88, 0x59, 0x0b, 0x18, 0x00, 0x00, 0x00};
+
+// memberLines(1, 40), gzip -9 with dynamic Huffman codes
+static const uint8_t membersGzip[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x95, 0x95, 0x31, 0x4e, 0x03, 0x31,
+    0x10, 0x45, 0x7b, 0x8e, 0xe1, 0x3a, 0x91, 0x3c, 0x7f, 0xbc, 0x5e, 0x3b, 0x3d, 0x45, 0x0e, 0xc0,
+    0x05, 0x48, 0x10, 0x6c, 0xb3, 0x44, 0x09, 0x5b, 0x45, 0xdc, 0x9d, 0xd0, 0xfa, 0xdb, 0xa0, 0x3f,
+    0xf5, 0xe8, 0xc9, 0xc5, 0x7b, 0xe3, 0x7b, 0xd8, 0x6e, 0x6f, 0xd7, 0xe3, 0x39, 0x1c, 0xc2, 0x4b,
+    0x7c, 0x8c, 0x85, 0x5d, 0xb8, 0x6c, 0xeb, 0xe9, 0x63, 0x59, 0xdf, 0x8f, 0x67, 0x0b, 0x07, 0xdb,
+    0x85, 0xdb, 0xf6, 0x7a, 0x3b, 0x5d, 0x97, 0xcb, 0xd7, 0xf2, 0xb9, 0x3e, 0xaf, 0xbf, 0xab, 0x88,
+    0xc8, 0xfb, 0x88, 0xfd, 0x63, 0xfd, 0xfb, 0xe9, 0xde, 0x20, 0xd0, 0x22, 0x30, 0x46, 0x78, 0x1f,
+    0xe1, 0x2d, 0xc2, 0xc7, 0x88, 0xd4, 0x47, 0xa4, 0x16, 0x91, 0xc6, 0x88, 0xa9, 0x8f, 0x98, 0x5a,
+    0xc4, 0x34, 0x46, 0xe4, 0x3e, 0x22, 0xb7, 0x88, 0x3c, 0x46, 0xcc, 0x7d, 0xc4, 0xdc, 0x22, 0xe6,
+    0x31, 0xa2, 0xf4, 0x11, 0xa5, 0x45, 0x94, 0x31, 0xa2, 0xf6, 0x11, 0xb5, 0x45, 0xd4, 0x21, 0xc2,
+    0x62, 0x17, 0x61, 0x91, 0xd4, 0x8a, 0x63, 0x86, 0xf5, 0x19, 0xac, 0xe7, 0xd8, 0x4f, 0xeb, 0xfb,
+    0x69, 0xe4, 0xa7, 0xfd, 0x21, 0xe8, 0xe0, 0x1d, 0x24, 0xa8, 0xb9, 0xda, 0x89, 0x91, 0xa1, 0x96,
+    0xd4, 0x50, 0x8c, 0x14, 0xb5, 0x49, 0x2d, 0xc5, 0xc8, 0x51, 0xcb, 0x6a, 0x2a, 0x46, 0x92, 0xda,
+    0xac, 0xb6, 0x62, 0x64, 0xa9, 0x15, 0x35, 0x16, 0x23, 0x4d, 0xad, 0xaa, 0xb5, 0x80, 0x3c, 0x45,
+    0x54, 0x73, 0x01, 0x79, 0x0a, 0x53, 0x7b, 0x01, 0xdf, 0x51, 0xa8, 0xbd, 0x80, 0x3c, 0x85, 0xab,
+    0xbd, 0x80, 0x3c, 0x45, 0x52, 0x7b, 0x01, 0x79, 0x8a, 0x49, 0xed, 0x05, 0xe4, 0x29, 0xb2, 0xda,
+    0x0b, 0xc8, 0x53, 0xcc, 0x6a, 0x2f, 0x20, 0x4f, 0x51, 0xd4, 0x5e, 0x40, 0x9e, 0xa2, 0xaa, 0xbd,
+    0x38, 0x79, 0xea, 0x51, 0xed, 0xc5, 0xc9, 0x53, 0x37, 0xb5, 0x17, 0x27, 0x4f, 0x1d, 0x6a, 0x2f,
+    0xce, 0x1f, 0xbe, 0xab, 0xbd, 0x38, 0x79, 0xea, 0x49, 0xed, 0xc5, 0xc9, 0x53, 0x9f, 0xd4, 0x5e,
+    0x9c, 0x3c, 0xf5, 0xac, 0xf6, 0xe2, 0xe4, 0xa9, 0xcf, 0x6a, 0x2f, 0x4e, 0x9e, 0x7a, 0x51, 0x7b,
+    0x71, 0xf2, 0xd4, 0xab, 0xda, 0x4b, 0x22, 0x4f, 0x53, 0xfc, 0xb7, 0x97, 0x1f, 0x01, 0x35, 0x6a,
+    0xb2, 0x97, 0x0a, 0x00, 0x00};
+
+static uint8_t out[4096];
+
+void setUp(void)
+{
+    memset(out, 0xAA, sizeof(out));
+}
+
+void tearDown(void) {}
+
+// Same NDJSON the fixture was made from
+static size_t memberLines(char *text, size_t size, int first, int last)
+{
+    size_t length = 0;
+    for (int i = first; i <= last; i++)
+    {
+        length += snprintf(text + length, size - length,
+                           "{\"userId\":\"U%05d\",\"punchingId1\":%d,\"subscriptionEnd\":\"2026-%02d-01\"}\n", i, i,
+                           i % 12 + 1);
+    }
+    return length;
+}
+
+void test_crc32(void)
+{
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32("123456789", 9));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32("6789", 4, crc32("12345", 5)));
+    TEST_ASSERT_EQUAL_HEX32(0, crc32("", 0));
+}
+
+// Uncompressed block: BFINAL, BTYPE 00, then LEN and NLEN
+void test_stored_block(void)
+{
+    const uint8_t stored[] = {0x01, 0x05, 0x00, 0xFA, 0xFF, 'd', 'o', 'o', 'r', 's', 0xFF};
+    size_t length = 0, consumed = 0;
+    TEST_ASSERT_EQUAL(INFLATE_OK, inflateRaw(stored, sizeof(stored), out, sizeof(out), length, consumed));
+    TEST_ASSERT_EQUAL(5, length);
+    TEST_ASSERT_EQUAL(10, consumed);
+    TEST_ASSERT_EQUAL_MEMORY("doors", out, 5);
+
+    uint8_t corrupt[sizeof(stored)];
+    memcpy(corrupt, stored, sizeof(stored));
+    corrupt[3] = 0x00; // NLEN no longer the complement of LEN
+    TEST_ASSERT_EQUAL(INFLATE_ERR_FORMAT, inflateRaw(corrupt, sizeof(corrupt), out, sizeof(out), length, consumed));
+}
+
+void test_fixed_huffman(void)
+{
+    size_t length = 0;
+    TEST_ASSERT_TRUE(isGzip(fixedGzip, sizeof(fixedGzip)));
+    TEST_ASSERT_EQUAL(INFLATE_OK, gunzip(fixedGzip, sizeof(fixedGzip), out, sizeof(out), length));
+    TEST_ASSERT_EQUAL(24, length);
+    TEST_ASSERT_EQUAL_MEMORY("hello hello hello hello\n", out, 24);
+}
+
+void test_dynamic_huffman(void)
+{
+    static char expected[4096];
+    size_t expectedLength = memberLines(expected, sizeof(expected), 1, 40);
+    size_t length = 0;
+    TEST_ASSERT_EQUAL(INFLATE_OK, gunzip(membersGzip, sizeof(membersGzip), out, sizeof(out), length));
+    TEST_ASSERT_EQUAL(expectedLength, length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, length);
+}
+
+// Every cut of the stream fails, none of them reads past the end. Less
+// than a header and a trailer is not taken for gzip at all.
+void test_truncated_input(void)
+{
+    size_t length = 0;
+    for (size_t cut = 0; cut < sizeof(membersGzip); cut++)
+    {
+        InflateStatus status = gunzip(membersGzip, cut, out, sizeof(out), length);
+        TEST_ASSERT_NOT_EQUAL(INFLATE_OK, status);
+        if (cut >= 18)
+        {
+            TEST_ASSERT_EQUAL(INFLATE_ERR_TRUNCATED, status);
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL(INFLATE_ERR_FORMAT, status);
+        }
+    }
+}
+
+void test_output_too_small(void)
+{
+    size_t length = 0;
+    TEST_ASSERT_EQUAL(INFLATE_ERR_FULL, gunzip(fixedGzip, sizeof(fixedGzip), out, 23, length));
+    TEST_ASSERT_EQUAL_HEX8(0xAA, out[23]);
+    TEST_ASSERT_EQUAL(INFLATE_ERR_FULL, gunzip(membersGzip, sizeof(membersGzip), out, 1000, length));
+    TEST_ASSERT_EQUAL_HEX8(0xAA, out[1000]);
+}
+
+void test_trailer_checked(void)
+{
+    uint8_t corrupt[sizeof(membersGzip)];
+    size_t length = 0;
+
+    memcpy(corrupt, membersGzip, sizeof(corrupt));
+    corrupt[sizeof(corrupt) - 8] ^= 0x01; // CRC-32
+    TEST_ASSERT_EQUAL(INFLATE_ERR_CHECK, gunzip(corrupt, sizeof(corrupt), out, sizeof(out), length));
+
+    memcpy(corrupt, membersGzip, sizeof(corrupt));
+    corrupt[sizeof(corrupt) - 4] ^= 0x01; // ISIZE
+    TEST_ASSERT_EQUAL(INFLATE_ERR_CHECK, gunzip(corrupt, sizeof(corrupt), out, sizeof(out), length));
+}
+
+void test_not_gzip(void)
+{
+    const uint8_t text[] = "{\"userId\":\"U00001\"}";
+    size_t length = 0;
+    TEST_ASSERT_FALSE(isGzip(text, sizeof(text)));
+    TEST_ASSERT_EQUAL(INFLATE_ERR_FORMAT, gunzip(text, sizeof(text), out, sizeof(out), length));
+
+    uint8_t method[sizeof(fixedGzip)];
+    memcpy(method, fixedGzip, sizeof(method));
+    method[2] = 0x07; // Not deflate
+    TEST_ASSERT_EQUAL(INFLATE_ERR_FORMAT, gunzip(method, sizeof(method), out, sizeof(out), length));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32);
+    RUN_TEST(test_stored_block);
+    RUN_TEST(test_fixed_huffman);
+    RUN_TEST(test_dynamic_huffman);
+    RUN_TEST(test_truncated_input);
+    RUN_TEST(test_output_too_small);
+    RUN_TEST(test_trailer_checked);
+    RUN_TEST(test_not_gzip);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <string.h>
+#include "config.h"
+#include "json_arena.h"
+
+#define BLOCK_HEADER 8 // JsonArena::Block ahead of every block
+
+alignas(8) static uint8_t buffer[JSON_ARENA_SIZE];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_out_of_order_frees_pop(void)
+{
+    JsonArena arena(buffer, sizeof(buffer));
+    void *a = arena.allocate(16);
+    void *b = arena.allocate(16);
+    void *c = arena.allocate(16);
+    TEST_ASSERT_EQUAL(3 * (BLOCK_HEADER + 16), arena.used());
+
+    // A freed block under the top stays until everything above it is freed
+    arena.deallocate(b);
+    TEST_ASSERT_EQUAL(3 * (BLOCK_HEADER + 16), arena.used());
+    arena.deallocate(c);
+    TEST_ASSERT_EQUAL(BLOCK_HEADER + 16, arena.used());
+
+    // Space popped from the top is handed out again
+    void *d = arena.allocate(16);
+    TEST_ASSERT_EQUAL_PTR(b, d);
+
+    arena.deallocate(a);
+    TEST_ASSERT_EQUAL(2 * (BLOCK_HEADER + 16), arena.used());
+    TEST_ASSERT_EQUAL_UINT32(0, arena.resets());
+    arena.deallocate(d);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL_UINT32(1, arena.resets());
+    TEST_ASSERT_EQUAL(3 * (BLOCK_HEADER + 16), arena.highWater());
+}
+
+void test_reallocate_top_in_place(void)
+{
+    JsonArena arena(buffer, sizeof(buffer));
+    void *a = arena.allocate(16);
+    void *b = arena.allocate(16);
+    strcpy(static_cast<char *>(b), "top block");
+
+    TEST_ASSERT_EQUAL_PTR(b, arena.reallocate(b, 100));
+    TEST_ASSERT_EQUAL(2 * BLOCK_HEADER + 16 + 104, arena.used());
+    TEST_ASSERT_EQUAL_STRING("top block", static_cast<char *>(b));
+
+    // Shrinking gives the tail back, as ArduinoJson's shrinkToFit() does
+    TEST_ASSERT_EQUAL_PTR(b, arena.reallocate(b, 12));
+    TEST_ASSERT_EQUAL(2 * (BLOCK_HEADER + 16), arena.used());
+    TEST_ASSERT_EQUAL(2 * BLOCK_HEADER + 16 + 104, arena.highWater());
+
+    arena.deallocate(b);
+    arena.deallocate(a);
+    TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+void test_reallocate_below_top_copies(void)
+{
+    JsonArena arena(buffer, sizeof(buffer));
+    void *a = arena.allocate(16);
+    strcpy(static_cast<char *>(a), "lower block");
+    void *b = arena.allocate(16);
+
+    // Fits in the block it already has
+    TEST_ASSERT_EQUAL_PTR(a, arena.reallocate(a, 8));
+    TEST_ASSERT_EQUAL(2 * (BLOCK_HEADER + 16), arena.used());
+
+    // Has to move above b; the old block is freed but b keeps it in place
+    void *moved = arena.reallocate(a, 64);
+    TEST_ASSERT_NOT_NULL(moved);
+    TEST_ASSERT_TRUE(moved != a);
+    TEST_ASSERT_EQUAL_STRING("lower block", static_cast<char *>(moved));
+    TEST_ASSERT_EQUAL(3 * BLOCK_HEADER + 16 + 16 + 64, arena.used());
+    TEST_ASSERT_EQUAL_UINT32(3, arena.allocations());
+
+    // Freeing b leaves the moved block on top, with both below it kept
+    arena.deallocate(b);
+    TEST_ASSERT_EQUAL(3 * BLOCK_HEADER + 16 + 16 + 64, arena.used());
+    arena.deallocate(moved);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL_UINT32(1, arena.resets());
+    TEST_ASSERT_EQUAL_UINT32(0, arena.spills());
+}
+
+void test_spills_counted_and_freed(void)
+{
+    alignas(8) uint8_t small[64];
+    JsonArena arena(small, sizeof(small));
+    void *a = arena.allocate(32);
+    TEST_ASSERT_EQUAL(BLOCK_HEADER + 32, arena.used());
+
+    void *spilled = arena.allocate(64);
+    TEST_ASSERT_NOT_NULL(spilled);
+    TEST_ASSERT_TRUE(spilled < (void *)small || spilled >= (void *)(small + sizeof(small)));
+    TEST_ASSERT_EQUAL_UINT32(1, arena.spills());
+    TEST_ASSERT_EQUAL(BLOCK_HEADER + 32, arena.used());
+    memset(spilled, 'x', 64);
+
+    // A spilled block grows on the heap, not in the arena
+    spilled = arena.reallocate(spilled, 256);
+    TEST_ASSERT_NOT_NULL(spilled);
+    memset(spilled, 'y', 256);
+    TEST_ASSERT_EQUAL_UINT32(1, arena.spills());
+    TEST_ASSERT_EQUAL(BLOCK_HEADER + 32, arena.used());
+
+    // The arena block is popped, but the reset waits for the spill
+    arena.deallocate(a);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL_UINT32(0, arena.resets());
+    arena.deallocate(spilled);
+    TEST_ASSERT_EQUAL_UINT32(1, arena.resets());
+    TEST_ASSERT_EQUAL(BLOCK_HEADER + 32, arena.highWater());
+}
+
+void test_reset_when_last_block_freed(void)
+{
+    JsonArena arena(buffer, sizeof(buffer));
+    void *a = arena.allocate(16);
+    void *b = arena.allocate(16);
+
+    // a is on the bottom: freeing it first pops nothing
+    arena.deallocate(a);
+    TEST_ASSERT_EQUAL(2 * (BLOCK_HEADER + 16), arena.used());
+    TEST_ASSERT_EQUAL_UINT32(0, arena.resets());
+
+    arena.deallocate(b);
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_EQUAL_UINT32(1, arena.resets());
+
+    // Starts over at the bottom of the buffer
+    void *c = arena.allocate(16);
+    TEST_ASSERT_EQUAL_PTR(a, c);
+    arena.deallocate(c);
+    TEST_ASSERT_EQUAL_UINT32(2, arena.resets());
+
+    // Nothing allocated: freeing null changes nothing
+    arena.deallocate(nullptr);
+    TEST_ASSERT_EQUAL_UINT32(2, arena.resets());
+}
+
+// One command as dispatchCommands() handles it: the command parsed, a reply
+// built from it and serialized, and both documents gone at the end
+static void handleCommand(JsonArena &arena, const char *command, char *reply, size_t size)
+{
+    JsonDocument doc(&arena);
+    TEST_ASSERT_FALSE(deserializeJson(doc, command));
+
+    JsonDocument response(&arena);
+    response["type"] = doc["type"].as<const char *>();
+    response["userId"] = doc["userId"].as<const char *>();
+    response["code"] = 0;
+    JsonArray ids = response["punchingIds"].to<JsonArray>();
+    for (JsonVariant id : doc["punchingIds"].as<JsonArray>())
+    {
+        ids.add(id.as<uint16_t>());
+    }
+    TEST_ASSERT_TRUE(serializeJson(response, reply, size) > 0);
+}
+
+void test_request_documents_leave_arena_empty(void)
+{
+    const char *commands[] = {
+        "{\"type\":\"enroll\",\"userId\":\"member-1\",\"punchingIds\":[1]}",
+        "{\"type\":\"update\",\"userId\":\"member-2\",\"punchingIds\":[2,3],\"name\":\"Member Two\"}",
+        "{\"type\":\"delete\",\"userId\":\"member-3\",\"punchingIds\":[]}",
+    };
+    JsonArena arena(buffer, sizeof(buffer));
+    char reply[128];
+
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+    {
+        handleCommand(arena, commands[i], reply, sizeof(reply));
+        TEST_ASSERT_EQUAL(0, arena.used());
+        TEST_ASSERT_EQUAL_UINT32(i + 1, arena.resets());
+    }
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"delete\",\"userId\":\"member-3\",\"code\":0,\"punchingIds\":[]}", reply);
+    TEST_ASSERT_TRUE(arena.allocations() > 0);
+    TEST_ASSERT_TRUE(arena.highWater() > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, arena.spills());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_out_of_order_frees_pop);
+    RUN_TEST(test_reallocate_top_in_place);
+    RUN_TEST(test_reallocate_below_top_copies);
+    RUN_TEST(test_spills_counted_and_freed);
+    RUN_TEST(test_reset_when_last_block_freed);
+    RUN_TEST(test_request_documents_leave_arena_empty);
+    return UNITY_END();
+}
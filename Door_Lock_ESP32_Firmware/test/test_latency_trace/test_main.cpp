@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "latency_trace.h"
+#include "sim_clock.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Every value lands in a bucket whose upper bound is at most 25% above it,
+// and buckets are in order
+void test_bucket_bounds(void)
+{
+    uint8_t last = 0;
+    for (uint32_t us = 0; us < (1u << LATENCY_MAX_LOG2); us += 1 + us / 4096)
+    {
+        uint8_t bucket = LatencyHistogram::bucketOf(us);
+        uint32_t upper = LatencyHistogram::bucketUpper(bucket);
+        TEST_ASSERT_TRUE(bucket < LATENCY_BUCKETS);
+        TEST_ASSERT_GREATER_OR_EQUAL(last, bucket);
+        TEST_ASSERT_GREATER_OR_EQUAL(us, upper);
+        TEST_ASSERT_LESS_OR_EQUAL((uint64_t)us + us / 4 + 1, upper);
+        if (bucket > 0)
+        {
+            TEST_ASSERT_LESS_THAN(us, LatencyHistogram::bucketUpper(bucket - 1));
+        }
+        last = bucket;
+    }
+    TEST_ASSERT_EQUAL(LATENCY_BUCKETS - 1, LatencyHistogram::bucketOf(UINT32_MAX));
+}
+
+void test_empty_and_single(void)
+{
+    LatencyHistogram histogram;
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.percentile(50));
+
+    histogram.record(1234);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.count());
+    // Capped at the largest sample rather than the bucket bound
+    TEST_ASSERT_EQUAL_UINT32(1234, histogram.percentile(0));
+    TEST_ASSERT_EQUAL_UINT32(1234, histogram.percentile(99));
+    TEST_ASSERT_EQUAL_UINT32(1234, histogram.max());
+
+    histogram.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.count());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.max());
+}
+
+// A scan-shaped distribution: percentiles against the exact sorted values
+void test_percentiles_match_exact(void)
+{
+    std::mt19937 random(7);
+    std::lognormal_distribution<double> latency(12.3, 0.4); // Around 220 ms
+    std::vector<uint32_t> samples;
+    LatencyHistogram histogram;
+
+    for (int i = 0; i < 20000; i++)
+    {
+        uint32_t us = (uint32_t)latency(random);
+        samples.push_back(us);
+        histogram.record(us);
+    }
+    // A few slow scans from a retried UART read
+    for (int i = 0; i < 50; i++)
+    {
+        samples.push_back(2000000 + i * 1000);
+        histogram.record(2000000 + i * 1000);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    const uint8_t pcts[] = {1, 50, 90, 95, 99, 100};
+    for (uint8_t pct : pcts)
+    {
+        size_t rank = (samples.size() * pct + 99) / 100;
+        uint32_t exact = samples[rank - 1];
+        uint32_t reported = histogram.percentile(pct);
+        TEST_ASSERT_GREATER_OR_EQUAL(exact, reported);
+        TEST_ASSERT_LESS_OR_EQUAL(exact + exact / 4 + 1, reported);
+    }
+    TEST_ASSERT_EQUAL_UINT32(samples.back(), histogram.percentile(100));
+    TEST_ASSERT_EQUAL_UINT32(samples.back(), histogram.max());
+}
+
+// Beyond ~16 s everything shares the last bucket, which reports the max
+// rather than a bound below the samples in it
+void test_overflow_bucket(void)
+{
+    LatencyHistogram histogram;
+    for (int i = 0; i < 98; i++)
+    {
+        histogram.record(200000);
+    }
+    histogram.record(30000000);
+    histogram.record(60000000);
+    TEST_ASSERT_EQUAL_UINT32(60000000, histogram.percentile(100));
+    TEST_ASSERT_EQUAL_UINT32(60000000, histogram.percentile(99));
+    TEST_ASSERT_UINT32_WITHIN(200000 / 4, 200000, histogram.percentile(98));
+}
+
+void test_lap_records_stages(void)
+{
+    SimClock clock;
+    LatencyTrace trace;
+    TraceLap lap(&trace, clock);
+
+    clock.advanceUs(120000);
+    lap.mark(TRACE_GET_IMAGE);
+    clock.advanceUs(70000);
+    lap.mark(TRACE_IMAGE2TZ);
+    clock.advanceUs(10);
+    lap.total(TRACE_DECISION);
+
+    TEST_ASSERT_EQUAL_UINT32(120000, trace.stage(TRACE_GET_IMAGE).max());
+    TEST_ASSERT_EQUAL_UINT32(70000, trace.stage(TRACE_IMAGE2TZ).max());
+    TEST_ASSERT_EQUAL_UINT32(190010, trace.stage(TRACE_DECISION).max());
+    TEST_ASSERT_EQUAL_UINT32(0, trace.stage(TRACE_SEARCH).count());
+
+    // A lap without a trace only reads the clock
+    TraceLap untraced(nullptr, clock);
+    untraced.mark(TRACE_SEARCH);
+    TEST_ASSERT_EQUAL_UINT32(0, trace.stage(TRACE_SEARCH).count());
+
+    trace.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, trace.stage(TRACE_DECISION).count());
+    TEST_ASSERT_EQUAL_STRING("grant", LatencyTrace::stageName(TRACE_GRANT));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_bounds);
+    RUN_TEST(test_empty_and_single);
+    RUN_TEST(test_percentiles_match_exact);
+    RUN_TEST(test_overflow_bucket);
+    RUN_TEST(test_lap_records_stages);
+    return UNITY_END();
+}
@@ -0,0 +1,220 @@
+#include <unity.h>
+#include "access_control.h"
+#include "attendance_journal.h"
+#include "lock_actuator.h"
+#include "member_index.h"
+#include "sim_clock.h"
+#include "sim_fingerprint.h"
+#include "sim_fs.h"
+#include "sim_gpio.h"
+
+#define RELAY_PIN 25
+#define DOOR_PIN  27
+#define FINGER    0xF1
+#define SLOT      7
+
+static const LockConfig withDoor = {RELAY_PIN, true, DOOR_PIN, true, 3000, 500, 30000};
+static const LockConfig noDoor = {RELAY_PIN, true, LOCK_NO_PIN, true, 3000, 500, 30000};
+
+static MemberIndex members;
+
+static bool lookup(uint16_t punchingId, MemberEntry &entry, void *ctx)
+{
+    const MemberEntry *found = static_cast<MemberIndex *>(ctx)->find(punchingId);
+    if (found == nullptr)
+    {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+void setUp(void)
+{
+    members.begin(32);
+    members.clear();
+}
+
+void tearDown(void) {}
+
+// begin() enables the pull-up, so the contact reads open until driven
+static void beginClosed(LockActuator &lock, SimGpio &gpio)
+{
+    lock.begin();
+    gpio.setInput(DOOR_PIN, false);
+    lock.update();
+}
+
+// The relay must switch inside scan(), before the punch is written
+void test_unlock_precedes_storage(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    RamFileSystem fs(clock);
+    SimFingerprintSensor sensor(clock, 32);
+    LockActuator lock(gpio, clock, noDoor);
+    AccessControl access(sensor, clock, lookup, &members);
+    AttendanceJournal journal(fs, "/attendance");
+
+    members.put(SLOT, "member-7", 0, clock.unixTime() + 86400);
+    sensor.setTemplate(SLOT, FINGER);
+    access.setLock(&lock);
+    lock.begin();
+    gpio.edges.clear();
+
+    sensor.touch(FINGER, 1000);
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_GRANTED, access.scan(decision));
+
+    // Nothing has touched storage yet, the relay already switched
+    TEST_ASSERT_EQUAL_UINT32(0, fs.operations());
+    TEST_ASSERT_EQUAL(1, gpio.edges.size());
+    TEST_ASSERT_EQUAL(RELAY_PIN, gpio.edges[0].pin);
+    TEST_ASSERT_TRUE(gpio.edges[0].high);
+    TEST_ASSERT_EQUAL(LOCK_UNLOCKED, lock.state());
+
+    uint64_t unlockedAt = gpio.edges[0].atUs;
+    uint64_t storageStart = clock.elapsedUs();
+    TEST_ASSERT_TRUE(journal.append(decision.punchingId, decision.timestamp, ATTENDANCE_IN));
+    TEST_ASSERT_GREATER_THAN(0, fs.operations());
+    TEST_ASSERT_LESS_OR_EQUAL(storageStart, unlockedAt);
+}
+
+void test_denied_stays_locked(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    SimFingerprintSensor sensor(clock, 32);
+    LockActuator lock(gpio, clock, noDoor);
+    AccessControl access(sensor, clock, lookup, &members);
+
+    members.put(SLOT, "member-7", 0, clock.unixTime() - 1);
+    sensor.setTemplate(SLOT, FINGER);
+    access.setLock(&lock);
+    lock.begin();
+    gpio.edges.clear();
+
+    sensor.touch(FINGER, 1000);
+    AccessDecision decision;
+    TEST_ASSERT_EQUAL(ACCESS_DENIED, access.scan(decision));
+    TEST_ASSERT_EQUAL(0, gpio.edges.size());
+    TEST_ASSERT_EQUAL(LOCK_LOCKED, lock.state());
+}
+
+void test_pulse_relocks_when_nobody_opens(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    LockActuator lock(gpio, clock, withDoor);
+    beginClosed(lock, gpio);
+
+    lock.unlock();
+    TEST_ASSERT_TRUE(gpio.read(RELAY_PIN));
+    clock.advanceMs(2999);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_NONE, lock.update());
+    clock.advanceMs(1);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_RELOCKED, lock.update());
+    TEST_ASSERT_FALSE(gpio.read(RELAY_PIN));
+}
+
+void test_relocks_after_door_closes(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    LockActuator lock(gpio, clock, withDoor);
+    beginClosed(lock, gpio);
+
+    lock.unlock();
+    gpio.setInput(DOOR_PIN, true);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_DOOR_OPENED, lock.update());
+    clock.advanceMs(5000);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_NONE, lock.update());
+    gpio.setInput(DOOR_PIN, false);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_DOOR_CLOSED, lock.update());
+    clock.advanceMs(500);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_RELOCKED, lock.update());
+    TEST_ASSERT_FALSE(gpio.read(RELAY_PIN));
+    TEST_ASSERT_EQUAL_UINT32(0, lock.heldOpens());
+}
+
+// A contact that never reads closed again must not hold the strike open
+void test_stuck_open_contact_relocks(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    LockActuator lock(gpio, clock, withDoor);
+    beginClosed(lock, gpio);
+
+    lock.unlock();
+    gpio.setInput(DOOR_PIN, true);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_DOOR_OPENED, lock.update());
+
+    for (uint32_t ms = 100; ms < 30000; ms += 100)
+    {
+        clock.advanceMs(100);
+        TEST_ASSERT_EQUAL(LOCK_EVENT_NONE, lock.update());
+    }
+    TEST_ASSERT_TRUE(gpio.read(RELAY_PIN));
+
+    clock.advanceMs(100);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_HELD_OPEN, lock.update());
+    TEST_ASSERT_EQUAL(LOCK_LOCKED, lock.state());
+    TEST_ASSERT_FALSE(gpio.read(RELAY_PIN));
+    TEST_ASSERT_EQUAL_UINT32(1, lock.heldOpens());
+
+    // Still reading open: no forced-open alarm, no second held-open
+    clock.advanceMs(60000);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_NONE, lock.update());
+    TEST_ASSERT_EQUAL_UINT32(0, lock.forcedOpens());
+    TEST_ASSERT_EQUAL_UINT32(1, lock.heldOpens());
+
+    gpio.setInput(DOOR_PIN, false);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_DOOR_CLOSED, lock.update());
+}
+
+// A bouncing contact keeps re-entering the relock delay
+void test_bouncing_contact_relocks(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    LockActuator lock(gpio, clock, withDoor);
+    beginClosed(lock, gpio);
+
+    lock.unlock();
+    LockEvent event = LOCK_EVENT_NONE;
+    for (uint32_t ms = 0; ms < 40000 && event != LOCK_EVENT_HELD_OPEN; ms += 100)
+    {
+        gpio.setInput(DOOR_PIN, (ms / 100) % 2 == 0);
+        event = lock.update();
+        TEST_ASSERT_NOT_EQUAL(LOCK_EVENT_RELOCKED, event);
+        clock.advanceMs(100);
+    }
+    TEST_ASSERT_EQUAL(LOCK_EVENT_HELD_OPEN, event);
+    TEST_ASSERT_FALSE(gpio.read(RELAY_PIN));
+}
+
+void test_door_opened_while_locked(void)
+{
+    SimClock clock;
+    SimGpio gpio(clock);
+    LockActuator lock(gpio, clock, withDoor);
+    beginClosed(lock, gpio);
+
+    gpio.setInput(DOOR_PIN, true);
+    TEST_ASSERT_EQUAL(LOCK_EVENT_FORCED_OPEN, lock.update());
+    TEST_ASSERT_EQUAL_UINT32(1, lock.forcedOpens());
+    TEST_ASSERT_FALSE(gpio.read(RELAY_PIN));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unlock_precedes_storage);
+    RUN_TEST(test_denied_stays_locked);
+    RUN_TEST(test_pulse_relocks_when_nobody_opens);
+    RUN_TEST(test_relocks_after_door_closes);
+    RUN_TEST(test_stuck_open_contact_relocks);
+    RUN_TEST(test_bouncing_contact_relocks);
+    RUN_TEST(test_door_opened_while_locked);
+    return UNITY_END();
+}
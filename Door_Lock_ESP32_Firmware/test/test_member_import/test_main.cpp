@@ -0,0 +1,280 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "json_arena.h"
+#include "member_import.h"
+#include "member_store.h"
+#include "sim_fs.h"
+
+#define STORE_PATH   "/members.bin"
+#define STAGING_PATH "/members.bin.new"
+#define CAPACITY     100
+
+// memberLines(1, 20) and memberLines(21, 40), each its own gzip member in base64
+static const char gzipChunk0[] =
+    "H4sIAAAAAAACA5XTOw6CQBSF4d5lTA3JnHnx6C1YgBsQjNIgAamIexfb+9DM1DdfpvjPbrb1tnSDac3FHg+mMPM29Y9xuncDTIvCrNt1"
+    "7Zdxfo3P6Tx9T511qbSuPM7fp50QjhJOJ7xMeEp4nQgyESgRdCLKRKRE1IkkE4kSSScqmagoUelELRM1JWqdaGSioUSjErAiAcvSsroB"
+    "2eB56n1C7hOsT/wIVPkHCxQ+dydghSLkDgUsUcTcpYA1ipQ7FbBIUeVuBaxS1LljAcsUTe5aHOvU2b9z+QB4QIfSRwUAAA==";
+static const char gzipChunk1[] =
+    "H4sIAAAAAAACA5XTPQ6CQBDF8d5jbC3J7L5l+egtOIAXEIzSIAGpiHc3tryZmO0nv0zxf7vb1vvSDa51VxEJ3p3dvE39c5we3eBdG/zZ"
+    "rdtt7Zdxfo+v6TL9boOEVHgpxLvPaT8YgYxgG143QAZsI+hGJCOahhh/lGSUtmH8kchItgHdqMiobCPqRk1GbRulbjRkNLaRVANyNCC2"
+    "UekGdQq7U6l1gzqF3ak0ukGdArl7AXWKmLsXUKcoc/cC6hQpdy+gTlHl7gXUKercvYA6RZO7l0idRvm7ly9SdgvqUAUAAA==";
+
+alignas(8) static uint8_t arenaBuffer[8192];
+static RamFileSystem fs;
+
+void setUp(void)
+{
+    fs = RamFileSystem();
+}
+
+void tearDown(void) {}
+
+static MemberRecord member(uint16_t punchingId, const char *userId)
+{
+    MemberRecord record;
+    memset(&record, 0, sizeof(record));
+    record.punchingId1 = punchingId;
+    strncpy(record.userId, userId, sizeof(record.userId) - 1);
+    return record;
+}
+
+static MemberImportStatus sendText(MemberImport &import, uint32_t id, uint32_t seq, const char *text)
+{
+    return import.chunk(id, seq, text, strlen(text), false);
+}
+
+static bool live(MemberStore &store, uint16_t slot, const char *userId)
+{
+    MemberRecord record;
+    return store.read(slot, record) == MEMBER_STORE_OK && strcmp(record.userId, userId) == 0;
+}
+
+// A line cut between two chunks is joined, a resent chunk is ignored and a
+// skipped one is refused without closing the import
+void test_chunk_sequencing(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    const char *first = "{\"userId\":\"A\",\"punchingId1\":3}\n{\"userId\":\"B\",\"punch";
+    const char *second = "ingId1\":4,\"subscriptionEnd\":\"2025-06-08\"}\n";
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(1, false));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 0, first));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 0, first));
+    TEST_ASSERT_EQUAL(1, import.nextSeq());
+
+    TEST_ASSERT_EQUAL(IMPORT_ERR_SEQUENCE, sendText(import, 1, 2, second));
+    TEST_ASSERT_TRUE(import.active());
+    TEST_ASSERT_EQUAL(1, import.nextSeq());
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 1, second));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(1));
+    TEST_ASSERT_EQUAL(2, import.imported());
+    TEST_ASSERT_EQUAL(0, import.rejected());
+
+    MemberRecord record;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(4, record));
+    TEST_ASSERT_EQUAL_STRING("B", record.userId);
+    TEST_ASSERT_EQUAL_UINT32(1749340800, record.subsEndInSec);
+    TEST_ASSERT_TRUE(live(store, 3, "A"));
+    TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+void test_other_ids_are_not_open(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    TEST_ASSERT_EQUAL(IMPORT_ERR_NOT_OPEN, sendText(import, 1, 0, "{}"));
+    TEST_ASSERT_EQUAL(IMPORT_ERR_NOT_OPEN, import.commit(1));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(1, false));
+    TEST_ASSERT_EQUAL(IMPORT_ERR_NOT_OPEN, sendText(import, 2, 0, "{}"));
+    TEST_ASSERT_EQUAL(IMPORT_ERR_NOT_OPEN, import.commit(2));
+    TEST_ASSERT_TRUE(import.active());
+}
+
+// Records stay in the staging file until commit; a merge keeps other slots
+void test_merge_commits_together(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    MemberRecord old = member(7, "OLD");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(old));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(5, false));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 5, 0, "{\"userId\":\"A\",\"punchingId1\":3}\n"));
+    TEST_ASSERT_FALSE(live(store, 3, "A"));
+    TEST_ASSERT_TRUE(fs.exists(STAGING_PATH));
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(5));
+    TEST_ASSERT_FALSE(import.active());
+    TEST_ASSERT_FALSE(fs.exists(STAGING_PATH));
+    TEST_ASSERT_TRUE(live(store, 3, "A"));
+    TEST_ASSERT_TRUE(live(store, 7, "OLD"));
+
+    // A resent last chunk or commit is acknowledged again
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 5, 0, "{}"));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(5));
+}
+
+// Too long, no userId, slot 0 and out of range slots are skipped, and the
+// stream need not end with a newline
+void test_bad_lines_are_rejected(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    char longLine[MEMBER_IMPORT_LINE_MAX + 40];
+    memset(longLine, 'x', sizeof(longLine) - 2);
+    longLine[sizeof(longLine) - 2] = '\n';
+    longLine[sizeof(longLine) - 1] = '\0';
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(1, false));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 0, longLine));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 1,
+                                          "{\"name\":\"no id\",\"punchingId1\":5}\n"
+                                          "not json\r\n"
+                                          "\n"
+                                          "{\"userId\":\"Z\",\"punchingId1\":100}\n"
+                                          "{\"userId\":\"S\",\"punchingId1\":0}\n"
+                                          "{\"userId\":\"C\",\"punchingId1\":5}"));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(1));
+    TEST_ASSERT_EQUAL(1, import.imported());
+    TEST_ASSERT_EQUAL(5, import.rejected());
+    TEST_ASSERT_TRUE(live(store, 5, "C"));
+}
+
+// Two gzip chunks of 20 members each, replacing what was there
+void test_gzip_chunks_replace(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    MemberRecord old = member(70, "OLD");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(old));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(9, true));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.chunk(9, 0, gzipChunk0, strlen(gzipChunk0), true));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.chunk(9, 1, gzipChunk1, strlen(gzipChunk1), true));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(9));
+    TEST_ASSERT_EQUAL(40, import.imported());
+    TEST_ASSERT_EQUAL(0, import.rejected());
+
+    char userId[8];
+    for (uint16_t slot = 1; slot <= 40; slot++)
+    {
+        snprintf(userId, sizeof(userId), "U%05u", slot);
+        TEST_ASSERT_TRUE_MESSAGE(live(store, slot, userId), userId);
+    }
+    MemberRecord record;
+    TEST_ASSERT_NOT_EQUAL(MEMBER_STORE_OK, store.read(70, record));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(11, record));
+    TEST_ASSERT_EQUAL_UINT32(1796083200, record.subsEndInSec); // 2026-12-01
+}
+
+// A bad chunk aborts the import and leaves the live file as it was
+void test_bad_gzip_aborts(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    MemberRecord old = member(7, "OLD");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(old));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(2, true));
+    TEST_ASSERT_EQUAL(IMPORT_ERR_DECODE, import.chunk(2, 0, "!!!", 3, true));
+    TEST_ASSERT_FALSE(import.active());
+    TEST_ASSERT_FALSE(fs.exists(STAGING_PATH));
+
+    // Valid base64, but the gzip member is cut short
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(3, true));
+    TEST_ASSERT_EQUAL(IMPORT_ERR_DECODE, import.chunk(3, 0, gzipChunk0, 100, true));
+    TEST_ASSERT_FALSE(import.active());
+    TEST_ASSERT_EQUAL(IMPORT_ERR_NOT_OPEN, import.commit(3));
+    TEST_ASSERT_TRUE(live(store, 7, "OLD"));
+}
+
+// abort() and a new begin() both drop the staged records
+void test_abort_and_restart(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(1, false));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 0, "{\"userId\":\"A\",\"punchingId1\":3}\n"));
+    import.abort();
+    TEST_ASSERT_FALSE(import.active());
+    TEST_ASSERT_FALSE(fs.exists(STAGING_PATH));
+
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(2, false));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 2, 0, "{\"userId\":\"B\",\"punchingId1\":4}\n"));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(3, false));
+    TEST_ASSERT_EQUAL(0, import.nextSeq());
+    TEST_ASSERT_EQUAL(IMPORT_ERR_NOT_OPEN, sendText(import, 2, 1, "{}"));
+    TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 3, 0, "{\"userId\":\"C\",\"punchingId1\":5}\n"));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(3));
+
+    MemberRecord record;
+    TEST_ASSERT_NOT_EQUAL(MEMBER_STORE_OK, store.read(3, record));
+    TEST_ASSERT_NOT_EQUAL(MEMBER_STORE_OK, store.read(4, record));
+    TEST_ASSERT_TRUE(live(store, 5, "C"));
+}
+
+// Power lost with an import open: the next boot drops the staging file
+void test_reboot_drops_staging(void)
+{
+    {
+        MemberStore store(fs, STORE_PATH);
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+        MemberRecord old = member(9, "OLD");
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(old));
+        JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+        MemberImport import(store, &arena, 0);
+        TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(1, true));
+        TEST_ASSERT_EQUAL(IMPORT_OK, sendText(import, 1, 0, "{\"userId\":\"A\",\"punchingId1\":3}\n"));
+        TEST_ASSERT_TRUE(fs.exists(STAGING_PATH));
+    }
+
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_FALSE(fs.exists(STAGING_PATH));
+    TEST_ASSERT_TRUE(live(store, 9, "OLD"));
+    TEST_ASSERT_FALSE(live(store, 3, "A"));
+}
+
+void test_status_names(void)
+{
+    for (int status = IMPORT_OK; status < IMPORT_STATUS_COUNT; status++)
+    {
+        TEST_ASSERT_NOT_EQUAL(0, strcmp("unknown", MemberImport::statusName((MemberImportStatus)status)));
+    }
+    TEST_ASSERT_EQUAL_STRING("unknown", MemberImport::statusName(IMPORT_STATUS_COUNT));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_chunk_sequencing);
+    RUN_TEST(test_other_ids_are_not_open);
+    RUN_TEST(test_merge_commits_together);
+    RUN_TEST(test_bad_lines_are_rejected);
+    RUN_TEST(test_gzip_chunks_replace);
+    RUN_TEST(test_bad_gzip_aborts);
+    RUN_TEST(test_abort_and_restart);
+    RUN_TEST(test_reboot_drops_staging);
+    RUN_TEST(test_status_names);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+#include <unity.h>
+#include <ArduinoJson.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "member_index.h"
+#include "sim_clock.h"
+#include "sim_fs.h"
+
+#define CAPACITY   1000
+#define SUBS_END   1767225600 // 2026-01-01
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_put_find_remove(void)
+{
+    MemberIndex index;
+    TEST_ASSERT_TRUE(index.begin(CAPACITY));
+    TEST_ASSERT_NULL(index.find(7));
+
+    TEST_ASSERT_TRUE(index.put(7, "member-7", 0, SUBS_END));
+    const MemberEntry *entry = index.find(7);
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL_STRING("member-7", entry->userId);
+    TEST_ASSERT_EQUAL_UINT32(SUBS_END, entry->subsEndInSec);
+    TEST_ASSERT_EQUAL(1, index.count());
+
+    // Overwriting a slot does not count it twice
+    TEST_ASSERT_TRUE(index.put(7, "member-7b", 1, 0));
+    TEST_ASSERT_EQUAL(1, index.count());
+    TEST_ASSERT_EQUAL(1, index.find(7)->userType);
+
+    TEST_ASSERT_TRUE(index.remove(7));
+    TEST_ASSERT_FALSE(index.remove(7));
+    TEST_ASSERT_NULL(index.find(7));
+    TEST_ASSERT_EQUAL(0, index.count());
+}
+
+void test_out_of_range(void)
+{
+    MemberIndex index;
+    TEST_ASSERT_NULL(index.find(1)); // Before begin()
+    TEST_ASSERT_TRUE(index.begin(10));
+    TEST_ASSERT_FALSE(index.put(10, "x", 0, 0));
+    TEST_ASSERT_FALSE(index.remove(10));
+    TEST_ASSERT_NULL(index.find(65535));
+}
+
+// A cut userId could no longer be found by the server's id
+void test_long_user_id_rejected(void)
+{
+    MemberIndex index;
+    index.begin(4);
+    TEST_ASSERT_FALSE(index.put(1, "65f1c2a9e4b0a1b2c3d4e5f6", 0, 0)); // 24 characters
+    TEST_ASSERT_NULL(index.find(1));
+    TEST_ASSERT_TRUE(index.put(1, "65f1c2a9e4b0a1b2c3d4e5f", 0, 0));
+    TEST_ASSERT_EQUAL_STRING("65f1c2a9e4b0a1b2c3d4e5f", index.find(1)->userId);
+    TEST_ASSERT_TRUE(index.put(2, nullptr, 0, 0));
+    TEST_ASSERT_EQUAL_STRING("", index.find(2)->userId);
+}
+
+// Rebuilding at the same or a smaller capacity reuses the table
+void test_begin_again_clears(void)
+{
+    MemberIndex index;
+    index.begin(CAPACITY);
+    index.put(3, "member-3", 0, SUBS_END);
+    TEST_ASSERT_TRUE(index.begin(CAPACITY / 2));
+    TEST_ASSERT_EQUAL(CAPACITY, index.capacity());
+    TEST_ASSERT_EQUAL(0, index.count());
+    TEST_ASSERT_NULL(index.find(3));
+}
+
+// The lookup checkFingerprint() did before the index: load and parse
+// members.json, then walk the array for the punching ID
+static int jsonLookup(RamFileSystem &fs, uint16_t punchingId, uint32_t &subsEnd)
+{
+    std::string text(fs.size("/members.json"), '\0');
+    fs.readAt("/members.json", 0, &text[0], text.size());
+    JsonDocument doc;
+    if (deserializeJson(doc, text))
+    {
+        return -1;
+    }
+
+    JsonArray members = doc.as<JsonArray>();
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        JsonObject member = members[i];
+        if (member["punchingId1"] == punchingId || member["punchingId2"] == punchingId)
+        {
+            subsEnd = member["subsEndInSec"].as<uint32_t>();
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// The members.json cost grows with the member count, the index lookup does not
+static void benchmarkMembers(uint16_t members)
+{
+    const int scans = 200;
+    char message[224];
+
+    SimClock clock;
+    RamFileSystem fs(clock);
+    std::string text = "[";
+    MemberIndex index;
+    index.begin(members + 1); // Slot 0 is never a punching ID
+    for (uint16_t id = 1; id <= members; id++)
+    {
+        char member[160];
+        snprintf(member, sizeof(member),
+                 "%s{\"userId\":\"member-%u\",\"name\":\"Member %u\",\"userType\":0,\"punchingId1\":%u,"
+                 "\"punchingId2\":0,\"subsEndInSec\":%u}",
+                 id > 1 ? "," : "", id, id, id, SUBS_END + id);
+        text += member;
+        index.put(id, "member", 0, SUBS_END + id);
+    }
+    text += "]";
+    fs.create("/members.json");
+    fs.append("/members.json", text.data(), text.size());
+
+    // Members at the end of the file cost the most, scan across all of them
+    uint64_t flashBefore = clock.elapsedUs();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < scans; i++)
+    {
+        uint16_t id = 1 + (i * 7) % members;
+        uint32_t subsEnd = 0;
+        TEST_ASSERT_EQUAL(id - 1, jsonLookup(fs, id, subsEnd));
+        TEST_ASSERT_EQUAL_UINT32(SUBS_END + id, subsEnd);
+    }
+    double jsonCpuUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / scans;
+    double jsonFlashUs = (double)(clock.elapsedUs() - flashBefore) / scans;
+
+    uint32_t ops = fs.operations();
+    start = std::chrono::steady_clock::now();
+    uint32_t found = 0;
+    for (int i = 0; i < scans * 1000; i++)
+    {
+        const MemberEntry *entry = index.find(1 + (i * 7) % members);
+        found += entry != nullptr && entry->subsEndInSec > SUBS_END;
+    }
+    double indexCpuUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / (scans * 1000);
+
+    snprintf(message, sizeof(message),
+             "%4u members: members.json %.0f us flash + %.1f us parse per scan (%u bytes), "
+             "index %.4f us per scan (%u bytes of RAM)",
+             members, jsonFlashUs, jsonCpuUs, (unsigned)text.size(), indexCpuUs,
+             (unsigned)(index.capacity() * sizeof(MemberEntry)));
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(scans * 1000, found);
+    TEST_ASSERT_EQUAL_UINT32(0, fs.operations() - ops);
+    TEST_ASSERT_TRUE(indexCpuUs * 100 < jsonCpuUs);
+}
+
+void test_benchmark_against_json_lookup(void)
+{
+    const uint16_t sizes[] = {100, 500, 1000};
+    for (uint16_t members : sizes)
+    {
+        benchmarkMembers(members);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_put_find_remove);
+    RUN_TEST(test_out_of_range);
+    RUN_TEST(test_long_user_id_rejected);
+    RUN_TEST(test_begin_again_clears);
+    RUN_TEST(test_benchmark_against_json_lookup);
+    return UNITY_END();
+}
@@ -0,0 +1,231 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "json_arena.h"
+#include "member_list.h"
+#include "member_store.h"
+#include "sim_fs.h"
+#include "sim_mqtt.h"
+
+#define TOPIC      "unimanage/acme/north/door-1/callback"
+#define ARENA_SIZE 8192 // JSON_ARENA_SIZE in the firmware's config.h
+
+// Counts the chunks the socket sees
+class CountingTransport : public SimMqttTransport
+{
+public:
+    size_t write(const uint8_t *data, size_t length) override
+    {
+        writes++;
+        largestWrite = length > largestWrite ? length : largestWrite;
+        return SimMqttTransport::write(data, length);
+    }
+
+    uint32_t writes = 0;
+    size_t largestWrite = 0;
+};
+
+struct Walk
+{
+    MemberStore *store;
+    JsonArena *arena;
+    uint16_t failAfter; // Fail the second pass after this many members, 0 for never
+};
+
+static RamFileSystem fs;
+alignas(8) static uint8_t arenaBuffer[ARENA_SIZE];
+
+void setUp(void)
+{
+    fs = RamFileSystem();
+}
+
+void tearDown(void) {}
+
+// forEach() has one context pointer, and it carries the stream
+static Walk *currentWalk = nullptr;
+
+static bool streamMember(const MemberRecord &record, void *ctx)
+{
+    MemberListStream &stream = *static_cast<MemberListStream *>(ctx);
+    if (currentWalk->failAfter != 0 && stream.out != nullptr && stream.count == currentWalk->failAfter)
+    {
+        return false;
+    }
+    JsonDocument member(currentWalk->arena);
+    memberRecordToJson(record, member.to<JsonObject>());
+    memberListItem(stream, member);
+    return true;
+}
+
+// Same shape as walkAllMembers() in the firmware
+static bool walkMembers(MemberListStream &stream, void *ctx)
+{
+    currentWalk = static_cast<Walk *>(ctx);
+    MemberStoreStatus status = currentWalk->store->forEach(streamMember, &stream);
+    return status == MEMBER_STORE_OK && (currentWalk->failAfter == 0 || stream.out == nullptr ||
+                                         stream.count < currentWalk->failAfter);
+}
+
+static void fillStore(MemberStore &store, uint16_t members)
+{
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(members + 1));
+    for (uint16_t id = 1; id <= members; id++)
+    {
+        MemberRecord record;
+        memset(&record, 0, sizeof(record));
+        record.punchingId1 = id;
+        record.subsEndInSec = 1767225600 + id;
+        snprintf(record.userId, sizeof(record.userId), "member-%04u", id);
+        snprintf(record.name, sizeof(record.name), "Member Number %u", id);
+        snprintf(record.subscriptionEnd, sizeof(record.subscriptionEnd), "2026-01-01T00:00:00.000Z");
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(record));
+    }
+}
+
+static MemberListStatus publish(CountingTransport &transport, MemberStore &store, JsonArena &arena,
+                                WireEncoding encoding, uint16_t failAfter = 0)
+{
+    JsonDocument envelope(&arena);
+    envelope["type"] = "deviceInfo";
+    envelope["timeStamp"] = 1767225600;
+    envelope["revision"] = store.revision();
+    envelope["members"].to<JsonArray>();
+
+    Walk walk = {&store, &arena, failAfter};
+    return memberListPublish(transport, TOPIC, encoding, envelope, walkMembers, &walk);
+}
+
+static void checkMessage(const SimMqttTransport::Message &message, WireEncoding encoding, uint16_t members)
+{
+    JsonDocument doc;
+    DeserializationError error = encoding == WIRE_MSGPACK ? deserializeMsgPack(doc, message.payload.data(), message.payload.size())
+                                                          : deserializeJson(doc, message.payload.data(), message.payload.size());
+    TEST_ASSERT_FALSE(error);
+    TEST_ASSERT_EQUAL_STRING("deviceInfo", doc["type"] | "");
+    JsonArray list = doc["members"];
+    TEST_ASSERT_EQUAL(members, list.size());
+    TEST_ASSERT_EQUAL_STRING("member-0001", list[0]["userId"] | "");
+    TEST_ASSERT_EQUAL_UINT32(1767225600 + members, list[members - 1]["subsEndInSec"] | 0u);
+}
+
+void test_json_list(void)
+{
+    MemberStore store(fs, "/members.bin");
+    fillStore(store, 40);
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CountingTransport transport;
+
+    TEST_ASSERT_EQUAL(MEMBER_LIST_OK, publish(transport, store, arena, WIRE_JSON));
+    TEST_ASSERT_EQUAL(1, transport.messages.size());
+    TEST_ASSERT_EQUAL_STRING(TOPIC, transport.messages[0].topic.c_str());
+    checkMessage(transport.messages[0], WIRE_JSON, 40);
+}
+
+// More than 15 elements needs the 16-bit MessagePack array header
+void test_msgpack_list(void)
+{
+    MemberStore store(fs, "/members.bin");
+    fillStore(store, 40);
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CountingTransport transport;
+
+    TEST_ASSERT_EQUAL(MEMBER_LIST_OK, publish(transport, store, arena, WIRE_MSGPACK));
+    TEST_ASSERT_EQUAL(1, transport.messages.size());
+    checkMessage(transport.messages[0], WIRE_MSGPACK, 40);
+}
+
+void test_empty_list(void)
+{
+    MemberStore store(fs, "/members.bin");
+    store.begin(8);
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    CountingTransport transport;
+
+    TEST_ASSERT_EQUAL(MEMBER_LIST_OK, publish(transport, store, arena, WIRE_JSON));
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, transport.messages[0].payload.data(), transport.messages[0].payload.size()));
+    TEST_ASSERT_EQUAL(0, doc["members"].as<JsonArray>().size());
+}
+
+// 1000 members: the payload grows, the memory used to build it does not
+void test_peak_memory_is_flat(void)
+{
+    char message[160];
+    size_t peaks[2];
+    const uint16_t counts[2] = {10, 1000};
+
+    for (int run = 0; run < 2; run++)
+    {
+        fs = RamFileSystem();
+        MemberStore store(fs, "/members.bin");
+        fillStore(store, counts[run]);
+        JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+        CountingTransport transport;
+
+        TEST_ASSERT_EQUAL(MEMBER_LIST_OK, publish(transport, store, arena, WIRE_JSON));
+        checkMessage(transport.messages[0], WIRE_JSON, counts[run]);
+        TEST_ASSERT_EQUAL_UINT32(0, arena.spills());
+        TEST_ASSERT_EQUAL(0, arena.used());
+        TEST_ASSERT_LESS_OR_EQUAL(BUFFERED_PRINT_SIZE, transport.largestWrite);
+        peaks[run] = arena.highWater();
+
+        // What the reply cost before streaming: one document holding every
+        // member, then a copy of the serialized payload
+        size_t payload = transport.messages[0].payload.size();
+        static uint8_t wholeBuffer[1 << 20];
+        JsonArena wholeArena(wholeBuffer, sizeof(wholeBuffer));
+        size_t wholePeak;
+        {
+            JsonDocument whole(&wholeArena);
+            TEST_ASSERT_FALSE(deserializeJson(whole, transport.messages[0].payload.data(), transport.messages[0].payload.size()));
+            wholePeak = wholeArena.highWater() + payload + 1;
+        }
+
+        snprintf(message, sizeof(message), "%4u members: %6u byte payload in %4u writes, peak %4u bytes (whole document: %u)",
+                 counts[run], (unsigned)payload, transport.writes, (unsigned)peaks[run], (unsigned)wholePeak);
+        TEST_MESSAGE(message);
+        if (run == 1)
+        {
+            TEST_ASSERT_GREATER_THAN(10 * peaks[run], wholePeak);
+        }
+    }
+    TEST_ASSERT_EQUAL(peaks[0], peaks[1]);
+}
+
+void test_failures(void)
+{
+    MemberStore store(fs, "/members.bin");
+    fillStore(store, 20);
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+
+    // Broker gone: nothing half sent
+    CountingTransport offline;
+    offline.online = false;
+    TEST_ASSERT_EQUAL(MEMBER_LIST_ERR_PUBLISH, publish(offline, store, arena, WIRE_JSON));
+    TEST_ASSERT_EQUAL(0, offline.messages.size());
+
+    // Store fails while writing: the broker would get a short message
+    CountingTransport transport;
+    TEST_ASSERT_EQUAL(MEMBER_LIST_ERR_TRUNCATED, publish(transport, store, arena, WIRE_JSON, 5));
+    TEST_ASSERT_EQUAL(0, transport.messages.size());
+
+    // An envelope that does not end in an empty array
+    JsonDocument envelope(&arena);
+    envelope["members"].to<JsonArray>();
+    envelope["type"] = "deviceInfo";
+    Walk walk = {&store, &arena, 0};
+    TEST_ASSERT_EQUAL(MEMBER_LIST_ERR_FRAME, memberListPublish(transport, TOPIC, WIRE_JSON, envelope, walkMembers, &walk));
+    TEST_ASSERT_EQUAL_STRING("bad envelope", memberListStatusName(MEMBER_LIST_ERR_FRAME));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_json_list);
+    RUN_TEST(test_msgpack_list);
+    RUN_TEST(test_empty_list);
+    RUN_TEST(test_peak_memory_is_flat);
+    RUN_TEST(test_failures);
+    return UNITY_END();
+}
@@ -0,0 +1,336 @@
+#include <unity.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include "json_arena.h"
+#include "member_import.h"
+#include "member_log.h"
+#include "member_store.h"
+#include "sim_fs.h"
+
+#define STORE_PATH "/members.bin"
+#define LOG_PATH   "/members.log"
+#define CAPACITY   100
+#define LOG_SLOTS  16
+
+// Net changes reported by changesSince(), by slot
+struct Changes
+{
+    uint8_t change[CAPACITY];
+    char userId[CAPACITY][MEMBER_USER_ID_LEN];
+    uint16_t count;
+};
+
+alignas(8) static uint8_t arenaBuffer[8192];
+static RamFileSystem fs;
+static Changes changes;
+
+void setUp(void)
+{
+    fs = RamFileSystem();
+    memset(&changes, 0, sizeof(changes));
+}
+
+void tearDown(void) {}
+
+static bool collect(uint16_t slot, MemberChange change, const char *userId, void *ctx)
+{
+    Changes &out = *static_cast<Changes *>(ctx);
+    TEST_ASSERT_EQUAL(0, out.change[slot]); // One net change per slot
+    out.change[slot] = change;
+    strncpy(out.userId[slot], userId, MEMBER_USER_ID_LEN - 1);
+    out.count++;
+    return true;
+}
+
+static bool changesSince(MemberLog &log, uint32_t since)
+{
+    memset(&changes, 0, sizeof(changes));
+    return log.changesSince(since, collect, &changes);
+}
+
+static MemberRecord member(uint16_t punchingId, const char *userId)
+{
+    MemberRecord record;
+    memset(&record, 0, sizeof(record));
+    record.punchingId1 = punchingId;
+    strncpy(record.userId, userId, sizeof(record.userId) - 1);
+    return record;
+}
+
+static void put(MemberStore &store, uint16_t slot, const char *userId)
+{
+    MemberRecord record = member(slot, userId);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(record));
+}
+
+// Each slot shows up once with its net change since the given revision
+void test_net_changes(void)
+{
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    uint32_t start = store.revision();
+    TEST_ASSERT_EQUAL_UINT32(start + 1, log.oldest());
+
+    put(store, 3, "A");
+    put(store, 4, "B");
+    uint32_t added = store.revision();
+    TEST_ASSERT_EQUAL_UINT32(start + 2, added);
+    TEST_ASSERT_EQUAL_UINT32(added, log.revision());
+
+    put(store, 4, "B2");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.erase(3));
+    put(store, 5, "C");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.erase(5));
+    store.erase(7); // Already empty, no revision
+    TEST_ASSERT_EQUAL_UINT32(added + 4, store.revision());
+
+    TEST_ASSERT_TRUE(changesSince(log, added));
+    TEST_ASSERT_EQUAL(2, changes.count);
+    TEST_ASSERT_EQUAL(MEMBER_CHANGE_UPDATE, changes.change[4]);
+    TEST_ASSERT_EQUAL_STRING("B2", changes.userId[4]);
+    TEST_ASSERT_EQUAL(MEMBER_CHANGE_DELETE, changes.change[3]);
+    TEST_ASSERT_EQUAL_STRING("A", changes.userId[3]); // Who was deleted
+
+    // From the start, A and C never existed and B is new
+    TEST_ASSERT_TRUE(changesSince(log, start));
+    TEST_ASSERT_EQUAL(1, changes.count);
+    TEST_ASSERT_EQUAL(MEMBER_CHANGE_ADD, changes.change[4]);
+
+    TEST_ASSERT_TRUE(changesSince(log, store.revision()));
+    TEST_ASSERT_EQUAL(0, changes.count);
+    TEST_ASSERT_FALSE(log.covers(store.revision() + 1));
+    TEST_ASSERT_FALSE(changesSince(log, store.revision() + 1));
+}
+
+void test_history_survives_reboot(void)
+{
+    uint32_t revision, since;
+    {
+        MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+        MemberStore store(fs, STORE_PATH, &log);
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+        put(store, 3, "A");
+        since = store.revision();
+        put(store, 4, "B");
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.erase(3));
+        revision = store.revision();
+    }
+
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_EQUAL_UINT32(revision, store.revision());
+    TEST_ASSERT_TRUE(changesSince(log, since));
+    TEST_ASSERT_EQUAL(2, changes.count);
+    TEST_ASSERT_EQUAL(MEMBER_CHANGE_ADD, changes.change[4]);
+    TEST_ASSERT_EQUAL(MEMBER_CHANGE_DELETE, changes.change[3]);
+}
+
+// Past LOG_SLOTS changes the oldest fall off the ring
+void test_ring_wraps(void)
+{
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    put(store, 3, "A");
+    uint32_t early = store.revision();
+
+    for (int i = 0; i < 20; i++)
+    {
+        put(store, 10 + i % 3, "W");
+    }
+    uint32_t revision = store.revision();
+    TEST_ASSERT_EQUAL_UINT32(revision - LOG_SLOTS + 1, log.oldest());
+    TEST_ASSERT_FALSE(log.covers(early));
+    TEST_ASSERT_TRUE(log.covers(revision - LOG_SLOTS));
+    TEST_ASSERT_FALSE(log.covers(revision - LOG_SLOTS - 1));
+    TEST_ASSERT_FALSE(changesSince(log, early));
+
+    TEST_ASSERT_TRUE(changesSince(log, revision - LOG_SLOTS));
+    TEST_ASSERT_EQUAL(3, changes.count);
+    TEST_ASSERT_EQUAL(MEMBER_CHANGE_UPDATE, changes.change[10]);
+}
+
+// An append that reached flash before the store header did still counts
+void test_log_ahead_of_store(void)
+{
+    uint32_t before;
+    {
+        MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+        MemberStore store(fs, STORE_PATH, &log);
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+        put(store, 3, "A");
+        before = store.revision();
+        TEST_ASSERT_TRUE(log.append(20, MEMBER_CHANGE_ADD, "Z"));
+    }
+
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_EQUAL_UINT32(before + 1, store.revision());
+}
+
+// Without its log the store keeps counting, but has no history to offer
+void test_lost_log_drops_history(void)
+{
+    uint32_t before;
+    {
+        MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+        MemberStore store(fs, STORE_PATH, &log);
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+        put(store, 3, "A");
+        put(store, 4, "B");
+        before = store.revision();
+    }
+    TEST_ASSERT_TRUE(fs.remove(LOG_PATH));
+
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_GREATER_OR_EQUAL(before, store.revision());
+    TEST_ASSERT_FALSE(log.covers(before - 1));
+    TEST_ASSERT_TRUE(log.covers(store.revision()));
+}
+
+// An import is one revision that resets the history, even when the swap
+// landed and the log reset did not
+void test_import_resets_history(void)
+{
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    put(store, 3, "A");
+    uint32_t before = store.revision();
+
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+    MemberImport import(store, &arena, 0);
+    const char *text = "{\"userId\":\"I\",\"punchingId1\":2}";
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(1, true));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.chunk(1, 0, text, strlen(text), false));
+    put(store, 9, "E"); // A live write while the import is open
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(1));
+    TEST_ASSERT_EQUAL_UINT32(before + 2, store.revision());
+    TEST_ASSERT_FALSE(log.covers(before));
+    TEST_ASSERT_TRUE(log.covers(before + 2));
+
+    MemberRecord record;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(2, record));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(9, record));
+
+    // Power cut after the swap: roll the log header back to before the reset
+    uint32_t swapped = store.revision();
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.begin(2, false));
+    TEST_ASSERT_EQUAL(IMPORT_OK, import.commit(2));
+    MemberLogHeader header;
+    TEST_ASSERT_TRUE(fs.readAt(LOG_PATH, 0, &header, sizeof(header)));
+    header.baseRevision = 0;
+    TEST_ASSERT_TRUE(fs.writeAt(LOG_PATH, 0, &header, sizeof(header)));
+
+    MemberLog rebootedLog(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore rebooted(fs, STORE_PATH, &rebootedLog);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, rebooted.begin(CAPACITY));
+    TEST_ASSERT_EQUAL_UINT32(swapped + 1, rebooted.revision());
+    TEST_ASSERT_FALSE(rebootedLog.covers(swapped));
+}
+
+void test_format_keeps_counting(void)
+{
+    MemberLog log(fs, LOG_PATH, LOG_SLOTS);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    put(store, 3, "A");
+    uint32_t before = store.revision();
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.format(CAPACITY));
+    TEST_ASSERT_GREATER_THAN(before, store.revision());
+    TEST_ASSERT_FALSE(log.covers(before));
+}
+
+// A server that applies every delta it is offered, and reloads everything
+// when it fell too far behind, always ends up with the device's members
+void test_random_replay_matches_store(void)
+{
+    const uint16_t capacity = 40;
+    MemberLog log(fs, LOG_PATH, 64);
+    MemberStore store(fs, STORE_PATH, &log);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(capacity));
+
+    static char server[CAPACITY][MEMBER_USER_ID_LEN];
+    memset(server, 0, sizeof(server));
+    uint32_t seen = store.revision();
+    int deltas = 0, reloads = 0;
+    std::mt19937 random(1);
+
+    for (int round = 0; round < 500; round++)
+    {
+        int writes = random() % 100;
+        for (int i = 0; i < writes; i++)
+        {
+            uint16_t slot = 1 + random() % 30;
+            if (random() % 3 == 0)
+            {
+                store.erase(slot);
+            }
+            else
+            {
+                char userId[12];
+                snprintf(userId, sizeof(userId), "u%u", (unsigned)(random() % 50));
+                put(store, slot, userId);
+            }
+        }
+
+        MemberRecord record;
+        if (log.covers(seen))
+        {
+            TEST_ASSERT_TRUE(changesSince(log, seen));
+            deltas++;
+            for (uint16_t slot = 0; slot < capacity; slot++)
+            {
+                if (changes.change[slot] == MEMBER_CHANGE_DELETE)
+                {
+                    TEST_ASSERT_NOT_EQUAL(0, server[slot][0]);
+                    server[slot][0] = '\0';
+                }
+                else if (changes.change[slot] != 0)
+                {
+                    TEST_ASSERT_EQUAL(changes.change[slot] == MEMBER_CHANGE_ADD, server[slot][0] == '\0');
+                    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(slot, record));
+                    strcpy(server[slot], record.userId);
+                }
+            }
+        }
+        else
+        {
+            reloads++;
+            for (uint16_t slot = 0; slot < capacity; slot++)
+            {
+                bool used = store.read(slot, record) == MEMBER_STORE_OK;
+                strcpy(server[slot], used ? record.userId : "");
+            }
+        }
+        seen = store.revision();
+
+        for (uint16_t slot = 0; slot < capacity; slot++)
+        {
+            bool used = store.read(slot, record) == MEMBER_STORE_OK;
+            TEST_ASSERT_EQUAL_STRING(used ? record.userId : "", server[slot]);
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(0, deltas);
+    TEST_ASSERT_GREATER_THAN(0, reloads);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_net_changes);
+    RUN_TEST(test_history_survives_reboot);
+    RUN_TEST(test_ring_wraps);
+    RUN_TEST(test_log_ahead_of_store);
+    RUN_TEST(test_lost_log_drops_history);
+    RUN_TEST(test_import_resets_history);
+    RUN_TEST(test_format_keeps_counting);
+    RUN_TEST(test_random_replay_matches_store);
+    return UNITY_END();
+}
@@ -0,0 +1,253 @@
+#include <unity.h>
+#include <string.h>
+#include "crc16.h"
+#include "member_store.h"
+#include "sim_fs.h"
+
+#define STORE_PATH "/members.bin"
+#define CAPACITY   64
+
+static RamFileSystem fs;
+
+void setUp(void)
+{
+    fs = RamFileSystem();
+}
+
+void tearDown(void) {}
+
+static MemberRecord member(uint16_t punchingId, const char *userId)
+{
+    MemberRecord record;
+    memset(&record, 0, sizeof(record));
+    record.punchingId1 = punchingId;
+    record.subsEndInSec = 1767225600;
+    strncpy(record.userId, userId, sizeof(record.userId) - 1);
+    strncpy(record.name, "Test Member", sizeof(record.name) - 1);
+    return record;
+}
+
+static size_t slotOffset(uint16_t slot)
+{
+    return sizeof(MemberStoreHeader) + slot * sizeof(MemberRecord);
+}
+
+static bool countRecord(const MemberRecord &record, void *ctx)
+{
+    (*static_cast<int *>(ctx))++;
+    return true;
+}
+
+void test_crc16_check_value(void)
+{
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16Ccitt("123456789", 9));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, crc16Ccitt("", 0));
+    // Chained over two halves, same as in one go
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16Ccitt("6789", 4, crc16Ccitt("12345", 5)));
+}
+
+void test_format_and_layout(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_EQUAL(CAPACITY, store.capacity());
+    TEST_ASSERT_EQUAL(slotOffset(CAPACITY), fs.size(STORE_PATH));
+
+    MemberRecord record;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_NOT_FOUND, store.read(5, record));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_ERR_RANGE, store.read(CAPACITY, record));
+}
+
+void test_write_read_reopen(void)
+{
+    uint32_t revision;
+    {
+        MemberStore store(fs, STORE_PATH);
+        store.begin(CAPACITY);
+        MemberRecord record = member(9, "alice");
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(record));
+        record = member(10, "bob");
+        TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(record));
+        revision = store.revision();
+    }
+
+    // Every change is one record write plus the header
+    size_t size = fs.size(STORE_PATH);
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_EQUAL(size, fs.size(STORE_PATH));
+    TEST_ASSERT_EQUAL_UINT32(revision, store.revision());
+
+    MemberRecord record;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(9, record));
+    TEST_ASSERT_EQUAL_STRING("alice", record.userId);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.findByUserId("bob", record));
+    TEST_ASSERT_EQUAL(10, record.punchingId1);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_NOT_FOUND, store.findByUserId("carol", record));
+
+    MemberRecord outside = member(CAPACITY, "carol");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_ERR_RANGE, store.write(outside));
+}
+
+void test_erase(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    store.begin(CAPACITY);
+    MemberRecord record = member(3, "alice");
+    store.write(record);
+    uint32_t revision = store.revision();
+
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.erase(3));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_NOT_FOUND, store.read(3, record));
+    TEST_ASSERT_GREATER_THAN_UINT32(revision, store.revision());
+    TEST_ASSERT_EQUAL(MEMBER_STORE_ERR_RANGE, store.erase(CAPACITY));
+}
+
+// A power cut halfway through a record write leaves a mix of old and new
+// bytes. Its CRC no longer matches: read() reports it, forEach() skips it
+// and the neighbouring records are untouched.
+void test_torn_write_detected(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    store.begin(CAPACITY);
+    MemberRecord record = member(4, "alice");
+    store.write(record);
+    record = member(5, "bob");
+    store.write(record);
+    record = member(6, "carol");
+    store.write(record);
+
+    MemberRecord replacement = member(5, "robert-the-replacement");
+    replacement.used = 1;
+    fs.writeAt(STORE_PATH, slotOffset(5), &replacement, sizeof(replacement) / 2);
+
+    TEST_ASSERT_EQUAL(MEMBER_STORE_ERR_CRC, store.read(5, record));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(4, record));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(6, record));
+
+    int visited = 0;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.forEach(countRecord, &visited));
+    TEST_ASSERT_EQUAL(2, visited);
+
+    // Writing the slot again repairs it
+    record = member(5, "bob");
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.write(record));
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(5, record));
+}
+
+void test_single_bit_flip_detected(void)
+{
+    MemberStore store(fs, STORE_PATH);
+    store.begin(CAPACITY);
+    MemberRecord record = member(7, "alice");
+    store.write(record);
+
+    for (size_t bit = 0; bit < sizeof(MemberRecord) * 8; bit += 13)
+    {
+        uint8_t byte;
+        size_t offset = slotOffset(7) + bit / 8;
+        fs.readAt(STORE_PATH, offset, &byte, 1);
+        byte ^= 1 << (bit % 8);
+        fs.writeAt(STORE_PATH, offset, &byte, 1);
+
+        MemberStoreStatus status = store.read(7, record);
+        TEST_ASSERT_TRUE(status == MEMBER_STORE_ERR_CRC || status == MEMBER_STORE_NOT_FOUND);
+
+        byte ^= 1 << (bit % 8);
+        fs.writeAt(STORE_PATH, offset, &byte, 1);
+    }
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(7, record));
+}
+
+// A file cut short while growing, or someone else's file, is not mounted
+void test_bad_files_rejected(void)
+{
+    {
+        MemberStore store(fs, STORE_PATH);
+        store.begin(CAPACITY);
+    }
+    fs.truncate(STORE_PATH, slotOffset(CAPACITY) - 1);
+    MemberStore shortStore(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_ERR_FORMAT, shortStore.begin(CAPACITY));
+
+    fs.create(STORE_PATH);
+    fs.append(STORE_PATH, "[{\"userId\":\"alice\"}]", 20);
+    MemberStore jsonStore(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_ERR_FORMAT, jsonStore.begin(CAPACITY));
+}
+
+// A larger capacity grows the file in place and keeps the members
+void test_grow_keeps_records(void)
+{
+    {
+        MemberStore store(fs, STORE_PATH);
+        store.begin(16);
+        MemberRecord record = member(15, "alice");
+        store.write(record);
+    }
+    MemberStore store(fs, STORE_PATH);
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.begin(CAPACITY));
+    TEST_ASSERT_EQUAL(CAPACITY, store.capacity());
+    TEST_ASSERT_EQUAL(slotOffset(CAPACITY), fs.size(STORE_PATH));
+
+    MemberRecord record;
+    TEST_ASSERT_EQUAL(MEMBER_STORE_OK, store.read(15, record));
+    TEST_ASSERT_EQUAL_STRING("alice", record.userId);
+}
+
+void test_json_round_trip(void)
+{
+    JsonDocument doc;
+    JsonObject json = doc.to<JsonObject>();
+    json["userId"] = "alice";
+    json["name"] = "Alice";
+    json["userType"] = 1;
+    json["subscriptionEnd"] = "2026-01-01T00:00:00.000Z";
+    json["subsEndInSec"] = 1767225600;
+    json["punchingId1"] = 12;
+
+    MemberRecord record;
+    TEST_ASSERT_TRUE(memberRecordFromJson(json, record));
+    TEST_ASSERT_EQUAL(12, record.punchingId1);
+    TEST_ASSERT_EQUAL(1, record.userType);
+
+    JsonDocument out;
+    memberRecordToJson(record, out.to<JsonObject>());
+    TEST_ASSERT_EQUAL_STRING("alice", out["userId"] | "");
+    TEST_ASSERT_EQUAL_STRING("2026-01-01T00:00:00.000Z", out["subscriptionEnd"] | "");
+    TEST_ASSERT_EQUAL_UINT32(1767225600, out["subsEndInSec"] | 0u);
+    TEST_ASSERT_FALSE(out["punchingId2"].is<int>());
+
+    JsonDocument missing;
+    missing["name"] = "No ID";
+    TEST_ASSERT_FALSE(memberRecordFromJson(missing.as<JsonObjectConst>(), record));
+}
+
+// 23 characters fit, 24 are refused instead of being cut to a prefix
+void test_json_user_id_limit(void)
+{
+    JsonDocument doc;
+    doc["userId"] = "65f1c2a9e4b0a1b2c3d4e5f";
+    MemberRecord record;
+    TEST_ASSERT_TRUE(memberRecordFromJson(doc.as<JsonObjectConst>(), record));
+    TEST_ASSERT_EQUAL_STRING("65f1c2a9e4b0a1b2c3d4e5f", record.userId);
+
+    doc["userId"] = "65f1c2a9e4b0a1b2c3d4e5f6";
+    TEST_ASSERT_FALSE(memberRecordFromJson(doc.as<JsonObjectConst>(), record));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc16_check_value);
+    RUN_TEST(test_format_and_layout);
+    RUN_TEST(test_write_read_reopen);
+    RUN_TEST(test_erase);
+    RUN_TEST(test_torn_write_detected);
+    RUN_TEST(test_single_bit_flip_detected);
+    RUN_TEST(test_bad_files_rejected);
+    RUN_TEST(test_grow_keeps_records);
+    RUN_TEST(test_json_round_trip);
+    RUN_TEST(test_json_user_id_limit);
+    return UNITY_END();
+}
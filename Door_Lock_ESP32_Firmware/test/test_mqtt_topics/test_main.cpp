@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include "command_queue.h"
+#include "json_arena.h"
+#include "mqtt_topics.h"
+#include "wire_format.h"
+
+// Every operator new in the test binary is counted, so a path that builds
+// a std::string, a String-like buffer or a container shows up here
+static uint32_t heapAllocations = 0;
+
+void *operator new(size_t size)
+{
+    heapAllocations++;
+    void *p = malloc(size != 0 ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static uint8_t arenaBuffer[4096];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void fillId(char *id, size_t length)
+{
+    memset(id, 'a', length);
+    id[length] = '\0';
+}
+
+void test_build_formats_device_topics(void)
+{
+    MqttTopics topics;
+    TEST_ASSERT_FALSE(topics.registered());
+    TEST_ASSERT_EQUAL_STRING("unimanage/registerDevice", topics.get(TOPIC_REGISTER));
+    TEST_ASSERT_EQUAL_STRING("unimanage////callback", topics.get(TOPIC_CALLBACK));
+
+    TEST_ASSERT_TRUE(topics.build("acme", "north", "door-1"));
+    TEST_ASSERT_TRUE(topics.registered());
+    TEST_ASSERT_EQUAL_STRING("unimanage/acme/north/door-1/command", topics.get(TOPIC_COMMAND));
+    TEST_ASSERT_EQUAL_STRING("unimanage/acme/north/door-1/callback", topics.get(TOPIC_CALLBACK));
+    TEST_ASSERT_EQUAL_STRING("unimanage/acme/north/door-1/telemetry", topics.get(TOPIC_TELEMETRY));
+    TEST_ASSERT_EQUAL_STRING("", topics.get(TOPIC_NONE));
+    TEST_ASSERT_EQUAL_STRING("", topics.get((TopicId)99));
+}
+
+void test_match(void)
+{
+    MqttTopics topics;
+    TEST_ASSERT_TRUE(topics.build("acme", "north", "door-1"));
+    TEST_ASSERT_EQUAL(TOPIC_COMMAND, topics.match("unimanage/acme/north/door-1/command"));
+    TEST_ASSERT_EQUAL(TOPIC_REGISTER, topics.match("unimanage/registerDevice"));
+    TEST_ASSERT_EQUAL(TOPIC_NONE, topics.match("unimanage/acme/north/door-2/command"));
+    TEST_ASSERT_EQUAL(TOPIC_NONE, topics.match(nullptr));
+}
+
+void test_empty_ids_rejected(void)
+{
+    MqttTopics topics;
+    TEST_ASSERT_FALSE(topics.build("", "north", "door-1"));
+    TEST_ASSERT_FALSE(topics.build("acme", nullptr, "door-1"));
+    TEST_ASSERT_FALSE(topics.registered());
+    TEST_ASSERT_EQUAL_STRING("unimanage////command", topics.get(TOPIC_COMMAND));
+}
+
+// An ID must survive the round trip through an MQTT_TOPIC_ID_LEN NVS buffer
+void test_id_length_limit(void)
+{
+    MqttTopics topics;
+    char id[MQTT_TOPIC_ID_LEN + 1];
+
+    fillId(id, MQTT_TOPIC_ID_LEN - 1);
+    TEST_ASSERT_TRUE(topics.build("acme", "north", id));
+
+    fillId(id, MQTT_TOPIC_ID_LEN);
+    TEST_ASSERT_FALSE(topics.build("acme", "north", id));
+    TEST_ASSERT_FALSE(topics.build(id, "north", "door-1"));
+    TEST_ASSERT_FALSE(topics.registered());
+}
+
+// Three IDs of 31 characters still fit MQTT_TOPIC_LEN
+void test_longest_ids_fit(void)
+{
+    MqttTopics topics;
+    char id[MQTT_TOPIC_ID_LEN];
+    fillId(id, MQTT_TOPIC_ID_LEN - 1);
+    TEST_ASSERT_TRUE(topics.build(id, id, id));
+    TEST_ASSERT_LESS_THAN(MQTT_TOPIC_LEN, strlen(topics.get(TOPIC_TELEMETRY)));
+}
+
+// mqttCallback() up to the dispatcher and a reply up to the socket: no
+// heap allocation, JSON documents stay inside the request arena
+void test_message_path_does_not_allocate(void)
+{
+    MqttTopics topics;
+    TEST_ASSERT_TRUE(topics.build("acme", "north", "door-1"));
+    static CommandQueue<2, 512> queue;
+    JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+
+    const char *command = "{\"type\":\"deviceInfo\",\"since\":42}";
+    char inboundTopic[MQTT_TOPIC_LEN];
+    strcpy(inboundTopic, "unimanage/acme/north/door-1/command");
+    uint8_t payload[256];
+    size_t published = 0;
+
+    uint32_t before = heapAllocations;
+    for (int round = 0; round < 10; round++)
+    {
+        // Inbound: topic match and copy into a queue slot
+        TEST_ASSERT_EQUAL(TOPIC_COMMAND, topics.match(inboundTopic));
+        TEST_ASSERT_TRUE(queue.push(reinterpret_cast<const uint8_t *>(command), strlen(command)));
+
+        // loop(): parse, reply, serialize for the callback topic
+        size_t length;
+        const char *queued = queue.front(length);
+        {
+            JsonDocument doc(&arena);
+            TEST_ASSERT_FALSE(wireDeserialize(doc, reinterpret_cast<const uint8_t *>(queued), length));
+            TEST_ASSERT_EQUAL_STRING("deviceInfo", doc["type"] | "");
+            TEST_ASSERT_EQUAL_UINT32(42, doc["since"] | 0);
+
+            JsonDocument reply(&arena);
+            reply["type"] = "deviceInfo";
+            reply["status"] = 1;
+            reply["revision"] = 42;
+            const char *topic = topics.get(TOPIC_CALLBACK);
+            TEST_ASSERT_TRUE(topic[0] != '\0');
+            size_t measured = wireMeasure(reply, WIRE_MSGPACK);
+            published = wireSerialize(reply, WIRE_MSGPACK, payload, sizeof(payload));
+            TEST_ASSERT_EQUAL(measured, published);
+        }
+        queue.pop();
+    }
+    uint32_t allocations = heapAllocations - before;
+
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+    TEST_ASSERT_EQUAL_UINT32(0, arena.spills());
+    TEST_ASSERT_EQUAL(0, arena.used());
+    TEST_ASSERT_GREATER_THAN(0, published);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_build_formats_device_topics);
+    RUN_TEST(test_match);
+    RUN_TEST(test_empty_ids_rejected);
+    RUN_TEST(test_id_length_limit);
+    RUN_TEST(test_longest_ids_fit);
+    RUN_TEST(test_message_path_does_not_allocate);
+    return UNITY_END();
+}
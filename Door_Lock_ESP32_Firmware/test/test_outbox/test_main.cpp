@@ -0,0 +1,219 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "outbox.h"
+#include "sim_fs.h"
+
+#define OUTBOX_PATH "/outbox.bin"
+#define SLOTS       4
+
+static RamFileSystem fs;
+
+void setUp(void)
+{
+    fs = RamFileSystem();
+}
+
+void tearDown(void) {}
+
+static uint32_t pushMessage(Outbox &outbox, uint32_t n)
+{
+    char message[48];
+    int length = snprintf(message, sizeof(message), "{\"type\":\"attendance\",\"n\":%u}", n);
+    return outbox.push(reinterpret_cast<const uint8_t *>(message), length);
+}
+
+// Peek the next message and check it is message `n`
+static uint32_t expectNext(Outbox &outbox, uint32_t n)
+{
+    uint8_t payload[OUTBOX_PAYLOAD_LEN];
+    uint16_t length = 0;
+    uint32_t seq = 0;
+    char expected[48];
+    int expectedLength = snprintf(expected, sizeof(expected), "{\"type\":\"attendance\",\"n\":%u}", n);
+
+    TEST_ASSERT_TRUE(outbox.peek(payload, length, seq));
+    TEST_ASSERT_EQUAL(expectedLength, length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, payload, length);
+    return seq;
+}
+
+static size_t slotOffset(uint32_t seq)
+{
+    return sizeof(OutboxHeader) + (seq % SLOTS) * OUTBOX_SLOT_SIZE;
+}
+
+void test_send_and_ack(void)
+{
+    Outbox outbox(fs, OUTBOX_PATH);
+    TEST_ASSERT_TRUE(outbox.begin(SLOTS, true));
+    TEST_ASSERT_EQUAL(sizeof(OutboxHeader) + SLOTS * OUTBOX_SLOT_SIZE, fs.size(OUTBOX_PATH));
+
+    TEST_ASSERT_EQUAL_UINT32(1, pushMessage(outbox, 1));
+    TEST_ASSERT_EQUAL_UINT32(2, pushMessage(outbox, 2));
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.pending());
+
+    uint32_t seq = expectNext(outbox, 1);
+    outbox.markSent(seq);
+    seq = expectNext(outbox, 2);
+    outbox.markSent(seq);
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.unsent());
+
+    uint8_t payload[OUTBOX_PAYLOAD_LEN];
+    uint16_t length;
+    TEST_ASSERT_FALSE(outbox.peek(payload, length, seq));
+
+    TEST_ASSERT_TRUE(outbox.ack(2));
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.pending());
+}
+
+// After a reconnect everything the server has not acked goes out again
+void test_rewind_resends_unacked(void)
+{
+    Outbox outbox(fs, OUTBOX_PATH);
+    outbox.begin(SLOTS, true);
+    for (uint32_t n = 1; n <= 3; n++)
+    {
+        pushMessage(outbox, n);
+        outbox.markSent(n);
+    }
+    outbox.ack(1);
+
+    outbox.rewind();
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.unsent());
+    expectNext(outbox, 2);
+
+    // An ack past the newest message is clamped to it
+    TEST_ASSERT_TRUE(outbox.ack(100));
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.pending());
+    TEST_ASSERT_EQUAL_UINT32(4, pushMessage(outbox, 4));
+}
+
+// Sequence numbers keep counting while the ring reuses its slots
+void test_ring_wraps(void)
+{
+    Outbox outbox(fs, OUTBOX_PATH);
+    outbox.begin(SLOTS, true);
+    for (uint32_t n = 1; n <= 50; n++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(n, pushMessage(outbox, n));
+        if (n % 3 == 0)
+        {
+            for (uint32_t sent = n - 2; sent <= n; sent++)
+            {
+                TEST_ASSERT_EQUAL_UINT32(sent, expectNext(outbox, sent));
+                outbox.markSent(sent);
+            }
+            TEST_ASSERT_TRUE(outbox.ack(n));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.dropped());
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.pending());
+    TEST_ASSERT_EQUAL(sizeof(OutboxHeader) + SLOTS * OUTBOX_SLOT_SIZE, fs.size(OUTBOX_PATH));
+}
+
+void test_full_drops_oldest(void)
+{
+    Outbox outbox(fs, OUTBOX_PATH);
+    outbox.begin(SLOTS, true);
+    for (uint32_t n = 1; n <= SLOTS + 2; n++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(n, pushMessage(outbox, n));
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.dropped());
+    TEST_ASSERT_EQUAL_UINT32(SLOTS, outbox.pending());
+    expectNext(outbox, 3);
+}
+
+void test_full_rejects_newest(void)
+{
+    Outbox outbox(fs, OUTBOX_PATH);
+    outbox.begin(SLOTS, false);
+    for (uint32_t n = 1; n <= SLOTS; n++)
+    {
+        pushMessage(outbox, n);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, pushMessage(outbox, SLOTS + 1));
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.dropped());
+    expectNext(outbox, 1);
+
+    uint8_t big[OUTBOX_PAYLOAD_LEN + 1] = {};
+    outbox.ack(SLOTS);
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.push(big, sizeof(big)));
+}
+
+// A reboot picks up the ring where it was, unacked messages included
+void test_reopen_recovers_position(void)
+{
+    {
+        Outbox outbox(fs, OUTBOX_PATH);
+        outbox.begin(SLOTS, true);
+        for (uint32_t n = 1; n <= 9; n++)
+        {
+            pushMessage(outbox, n);
+            outbox.markSent(n);
+        }
+        outbox.ack(7);
+    }
+
+    Outbox outbox(fs, OUTBOX_PATH);
+    TEST_ASSERT_TRUE(outbox.begin(SLOTS, true));
+    TEST_ASSERT_EQUAL_UINT32(10, outbox.nextSeq());
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.pending());
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.unsent());
+    TEST_ASSERT_EQUAL_UINT32(8, expectNext(outbox, 8));
+}
+
+// A slot torn by a power cut is skipped and counted, the rest still goes
+void test_torn_slot_skipped(void)
+{
+    {
+        Outbox outbox(fs, OUTBOX_PATH);
+        outbox.begin(SLOTS, true);
+        for (uint32_t n = 1; n <= 3; n++)
+        {
+            pushMessage(outbox, n);
+        }
+    }
+    uint8_t garbage[6] = {0xDE, 0xAD, 0xBE, 0xEF, 0x00, 0x11};
+    fs.writeAt(OUTBOX_PATH, slotOffset(2) + sizeof(OutboxSlotHeader) + 4, garbage, sizeof(garbage));
+
+    Outbox outbox(fs, OUTBOX_PATH);
+    outbox.begin(SLOTS, true);
+    TEST_ASSERT_EQUAL_UINT32(1, expectNext(outbox, 1));
+    outbox.markSent(1);
+    TEST_ASSERT_EQUAL_UINT32(3, expectNext(outbox, 3));
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.dropped());
+}
+
+// Another slot count, or a file cut short, starts a fresh outbox
+void test_layout_change_reformats(void)
+{
+    {
+        Outbox outbox(fs, OUTBOX_PATH);
+        outbox.begin(SLOTS, true);
+        pushMessage(outbox, 1);
+    }
+    Outbox resized(fs, OUTBOX_PATH);
+    TEST_ASSERT_TRUE(resized.begin(SLOTS * 2, true));
+    TEST_ASSERT_EQUAL_UINT32(0, resized.pending());
+
+    fs.truncate(OUTBOX_PATH, 100);
+    Outbox truncated(fs, OUTBOX_PATH);
+    TEST_ASSERT_TRUE(truncated.begin(SLOTS * 2, true));
+    TEST_ASSERT_EQUAL(sizeof(OutboxHeader) + SLOTS * 2 * OUTBOX_SLOT_SIZE, fs.size(OUTBOX_PATH));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_send_and_ack);
+    RUN_TEST(test_rewind_resends_unacked);
+    RUN_TEST(test_ring_wraps);
+    RUN_TEST(test_full_drops_oldest);
+    RUN_TEST(test_full_rejects_newest);
+    RUN_TEST(test_reopen_recovers_position);
+    RUN_TEST(test_torn_slot_skipped);
+    RUN_TEST(test_layout_change_reformats);
+    return UNITY_END();
+}
@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <thread>
+#include "spsc_queue.h"
+
+struct Event
+{
+    uint32_t seq;
+    uint32_t check;
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fifo_and_drops(void)
+{
+    SpscQueue<uint32_t, 4> queue;
+    uint32_t item;
+    TEST_ASSERT_FALSE(queue.pop(item));
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push(i));
+    }
+    TEST_ASSERT_FALSE(queue.push(99));
+    TEST_ASSERT_EQUAL_UINT32(1, queue.drops());
+    TEST_ASSERT_EQUAL(4, queue.depth());
+    TEST_ASSERT_EQUAL(4, queue.peak());
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL_UINT32(i, item);
+    }
+    TEST_ASSERT_FALSE(queue.pop(item));
+    TEST_ASSERT_EQUAL(0, queue.depth());
+}
+
+// Indices run far past N and wrap into the slots in order
+void test_wraps(void)
+{
+    SpscQueue<uint32_t, 8> queue;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    uint32_t item;
+    for (int round = 0; round < 1000; round++)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            TEST_ASSERT_TRUE(queue.push(next++));
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            TEST_ASSERT_TRUE(queue.pop(item));
+            TEST_ASSERT_EQUAL_UINT32(expected++, item);
+        }
+    }
+    TEST_ASSERT_EQUAL(5, queue.peak());
+    TEST_ASSERT_EQUAL_UINT32(0, queue.drops());
+}
+
+// The fingerprint task and loop() on two real threads: every event
+// arrives once, whole and in order, or is counted as dropped
+void test_two_threads(void)
+{
+    static SpscQueue<Event, 16> queue;
+    const uint32_t events = 200000;
+
+    std::thread producer([&]() {
+        for (uint32_t seq = 1; seq <= events; seq++)
+        {
+            Event event = {seq, seq * 2654435761u};
+            while (!queue.push(event))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 1;
+    Event event;
+    while (expected <= events)
+    {
+        if (!queue.pop(event))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        TEST_ASSERT_EQUAL_UINT32(expected, event.seq);
+        TEST_ASSERT_EQUAL_UINT32(expected * 2654435761u, event.check);
+        expected++;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(0, queue.depth());
+    TEST_ASSERT_LESS_OR_EQUAL(16, queue.peak());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_and_drops);
+    RUN_TEST(test_wraps);
+    RUN_TEST(test_two_threads);
+    return UNITY_END();
+}
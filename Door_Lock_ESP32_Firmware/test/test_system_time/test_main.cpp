@@ -0,0 +1,205 @@
+#include <unity.h>
+#include "sim_clock.h"
+#include "system_time.h"
+
+#define REF_START 1735689600000000LL // 2025-01-01 in unix microseconds
+#define SECOND    1000000LL
+
+// Same values as the firmware's config.h
+static const SystemTimeConfig config = {500, 2000, 100000, 3600000, 200, 600, 20000};
+
+static SimClock simClock(0);
+
+void setUp(void)
+{
+    simClock = SimClock(0);
+}
+
+void tearDown(void) {}
+
+static void advanceSeconds(double seconds)
+{
+    simClock.advanceUs((uint64_t)(seconds * SECOND));
+}
+
+void test_first_sample_sets_clock(void)
+{
+    SystemTime time(simClock, config);
+    TEST_ASSERT_FALSE(time.valid());
+    TEST_ASSERT_EQUAL_INT64(0, time.nowUs());
+
+    simClock.advanceMs(1234);
+    TEST_ASSERT_EQUAL(TIME_ADJUST_INITIAL, time.discipline(REF_START, simClock.micros64(), 1000));
+    TEST_ASSERT_TRUE(time.valid());
+    TEST_ASSERT_EQUAL_INT64(REF_START, time.nowUs());
+    advanceSeconds(10);
+    TEST_ASSERT_EQUAL_INT64(REF_START + 10 * SECOND, time.nowUs());
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)(REF_START / SECOND) + 10, time.unixTime());
+}
+
+void test_offset_within_tolerance_is_ignored(void)
+{
+    SystemTime time(simClock, config);
+    time.discipline(REF_START, simClock.micros64(), 1000);
+    advanceSeconds(60);
+    TEST_ASSERT_EQUAL(TIME_ADJUST_NONE, time.discipline(REF_START + 60 * SECOND + 400, simClock.micros64(), 1000));
+    TEST_ASSERT_EQUAL_INT64(0, time.slewRemainingUs());
+}
+
+// Behind by less than the step threshold: worked off at slewMaxPpm
+void test_small_lag_is_slewed(void)
+{
+    SystemTime time(simClock, config);
+    time.discipline(REF_START, simClock.micros64(), 1000);
+    TEST_ASSERT_EQUAL(TIME_ADJUST_SLEW, time.discipline(REF_START + SECOND, simClock.micros64(), 1000));
+    TEST_ASSERT_EQUAL_INT64(SECOND, time.slewRemainingUs());
+    TEST_ASSERT_EQUAL_INT64(REF_START, time.nowUs());
+
+    advanceSeconds(1000); // 500 ppm of 1000 s
+    TEST_ASSERT_INT64_WITHIN(1000, SECOND / 2, time.slewRemainingUs());
+    advanceSeconds(1000);
+    TEST_ASSERT_EQUAL_INT64(0, time.slewRemainingUs());
+    TEST_ASSERT_EQUAL_INT64(REF_START + 2001 * SECOND, time.nowUs());
+}
+
+void test_large_lag_is_stepped(void)
+{
+    SystemTime time(simClock, config);
+    time.discipline(REF_START, simClock.micros64(), 1000);
+    advanceSeconds(1);
+    TEST_ASSERT_EQUAL(TIME_ADJUST_STEP, time.discipline(REF_START + 61 * SECOND, simClock.micros64(), 1000));
+    TEST_ASSERT_EQUAL_INT64(REF_START + 61 * SECOND, time.nowUs());
+    TEST_ASSERT_EQUAL_UINT32(1, time.steps());
+}
+
+// Ahead by more than the step threshold: the clock runs slow, never stops
+void test_large_lead_is_slewed_not_held(void)
+{
+    SystemTime time(simClock, config);
+    time.discipline(REF_START + 600 * SECOND, simClock.micros64(), 1000);
+    TEST_ASSERT_EQUAL(TIME_ADJUST_SLEW, time.discipline(REF_START, simClock.micros64(), 1000));
+    TEST_ASSERT_EQUAL_INT64(-600 * SECOND, time.slewRemainingUs());
+
+    int64_t before = time.nowUs();
+    advanceSeconds(1);
+    int64_t advanced = time.nowUs() - before;
+    TEST_ASSERT_INT64_WITHIN(1000, 900000, advanced); // 100000 ppm slower
+
+    // 600 s at 10 % takes 6000 s, then it runs at full rate again
+    advanceSeconds(5999);
+    TEST_ASSERT_EQUAL_INT64(0, time.slewRemainingUs());
+    TEST_ASSERT_EQUAL_INT64(REF_START + 6000 * SECOND, time.nowUs());
+    TEST_ASSERT_EQUAL_UINT32(0, time.stepBacks());
+}
+
+// Ahead by more than an hour: stepped back, and readers follow at once
+void test_absurd_lead_is_stepped_back(void)
+{
+    SystemTime time(simClock, config);
+    time.discipline(REF_START + 86400 * SECOND, simClock.micros64(), 1000);
+    advanceSeconds(1);
+    int64_t before = time.nowUs();
+    TEST_ASSERT_EQUAL_INT64(REF_START + 86401 * SECOND, before);
+
+    TEST_ASSERT_EQUAL(TIME_ADJUST_STEP_BACK, time.discipline(REF_START, simClock.micros64(), 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, time.stepBacks());
+    TEST_ASSERT_EQUAL_INT64(-86401 * SECOND, time.lastOffsetUs());
+    TEST_ASSERT_EQUAL_INT64(REF_START, time.nowUs());
+
+    advanceSeconds(1);
+    TEST_ASSERT_EQUAL_INT64(REF_START + SECOND, time.nowUs());
+}
+
+// nowUs() never goes backwards across slews, steps forward and resamples
+void test_monotonic(void)
+{
+    SystemTime time(simClock, config);
+    time.discipline(REF_START, simClock.micros64(), 1000);
+
+    int64_t last = time.nowUs();
+    int64_t reference = REF_START;
+    const int64_t offsets[] = {-1500000, 800000, -30 * SECOND, 5 * SECOND, -200000, 0};
+    for (int64_t offset : offsets)
+    {
+        for (int i = 0; i < 2000; i++)
+        {
+            simClock.advanceUs(997);
+            reference += 997;
+            int64_t now = time.nowUs();
+            TEST_ASSERT_GREATER_OR_EQUAL(last, now);
+            last = now;
+        }
+        time.discipline(reference + offset, simClock.micros64(), 1000);
+        int64_t now = time.nowUs();
+        TEST_ASSERT_GREATER_OR_EQUAL(last, now);
+        last = now;
+    }
+}
+
+// A crystal 80 ppm fast against precise RTC edges every 10 minutes
+void test_drift_is_learned(void)
+{
+    SystemTime time(simClock, config);
+    const double ppm = 80;
+    int64_t reference = REF_START;
+
+    time.discipline(reference, simClock.micros64(), 5000);
+    for (int sample = 0; sample < 12; sample++)
+    {
+        advanceSeconds(600 * (1 + ppm / 1e6));
+        reference += 600 * SECOND;
+        time.discipline(reference, simClock.micros64(), 5000);
+    }
+    TEST_ASSERT_INT32_WITHIN(5000, -80000, time.driftPpb());
+
+    // Another 10 minutes free running stays within a few ms
+    time.discipline(reference, simClock.micros64(), 5000);
+    advanceSeconds(600 * (1 + ppm / 1e6));
+    reference += 600 * SECOND;
+    TEST_ASSERT_INT64_WITHIN(5000, reference, time.nowUs() - time.slewRemainingUs());
+}
+
+void test_drift_is_clamped(void)
+{
+    SystemTime time(simClock, config);
+    int64_t reference = REF_START;
+    time.discipline(reference, simClock.micros64(), 5000);
+    for (int sample = 0; sample < 6; sample++)
+    {
+        advanceSeconds(600 * (1 + 500 / 1e6)); // Beyond driftMaxPpm
+        reference += 600 * SECOND;
+        time.discipline(reference, simClock.micros64(), 5000);
+    }
+    TEST_ASSERT_EQUAL_INT32(-200000, time.driftPpb());
+}
+
+// Imprecise samples (NTP, whole seconds) never feed the drift estimate
+void test_imprecise_samples_keep_drift(void)
+{
+    SystemTime time(simClock, config);
+    int64_t reference = REF_START;
+    time.discipline(reference, simClock.micros64(), 600000);
+    for (int sample = 0; sample < 6; sample++)
+    {
+        advanceSeconds(600 * (1 + 80 / 1e6));
+        reference += 600 * SECOND;
+        time.discipline(reference, simClock.micros64(), 600000);
+    }
+    TEST_ASSERT_EQUAL_INT32(0, time.driftPpb());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_sets_clock);
+    RUN_TEST(test_offset_within_tolerance_is_ignored);
+    RUN_TEST(test_small_lag_is_slewed);
+    RUN_TEST(test_large_lag_is_stepped);
+    RUN_TEST(test_large_lead_is_slewed_not_held);
+    RUN_TEST(test_absurd_lead_is_stepped_back);
+    RUN_TEST(test_monotonic);
+    RUN_TEST(test_drift_is_learned);
+    RUN_TEST(test_drift_is_clamped);
+    RUN_TEST(test_imprecise_samples_keep_drift);
+    return UNITY_END();
+}
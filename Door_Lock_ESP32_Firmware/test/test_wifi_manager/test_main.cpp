@@ -0,0 +1,269 @@
+#include <unity.h>
+#include "sim_clock.h"
+#include "sim_kv.h"
+#include "sim_wifi.h"
+#include "wifi_cache.h"
+#include "wifi_manager.h"
+
+// Same values as the firmware's config.h
+static const WiFiManagerConfig config = {"Setup", "12345678", 10000, 3000, 2000, 60000, 3, 30000, false};
+
+#define STEP_MS 10 // One loop() pass
+
+static SimClock simClock;
+static SimKeyValueStore nvs;
+static uint32_t randomState;
+
+static uint32_t testRandom()
+{
+    randomState = randomState * 1664525 + 1013904223;
+    return randomState;
+}
+
+void setUp(void)
+{
+    simClock = SimClock();
+    nvs = SimKeyValueStore();
+    randomState = 1;
+}
+
+void tearDown(void) {}
+
+// Run loop() passes for `ms`, collecting the events
+static uint8_t runFor(WiFiManager &manager, uint32_t ms)
+{
+    uint8_t events = 0;
+    for (uint32_t t = 0; t < ms; t += STEP_MS)
+    {
+        events |= manager.update();
+        simClock.advanceMs(STEP_MS);
+    }
+    return events;
+}
+
+static void provision()
+{
+    WiFiCache cache(nvs);
+    cache.saveCredentials("office", "secret");
+}
+
+void test_unconfigured_opens_ap(void)
+{
+    SimWiFiRadio radio(simClock);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+
+    TEST_ASSERT_EQUAL(WIFI_EVENT_AP_STARTED, manager.begin());
+    TEST_ASSERT_TRUE(radio.apUp);
+    TEST_ASSERT_EQUAL(WIFI_MGR_UNCONFIGURED, manager.state());
+    runFor(manager, 5000);
+    TEST_ASSERT_EQUAL_UINT32(0, radio.begins);
+
+    // Credentials from the setup page: joined, saved, AP kept for the page
+    manager.setCredentials("office", "secret");
+    TEST_ASSERT_TRUE(runFor(manager, 3000) & WIFI_EVENT_CONNECTED);
+    TEST_ASSERT_TRUE(radio.apUp);
+    TEST_ASSERT_TRUE(runFor(manager, config.apLingerMs) & WIFI_EVENT_AP_STOPPED);
+    TEST_ASSERT_FALSE(radio.apUp);
+
+    char ssid[WIFI_SSID_LEN];
+    char password[WIFI_PASSWORD_LEN];
+    TEST_ASSERT_TRUE(cache.loadCredentials(ssid, password));
+    TEST_ASSERT_EQUAL_STRING("office", ssid);
+}
+
+// The first boot scans, later boots join the cached BSSID and channel
+void test_cached_link_connects_fast(void)
+{
+    provision();
+    uint32_t firstMs;
+    {
+        SimWiFiRadio radio(simClock);
+        WiFiCache cache(nvs);
+        WiFiManager manager(radio, simClock, cache, testRandom, config);
+        manager.begin();
+        TEST_ASSERT_TRUE(runFor(manager, 5000) & WIFI_EVENT_CONNECTED);
+        TEST_ASSERT_FALSE(manager.fastConnected());
+        firstMs = manager.connectMs();
+    }
+
+    SimWiFiRadio radio(simClock);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+    TEST_ASSERT_TRUE(runFor(manager, 1000) & WIFI_EVENT_CONNECTED);
+    TEST_ASSERT_TRUE(manager.fastConnected());
+    TEST_ASSERT_LESS_THAN(firstMs, manager.connectMs());
+    TEST_ASSERT_EQUAL_UINT32(manager.connectMs(), manager.bootConnectMs());
+    TEST_ASSERT_FALSE(radio.usedStaticIp);
+}
+
+// The access point moved: the cached attempt times out and a scan follows
+// at once, without counting towards the AP fallback
+void test_stale_cache_falls_back_to_scan(void)
+{
+    provision();
+    {
+        SimWiFiRadio radio(simClock);
+        WiFiCache cache(nvs);
+        WiFiManager manager(radio, simClock, cache, testRandom, config);
+        manager.begin();
+        runFor(manager, 5000);
+    }
+
+    SimWiFiRadio radio(simClock);
+    radio.channel = 11;
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+    TEST_ASSERT_TRUE(runFor(manager, config.fastConnectTimeoutMs + 3000) & WIFI_EVENT_CONNECTED);
+    TEST_ASSERT_FALSE(manager.fastConnected());
+    TEST_ASSERT_EQUAL_UINT32(2, manager.attempts());
+    TEST_ASSERT_FALSE(radio.apUp);
+
+    // The new channel is what the next boot tries
+    WiFiLink link;
+    TEST_ASSERT_TRUE(cache.load("office", link));
+    TEST_ASSERT_EQUAL(11, link.channel);
+}
+
+// A link that drops every few seconds for ten minutes: each drop is retried
+// at once, the setup AP never comes up, and reconnecting to the same access
+// point writes nothing to NVS
+void test_flapping_link(void)
+{
+    provision();
+    SimWiFiRadio radio(simClock);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+    runFor(manager, 5000);
+    TEST_ASSERT_TRUE(manager.online());
+    uint32_t writes = cache.writes();
+
+    uint32_t connects = 0;
+    uint32_t disconnects = 0;
+    for (int flap = 0; flap < 100; flap++)
+    {
+        radio.setAvailable(false);
+        uint8_t events = runFor(manager, 200 + (flap % 7) * 100);
+        disconnects += (events & WIFI_EVENT_DISCONNECTED) != 0;
+
+        radio.setAvailable(true);
+        events = runFor(manager, 5000);
+        connects += (events & WIFI_EVENT_CONNECTED) != 0;
+        TEST_ASSERT_TRUE(manager.online());
+        TEST_ASSERT_FALSE(radio.apUp);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(100, disconnects);
+    TEST_ASSERT_EQUAL_UINT32(100, connects);
+    TEST_ASSERT_EQUAL_UINT32(100, manager.drops());
+    TEST_ASSERT_EQUAL_UINT32(writes, cache.writes());
+    // Quick reconnects stay on the cached link
+    TEST_ASSERT_TRUE(manager.fastConnected());
+    TEST_ASSERT_LESS_OR_EQUAL(1000, manager.connectMs());
+}
+
+// The access point is gone for good: retries back off, the setup AP comes
+// up after apFallbackFailures and the station keeps trying next to it
+void test_long_outage(void)
+{
+    provision();
+    SimWiFiRadio radio(simClock);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+    runFor(manager, 5000);
+
+    radio.setAvailable(false);
+    uint8_t events = runFor(manager, 10 * 60 * 1000);
+    TEST_ASSERT_TRUE(events & WIFI_EVENT_AP_STARTED);
+    TEST_ASSERT_TRUE(radio.apUp);
+
+    // Backoff keeps the attempts well below one per connect timeout
+    uint32_t attempts = manager.attempts();
+    TEST_ASSERT_GREATER_OR_EQUAL(10, attempts);
+    TEST_ASSERT_LESS_THAN(40, attempts);
+
+    // Back within one backoff window; the AP lingers, then goes
+    radio.setAvailable(true);
+    events = runFor(manager, config.backoffMaxMs + config.connectTimeoutMs);
+    TEST_ASSERT_TRUE(events & WIFI_EVENT_CONNECTED);
+    events |= runFor(manager, config.apLingerMs + STEP_MS);
+    TEST_ASSERT_TRUE(events & WIFI_EVENT_AP_STOPPED);
+    TEST_ASSERT_FALSE(radio.apUp);
+}
+
+void test_wrong_password(void)
+{
+    SimWiFiRadio radio(simClock);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+    manager.setCredentials("office", "wrong");
+    runFor(manager, 60000);
+    TEST_ASSERT_FALSE(manager.online());
+    TEST_ASSERT_GREATER_THAN_UINT32(0, manager.failures());
+
+    // Nothing is saved until a join works
+    char ssid[WIFI_SSID_LEN];
+    char password[WIFI_PASSWORD_LEN];
+    TEST_ASSERT_FALSE(cache.loadCredentials(ssid, password));
+}
+
+// A scan asked for during a join waits for it, then runs
+void test_scan_waits_for_join(void)
+{
+    provision();
+    SimWiFiRadio radio(simClock);
+    hal::WiFiNetwork network = {};
+    radio.networks.push_back(network);
+    radio.networks.push_back(network);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+
+    manager.requestScan();
+    runFor(manager, 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, radio.scans);
+    TEST_ASSERT_TRUE(manager.scanning());
+
+    uint8_t events = runFor(manager, 6000);
+    TEST_ASSERT_TRUE(events & WIFI_EVENT_SCAN_DONE);
+    TEST_ASSERT_EQUAL_UINT32(1, radio.scans);
+    TEST_ASSERT_EQUAL(2, manager.scanCount());
+    TEST_ASSERT_FALSE(manager.scanning());
+}
+
+void test_forget(void)
+{
+    provision();
+    SimWiFiRadio radio(simClock);
+    WiFiCache cache(nvs);
+    WiFiManager manager(radio, simClock, cache, testRandom, config);
+    manager.begin();
+    runFor(manager, 5000);
+
+    manager.forget();
+    TEST_ASSERT_EQUAL(WIFI_MGR_UNCONFIGURED, manager.state());
+    TEST_ASSERT_TRUE(radio.apUp);
+    char ssid[WIFI_SSID_LEN];
+    char password[WIFI_PASSWORD_LEN];
+    TEST_ASSERT_FALSE(cache.loadCredentials(ssid, password));
+    TEST_ASSERT_EQUAL_STRING("unconfigured", WiFiManager::stateName(manager.state()));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unconfigured_opens_ap);
+    RUN_TEST(test_cached_link_connects_fast);
+    RUN_TEST(test_stale_cache_falls_back_to_scan);
+    RUN_TEST(test_flapping_link);
+    RUN_TEST(test_long_outage);
+    RUN_TEST(test_wrong_password);
+    RUN_TEST(test_scan_waits_for_join);
+    RUN_TEST(test_forget);
+    return UNITY_END();
+}